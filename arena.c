@@ -0,0 +1,97 @@
+/* arena.c */
+
+#include "arena.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_BLOCK_SIZE (64 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (4 * 1024 * 1024)
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+void arena_init(Arena *arena)
+{
+    arena->head = NULL;
+    arena->next_block_size = ARENA_MIN_BLOCK_SIZE;
+}
+
+static ArenaBlock *arena_new_block(Arena *arena, size_t min_size)
+{
+    size_t size = arena->next_block_size;
+    while (size < min_size)
+    {
+        size *= 2;
+    }
+    if (arena->next_block_size < ARENA_MAX_BLOCK_SIZE)
+    {
+        arena->next_block_size *= 2;
+    }
+
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (!block)
+    {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    block->size = size;
+    block->used = 0;
+    block->next = arena->head;
+    arena->head = block;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size)
+    {
+        block = arena_new_block(arena, size);
+    }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+void *arena_calloc(Arena *arena, size_t size)
+{
+    void *memory = arena_alloc(arena, size);
+    memset(memory, 0, size);
+    return memory;
+}
+
+char *arena_strndup(Arena *arena, const char *string, size_t length)
+{
+    char *copy = arena_alloc(arena, length + 1);
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *string)
+{
+    return arena_strndup(arena, string, strlen(string));
+}
+
+void arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
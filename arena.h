@@ -0,0 +1,29 @@
+/* arena.h */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator. Memory is carved out of a short list of large blocks and
+ * is only ever released all at once by arena_free, so allocating a node is
+ * a pointer increment and tearing a whole program down touches each block
+ * once.
+ */
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct
+{
+    ArenaBlock *head;
+    size_t next_block_size;
+} Arena;
+
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_calloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *string);
+char *arena_strndup(Arena *arena, const char *string, size_t length);
+void arena_free(Arena *arena);
+
+#endif /* ARENA_H */
@@ -1,66 +1,217 @@
 /* ast.c */
 
+#define _GNU_SOURCE /* pthread_getattr_np */
 #include "ast.h"
+#include "format.h"
+#include "jit.h"
+#include "vector.h"
+#include <pthread.h>
 #include <stdbool.h>
-#include <setjmp.h>
 #include <string.h>
 
-static jmp_buf break_env;
+/* C stack kept free below the deepest call the tree walker makes */
+#define STACK_RESERVE (256 * 1024)
 
-TypeModifiers current_modifiers = {false, false, false, false, false};
+_Thread_local TypeModifiers current_modifiers = {false, false, false, false, false, false};
 
-variable symbol_table[MAX_VARS];
-int var_count = 0;
+_Thread_local Program *current_program = NULL;
 
-// Symbol table functions
-bool set_int_variable(char *name, int value, TypeModifiers mods)
+extern void yyerror(const char *s);
+
+/* Return the symbol table index for atom, registering it if needed */
+int define_variable_slot(Atom atom)
 {
     for (int i = 0; i < var_count; i++)
     {
-        if (strcmp(symbol_table[i].name, name) == 0)
+        if (symbol_table[i].atom == atom)
         {
-            symbol_table[i].is_float = false;
-            symbol_table[i].value.ivalue = value;
-            symbol_table[i].modifiers = mods;
-            return true;
+            return i;
         }
     }
 
     if (var_count < MAX_VARS)
     {
-        symbol_table[var_count].name = strdup(name);
-        symbol_table[var_count].is_float = false;
-        symbol_table[var_count].value.ivalue = value;
-        symbol_table[var_count].modifiers = mods;
-        var_count++;
-        return true;
+        symbol_table[var_count].atom = atom;
+        symbol_table[var_count].value.lvalue = 0;
+        return var_count++;
     }
-    return false;
+    return -1;
 }
 
-bool set_float_variable(char *name, float value, TypeModifiers mods)
+void enter_scope(Scope *scope)
 {
-    for (int i = 0; i < var_count; i++)
+    current_program->scope = scope;
+    current_program->frame = scope->symbols;
+}
+
+/* Record a function definition; resolve_program reports duplicate names */
+void define_function(Atom name, ValueType return_type, ArgumentList *parameters, ASTNode *body)
+{
+    Program *program = current_program;
+    if (program->function_count == program->function_capacity)
     {
-        if (strcmp(symbol_table[i].name, name) == 0)
+        int capacity = program->function_capacity ? program->function_capacity * 2 : 8;
+        Function **functions = arena_alloc(ast_arena, capacity * sizeof(Function *));
+        if (program->function_count > 0)
+            memcpy(functions, program->functions, program->function_count * sizeof(Function *));
+        program->functions = functions;
+        program->function_capacity = capacity;
+    }
+
+    Function *function = arena_calloc(ast_arena, sizeof(Function));
+    function->name = name;
+    function->return_type = return_type;
+    function->body = body;
+    for (ArgumentList *p = parameters; p; p = p->next)
+    {
+        function->parameter_count++;
+    }
+    function->parameters = arena_alloc(ast_arena, (function->parameter_count + 1) * sizeof(ASTNode *));
+    int i = 0;
+    for (ArgumentList *p = parameters; p; p = p->next)
+    {
+        function->parameters[i++] = p->expr;
+    }
+    program->functions[program->function_count++] = function;
+}
+
+/* Index of the first function named name, or -1 */
+int find_function(Atom name)
+{
+    for (int i = 0; i < current_program->function_count; i++)
+    {
+        if (current_program->functions[i]->name == name)
+            return i;
+    }
+    return -1;
+}
+
+variable *push_frame(int size)
+{
+    Program *program = current_program;
+    if (program->call_depth == MAX_CALL_DEPTH || size > FRAME_STACK_SIZE - program->frame_top)
+    {
+        yyerror("Recursion too deep");
+        return NULL;
+    }
+    if (!program->frames)
+    {
+        // Untouched pages of the stack cost nothing until a call reaches them
+        program->frames = calloc(FRAME_STACK_SIZE, sizeof(variable));
+        if (!program->frames)
         {
-            symbol_table[i].is_float = true;
-            symbol_table[i].value.fvalue = value;
-            symbol_table[i].modifiers = mods;
-            return true;
+            yyerror("Out of memory");
+            program->halted = true;
+            return NULL;
         }
     }
 
-    if (var_count < MAX_VARS)
+    variable *frame = program->frames + program->frame_top;
+    memset(frame, 0, size * sizeof(variable));
+    program->frame_top += size;
+    program->call_depth++;
+    return frame;
+}
+
+void pop_frame(variable *frame, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        if (frame[i].elements)
+            release_array(&frame[i]);
+    }
+    current_program->frame_top -= size;
+    current_program->call_depth--;
+}
+
+int variable_sizeof(const variable *var)
+{
+    switch (var->type)
+    {
+    case TYPE_FLOAT:
+        return sizeof(float);
+    case TYPE_DOUBLE:
+        return sizeof(double);
+    case TYPE_LONG:
+        return sizeof(int64_t);
+    case TYPE_SHORT:
+        return sizeof(short);
+    case TYPE_UNSIGNED:
+        return sizeof(unsigned int);
+    case TYPE_BOOL:
+        return sizeof(bool);
+    case TYPE_CHAR:
+        return sizeof(char);
+    default:
+        return sizeof(int);
+    }
+}
+
+#define ARRAY_ALIGNMENT 64
+
+/* Values the array_element functions hand out in place of an element that does not exist */
+static _Thread_local Element scratch_element;
+static _Thread_local Value scratch_wide_element;
+static _Thread_local char scratch_byte_element;
+static _Thread_local short scratch_short_element;
+
+bool declare_array(variable *var, int length, int element_size)
+{
+    release_array(var);
+    if (length < 0)
     {
-        symbol_table[var_count].name = strdup(name);
-        symbol_table[var_count].is_float = true;
-        symbol_table[var_count].value.fvalue = value;
-        symbol_table[var_count].modifiers = mods;
-        var_count++;
+        yyerror("Negative array length");
         return true;
     }
-    return false;
+    if (length == 0)
+        return true;
+
+    size_t size = ((size_t)length * (size_t)element_size + ARRAY_ALIGNMENT - 1) & ~(size_t)(ARRAY_ALIGNMENT - 1);
+    var->elements = aligned_alloc(ARRAY_ALIGNMENT, size);
+    if (!var->elements)
+    {
+        yyerror("Out of memory");
+        current_program->halted = true;
+        return false;
+    }
+    memset(var->elements, 0, size);
+    var->length = length;
+    return true;
+}
+
+void release_array(variable *var)
+{
+    free(var->elements);
+    var->elements = NULL;
+    var->length = 0;
+}
+
+Element *array_index_error(void)
+{
+    yyerror("Array index out of bounds");
+    scratch_element.ivalue = 0;
+    return &scratch_element;
+}
+
+Value *wide_array_index_error(void)
+{
+    yyerror("Array index out of bounds");
+    scratch_wide_element.lvalue = 0;
+    return &scratch_wide_element;
+}
+
+char *byte_array_index_error(void)
+{
+    yyerror("Array index out of bounds");
+    scratch_byte_element = 0;
+    return &scratch_byte_element;
+}
+
+short *short_array_index_error(void)
+{
+    yyerror("Array index out of bounds");
+    scratch_short_element = 0;
+    return &scratch_short_element;
 }
 
 void reset_modifiers(void)
@@ -68,6 +219,8 @@ void reset_modifiers(void)
     current_modifiers.is_volatile = false;
     current_modifiers.is_signed = false;
     current_modifiers.is_unsigned = false;
+    current_modifiers.is_boolean = false;
+    current_modifiers.is_const = false;
 }
 
 TypeModifiers get_current_modifiers(void)
@@ -77,71 +230,226 @@ TypeModifiers get_current_modifiers(void)
     return mods;
 }
 
-void execute_switch_statement(ASTNode *node)
+static int compare_switch_entries(const void *a, const void *b)
+{
+    int left = ((const SwitchEntry *)a)->value;
+    int right = ((const SwitchEntry *)b)->value;
+    return (left > right) - (left < right);
+}
+
+/* Case labels must already be constants (typecheck_program ensures this) */
+SwitchTable *build_switch_table(CaseNode *cases)
 {
-    int switch_value = evaluate_expression(node->data.switch_stmt.expression);
-    CaseNode *current_case = node->data.switch_stmt.cases;
-    int matched = 0;
+    SwitchTable *table = arena_calloc(ast_arena, sizeof(SwitchTable));
+    table->default_arm = -1;
+
+    for (CaseNode *cn = cases; cn; cn = cn->next)
+    {
+        table->arm_count++;
+        if (!cn->value)
+            break;
+    }
 
-    if (setjmp(break_env) == 0)
+    table->arms = arena_alloc(ast_arena, table->arm_count * sizeof(CaseNode *));
+    table->entries = arena_alloc(ast_arena, table->arm_count * sizeof(SwitchEntry));
+    CaseNode *cn = cases;
+    for (int i = 0; i < table->arm_count; i++, cn = cn->next)
     {
-        while (current_case)
+        table->arms[i] = cn;
+        if (!cn->value)
         {
-            if (current_case->value)
-            {
-                int case_value = evaluate_expression(current_case->value);
-                if (case_value == switch_value || matched)
-                {
-                    matched = 1;
-                    execute_statements(current_case->statements);
-                }
-            }
-            else
-            {
-                // Default case
-                if (matched || !matched)
-                {
-                    execute_statements(current_case->statements);
-                    break;
-                }
-            }
-            current_case = current_case->next;
+            table->default_arm = i;
+            continue;
         }
+        table->entries[table->entry_count].value = cn->value->data.value;
+        table->entries[table->entry_count].arm = i;
+        table->entry_count++;
     }
-    else
+    if (table->entry_count == 0)
+        return table;
+
+    qsort(table->entries, table->entry_count, sizeof(SwitchEntry), compare_switch_entries);
+    long long min = table->entries[0].value;
+    long long range = (long long)table->entries[table->entry_count - 1].value - min + 1;
+
+    // Use a dense table unless more than half of it would be holes
+    if (range <= 2LL * table->entry_count)
     {
-        // Break encountered; do nothing
+        table->min = (int)min;
+        table->range = (int)range;
+        table->dense = arena_alloc(ast_arena, range * sizeof(int));
+        for (long long i = 0; i < range; i++)
+        {
+            table->dense[i] = table->default_arm;
+        }
+        for (int i = table->entry_count - 1; i >= 0; i--)
+        {
+            table->dense[table->entries[i].value - table->min] = table->entries[i].arm;
+        }
     }
+    return table;
+}
+
+/* Index of the arm execution starts in for value, or -1 if none */
+int switch_table_lookup(const SwitchTable *table, int value)
+{
+    if (table->range)
+    {
+        unsigned int index = (unsigned int)value - (unsigned int)table->min;
+        return index < (unsigned int)table->range ? table->dense[index] : table->default_arm;
+    }
+
+    int low = 0;
+    int high = table->entry_count - 1;
+    while (low <= high)
+    {
+        int mid = low + (high - low) / 2;
+        int label = table->entries[mid].value;
+        if (label == value)
+            return table->entries[mid].arm;
+        if (label < value)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return table->default_arm;
+}
+
+/*
+ * `bruh` ends the switch; `grind` and `bussin` are passed on.
+ */
+ControlFlow execute_switch_statement(ASTNode *node)
+{
+    SwitchTable *table = node->data.switch_stmt.table;
+    if (!table)
+    {
+        table = node->data.switch_stmt.table = build_switch_table(node->data.switch_stmt.cases);
+    }
+
+    int arm = switch_table_lookup(table, evaluate_expression_int(node->data.switch_stmt.expression));
+    ControlFlow flow = FLOW_NORMAL;
+    if (arm < 0)
+        return flow;
+
+    // Fall through from the matching arm to the end of the reachable arms
+    for (; arm < table->arm_count; arm++)
+    {
+        flow = execute_statements(table->arms[arm]->statements);
+        if (flow != FLOW_NORMAL)
+            break;
+    }
+    return flow == FLOW_BREAK ? FLOW_NORMAL : flow;
 }
 
-/* Include the symbol table functions */
-extern bool set_variable(char *name, int value, TypeModifiers mod);
-extern int get_variable(char *name);
-extern void yyerror(const char *s);
 extern void yapping(const char *format, ...);
 extern void yappin(const char *format, ...);
 extern void baka(const char *format, ...);
-extern TypeModifiers get_variable_modifiers(const char *name);
 
 /* Function implementations */
 
+Program *create_program(void)
+{
+    Program *program = calloc(1, sizeof(Program));
+    arena_init(&program->arena);
+    intern_init(&program->atoms, &program->arena);
+    program->scope = &program->main;
+    program->frame = program->main.symbols;
+    return program;
+}
+
+/*
+ * Release a program in one step. Every node, list, string and function
+ * belongs to the program's arena, and its symbol tables only refer into
+ * it apart from array storage, so all of it goes along with the frame
+ * stack and the code the JIT compiled for its loops.
+ */
+void free_program(Program *program)
+{
+    if (!program)
+        return;
+    if (current_program == program)
+        current_program = NULL;
+    // A chunk loaded from a .brc file declares arrays in any slot
+    for (int i = 0; i < MAX_VARS; i++)
+    {
+        release_array(&program->main.symbols[i]);
+    }
+    free(program->frames);
+    jit_release(program);
+    intern_free(&program->atoms);
+    arena_free(&program->arena);
+    free(program);
+}
+
+static ASTNode *new_node(NodeType type)
+{
+    ASTNode *node = arena_calloc(ast_arena, sizeof(ASTNode));
+    node->type = type;
+    return node;
+}
+
 ASTNode *create_number_node(int value)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_NUMBER;
+    ASTNode *node = new_node(NODE_NUMBER);
     node->data.value = value;
     node->modifiers.is_unsigned = current_modifiers.is_unsigned;
     return node;
 }
 
-ASTNode *create_float_node(float value)
+ASTNode *create_long_node(int64_t value)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_FLOAT;
-    node->data.fvalue = value;
+    ASTNode *node = new_node(NODE_LONG);
+    node->data.lvalue = value;
     return node;
 }
 
+ASTNode *create_float_node(double value)
+{
+    ASTNode *node = new_node(NODE_FLOAT);
+    node->data.fvalue = (float)value;
+    node->data.dvalue = value;
+    return node;
+}
+
+/* The element an index node reads or writes */
+static Element *element(ASTNode *node)
+{
+    variable *var = &symbol_table[node->slot];
+    int index = evaluate_expression_int(node->data.element.index);
+    return node->data.element.unchecked ? &var->elements[index] : array_element(var, index);
+}
+
+static Value *wide_element(ASTNode *node)
+{
+    variable *var = &symbol_table[node->slot];
+    int index = evaluate_expression_int(node->data.element.index);
+    return node->data.element.unchecked ? &var->wide_elements[index] : wide_array_element(var, index);
+}
+
+/* An element of an int-valued array, read at its width */
+static int int_element(ASTNode *node)
+{
+    variable *var = &symbol_table[node->slot];
+    int index = evaluate_expression_int(node->data.element.index);
+    bool unchecked = node->data.element.unchecked;
+    switch (element_size(node->value_type))
+    {
+    case sizeof(char):
+        return unchecked ? var->byte_elements[index] : *byte_array_element(var, index);
+    case sizeof(short):
+        return unchecked ? var->short_elements[index] : *short_array_element(var, index);
+    default:
+        return unchecked ? var->elements[index].ivalue : array_element(var, index)->ivalue;
+    }
+}
+
+/*
+ * The evaluators below only accept type-checked trees: every node reaching
+ * evaluate_expression_float has TYPE_FLOAT, every node reaching
+ * evaluate_expression_long TYPE_LONG, every node reaching
+ * evaluate_expression_double TYPE_DOUBLE and every node reaching
+ * evaluate_expression_int another type held in an int.
+ */
 float evaluate_expression_float(ASTNode *node)
 {
     if (!node)
@@ -151,277 +459,459 @@ float evaluate_expression_float(ASTNode *node)
     {
     case NODE_FLOAT:
         return node->data.fvalue;
-    case NODE_NUMBER:
-        return (float)node->data.value;
     case NODE_IDENTIFIER:
-    {
-        char *name = node->data.name;
-        for (int i = 0; i < var_count; i++)
-        {
-            if (strcmp(symbol_table[i].name, name) == 0)
-            {
-                return symbol_table[i].is_float ? symbol_table[i].value.fvalue : (float)symbol_table[i].value.ivalue;
-            }
-        }
-        yyerror("Undefined variable");
-        return 0.0f;
-    }
-    case NODE_OPERATION:
+        return symbol_table[node->slot].value.fvalue;
+    case NODE_INDEX:
+        return element(node)->fvalue;
+    case NODE_FUNC_CALL:
+        return call_function(node).fvalue;
+    case NODE_FLOAT_ADD:
+        return evaluate_expression_float(node->data.op.left) + evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_SUB:
+        return evaluate_expression_float(node->data.op.left) - evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_MUL:
+        return evaluate_expression_float(node->data.op.left) * evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_DIV:
     {
         float left = evaluate_expression_float(node->data.op.left);
         float right = evaluate_expression_float(node->data.op.right);
-
-        switch (node->data.op.op)
+        if (right == 0.0f)
         {
-        case OP_PLUS:
-            return left + right;
-        case OP_MINUS:
-            return left - right;
-        case OP_TIMES:
-            return left * right;
-        case OP_DIVIDE:
-            if (right == 0.0f)
-            {
-                yyerror("Division by zero");
-                return 0.0f;
-            }
-            return left / right;
-        case OP_LT:
-            return left < right ? 1.0f : 0.0f;
-        case OP_GT:
-            return left > right ? 1.0f : 0.0f;
-        case OP_LE:
-            return left <= right ? 1.0f : 0.0f;
-        case OP_GE:
-            return left >= right ? 1.0f : 0.0f;
-        case OP_EQ:
-            return left == right ? 1.0f : 0.0f;
-        case OP_NE:
-            return left != right ? 1.0f : 0.0f;
-        default:
-            yyerror("Invalid operator for float operation");
-            return 0.0f;
-        }
-    }
-    case NODE_UNARY_OPERATION:
-    {
-        float operand = evaluate_expression_float(node->data.unary.operand);
-        switch (node->data.unary.op)
-        {
-        case OP_NEG:
-            return -operand;
-        default:
-            yyerror("Unknown unary operator for float");
+            yyerror("Division by zero");
             return 0.0f;
         }
+        return left / right;
     }
+    case NODE_FLOAT_NEG:
+        return -evaluate_expression_float(node->data.unary.operand);
+    case NODE_INT_TO_FLOAT:
+        return (float)evaluate_expression_int(node->data.unary.operand);
+    case NODE_UNSIGNED_TO_FLOAT:
+        return (float)(unsigned int)evaluate_expression_int(node->data.unary.operand);
+    case NODE_LONG_TO_FLOAT:
+        return (float)evaluate_expression_long(node->data.unary.operand);
+    case NODE_DOUBLE_TO_FLOAT:
+        return (float)evaluate_expression_double(node->data.unary.operand);
     default:
         yyerror("Invalid float expression");
         return 0.0f;
     }
 }
 
-int evaluate_expression_int(ASTNode *node)
+double evaluate_expression_double(ASTNode *node)
 {
     if (!node)
-        return 0;
+        return 0.0;
 
     switch (node->type)
     {
-    case NODE_NUMBER:
-        return node->data.value;
-    case NODE_BOOLEAN:
-        return node->data.value; // Already 1 or 0
-    case NODE_CHAR:              // Add explicit handling for characters
-        return node->data.value;
-    case NODE_FLOAT:
-        yyerror("Cannot use float in integer context");
-        return (int)node->data.fvalue;
-    case NODE_SIZEOF:
+    case NODE_DOUBLE:
+        return node->data.dvalue;
+    case NODE_IDENTIFIER:
+        return symbol_table[node->slot].value.dvalue;
+    case NODE_INDEX:
+        return wide_element(node)->dvalue;
+    case NODE_FUNC_CALL:
+        return call_function(node).dvalue;
+    case NODE_DOUBLE_ADD:
+        return evaluate_expression_double(node->data.op.left) + evaluate_expression_double(node->data.op.right);
+    case NODE_DOUBLE_SUB:
+        return evaluate_expression_double(node->data.op.left) - evaluate_expression_double(node->data.op.right);
+    case NODE_DOUBLE_MUL:
+        return evaluate_expression_double(node->data.op.left) * evaluate_expression_double(node->data.op.right);
+    case NODE_DOUBLE_DIV:
     {
-        char *name = node->data.name;
-        for (int i = 0; i < var_count; i++)
+        double left = evaluate_expression_double(node->data.op.left);
+        double right = evaluate_expression_double(node->data.op.right);
+        if (right == 0.0)
         {
-            if (strcmp(symbol_table[i].name, name) == 0)
-            {
-                if (symbol_table[i].is_float)
-                {
-                    return sizeof(float);
-                }
-                else if (symbol_table[i].modifiers.is_unsigned)
-                {
-                    return sizeof(unsigned int);
-                }
-                else if (symbol_table[i].modifiers.is_boolean)
-                {
-                    return sizeof(bool);
-                }
-                else
-                {
-                    return sizeof(int);
-                }
-            }
+            yyerror("Division by zero");
+            return 0.0;
         }
-        yyerror("Undefined variable in sizeof");
-        return 0;
+        return left / right;
+    }
+    case NODE_DOUBLE_NEG:
+        return -evaluate_expression_double(node->data.unary.operand);
+    case NODE_INT_TO_DOUBLE:
+        return evaluate_expression_int(node->data.unary.operand);
+    case NODE_UNSIGNED_TO_DOUBLE:
+        return (unsigned int)evaluate_expression_int(node->data.unary.operand);
+    case NODE_LONG_TO_DOUBLE:
+        return (double)evaluate_expression_long(node->data.unary.operand);
+    case NODE_FLOAT_TO_DOUBLE:
+        return evaluate_expression_float(node->data.unary.operand);
+    default:
+        yyerror("Invalid gigachad expression");
+        return 0.0;
     }
+}
+
+/* Wrapping 64-bit arithmetic, as WRAP below for ints */
+#define WRAP64(left, operator, right) ((int64_t)((uint64_t)(left) operator (uint64_t)(right)))
+
+int64_t evaluate_expression_long(ASTNode *node)
+{
+    if (!node)
+        return 0;
+
+    switch (node->type)
+    {
+    case NODE_LONG:
+        return node->data.lvalue;
     case NODE_IDENTIFIER:
+        return symbol_table[node->slot].value.lvalue;
+    case NODE_INDEX:
+        return wide_element(node)->lvalue;
+    case NODE_FUNC_CALL:
+        return call_function(node).lvalue;
+    case NODE_LONG_ADD:
+        return WRAP64(evaluate_expression_long(node->data.op.left), +, evaluate_expression_long(node->data.op.right));
+    case NODE_LONG_SUB:
+        return WRAP64(evaluate_expression_long(node->data.op.left), -, evaluate_expression_long(node->data.op.right));
+    case NODE_LONG_MUL:
+        return WRAP64(evaluate_expression_long(node->data.op.left), *, evaluate_expression_long(node->data.op.right));
+    case NODE_LONG_DIV:
+    case NODE_LONG_MOD:
     {
-        char *name = node->data.name;
-        for (int i = 0; i < var_count; i++)
+        int64_t left = evaluate_expression_long(node->data.op.left);
+        int64_t right = evaluate_expression_long(node->data.op.right);
+        if (right == 0)
         {
-            if (strcmp(symbol_table[i].name, name) == 0)
-            {
-                if (symbol_table[i].is_float)
-                {
-                    yyerror("Cannot use float variable in integer context");
-                    return (int)symbol_table[i].value.fvalue;
-                }
-                return symbol_table[i].value.ivalue;
-            }
+            yyerror("Division by zero");
+            return 0;
         }
-        yyerror("Undefined variable");
+        // The one quotient that overflows wraps, and its remainder is zero
+        if (right == -1)
+            return node->type == NODE_LONG_DIV ? WRAP64(0, -, left) : 0;
+        return node->type == NODE_LONG_DIV ? left / right : left % right;
+    }
+    case NODE_LONG_NEG:
+        return WRAP64(0, -, evaluate_expression_long(node->data.unary.operand));
+    case NODE_INT_TO_LONG:
+        return evaluate_expression_int(node->data.unary.operand);
+    case NODE_UNSIGNED_TO_LONG:
+        return (unsigned int)evaluate_expression_int(node->data.unary.operand);
+    case NODE_FLOAT_TO_LONG:
+        return (int64_t)evaluate_expression_float(node->data.unary.operand);
+    case NODE_DOUBLE_TO_LONG:
+        return (int64_t)evaluate_expression_double(node->data.unary.operand);
+    default:
+        yyerror("Invalid giga expression");
         return 0;
     }
-    case NODE_OPERATION:
-    {
-        // Special handling for logical operations
-        if (node->data.op.op == OP_AND || node->data.op.op == OP_OR)
-        {
-            int left = evaluate_expression_int(node->data.op.left);
-            int right = evaluate_expression_int(node->data.op.right);
-
-            switch (node->data.op.op)
-            {
-            case OP_AND:
-                return left && right;
-            case OP_OR:
-                return left || right;
-            default:
-                break;
-            }
-        }
+}
+
+/* Wrapping integer arithmetic, matching two's complement hardware */
+#define WRAP(left, operator, right) ((int)((unsigned int)(left) operator (unsigned int)(right)))
+
+int evaluate_expression_int(ASTNode *node)
+{
+    if (!node)
+        return 0;
 
-        // Regular integer operations
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_BOOLEAN:
+    case NODE_CHAR:
+        return node->data.value;
+    case NODE_IDENTIFIER:
+        return symbol_table[node->slot].value.ivalue;
+    case NODE_INDEX:
+        return int_element(node);
+    case NODE_FUNC_CALL:
+        return call_function(node).ivalue;
+    case NODE_INT_ADD:
+        return WRAP(evaluate_expression_int(node->data.op.left), +, evaluate_expression_int(node->data.op.right));
+    case NODE_INT_SUB:
+        return WRAP(evaluate_expression_int(node->data.op.left), -, evaluate_expression_int(node->data.op.right));
+    case NODE_INT_MUL:
+        return WRAP(evaluate_expression_int(node->data.op.left), *, evaluate_expression_int(node->data.op.right));
+    case NODE_INT_DIV:
+    case NODE_INT_MOD:
+    case NODE_UNSIGNED_DIV:
+    case NODE_UNSIGNED_MOD:
+    {
         int left = evaluate_expression_int(node->data.op.left);
         int right = evaluate_expression_int(node->data.op.right);
-
-        switch (node->data.op.op)
+        if (right == 0)
         {
-        case OP_PLUS:
-            return left + right;
-        case OP_MINUS:
-            return left - right;
-        case OP_TIMES:
-            return left * right;
-        case OP_DIVIDE:
-            if (right == 0)
-            {
-                yyerror("Division by zero");
-                return 0;
-            }
-            return left / right;
-        case OP_MOD:
-            if (right == 0)
-            {
-                yyerror("Division by zero");
-                return 0;
-            }
-            // Explicitly handle unsigned modulo
-            if (node->modifiers.is_unsigned)
-            {
-                unsigned int ul = (unsigned int)left;
-                unsigned int ur = (unsigned int)right;
-                return ul % ur;
-            }
-            return left % right;
-        case OP_LT:
-            return left < right;
-        case OP_GT:
-            return left > right;
-        case OP_LE:
-            return left <= right;
-        case OP_GE:
-            return left >= right;
-        case OP_EQ:
-            return left == right;
-        case OP_NE:
-            return left != right;
-        default:
-            yyerror("Unknown operator");
+            yyerror("Division by zero");
             return 0;
         }
-    }
-    case NODE_UNARY_OPERATION:
-    {
-        int operand = evaluate_expression_int(node->data.unary.operand);
-        switch (node->data.unary.op)
+        switch (node->type)
         {
-        case OP_NEG:
-            return -operand;
+        // INT_MIN / -1 overflows, so dividing by -1 negates, wrapping like the other operators
+        case NODE_INT_DIV:
+            return right == -1 ? (int)(0u - (unsigned int)left) : left / right;
+        case NODE_INT_MOD:
+            return right == -1 ? 0 : left % right;
+        case NODE_UNSIGNED_DIV:
+            return (unsigned int)left / (unsigned int)right;
         default:
-            yyerror("Unknown unary operator");
-            return 0;
+            return (unsigned int)left % (unsigned int)right;
         }
     }
+    case NODE_INT_LT:
+        return evaluate_expression_int(node->data.op.left) < evaluate_expression_int(node->data.op.right);
+    case NODE_INT_GT:
+        return evaluate_expression_int(node->data.op.left) > evaluate_expression_int(node->data.op.right);
+    case NODE_INT_LE:
+        return evaluate_expression_int(node->data.op.left) <= evaluate_expression_int(node->data.op.right);
+    case NODE_INT_GE:
+        return evaluate_expression_int(node->data.op.left) >= evaluate_expression_int(node->data.op.right);
+    case NODE_INT_EQ:
+        return evaluate_expression_int(node->data.op.left) == evaluate_expression_int(node->data.op.right);
+    case NODE_INT_NE:
+        return evaluate_expression_int(node->data.op.left) != evaluate_expression_int(node->data.op.right);
+    case NODE_UNSIGNED_LT:
+        return (unsigned int)evaluate_expression_int(node->data.op.left) < (unsigned int)evaluate_expression_int(node->data.op.right);
+    case NODE_UNSIGNED_GT:
+        return (unsigned int)evaluate_expression_int(node->data.op.left) > (unsigned int)evaluate_expression_int(node->data.op.right);
+    case NODE_UNSIGNED_LE:
+        return (unsigned int)evaluate_expression_int(node->data.op.left) <= (unsigned int)evaluate_expression_int(node->data.op.right);
+    case NODE_UNSIGNED_GE:
+        return (unsigned int)evaluate_expression_int(node->data.op.left) >= (unsigned int)evaluate_expression_int(node->data.op.right);
+    case NODE_FLOAT_LT:
+        return evaluate_expression_float(node->data.op.left) < evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_GT:
+        return evaluate_expression_float(node->data.op.left) > evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_LE:
+        return evaluate_expression_float(node->data.op.left) <= evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_GE:
+        return evaluate_expression_float(node->data.op.left) >= evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_EQ:
+        return evaluate_expression_float(node->data.op.left) == evaluate_expression_float(node->data.op.right);
+    case NODE_FLOAT_NE:
+        return evaluate_expression_float(node->data.op.left) != evaluate_expression_float(node->data.op.right);
+    case NODE_LONG_LT:
+    case NODE_LONG_GT:
+    case NODE_LONG_LE:
+    case NODE_LONG_GE:
+    case NODE_LONG_EQ:
+    case NODE_LONG_NE:
+    case NODE_DOUBLE_LT:
+    case NODE_DOUBLE_GT:
+    case NODE_DOUBLE_LE:
+    case NODE_DOUBLE_GE:
+    case NODE_DOUBLE_EQ:
+    case NODE_DOUBLE_NE:
+    case NODE_LOGICAL_AND:
+    case NODE_LOGICAL_OR:
+        return evaluate_condition(node);
+    case NODE_INT_NEG:
+        return WRAP(0, -, evaluate_expression_int(node->data.unary.operand));
+    case NODE_FLOAT_TO_INT:
+        return (int)evaluate_expression_float(node->data.unary.operand);
+    case NODE_FLOAT_TO_UNSIGNED:
+        return (int)(unsigned int)evaluate_expression_float(node->data.unary.operand);
+    case NODE_FLOAT_TO_BOOL:
+        return evaluate_expression_float(node->data.unary.operand) != 0.0f;
+    case NODE_INT_TO_BOOL:
+        return evaluate_expression_int(node->data.unary.operand) != 0;
+    case NODE_INT_TO_CHAR:
+        return (char)evaluate_expression_int(node->data.unary.operand);
+    case NODE_INT_TO_SHORT:
+        return (short)evaluate_expression_int(node->data.unary.operand);
+    case NODE_LONG_TO_INT:
+        return (int)evaluate_expression_long(node->data.unary.operand);
+    case NODE_LONG_TO_BOOL:
+        return evaluate_expression_long(node->data.unary.operand) != 0;
+    case NODE_DOUBLE_TO_INT:
+        return (int)evaluate_expression_double(node->data.unary.operand);
+    case NODE_DOUBLE_TO_UNSIGNED:
+        return (int)(unsigned int)evaluate_expression_double(node->data.unary.operand);
+    case NODE_DOUBLE_TO_BOOL:
+        return evaluate_expression_double(node->data.unary.operand) != 0.0;
     default:
         yyerror("Invalid integer expression");
         return 0;
     }
 }
 
+/*
+ * Decide a branch on a type-checked condition. Comparisons are tested
+ * directly rather than materialized as 0 or 1 and tested again, and
+ * `&&` and `||` evaluate their right operand only when the left one does
+ * not settle the result.
+ */
+bool evaluate_condition(ASTNode *node)
+{
+    ASTNode *left = node->data.op.left;
+    ASTNode *right = node->data.op.right;
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_BOOLEAN:
+    case NODE_CHAR:
+        return node->data.value != 0;
+    case NODE_INT_LT:
+        return evaluate_expression_int(left) < evaluate_expression_int(right);
+    case NODE_INT_GT:
+        return evaluate_expression_int(left) > evaluate_expression_int(right);
+    case NODE_INT_LE:
+        return evaluate_expression_int(left) <= evaluate_expression_int(right);
+    case NODE_INT_GE:
+        return evaluate_expression_int(left) >= evaluate_expression_int(right);
+    case NODE_INT_EQ:
+        return evaluate_expression_int(left) == evaluate_expression_int(right);
+    case NODE_INT_NE:
+        return evaluate_expression_int(left) != evaluate_expression_int(right);
+    case NODE_UNSIGNED_LT:
+        return (unsigned int)evaluate_expression_int(left) < (unsigned int)evaluate_expression_int(right);
+    case NODE_UNSIGNED_GT:
+        return (unsigned int)evaluate_expression_int(left) > (unsigned int)evaluate_expression_int(right);
+    case NODE_UNSIGNED_LE:
+        return (unsigned int)evaluate_expression_int(left) <= (unsigned int)evaluate_expression_int(right);
+    case NODE_UNSIGNED_GE:
+        return (unsigned int)evaluate_expression_int(left) >= (unsigned int)evaluate_expression_int(right);
+    case NODE_FLOAT_LT:
+        return evaluate_expression_float(left) < evaluate_expression_float(right);
+    case NODE_FLOAT_GT:
+        return evaluate_expression_float(left) > evaluate_expression_float(right);
+    case NODE_FLOAT_LE:
+        return evaluate_expression_float(left) <= evaluate_expression_float(right);
+    case NODE_FLOAT_GE:
+        return evaluate_expression_float(left) >= evaluate_expression_float(right);
+    case NODE_FLOAT_EQ:
+        return evaluate_expression_float(left) == evaluate_expression_float(right);
+    case NODE_FLOAT_NE:
+        return evaluate_expression_float(left) != evaluate_expression_float(right);
+    case NODE_LONG_LT:
+        return evaluate_expression_long(left) < evaluate_expression_long(right);
+    case NODE_LONG_GT:
+        return evaluate_expression_long(left) > evaluate_expression_long(right);
+    case NODE_LONG_LE:
+        return evaluate_expression_long(left) <= evaluate_expression_long(right);
+    case NODE_LONG_GE:
+        return evaluate_expression_long(left) >= evaluate_expression_long(right);
+    case NODE_LONG_EQ:
+        return evaluate_expression_long(left) == evaluate_expression_long(right);
+    case NODE_LONG_NE:
+        return evaluate_expression_long(left) != evaluate_expression_long(right);
+    case NODE_DOUBLE_LT:
+        return evaluate_expression_double(left) < evaluate_expression_double(right);
+    case NODE_DOUBLE_GT:
+        return evaluate_expression_double(left) > evaluate_expression_double(right);
+    case NODE_DOUBLE_LE:
+        return evaluate_expression_double(left) <= evaluate_expression_double(right);
+    case NODE_DOUBLE_GE:
+        return evaluate_expression_double(left) >= evaluate_expression_double(right);
+    case NODE_DOUBLE_EQ:
+        return evaluate_expression_double(left) == evaluate_expression_double(right);
+    case NODE_DOUBLE_NE:
+        return evaluate_expression_double(left) != evaluate_expression_double(right);
+    case NODE_LOGICAL_AND:
+        return evaluate_condition(left) && evaluate_condition(right);
+    case NODE_LOGICAL_OR:
+        return evaluate_condition(left) || evaluate_condition(right);
+    case NODE_INT_TO_BOOL:
+        return evaluate_expression_int(node->data.unary.operand) != 0;
+    case NODE_FLOAT_TO_BOOL:
+        return evaluate_expression_float(node->data.unary.operand) != 0.0f;
+    case NODE_LONG_TO_BOOL:
+        return evaluate_expression_long(node->data.unary.operand) != 0;
+    case NODE_DOUBLE_TO_BOOL:
+        return evaluate_expression_double(node->data.unary.operand) != 0.0;
+    default:
+        return evaluate_expression_int(node) != 0;
+    }
+}
+
 ASTNode *create_char_node(char value)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_CHAR;
+    ASTNode *node = new_node(NODE_CHAR);
     node->data.value = value;
     return node;
 }
 
 ASTNode *create_boolean_node(int value)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_BOOLEAN;
+    ASTNode *node = new_node(NODE_BOOLEAN);
     node->data.value = value ? 1 : 0;
     node->modifiers.is_boolean = true;
     return node;
 }
 
-ASTNode *create_sizeof_node(char *identifier)
+ASTNode *create_sizeof_node(Atom atom)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_SIZEOF;
-    node->data.name = strdup(identifier);
+    ASTNode *node = new_node(NODE_SIZEOF);
+    node->slot = -1;
+    node->data.atom = atom;
     return node;
 }
 
-ASTNode *create_identifier_node(char *name)
+ASTNode *create_identifier_node(Atom atom)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_IDENTIFIER;
-    node->data.name = strdup(name);
+    ASTNode *node = new_node(NODE_IDENTIFIER);
+    node->slot = -1;
+    node->data.atom = atom;
     return node;
 }
 
-ASTNode *create_assignment_node(char *name, ASTNode *expr)
+ASTNode *create_assignment_node(Atom atom, ASTNode *expr)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_ASSIGNMENT;
+    ASTNode *node = new_node(NODE_ASSIGNMENT);
     node->modifiers = get_current_modifiers();
     if (expr->type == NODE_BOOLEAN)
     {
         node->modifiers.is_boolean = true;
     }
-    node->data.op.left = create_identifier_node(name);
+    node->value_type = TYPE_UNKNOWN;
+    node->data.op.left = create_identifier_node(atom);
     node->data.op.right = expr;
     node->data.op.op = '=';
     return node;
 }
 
+/* A declaration is an assignment that also fixes the variable's type */
+ASTNode *create_declaration_node(ValueType type, Atom atom, ASTNode *expr)
+{
+    if (type == TYPE_INT && current_modifiers.is_unsigned)
+    {
+        type = TYPE_UNSIGNED;
+    }
+    ASTNode *node = create_assignment_node(atom, expr);
+    node->value_type = type;
+    return node;
+}
+
+ASTNode *create_array_declaration_node(ValueType type, Atom atom, ASTNode *length)
+{
+    if (type == TYPE_INT && current_modifiers.is_unsigned)
+    {
+        type = TYPE_UNSIGNED;
+    }
+    ASTNode *node = new_node(NODE_ARRAY_DECLARATION);
+    node->modifiers = get_current_modifiers();
+    node->slot = -1;
+    node->value_type = type;
+    node->data.element.array = atom;
+    node->data.element.index = length;
+    return node;
+}
+
+ASTNode *create_index_node(Atom atom, ASTNode *index)
+{
+    ASTNode *node = new_node(NODE_INDEX);
+    node->slot = -1;
+    node->data.element.array = atom;
+    node->data.element.index = index;
+    return node;
+}
+
+ASTNode *create_index_assignment_node(Atom atom, ASTNode *index, ASTNode *value)
+{
+    ASTNode *node = create_index_node(atom, index);
+    node->type = NODE_INDEX_ASSIGNMENT;
+    node->data.element.value = value;
+    return node;
+}
+
 ASTNode *create_operation_node(OperatorType op, ASTNode *left, ASTNode *right)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_OPERATION;
+    ASTNode *node = new_node(NODE_OPERATION);
     node->data.op.left = left;
     node->data.op.right = right;
     node->data.op.op = op;
@@ -435,8 +925,7 @@ ASTNode *create_operation_node(OperatorType op, ASTNode *left, ASTNode *right)
 
 ASTNode *create_unary_operation_node(OperatorType op, ASTNode *operand)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_UNARY_OPERATION;
+    ASTNode *node = new_node(NODE_UNARY_OPERATION);
     node->data.unary.operand = operand;
     node->data.unary.op = op;
     return node;
@@ -444,8 +933,7 @@ ASTNode *create_unary_operation_node(OperatorType op, ASTNode *operand)
 
 ASTNode *create_for_statement_node(ASTNode *init, ASTNode *cond, ASTNode *incr, ASTNode *body)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_FOR_STATEMENT;
+    ASTNode *node = new_node(NODE_FOR_STATEMENT);
     node->data.for_stmt.init = init;
     node->data.for_stmt.cond = cond;
     node->data.for_stmt.incr = incr;
@@ -455,27 +943,34 @@ ASTNode *create_for_statement_node(ASTNode *init, ASTNode *cond, ASTNode *incr,
 
 ASTNode *create_while_statement_node(ASTNode *cond, ASTNode *body)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_WHILE_STATEMENT;
+    ASTNode *node = new_node(NODE_WHILE_STATEMENT);
     node->data.while_stmt.cond = cond;
     node->data.while_stmt.body = body;
     return node;
 }
 
-ASTNode *create_function_call_node(char *func_name, ArgumentList *args)
+ASTNode *create_do_while_statement_node(ASTNode *body, ASTNode *cond)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_FUNC_CALL;
-    node->data.func_call.function_name = strdup(func_name);
+    ASTNode *node = create_while_statement_node(cond, body);
+    node->type = NODE_DO_WHILE_STATEMENT;
+    return node;
+}
+
+ASTNode *create_function_call_node(Atom function, ArgumentList *args)
+{
+    ASTNode *node = new_node(NODE_FUNC_CALL);
+    node->slot = -1;
+    node->data.func_call.function = function;
     node->data.func_call.arguments = args;
     return node;
 }
 
 ArgumentList *create_argument_list(ASTNode *expr, ArgumentList *existing_list)
 {
-    ArgumentList *new_node = malloc(sizeof(ArgumentList));
+    ArgumentList *new_node = arena_alloc(ast_arena, sizeof(ArgumentList));
     new_node->expr = expr;
     new_node->next = NULL;
+    new_node->tail = new_node;
 
     if (!existing_list)
     {
@@ -484,28 +979,30 @@ ArgumentList *create_argument_list(ASTNode *expr, ArgumentList *existing_list)
     else
     {
         /* Append to the end of existing_list */
-        ArgumentList *temp = existing_list;
-        while (temp->next)
-        {
-            temp = temp->next;
-        }
-        temp->next = new_node;
+        existing_list->tail->next = new_node;
+        existing_list->tail = new_node;
         return existing_list;
     }
 }
 
+ArgumentList *prepend_argument(ASTNode *expr, ArgumentList *list)
+{
+    ArgumentList *node = create_argument_list(expr, NULL);
+    node->next = list;
+    node->tail = list->tail;
+    return node;
+}
+
 ASTNode *create_print_statement_node(ASTNode *expr)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_PRINT_STATEMENT;
+    ASTNode *node = new_node(NODE_PRINT_STATEMENT);
     node->data.op.left = expr;
     return node;
 }
 
 ASTNode *create_error_statement_node(ASTNode *expr)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_ERROR_STATEMENT;
+    ASTNode *node = new_node(NODE_ERROR_STATEMENT);
     node->data.op.left = expr;
     return node;
 }
@@ -515,62 +1012,30 @@ ASTNode *create_statement_list(ASTNode *statement, ASTNode *existing_list)
     if (!existing_list)
     {
         // If there's no existing list, create a new one
-        ASTNode *node = malloc(sizeof(ASTNode));
-        node->type = NODE_STATEMENT_LIST;
-        node->data.statements = malloc(sizeof(StatementList));
+        ASTNode *node = new_node(NODE_STATEMENT_LIST);
+        node->data.statements = arena_alloc(ast_arena, sizeof(StatementList));
         node->data.statements->statement = statement;
         node->data.statements->next = NULL;
+        node->data.statements->tail = node->data.statements;
         return node;
     }
     else
     {
-        // Append at the end of existing_list
-        StatementList *sl = existing_list->data.statements;
-        while (sl->next)
-        {
-            sl = sl->next;
-        }
-        // Now sl is the last element; append the new statement
-        StatementList *new_item = malloc(sizeof(StatementList));
+        // Append after the tail remembered by the first element
+        StatementList *head = existing_list->data.statements;
+        StatementList *new_item = arena_alloc(ast_arena, sizeof(StatementList));
         new_item->statement = statement;
         new_item->next = NULL;
-        sl->next = new_item;
+        new_item->tail = NULL;
+        head->tail->next = new_item;
+        head->tail = new_item;
         return existing_list;
     }
 }
 
 bool is_float_expression(ASTNode *node)
 {
-    if (!node)
-        return false;
-
-    switch (node->type)
-    {
-    case NODE_FLOAT:
-        return true;
-    case NODE_NUMBER:
-        return false;
-    case NODE_IDENTIFIER:
-    {
-        for (int i = 0; i < var_count; i++)
-        {
-            if (strcmp(symbol_table[i].name, node->data.name) == 0)
-            {
-                return symbol_table[i].is_float;
-            }
-        }
-        yyerror("Undefined variable in type check");
-        return false;
-    }
-    case NODE_OPERATION:
-    {
-        // If either operand is float, result is float
-        return is_float_expression(node->data.op.left) ||
-               is_float_expression(node->data.op.right);
-    }
-    default:
-        return false;
-    }
+    return node && node->value_type == TYPE_FLOAT;
 }
 
 int evaluate_expression(ASTNode *node)
@@ -579,9 +1044,37 @@ int evaluate_expression(ASTNode *node)
     {
         return (int)evaluate_expression_float(node);
     }
+    if (node && node->value_type == TYPE_DOUBLE)
+        return (int)evaluate_expression_double(node);
+    if (node && node->value_type == TYPE_LONG)
+        return (int)evaluate_expression_long(node);
     return evaluate_expression_int(node);
 }
 
+/* Evaluate an expression of any type into the member of a Value its type uses */
+Value evaluate_value(ASTNode *node)
+{
+    Value value = {0};
+    if (!node)
+        return value;
+    switch (node->value_type)
+    {
+    case TYPE_FLOAT:
+        value.fvalue = evaluate_expression_float(node);
+        break;
+    case TYPE_DOUBLE:
+        value.dvalue = evaluate_expression_double(node);
+        break;
+    case TYPE_LONG:
+        value.lvalue = evaluate_expression_long(node);
+        break;
+    default:
+        value.ivalue = evaluate_expression_int(node);
+        break;
+    }
+    return value;
+}
+
 void execute_assignment(ASTNode *node)
 {
     if (node->type != NODE_ASSIGNMENT)
@@ -590,94 +1083,100 @@ void execute_assignment(ASTNode *node)
         return;
     }
 
-    char *name = node->data.op.left->data.name;
-    ASTNode *value_node = node->data.op.right;
-    TypeModifiers mods = node->modifiers;
+    variable *var = &symbol_table[node->data.op.left->slot];
+    switch (node->value_type)
+    {
+    case TYPE_FLOAT:
+        var->value.fvalue = evaluate_expression_float(node->data.op.right);
+        break;
+    case TYPE_DOUBLE:
+        var->value.dvalue = evaluate_expression_double(node->data.op.right);
+        break;
+    case TYPE_LONG:
+        var->value.lvalue = evaluate_expression_long(node->data.op.right);
+        break;
+    default:
+        var->value.ivalue = evaluate_expression_int(node->data.op.right);
+        break;
+    }
+}
 
-    // Check if the right-hand side is a float expression
-    if (is_float_expression(value_node))
+/* The index is evaluated before the value, and checked after both */
+void execute_index_assignment(ASTNode *node)
+{
+    variable *var = &symbol_table[node->slot];
+    int index = evaluate_expression_int(node->data.element.index);
+    if (is_wide_type(node->value_type))
     {
-        float value = evaluate_expression_float(value_node);
-        if (!set_float_variable(name, value, mods))
-        {
-            yyerror("Failed to set float variable");
-        }
+        Value value = evaluate_value(node->data.element.value);
+        if (node->data.element.unchecked)
+            var->wide_elements[index] = value;
+        else
+            *wide_array_element(var, index) = value;
+        return;
     }
+
+    Element value;
+    if (node->value_type == TYPE_FLOAT)
+        value.fvalue = evaluate_expression_float(node->data.element.value);
     else
+        value.ivalue = evaluate_expression_int(node->data.element.value);
+
+    bool unchecked = node->data.element.unchecked;
+    switch (element_size(node->value_type))
     {
-        int value = evaluate_expression_int(value_node);
-        if (!set_int_variable(name, value, mods))
-        {
-            yyerror("Failed to set integer variable");
-        }
+    case sizeof(char):
+        *(unchecked ? &var->byte_elements[index] : byte_array_element(var, index)) = (char)value.ivalue;
+        break;
+    case sizeof(short):
+        *(unchecked ? &var->short_elements[index] : short_array_element(var, index)) = (short)value.ivalue;
+        break;
+    default:
+        *(unchecked ? &var->elements[index] : array_element(var, index)) = value;
+        break;
     }
 }
 
-void execute_statement(ASTNode *node)
+/*
+ * Execute a statement and report how control leaves it: normally, through
+ * a `bruh` or `grind` that an enclosing loop or switch handles, or through
+ * a `bussin` that ends the function.
+ */
+ControlFlow execute_statement(ASTNode *node)
 {
     if (!node)
-        return;
+        return FLOW_NORMAL;
+    if (current_program->halted)
+        return FLOW_HALT;
     switch (node->type)
     {
     case NODE_ASSIGNMENT:
-    {
-        char *name = node->data.op.left->data.name;
-        ASTNode *value_node = node->data.op.right;
-        TypeModifiers mods = node->modifiers;
-
-        if (value_node->type == NODE_CHAR)
-        {
-            // Handle character assignments directly
-            if (!set_int_variable(name, value_node->data.value, mods))
-            {
-                yyerror("Failed to set character variable");
-            }
-        }
-        else if (is_float_expression(value_node))
-        {
-            float value = evaluate_expression_float(value_node);
-            if (!set_float_variable(name, value, mods))
-            {
-                yyerror("Failed to set float variable");
-            }
-        }
-        else
-        {
-            int value = evaluate_expression_int(value_node);
-            if (!set_int_variable(name, value, mods))
-            {
-                yyerror("Failed to set integer variable");
-            }
-        }
+        execute_assignment(node);
         break;
-    }
-    case NODE_OPERATION:
-    case NODE_UNARY_OPERATION:
-    case NODE_NUMBER:
-    case NODE_CHAR:
-    case NODE_IDENTIFIER:
-        evaluate_expression(node);
+    case NODE_ARRAY_DECLARATION:
+        if (!declare_array(&symbol_table[node->slot], evaluate_expression_int(node->data.element.index),
+                           element_size(node->value_type)))
+            return FLOW_HALT;
+        break;
+    case NODE_INDEX_ASSIGNMENT:
+        execute_index_assignment(node);
         break;
     case NODE_FUNC_CALL:
-        if (strcmp(node->data.func_call.function_name, "yapping") == 0)
-        {
-            execute_yapping_call(node->data.func_call.arguments);
-        }
-        else if (strcmp(node->data.func_call.function_name, "yappin") == 0)
+        if (node->data.func_call.format)
         {
-            execute_yappin_call(node->data.func_call.arguments);
+            execute_print_call(node);
         }
-        else if (strcmp(node->data.func_call.function_name, "baka") == 0)
+        else
         {
-            execute_baka_call(node->data.func_call.arguments);
+            call_function(node);
         }
         break;
     case NODE_FOR_STATEMENT:
-        execute_for_statement(node);
-        break;
+        return execute_for_statement(node);
     case NODE_WHILE_STATEMENT:
-        execute_while_statement(node);
-        break;
+        return execute_while_statement(node);
+    case NODE_DO_WHILE_STATEMENT:
+        return execute_do_while_statement(node);
     case NODE_PRINT_STATEMENT:
     {
         ASTNode *expr = node->data.op.left;
@@ -688,7 +1187,8 @@ void execute_statement(ASTNode *node)
         else
         {
             int value = evaluate_expression(expr);
-            yapping("%d\n", value);
+            if (!current_program->halted)
+                format_write_int(OUTPUT_STDOUT, value, "\n\n");
         }
         break;
     }
@@ -702,77 +1202,90 @@ void execute_statement(ASTNode *node)
         else
         {
             int value = evaluate_expression(expr);
-            baka("%d\n", value);
+            if (!current_program->halted)
+                format_write_int(OUTPUT_STDERR, value, "\n");
         }
         break;
     }
     case NODE_STATEMENT_LIST:
-        execute_statements(node);
-        break;
+        return execute_statements(node);
     case NODE_IF_STATEMENT:
-        if (evaluate_expression(node->data.if_stmt.condition))
-        {
-            execute_statement(node->data.if_stmt.then_branch);
-        }
-        else if (node->data.if_stmt.else_branch)
+        if (evaluate_condition(node->data.if_stmt.condition))
         {
-            execute_statement(node->data.if_stmt.else_branch);
+            return execute_statement(node->data.if_stmt.then_branch);
         }
-        break;
+        return execute_statement(node->data.if_stmt.else_branch);
     case NODE_SWITCH_STATEMENT:
-        execute_switch_statement(node);
-        break;
+        return execute_switch_statement(node);
     case NODE_BREAK_STATEMENT:
-        // Signal to break out of the current loop/switch
-        longjmp(break_env, 1);
-        break;
+        return FLOW_BREAK;
+    case NODE_CONTINUE_STATEMENT:
+        return FLOW_CONTINUE;
+    case NODE_RETURN:
+        current_program->result = evaluate_value(node->data.op.left);
+        return FLOW_RETURN;
     default:
-        yyerror("Unknown statement type");
+        // Any remaining node is an expression evaluated for its effects
+        evaluate_expression(node);
         break;
     }
+    return FLOW_NORMAL;
 }
 
-void execute_statements(ASTNode *node)
+ControlFlow execute_statements(ASTNode *node)
 {
     if (!node)
-        return;
+        return FLOW_NORMAL;
     if (node->type != NODE_STATEMENT_LIST)
     {
-        execute_statement(node);
-        return;
+        return execute_statement(node);
     }
     StatementList *current = node->data.statements;
     while (current)
     {
-        execute_statement(current->statement);
+        ControlFlow flow = execute_statement(current->statement);
+        if (flow != FLOW_NORMAL)
+            return flow;
         current = current->next;
     }
+    return FLOW_NORMAL;
 }
 
-void execute_for_statement(ASTNode *node)
+ControlFlow execute_for_statement(ASTNode *node)
 {
+    bool vectorized = node->data.for_stmt.vector != NULL;
+    if (!vectorized && jit_enabled && jit_execute_loop(node))
+        return FLOW_NORMAL;
+
     // Execute initialization once
     if (node->data.for_stmt.init)
     {
         execute_statement(node->data.for_stmt.init);
     }
 
+    // Whole blocks of iterations at once; the loop below runs the rest
+    if (vectorized)
+    {
+        vector_execute_blocks(node);
+    }
+
     while (1)
     {
         // Evaluate condition
-        if (node->data.for_stmt.cond)
+        if (node->data.for_stmt.cond && !evaluate_condition(node->data.for_stmt.cond))
         {
-            int cond_result = evaluate_expression(node->data.for_stmt.cond);
-            if (!cond_result)
-            {
-                break;
-            }
+            break;
         }
 
-        // Execute body
-        if (node->data.for_stmt.body)
+        // Execute body; grind skips to the increment
+        ControlFlow flow = execute_statement(node->data.for_stmt.body);
+        if (flow == FLOW_BREAK)
+        {
+            break;
+        }
+        if (flow == FLOW_RETURN || flow == FLOW_HALT)
         {
-            execute_statement(node->data.for_stmt.body);
+            return flow;
         }
 
         // Execute increment
@@ -781,20 +1294,115 @@ void execute_for_statement(ASTNode *node)
             execute_statement(node->data.for_stmt.incr);
         }
     }
+    return FLOW_NORMAL;
+}
+
+ControlFlow execute_while_statement(ASTNode *node)
+{
+    if (jit_enabled && jit_execute_loop(node))
+        return FLOW_NORMAL;
+
+    while (evaluate_condition(node->data.while_stmt.cond))
+    {
+        ControlFlow flow = execute_statement(node->data.while_stmt.body);
+        if (flow == FLOW_BREAK)
+            break;
+        if (flow == FLOW_RETURN || flow == FLOW_HALT)
+            return flow;
+    }
+    return FLOW_NORMAL;
+}
+
+ControlFlow execute_do_while_statement(ASTNode *node)
+{
+    if (jit_enabled && jit_execute_loop(node))
+        return FLOW_NORMAL;
+
+    do
+    {
+        ControlFlow flow = execute_statement(node->data.while_stmt.body);
+        if (flow == FLOW_BREAK)
+            break;
+        if (flow == FLOW_RETURN || flow == FLOW_HALT)
+            return flow;
+    } while (evaluate_condition(node->data.while_stmt.cond));
+    return FLOW_NORMAL;
+}
+
+/*
+ * True when the tree walker, which recurses on the C stack for every
+ * call, is close to the end of this thread's stack; the limits on calls
+ * normally stop recursion long before that.
+ */
+static bool stack_exhausted(void)
+{
+    static _Thread_local char *limit;
+    static _Thread_local bool known;
+    if (!known)
+    {
+        known = true;
+        pthread_attr_t attr;
+        void *low;
+        size_t size;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0)
+        {
+            if (pthread_attr_getstack(&attr, &low, &size) == 0 && size > 2 * STACK_RESERVE)
+                limit = (char *)low + STACK_RESERVE;
+            pthread_attr_destroy(&attr);
+        }
+    }
+    char here;
+    return limit && &here < limit;
 }
 
-void execute_while_statement(ASTNode *node)
+/*
+ * Run a call to a user-defined function. The arguments, already converted
+ * to their parameters' types, are evaluated in the caller's frame before
+ * the callee's frame is reserved, as the VM does, so calls in them reach
+ * the same depth. A function that ends without `bussin` returns zero.
+ */
+Value call_function(ASTNode *node)
 {
-    while (evaluate_expression(node->data.while_stmt.cond))
+    Program *program = current_program;
+    Function *function = program->functions[node->slot];
+    int size = function->scope.count;
+    Value result = {0};
+
+    Value arguments[function->parameter_count + 1];
+    Value *argument = arguments;
+    for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next, argument++)
+    {
+        *argument = evaluate_value(arg->expr);
+    }
+
+    // A halted program finishes the expression it was in without running anything more
+    if (program->halted)
+        return result;
+    if (stack_exhausted())
+    {
+        yyerror("Recursion too deep");
+        return result;
+    }
+    variable *frame = push_frame(size);
+    if (!frame)
+        return result;
+    for (int i = 0; i < function->parameter_count; i++)
     {
-        execute_statement(node->data.while_stmt.body);
+        frame[i].value = arguments[i];
     }
+
+    variable *caller = program->frame;
+    program->frame = frame;
+    if (execute_statement(function->body) == FLOW_RETURN)
+        result = program->result;
+    program->frame = caller;
+    pop_frame(frame, size);
+    return result;
 }
 
 ASTNode *create_if_statement_node(ASTNode *condition, ASTNode *then_branch, ASTNode *else_branch)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_IF_STATEMENT;
+    ASTNode *node = new_node(NODE_IF_STATEMENT);
     node->data.if_stmt.condition = condition;
     node->data.if_stmt.then_branch = then_branch;
     node->data.if_stmt.else_branch = else_branch;
@@ -803,16 +1411,14 @@ ASTNode *create_if_statement_node(ASTNode *condition, ASTNode *then_branch, ASTN
 
 ASTNode *create_string_literal_node(char *string)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_STRING_LITERAL;
+    ASTNode *node = new_node(NODE_STRING_LITERAL);
     node->data.name = string;
     return node;
 }
 
 ASTNode *create_switch_statement_node(ASTNode *expression, CaseNode *cases)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_SWITCH_STATEMENT;
+    ASTNode *node = new_node(NODE_SWITCH_STATEMENT);
     node->data.switch_stmt.expression = expression;
     node->data.switch_stmt.cases = cases;
     return node;
@@ -820,10 +1426,11 @@ ASTNode *create_switch_statement_node(ASTNode *expression, CaseNode *cases)
 
 CaseNode *create_case_node(ASTNode *value, ASTNode *statements)
 {
-    CaseNode *node = malloc(sizeof(CaseNode));
+    CaseNode *node = arena_alloc(ast_arena, sizeof(CaseNode));
     node->value = value;
     node->statements = statements;
     node->next = NULL;
+    node->tail = node;
     return node;
 }
 
@@ -836,172 +1443,44 @@ CaseNode *append_case_list(CaseNode *list, CaseNode *case_node)
 {
     if (!list)
         return case_node;
-    CaseNode *current = list;
-    while (current->next)
-        current = current->next;
-    current->next = case_node;
+    list->tail->next = case_node;
+    list->tail = case_node;
     return list;
 }
 
 ASTNode *create_break_node()
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    node->type = NODE_BREAK_STATEMENT;
+    ASTNode *node = new_node(NODE_BREAK_STATEMENT);
     node->data.break_stmt = NULL;
     return node;
 }
 
-void execute_yapping_call(ArgumentList *args)
+ASTNode *create_continue_node(void)
 {
-    if (!args)
-    {
-        yapping("\n");
-        return;
-    }
-
-    ASTNode *formatNode = args->expr;
-    if (formatNode->type != NODE_STRING_LITERAL)
-    {
-        yyerror("First argument to yapping must be a string literal");
-        return;
-    }
-
-    ArgumentList *cur = args->next;
-    if (!cur)
-    {
-        yapping("%s", formatNode->data.name);
-        return;
-    }
-
-    ASTNode *expr = cur->expr;
-
-    // Handle float expressions
-    if (is_float_expression(expr))
-    {
-        float val = evaluate_expression_float(expr);
-        yapping(formatNode->data.name, val);
-        return;
-    }
-
-    // Check if we're dealing with an unsigned value
-    bool is_unsigned = false;
-    bool is_bool = false;
-
-    if (expr->type == NODE_BOOLEAN)
-    {
-        is_bool = true;
-    }
-    if (expr->type == NODE_IDENTIFIER)
-    {
-        TypeModifiers mods = get_variable_modifiers(expr->data.name);
-        is_unsigned = mods.is_unsigned;
-        is_bool = mods.is_boolean;
-    }
-    else
-    {
-        // Check if the node itself has unsigned modifier
-        is_unsigned = expr->modifiers.is_unsigned;
-    }
-
-    if (is_bool)
-    {
-        int val = evaluate_expression_int(expr);
-
-        // If format specifier is present, handle differently
-        if (strstr(formatNode->data.name, "%") != NULL)
-        {
-            yapping(formatNode->data.name, val);
-        }
-        else
-        {
-            yapping("%s", val ? "yes" : "no");
-        }
-        return;
-    }
-    if (is_unsigned)
-    {
-        unsigned int val = (unsigned int)evaluate_expression_int(expr);
-        if (strstr(formatNode->data.name, "%lu") != NULL)
-        {
-            yapping(formatNode->data.name, (unsigned long)val);
-        }
-        else if (strstr(formatNode->data.name, "%u") != NULL)
-        {
-            yapping(formatNode->data.name, val);
-        }
-        else
-        {
-            yapping("%u", val);
-        }
-        return;
-    }
-
-    // Handle regular integers
-    int val = evaluate_expression_int(expr);
-    yapping(formatNode->data.name, val);
+    return new_node(NODE_CONTINUE_STATEMENT);
 }
 
-void execute_yappin_call(ArgumentList *args)
+/* expr is NULL for a bare `bussin` */
+ASTNode *create_return_node(ASTNode *expr)
 {
-    if (!args)
-    {
-        yappin("\n");
-        return;
-    }
-
-    ASTNode *formatNode = args->expr;
-    if (formatNode->type != NODE_STRING_LITERAL)
-    {
-        yyerror("First argument to yappin must be a string literal");
-        return;
-    }
-
-    ArgumentList *cur = args->next;
-    if (!cur)
-    {
-        yappin("%s", formatNode->data.name);
-        return;
-    }
-
-    ASTNode *expr = cur->expr;
-
-    // Check if it's a boolean value
-    if (expr->type == NODE_BOOLEAN ||
-        (expr->type == NODE_IDENTIFIER && get_variable_modifiers(expr->data.name).is_boolean))
-    {
-        int val = evaluate_expression_int(expr);
-        if (strstr(formatNode->data.name, "%d") != NULL)
-        {
-            yappin(formatNode->data.name, val);
-        }
-        else
-        {
-            yappin(val ? "yes" : "no");
-        }
-        return;
-    }
-
-    // Handle float expressions
-    if (is_float_expression(expr))
-    {
-        float val = evaluate_expression_float(expr);
-        yappin(formatNode->data.name, val);
-        return;
-    }
-
-    // Handle integer expressions
-    int val = evaluate_expression_int(expr);
-    yappin(formatNode->data.name, val);
+    ASTNode *node = new_node(NODE_RETURN);
+    node->data.op.left = expr;
+    return node;
 }
 
-void execute_baka_call(ArgumentList *args)
+/* Evaluate the placeholder arguments of a compiled print call and print it */
+void execute_print_call(ASTNode *node)
 {
-    if (!args)
+    const Format *format = node->data.func_call.format;
+    Value values[MAX_FORMAT_ARGUMENTS];
+    int count = 0;
+    for (int i = 0; i < format->segment_count; i++)
     {
-        baka("\n");
-        return;
+        ArgumentList *arg = format->segments[i].argument;
+        if (!arg)
+            continue;
+        values[count++] = evaluate_value(arg->expr);
     }
-    // parse the first argument as a format string
-    // parse subsequent arguments as integers, etc.
-    // call "baka(formatString, val, ...)"
+    if (!current_program->halted)
+        print_format(format, values);
 }
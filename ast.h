@@ -7,14 +7,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "arena.h"
+#include "intern.h"
 
 #define MAX_VARS 100
 
+/*
+ * Calls to user-defined functions nest at most MAX_CALL_DEPTH deep, and
+ * the frames of the calls in progress share one stack of FRAME_STACK_SIZE
+ * variables; a call past either limit reports an error and returns zero.
+ */
+#define MAX_CALL_DEPTH 10000
+#define FRAME_STACK_SIZE (1 << 16)
+
 /* Forward declarations */
 typedef struct ASTNode ASTNode;
 typedef struct StatementList StatementList;
 typedef struct ArgumentList ArgumentList;
 typedef struct CaseNode CaseNode;
+typedef struct SwitchTable SwitchTable;
+typedef struct Format Format;
+typedef struct JitCode JitCode;
+typedef struct VectorLoop VectorLoop;
 
 /* Define TypeModifiers first */
 typedef struct
@@ -24,18 +39,76 @@ typedef struct
     bool is_unsigned;
     bool is_boolean;
     bool is_sizeof;
+    bool is_const;
 } TypeModifiers;
 
-/* Symbol table structure */
+/* Static types computed by typecheck_program */
+typedef enum
+{
+    TYPE_UNKNOWN,
+    TYPE_INT,
+    TYPE_UNSIGNED,
+    TYPE_FLOAT,
+    TYPE_BOOL,
+    TYPE_CHAR,
+    TYPE_STRING,
+    TYPE_SHORT,  /* soy: held as an int, narrowed to 16 bits on conversion like a char */
+    TYPE_LONG,   /* giga */
+    TYPE_DOUBLE  /* gigachad */
+} ValueType;
+
+/*
+ * A runtime value in 8 bytes. Which member is live follows from its static
+ * type, which typecheck_program computes for every expression, so values
+ * carry no tag: giga uses lvalue, gigachad dvalue, chad fvalue and every
+ * other type ivalue.
+ */
+typedef union
+{
+    int64_t lvalue;
+    double dvalue;
+    int ivalue;
+    float fvalue;
+} Value;
+
+/* An element of an array of rizz, nonut rizz or chad */
+typedef union
+{
+    int ivalue;
+    float fvalue;
+} Element;
+
+/* Types whose values take all 8 bytes of a Value */
+static inline bool is_wide_type(ValueType type)
+{
+    return type == TYPE_LONG || type == TYPE_DOUBLE;
+}
+
+/* Bytes an array element of the type takes: a yap or cap is a char, a soy a short */
+static inline int element_size(ValueType type)
+{
+    if (type == TYPE_CHAR || type == TYPE_BOOL)
+        return sizeof(char);
+    if (type == TYPE_SHORT)
+        return sizeof(short);
+    return is_wide_type(type) ? sizeof(Value) : sizeof(Element);
+}
+
+/* Symbol table structure, 32 bytes */
 typedef struct
 {
-    char *name;
+    Value value;
     union
     {
-        int ivalue;
-        float fvalue;
-    } value;
-    bool is_float;
+        Element *elements;     /* Storage of an array, 64-byte aligned, or NULL */
+        Value *wide_elements;  /* The same storage when the element type is wide */
+        char *byte_elements;   /* ... a yap or cap */
+        short *short_elements; /* ... or a soy */
+    };
+    int length; /* Number of elements */
+    Atom atom;
+    unsigned char type; /* A ValueType */
+    bool is_array;      /* Declared with a length; type is then the element type */
     TypeModifiers modifiers;
 } variable;
 
@@ -65,6 +138,8 @@ typedef enum
     NODE_FLOAT,
     NODE_CHAR,
     NODE_BOOLEAN,
+    NODE_LONG,
+    NODE_DOUBLE,
     NODE_IDENTIFIER,
     NODE_ASSIGNMENT,
     NODE_OPERATION,
@@ -80,15 +155,112 @@ typedef enum
     NODE_CASE,
     NODE_DEFAULT_CASE,
     NODE_BREAK_STATEMENT,
+    NODE_CONTINUE_STATEMENT,
+    NODE_DO_WHILE_STATEMENT,
     NODE_FUNC_CALL,
-    NODE_SIZEOF
+    NODE_SIZEOF,
+    NODE_ARRAY_DECLARATION,
+    NODE_INDEX,
+    NODE_INDEX_ASSIGNMENT,
+    NODE_RETURN,
+
+    /*
+     * Type-specialized expressions. typecheck_program rewrites every
+     * NODE_OPERATION and NODE_UNARY_OPERATION into one of these and makes
+     * implicit conversions explicit, so the evaluators never inspect
+     * operand types at run time. Unsigned addition, subtraction,
+     * multiplication and equality share the int kinds.
+     */
+    NODE_INT_ADD,
+    NODE_INT_SUB,
+    NODE_INT_MUL,
+    NODE_INT_DIV,
+    NODE_INT_MOD,
+    NODE_INT_LT,
+    NODE_INT_GT,
+    NODE_INT_LE,
+    NODE_INT_GE,
+    NODE_INT_EQ,
+    NODE_INT_NE,
+    NODE_INT_NEG,
+    NODE_UNSIGNED_DIV,
+    NODE_UNSIGNED_MOD,
+    NODE_UNSIGNED_LT,
+    NODE_UNSIGNED_GT,
+    NODE_UNSIGNED_LE,
+    NODE_UNSIGNED_GE,
+    NODE_FLOAT_ADD,
+    NODE_FLOAT_SUB,
+    NODE_FLOAT_MUL,
+    NODE_FLOAT_DIV,
+    NODE_FLOAT_LT,
+    NODE_FLOAT_GT,
+    NODE_FLOAT_LE,
+    NODE_FLOAT_GE,
+    NODE_FLOAT_EQ,
+    NODE_FLOAT_NE,
+    NODE_FLOAT_NEG,
+    NODE_LONG_ADD,
+    NODE_LONG_SUB,
+    NODE_LONG_MUL,
+    NODE_LONG_DIV,
+    NODE_LONG_MOD,
+    NODE_LONG_LT,
+    NODE_LONG_GT,
+    NODE_LONG_LE,
+    NODE_LONG_GE,
+    NODE_LONG_EQ,
+    NODE_LONG_NE,
+    NODE_DOUBLE_ADD,
+    NODE_DOUBLE_SUB,
+    NODE_DOUBLE_MUL,
+    NODE_DOUBLE_DIV,
+    NODE_DOUBLE_LT,
+    NODE_DOUBLE_GT,
+    NODE_DOUBLE_LE,
+    NODE_DOUBLE_GE,
+    NODE_DOUBLE_EQ,
+    NODE_DOUBLE_NE,
+    NODE_LOGICAL_AND,
+    NODE_LOGICAL_OR,
+    NODE_LONG_NEG,
+    NODE_DOUBLE_NEG,
+    NODE_INT_TO_FLOAT,
+    NODE_UNSIGNED_TO_FLOAT,
+    NODE_FLOAT_TO_INT,
+    NODE_FLOAT_TO_UNSIGNED,
+    NODE_FLOAT_TO_BOOL,
+    NODE_INT_TO_BOOL,
+    NODE_INT_TO_CHAR,
+    NODE_INT_TO_SHORT,
+    NODE_INT_TO_LONG,
+    NODE_UNSIGNED_TO_LONG,
+    NODE_LONG_TO_INT,
+    NODE_LONG_TO_BOOL,
+    NODE_LONG_TO_FLOAT,
+    NODE_LONG_TO_DOUBLE,
+    NODE_FLOAT_TO_LONG,
+    NODE_DOUBLE_TO_LONG,
+    NODE_INT_TO_DOUBLE,
+    NODE_UNSIGNED_TO_DOUBLE,
+    NODE_FLOAT_TO_DOUBLE,
+    NODE_DOUBLE_TO_FLOAT,
+    NODE_DOUBLE_TO_INT,
+    NODE_DOUBLE_TO_UNSIGNED,
+    NODE_DOUBLE_TO_BOOL
 } NodeType;
 
 /* Rest of the structure definitions */
+/*
+ * The list types below are built by appending in the parser. The first
+ * element keeps a pointer to the last one so an append is O(1); `tail` is
+ * only meaningful on the first element.
+ */
 struct StatementList
 {
     ASTNode *statement;
     struct StatementList *next;
+    struct StatementList *tail;
 };
 
 typedef struct
@@ -103,12 +275,41 @@ struct CaseNode
     ASTNode *value;
     ASTNode *statements;
     struct CaseNode *next;
+    struct CaseNode *tail;
 };
 
 struct ArgumentList
 {
     struct ASTNode *expr;
     struct ArgumentList *next;
+    struct ArgumentList *tail;
+};
+
+/* A case label and the index of the arm it starts in */
+typedef struct
+{
+    int value;
+    int arm;
+} SwitchEntry;
+
+/*
+ * Lookup structure for an `ohio` statement. Execution starts in the arm
+ * whose label equals the switch value, or in `based` if none does, and
+ * falls through the following arms; `based` always ends the switch, so
+ * arms after it are never reached and are left out. Labels are found
+ * through a dense table indexed by value - min when they are close
+ * together, otherwise by binary search over the sorted entries.
+ */
+struct SwitchTable
+{
+    CaseNode **arms; /* Reachable arms in source order, ending with based if present */
+    int arm_count;
+    int default_arm; /* Index of based in arms, or -1 */
+    int min;
+    int range;  /* Size of dense, or 0 when the sorted entries are used */
+    int *dense; /* Arm for each value in min .. min + range - 1, or default_arm */
+    SwitchEntry *entries;
+    int entry_count;
 };
 
 /* AST node structure */
@@ -116,11 +317,19 @@ struct ASTNode
 {
     NodeType type;
     TypeModifiers modifiers;
+    int slot;             /* Symbol table index of an identifier, array or sizeof operand, bound by resolve_program */
+    ValueType value_type; /* Declared type of a declaration, otherwise set by typecheck_program */
     union
     {
         int value;
-        float fvalue;
-        char *name;
+        int64_t lvalue; /* A giga literal */
+        struct
+        {
+            float fvalue;
+            double dvalue; /* A literal with a decimal point as written, used when it becomes a gigachad */
+        };
+        char *name; /* Text of a string literal */
+        Atom atom;  /* Name of an identifier or sizeof operand */
         struct
         {
             ASTNode *left;
@@ -138,55 +347,216 @@ struct ASTNode
             ASTNode *cond;
             ASTNode *incr;
             ASTNode *body;
+            JitCode *jit;       /* Native code, compiled on first execution with --jit */
+            VectorLoop *vector; /* Batch form planned by optimize_loops, or NULL */
         } for_stmt;
         struct
         {
             ASTNode *cond;
             ASTNode *body;
+            JitCode *jit; /* As for for_stmt; also used by do-while loops */
         } while_stmt;
         struct
         {
-            char *function_name;
+            Atom array;
+            ASTNode *index; /* Element index, or the length of a declaration */
+            ASTNode *value; /* Value stored by an element assignment */
+            bool unchecked; /* Index proven in range by optimize_loops */
+        } element;
+        struct
+        {
+            Atom function;
             ArgumentList *arguments;
-        } func_call;
+            Format *format; /* yapping, yappin and baka; set by the type checker */
+        } func_call;     /* slot is the index of a user-defined function, or -1 */
         StatementList *statements;
         IfStatementNode if_stmt;
         struct
         {
             ASTNode *expression;
             CaseNode *cases;
+            SwitchTable *table; /* Built on first execution */
         } switch_stmt;
         ASTNode *break_stmt;
     } data;
 };
 
-/* Global variable declarations */
-extern TypeModifiers current_modifiers;
-extern variable symbol_table[MAX_VARS];
-extern int var_count;
+/* How control leaves a statement */
+typedef enum
+{
+    FLOW_NORMAL,
+    FLOW_BREAK,
+    FLOW_CONTINUE,
+    FLOW_RETURN, /* `bussin`, with the value left in the program's result */
+    FLOW_HALT    /* An error the program cannot run past, such as running out of memory */
+} ControlFlow;
+
+/* The variables of main or of a user-defined function, in slot order */
+typedef struct
+{
+    variable symbols[MAX_VARS];
+    int count;
+} Scope;
+
+/*
+ * A user-defined function. Its parameters are its first variables, so a
+ * call's frame is one block of scope.count variables on the frame stack,
+ * starting with the arguments.
+ */
+typedef struct
+{
+    Atom name;
+    ValueType return_type; /* TYPE_UNKNOWN if it returns nothing */
+    ASTNode **parameters;  /* Declarations, without their initial values */
+    int parameter_count;
+    ASTNode *body;
+    Scope scope;
+} Function;
+
+/*
+ * A parsed program. Nodes, lists and strings created while parsing are
+ * allocated from its arena and released together by free_program, and
+ * its identifiers are interned in atoms. Its variables live in main and
+ * in the frames of its calls, so separate programs can be parsed and run
+ * at the same time.
+ */
+typedef struct
+{
+    Arena arena;
+    InternTable atoms;
+    ASTNode *root;
+    Scope main;
+    Function **functions; /* In definition order; calls refer to them by index */
+    int function_count;
+    int function_capacity;
+    Scope *scope;         /* Scope the passes are working on */
+    variable *frame;      /* Variables in use: main's, or the running call's frame */
+    variable *frames;     /* Frame stack, allocated by the first call */
+    int frame_top;        /* Variables of frames in use */
+    int call_depth;
+    Value result;         /* Value of the last `bussin` */
+    bool halted;          /* An error ended the run; the executors stop as soon as they see it */
+    int line;             /* Line runtime errors are reported at: the last one parsed */
+    JitCode *jit_code;    /* Loops compiled by the JIT, released with the program */
+} Program;
+
+/*
+ * The program this thread is parsing, checking or running. parse_program
+ * makes the new program current; the passes and the executors reach its
+ * symbol table and arena through the names below. The passes visit each
+ * function with enter_scope, and a call switches symbol_table to its
+ * frame while it runs.
+ */
+extern _Thread_local Program *current_program;
+#define symbol_table (current_program->frame)
+#define var_count (current_program->scope->count)
+#define ast_arena (&current_program->arena)
+#define ast_atoms (&current_program->atoms)
+
+/* Modifiers of the declaration being parsed */
+extern _Thread_local TypeModifiers current_modifiers;
 
 /* Function prototypes */
-bool set_int_variable(char *name, int value, TypeModifiers mods);
-bool set_float_variable(char *name, float value, TypeModifiers mods);
-TypeModifiers get_variable_modifiers(const char *name);
+int define_variable_slot(Atom atom);
+
+/* A variable's name, for messages */
+static inline const char *variable_name(const variable *var)
+{
+    return atom_name(ast_atoms, var->atom);
+}
+
+void enter_scope(Scope *scope);
+
+/* User-defined functions */
+void define_function(Atom name, ValueType return_type, ArgumentList *parameters, ASTNode *body);
+int find_function(Atom name);
+
+/*
+ * Call frames. push_frame returns size zeroed variables on top of the
+ * frame stack, or NULL after reporting the error if the call would nest
+ * too deeply or the stack cannot be allocated, which also halts the
+ * program; pop_frame releases the frame's arrays and the frame.
+ */
+variable *push_frame(int size);
+void pop_frame(variable *frame, int size);
+int variable_sizeof(const variable *var);
+
+/*
+ * Arrays. An array is one contiguous buffer of elements of element_size
+ * bytes, aligned to a cache line and zeroed when it is declared. Declaring
+ * an array again replaces its storage. declare_array returns false after
+ * reporting the error and halting the program if the storage cannot be
+ * allocated, since accesses proven in range rely on the array having its
+ * length.
+ */
+bool declare_array(variable *var, int length, int size);
+void release_array(variable *var);
+Element *array_index_error(void);
+Value *wide_array_index_error(void);
+char *byte_array_index_error(void);
+short *short_array_index_error(void);
+
+/*
+ * The element at index, or, after reporting the index out of bounds, a
+ * scratch value that reads as zero and absorbs writes
+ */
+static inline Element *array_element(variable *var, int index)
+{
+    if ((unsigned int)index < (unsigned int)var->length)
+        return &var->elements[index];
+    return array_index_error();
+}
+
+static inline Value *wide_array_element(variable *var, int index)
+{
+    if ((unsigned int)index < (unsigned int)var->length)
+        return &var->wide_elements[index];
+    return wide_array_index_error();
+}
+
+static inline char *byte_array_element(variable *var, int index)
+{
+    if ((unsigned int)index < (unsigned int)var->length)
+        return &var->byte_elements[index];
+    return byte_array_index_error();
+}
+
+static inline short *short_array_element(variable *var, int index)
+{
+    if ((unsigned int)index < (unsigned int)var->length)
+        return &var->short_elements[index];
+    return short_array_index_error();
+}
+
 void reset_modifiers(void);
 TypeModifiers get_current_modifiers(void);
 
+/* Program lifetime */
+Program *create_program(void);
+void free_program(Program *program);
+
 /* Node creation functions */
 ASTNode *create_number_node(int value);
-ASTNode *create_float_node(float value);
+ASTNode *create_long_node(int64_t value);
+ASTNode *create_float_node(double value);
 ASTNode *create_char_node(char value);
 ASTNode *create_boolean_node(int value);
-ASTNode *create_identifier_node(char *name);
-ASTNode *create_assignment_node(char *name, ASTNode *expr);
+ASTNode *create_identifier_node(Atom atom);
+ASTNode *create_assignment_node(Atom atom, ASTNode *expr);
+ASTNode *create_declaration_node(ValueType type, Atom atom, ASTNode *expr);
+ASTNode *create_array_declaration_node(ValueType type, Atom atom, ASTNode *length);
+ASTNode *create_index_node(Atom atom, ASTNode *index);
+ASTNode *create_index_assignment_node(Atom atom, ASTNode *index, ASTNode *value);
 ASTNode *create_operation_node(OperatorType op, ASTNode *left, ASTNode *right);
 ASTNode *create_unary_operation_node(OperatorType op, ASTNode *operand);
 ASTNode *create_for_statement_node(ASTNode *init, ASTNode *cond, ASTNode *incr, ASTNode *body);
 ASTNode *create_while_statement_node(ASTNode *cond, ASTNode *body);
-ASTNode *create_function_call_node(char *func_name, ArgumentList *args);
+ASTNode *create_do_while_statement_node(ASTNode *body, ASTNode *cond);
+ASTNode *create_function_call_node(Atom function, ArgumentList *args);
 ArgumentList *create_argument_list(ASTNode *expr, ArgumentList *existing_list);
+ArgumentList *prepend_argument(ASTNode *expr, ArgumentList *list);
 ASTNode *create_print_statement_node(ASTNode *expr);
-ASTNode *create_sizeof_node(char *identifier);
+ASTNode *create_sizeof_node(Atom atom);
 ASTNode *create_error_statement_node(ASTNode *expr);
 ASTNode *create_statement_list(ASTNode *statement, ASTNode *next_statement);
 ASTNode *create_if_statement_node(ASTNode *condition, ASTNode *then_branch, ASTNode *else_branch);
@@ -196,23 +566,30 @@ CaseNode *create_case_node(ASTNode *value, ASTNode *statements);
 CaseNode *create_default_case_node(ASTNode *statements);
 CaseNode *append_case_list(CaseNode *list, CaseNode *case_node);
 ASTNode *create_break_node(void);
+ASTNode *create_continue_node(void);
+ASTNode *create_return_node(ASTNode *expr);
 
 /* Evaluation and execution functions */
 float evaluate_expression_float(ASTNode *node);
 int evaluate_expression_int(ASTNode *node);
+int64_t evaluate_expression_long(ASTNode *node);
+double evaluate_expression_double(ASTNode *node);
+Value evaluate_value(ASTNode *node);
+bool evaluate_condition(ASTNode *node);
 int evaluate_expression(ASTNode *node);
 bool is_float_expression(ASTNode *node);
-void execute_statement(ASTNode *node);
-void execute_statements(ASTNode *node);
+ControlFlow execute_statement(ASTNode *node);
+ControlFlow execute_statements(ASTNode *node);
 void execute_assignment(ASTNode *node);
-void execute_for_statement(ASTNode *node);
-void execute_while_statement(ASTNode *node);
-void execute_yapping_call(ArgumentList *args);
-void execute_yappin_call(ArgumentList *args);
-void execute_baka_call(ArgumentList *args);
-void free_ast(ASTNode *node);
+void execute_index_assignment(ASTNode *node);
+ControlFlow execute_for_statement(ASTNode *node);
+ControlFlow execute_while_statement(ASTNode *node);
+ControlFlow execute_do_while_statement(ASTNode *node);
+Value call_function(ASTNode *node);
+ControlFlow execute_switch_statement(ASTNode *node);
+SwitchTable *build_switch_table(CaseNode *cases);
+int switch_table_lookup(const SwitchTable *table, int value);
+void execute_print_call(ASTNode *node);
 void reset_modifiers(void);
 
-extern TypeModifiers current_modifiers;
-
 #endif /* AST_H */
@@ -0,0 +1,332 @@
+/* batch.c */
+
+#include "batch.h"
+#include "output.h"
+#include "source.h"
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/* A run of output on one stream */
+typedef struct
+{
+    BrainrotStream stream;
+    size_t length;
+} Segment;
+
+typedef struct
+{
+    char *path;
+
+    /* Everything the script printed, in order */
+    char *output;
+    size_t output_length;
+    size_t output_capacity;
+    Segment *segments;
+    int segment_count;
+    int segment_capacity;
+
+    double milliseconds;
+    bool failed;
+    bool done;
+} Script;
+
+/* A worker's scripts: it takes from head, thieves take from tail */
+typedef struct
+{
+    int *scripts;
+    int head;
+    int tail;
+    pthread_mutex_t lock;
+} Queue;
+
+typedef struct
+{
+    Script *scripts;
+    int script_count;
+    Queue *queues;
+    int queue_count;
+    BrainrotOptions options;
+
+    /* Signalled whenever a script is done */
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} Batch;
+
+typedef struct
+{
+    Batch *batch;
+    int index;
+} Worker;
+
+static void collect(void *context, BrainrotStream stream, const char *data, size_t length)
+{
+    Script *script = context;
+    if (script->output_length + length > script->output_capacity)
+    {
+        size_t capacity = script->output_capacity ? script->output_capacity * 2 : 4096;
+        while (capacity < script->output_length + length)
+            capacity *= 2;
+        script->output = realloc(script->output, capacity);
+        script->output_capacity = capacity;
+    }
+    memcpy(script->output + script->output_length, data, length);
+    script->output_length += length;
+
+    Segment *last = script->segment_count ? &script->segments[script->segment_count - 1] : NULL;
+    if (last && last->stream == stream)
+    {
+        last->length += length;
+        return;
+    }
+    if (script->segment_count == script->segment_capacity)
+    {
+        script->segment_capacity = script->segment_capacity ? script->segment_capacity * 2 : 4;
+        script->segments = realloc(script->segments, script->segment_capacity * sizeof(Segment));
+    }
+    script->segments[script->segment_count++] = (Segment){stream, length};
+}
+
+static double elapsed_milliseconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void run_script(const Batch *batch, Script *script)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    BrainrotOptions options = batch->options;
+    options.write = collect;
+    options.context = script;
+
+    Source source;
+    if (!source_open(&source, script->path))
+    {
+        char message[512];
+        int length = snprintf(message, sizeof(message), "Error: Cannot read %s: %s\n", script->path, strerror(errno));
+        collect(script, BRAINROT_STDERR, message, (size_t)length < sizeof(message) ? (size_t)length : sizeof(message) - 1);
+        script->failed = true;
+    }
+    else
+    {
+        BrainrotProgram *program = brainrot_parse(source.data, source.length, &options);
+        source_release(&source);
+        if (program)
+        {
+            brainrot_run(program);
+            brainrot_free(program);
+        }
+        else
+        {
+            script->failed = true;
+        }
+    }
+    script->milliseconds = elapsed_milliseconds(&start);
+}
+
+/* Next script for worker index to run, from its own queue or stolen; -1 when all are taken */
+static int take_script(Batch *batch, int index)
+{
+    for (int i = 0; i < batch->queue_count; i++)
+    {
+        Queue *queue = &batch->queues[(index + i) % batch->queue_count];
+        int script = -1;
+        pthread_mutex_lock(&queue->lock);
+        if (queue->head < queue->tail)
+            script = i == 0 ? queue->scripts[queue->head++] : queue->scripts[--queue->tail];
+        pthread_mutex_unlock(&queue->lock);
+        if (script >= 0)
+            return script;
+    }
+    return -1;
+}
+
+static void *work(void *argument)
+{
+    Worker *worker = argument;
+    Batch *batch = worker->batch;
+    int index;
+    while ((index = take_script(batch, worker->index)) >= 0)
+    {
+        run_script(batch, &batch->scripts[index]);
+        pthread_mutex_lock(&batch->lock);
+        batch->scripts[index].done = true;
+        pthread_cond_broadcast(&batch->finished);
+        pthread_mutex_unlock(&batch->lock);
+    }
+    return NULL;
+}
+
+static void print_script(const Script *script)
+{
+    size_t offset = 0;
+    for (int i = 0; i < script->segment_count; i++)
+    {
+        OutputStream stream = script->segments[i].stream == BRAINROT_STDOUT ? OUTPUT_STDOUT : OUTPUT_STDERR;
+        output_write(stream, script->output + offset, script->segments[i].length);
+        offset += script->segments[i].length;
+    }
+    output_printf(OUTPUT_STDERR, "%s: %.3f ms\n", script->path, script->milliseconds);
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(((const Script *)a)->path, ((const Script *)b)->path);
+}
+
+/* The .brainrot files in directory, sorted by name */
+static Script *list_directory(const char *directory, int *count)
+{
+    DIR *dir = opendir(directory);
+    if (!dir)
+        return NULL;
+    Script *scripts = NULL;
+    int capacity = 0;
+    *count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        size_t length = strlen(entry->d_name);
+        if (length <= 9 || strcmp(entry->d_name + length - 9, ".brainrot") != 0)
+            continue;
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            scripts = realloc(scripts, capacity * sizeof(Script));
+        }
+        Script *script = &scripts[(*count)++];
+        memset(script, 0, sizeof(Script));
+        script->path = malloc(strlen(directory) + length + 2);
+        sprintf(script->path, "%s/%s", directory, entry->d_name);
+    }
+    closedir(dir);
+    qsort(scripts, *count, sizeof(Script), compare_paths);
+    if (!scripts)
+        scripts = calloc(1, sizeof(Script));
+    return scripts;
+}
+
+/* The files named on the non-empty lines of the list file at path */
+static Script *list_file(const char *path, int *count)
+{
+    Source list;
+    if (!source_open(&list, path))
+        return NULL;
+    Script *scripts = NULL;
+    int capacity = 0;
+    *count = 0;
+    char *line = list.data;
+    char *end = list.data + list.length;
+    while (line < end)
+    {
+        char *next = memchr(line, '\n', end - line);
+        char *stop = next ? next : end;
+        while (stop > line && (stop[-1] == ' ' || stop[-1] == '\t' || stop[-1] == '\r'))
+            stop--;
+        if (stop > line)
+        {
+            if (*count == capacity)
+            {
+                capacity = capacity ? capacity * 2 : 64;
+                scripts = realloc(scripts, capacity * sizeof(Script));
+            }
+            Script *script = &scripts[(*count)++];
+            memset(script, 0, sizeof(Script));
+            script->path = strndup(line, stop - line);
+        }
+        line = next ? next + 1 : end;
+    }
+    source_release(&list);
+    if (!scripts)
+        scripts = calloc(1, sizeof(Script));
+    return scripts;
+}
+
+int batch_run(const char *path, int threads, const BrainrotOptions *options)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct stat info;
+    Batch batch = {.options = *options};
+    bool directory = strcmp(path, "-") != 0 && stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+    batch.scripts = directory ? list_directory(path, &batch.script_count) : list_file(path, &batch.script_count);
+    if (!batch.scripts)
+    {
+        output_printf(OUTPUT_STDERR, "Error: Cannot read %s: %s\n", strcmp(path, "-") == 0 ? "standard input" : path,
+                      strerror(errno));
+        return 1;
+    }
+
+    // Deal the scripts out in turn, so every worker starts on early ones
+    if (threads > batch.script_count)
+        threads = batch.script_count > 0 ? batch.script_count : 1;
+    batch.queue_count = threads;
+    batch.queues = calloc(threads, sizeof(Queue));
+    for (int i = 0; i < threads; i++)
+    {
+        batch.queues[i].scripts = malloc((batch.script_count / threads + 1) * sizeof(int));
+        pthread_mutex_init(&batch.queues[i].lock, NULL);
+    }
+    for (int i = 0; i < batch.script_count; i++)
+    {
+        Queue *queue = &batch.queues[i % threads];
+        queue->scripts[queue->tail++] = i;
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.finished, NULL);
+
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    Worker *workers = malloc(threads * sizeof(Worker));
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i] = (Worker){&batch, i};
+        pthread_create(&ids[i], NULL, work, &workers[i]);
+    }
+
+    // Print each script's output as soon as it and every script before it are done
+    int status = 0;
+    for (int i = 0; i < batch.script_count; i++)
+    {
+        Script *script = &batch.scripts[i];
+        pthread_mutex_lock(&batch.lock);
+        while (!script->done)
+            pthread_cond_wait(&batch.finished, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+
+        print_script(script);
+        if (script->failed)
+            status = 1;
+        free(script->output);
+        free(script->segments);
+        free(script->path);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(ids[i], NULL);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_mutex_destroy(&batch.queues[i].lock);
+        free(batch.queues[i].scripts);
+    }
+    output_printf(OUTPUT_STDERR, "%d scripts in %.3f ms on %d thread%s\n", batch.script_count,
+                  elapsed_milliseconds(&start), threads, threads == 1 ? "" : "s");
+
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.finished);
+    free(ids);
+    free(workers);
+    free(batch.queues);
+    free(batch.scripts);
+    return status;
+}
@@ -0,0 +1,28 @@
+/* batch.h */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "brainrot.h"
+
+/*
+ * Batch mode (--batch): many independent scripts run in one process on a
+ * pool of worker threads, without a process per script.
+ *
+ * Each script is parsed and run through libbrainrot with a program and
+ * output buffers of its own. Every worker has a queue of scripts to run
+ * in order and, once it is empty, steals from the far end of another
+ * worker's queue. As scripts finish, their output is printed in the order
+ * they were listed, exactly as running them one after another would
+ * print it, each followed on stderr by the time it took.
+ */
+
+/*
+ * Run every .brainrot file in the directory at path, in name order, or
+ * each file named on a line of the list file at path ("-" reads the list
+ * from standard input), on the given number of threads. Returns 1 if any
+ * script could not be read, parsed or checked, otherwise 0.
+ */
+int batch_run(const char *path, int threads, const BrainrotOptions *options);
+
+#endif /* BATCH_H */
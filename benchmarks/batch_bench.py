@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+Batch benchmark.
+
+Generates a directory of small independent scripts and runs all of them
+three ways: one brainrot process per script, as a shell loop over the
+files would, then `brainrot --batch` on one thread and on --threads
+threads. Reports the wall time of each and the time per script.
+
+Usage: python3 benchmarks/batch_bench.py [--brainrot ./brainrot] [--scripts 2000] [--threads 4]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def script(i):
+    return (
+        "skibidi main {\n"
+        "    rizz total = 0;\n"
+        "    flex (rizz j = 0; j < %d; j = j + 1) {\n"
+        "        edging (j %% 3 == 0) { total = total + j; }\n"
+        "    }\n"
+        '    yapping("script %d: %%d", total);\n'
+        "}\n" % (100 + i % 50, i)
+    )
+
+
+def run(command):
+    start = time.perf_counter()
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        sys.exit("%s failed: %s" % (" ".join(command), result.stderr.decode().strip()))
+    return time.perf_counter() - start, result.stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--brainrot", default="./brainrot")
+    parser.add_argument("--scripts", type=int, default=2000)
+    parser.add_argument("--threads", type=int, default=os.cpu_count() or 1)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        paths = []
+        for i in range(args.scripts):
+            path = os.path.join(directory, "script_%05d.brainrot" % i)
+            with open(path, "w") as f:
+                f.write(script(i))
+            paths.append(path)
+
+        start = time.perf_counter()
+        expected = b""
+        for path in paths:
+            expected += run([args.brainrot, path])[1]
+        processes = time.perf_counter() - start
+
+        results = [("process per script", processes)]
+        for threads in sorted({1, args.threads}):
+            elapsed, output = run([args.brainrot, "--batch", directory, "-j", str(threads)])
+            if output != expected:
+                sys.exit("--batch -j %d printed different output" % threads)
+            results.append(("--batch -j %d" % threads, elapsed))
+
+        print("%-20s %12s %16s" % ("mode", "seconds", "per script (us)"))
+        for name, elapsed in results:
+            print("%-20s %12.3f %16.1f" % (name, elapsed, elapsed / args.scripts * 1e6))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Function call benchmark.
+
+Runs a recursive `fib(n)` on the tree walker, the virtual machine and a
+native build and reports the time per call, which is dominated by call
+overhead since each call does a comparison and an addition. The time of
+an empty program is subtracted so that process startup and parsing are
+not counted.
+
+Usage: python3 benchmarks/call_bench.py [--brainrot ./brainrot] [--n 30] [--runs 3]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+PROGRAM = """skibidi rizz fib(rizz n) {
+    edging (n < 2) {
+        bussin n;
+    }
+    bussin fib(n - 1) + fib(n - 2);
+}
+
+skibidi main {
+    yapping("%%d", fib(%d));
+}
+"""
+
+EMPTY = """skibidi main {
+    yapping("%d", 0);
+}
+"""
+
+
+def calls(n):
+    a, b = 1, 1
+    for _ in range(n):
+        a, b = b, a + b + 1
+    return a
+
+
+def best_time(command, runs):
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        result = subprocess.run(command, capture_output=True, text=True)
+        elapsed = time.perf_counter() - start
+        if result.returncode != 0:
+            sys.exit("%s failed: %s" % (command[0], result.stderr.strip()))
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--brainrot", default="./brainrot")
+    parser.add_argument("--n", type=int, default=30)
+    parser.add_argument("--runs", type=int, default=3)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        source = os.path.join(directory, "fib.brainrot")
+        empty = os.path.join(directory, "empty.brainrot")
+        with open(source, "w") as f:
+            f.write(PROGRAM % args.n)
+        with open(empty, "w") as f:
+            f.write(EMPTY)
+
+        native = os.path.join(directory, "fib")
+        native_empty = os.path.join(directory, "empty")
+        for path, output in ((source, native), (empty, native_empty)):
+            subprocess.run([args.brainrot, "--native", "-o", output, path], check=True)
+
+        engines = [
+            ("tree", [args.brainrot, "-O0", "--engine=tree"], None),
+            ("vm", [args.brainrot, "-O0", "--engine=vm"], None),
+            ("native", None, (native, native_empty)),
+        ]
+        count = calls(args.n)
+        print("fib(%d): %d calls" % (args.n, count))
+        print("%-8s %10s %12s" % ("engine", "seconds", "ns/call"))
+        for name, command, binaries in engines:
+            if binaries:
+                elapsed = best_time([binaries[0]], args.runs) - best_time([binaries[1]], args.runs)
+            else:
+                elapsed = best_time(command + [source], args.runs) - best_time(command + [empty], args.runs)
+            print("%-8s %10.3f %12.1f" % (name, elapsed, elapsed * 1e9 / count))
+
+
+if __name__ == "__main__":
+    main()
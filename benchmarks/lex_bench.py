@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+Scanner throughput benchmark.
+
+Generates large sources made of declarations, assignments over many
+distinct identifiers, keywords, string literals and comments, and times
+`brainrot --lex-only` on them, which scans a program without parsing it.
+Reports megabytes of source scanned per second; pass --brainrot more than
+once to compare builds.
+
+Usage: python3 benchmarks/lex_bench.py [--brainrot ./brainrot ...] [--sizes 1,16,64] [--runs 5]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def lexing_program(megabytes):
+    target = megabytes * 1024 * 1024
+    lines = ["skibidi main {"]
+    size = 0
+    i = 0
+    while size < target:
+        name = "counter_%d" % (i % 5000)
+        chunk = [
+            "    rizz %s = %d;" % (name, i),
+            "    flex (rizz j = 0; j < 10; j = j + 1) { %s = %s + j * 2; }" % (name, name),
+            '    edging (%s > 100) { yapping("%%d is big\\n", %s); } amogus { bruh; }' % (name, name),
+            "    // %s keeps count of nothing in particular" % name,
+        ]
+        lines.extend(chunk)
+        size += sum(len(line) + 1 for line in chunk)
+        i += 1
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def best_time(brainrot, path, runs):
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        result = subprocess.run([brainrot, "--lex-only", path], capture_output=True, text=True)
+        elapsed = time.perf_counter() - start
+        if result.returncode != 0:
+            sys.exit("%s failed: %s" % (brainrot, result.stderr.strip()))
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--brainrot", action="append")
+    parser.add_argument("--sizes", default="1,16,64")
+    parser.add_argument("--runs", type=int, default=5)
+    args = parser.parse_args()
+    binaries = args.brainrot or ["./brainrot"]
+
+    print("%-24s %8s %10s %10s" % ("brainrot", "MB", "seconds", "MB/s"))
+    with tempfile.TemporaryDirectory() as directory:
+        for megabytes in (int(s) for s in args.sizes.split(",")):
+            path = os.path.join(directory, "lex.brainrot")
+            with open(path, "w") as f:
+                f.write(lexing_program(megabytes))
+            actual = os.path.getsize(path) / (1024 * 1024)
+            for brainrot in binaries:
+                elapsed = best_time(brainrot, path, args.runs)
+                print("%-24s %8.1f %10.3f %10.1f" % (brainrot, actual, elapsed, actual / elapsed))
+
+
+if __name__ == "__main__":
+    main()
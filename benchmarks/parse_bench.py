@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+Parse-time scaling benchmark.
+
+Generates brainrot programs with N statements and a switch with N
+`sigma rule` arms, runs each through the interpreter and reports the time
+per statement. Parsing is linear in program size, so the per-statement
+cost should stay roughly flat as N grows; a quadratic step shows up as a
+per-statement cost that grows with N.
+
+Usage: python3 benchmarks/parse_bench.py [--brainrot ./brainrot] [--sizes 10000,100000,1000000]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def statements_program(n):
+    body = ["    rizz x = 0;"]
+    body += ["    x = x + 1;"] * n
+    body.append('    yapping("%d", x);')
+    return "skibidi main {\n" + "\n".join(body) + "\n}\n"
+
+
+def switch_program(n):
+    body = ["    rizz x = %d;" % (n - 1), "    rizz hits = 0;", "    ohio (x) {"]
+    for i in range(n):
+        body.append("        sigma rule %d: hits = hits + 1; bruh;" % i)
+    body.append("    }")
+    body.append('    yapping("%d", hits);')
+    return "skibidi main {\n" + "\n".join(body) + "\n}\n"
+
+
+def run(brainrot, engine, source):
+    with tempfile.NamedTemporaryFile("w", suffix=".brainrot", delete=False) as f:
+        f.write(source)
+        path = f.name
+    try:
+        with open(path) as stdin:
+            start = time.perf_counter()
+            result = subprocess.run(
+                [brainrot, "--engine=" + engine],
+                stdin=stdin,
+                capture_output=True,
+                text=True,
+            )
+            elapsed = time.perf_counter() - start
+    finally:
+        os.unlink(path)
+    if result.returncode != 0:
+        sys.exit("brainrot failed: " + result.stderr.strip())
+    return elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--brainrot", default="./brainrot")
+    parser.add_argument("--engine", default="tree", choices=["tree", "vm"])
+    parser.add_argument("--sizes", default="10000,100000,1000000")
+    args = parser.parse_args()
+    sizes = [int(s) for s in args.sizes.split(",")]
+
+    print("%-12s %10s %10s %14s" % ("shape", "N", "seconds", "ns/statement"))
+    for name, generate in (("statements", statements_program), ("switch", switch_program)):
+        for n in sizes:
+            elapsed = run(args.brainrot, args.engine, generate(n))
+            print("%-12s %10d %10.3f %14.1f" % (name, n, elapsed, elapsed * 1e9 / n))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+Server latency benchmark.
+
+Starts `brainrot --serve` and measures the latency of requests for a
+small script: a new process per run, the server given the source, and
+the server given only the hash of a script it has cached. Reports the
+median and 99th percentile of each.
+
+Usage: python3 benchmarks/serve_bench.py [--brainrot ./brainrot] [--requests 2000] [--threads 4]
+"""
+
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+SCRIPT = b"""skibidi main {
+    rizz total = 0;
+    flex (rizz i = 0; i < 100; i = i + 1) {
+        edging (i % 3 == 0) { total = total + i; }
+    }
+    yapping("%d", total);
+}
+"""
+
+
+def fnv1a(data):
+    value = 0xcbf29ce484222325
+    for byte in data:
+        value = ((value ^ byte) * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+def request(sock, kind, payload):
+    sock.sendall(kind + struct.pack("=I", len(payload)) + payload)
+    while True:
+        header = sock.recv(5, socket.MSG_WAITALL)
+        length = struct.unpack("=I", header[1:])[0]
+        data = sock.recv(length, socket.MSG_WAITALL) if length else b""
+        if header[:1] == b"X":
+            if struct.unpack("=i", data)[0] != 0:
+                sys.exit("request failed")
+            return
+        if header[:1] == b"M":
+            sys.exit("script not cached")
+
+
+def percentiles(times):
+    times = sorted(times)
+    return times[len(times) // 2] * 1e3, times[min(len(times) - 1, len(times) * 99 // 100)] * 1e3
+
+
+def measure(run, count):
+    times = []
+    for _ in range(count):
+        start = time.perf_counter()
+        run()
+        times.append(time.perf_counter() - start)
+    return percentiles(times)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--brainrot", default="./brainrot")
+    parser.add_argument("--requests", type=int, default=2000)
+    parser.add_argument("--threads", type=int, default=4)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        script = os.path.join(directory, "script.brainrot")
+        with open(script, "wb") as f:
+            f.write(SCRIPT)
+        path = os.path.join(directory, "brainrot.sock")
+        server = subprocess.Popen([args.brainrot, "--serve", path, "-j", str(args.threads)])
+        try:
+            while not os.path.exists(path):
+                time.sleep(0.01)
+            with socket.socket(socket.AF_UNIX) as sock:
+                sock.connect(path)
+                by_hash = struct.pack("=Q", fnv1a(SCRIPT))
+                results = [
+                    ("process per run", measure(lambda: subprocess.run([args.brainrot, script], stdout=subprocess.DEVNULL,
+                                                                       check=True), min(args.requests, 500))),
+                    ("server, source", measure(lambda: request(sock, b"S", SCRIPT), args.requests)),
+                    ("server, hash", measure(lambda: request(sock, b"H", by_hash), args.requests)),
+                ]
+        finally:
+            server.terminate()
+            server.wait()
+
+    print("%-18s %10s %10s" % ("request", "p50 (ms)", "p99 (ms)"))
+    for name, (p50, p99) in results:
+        print("%-18s %10.3f %10.3f" % (name, p50, p99))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Startup benchmark for precompiled programs.
+
+Runs small and generated larger programs many times each: compiled from
+source every run, reused from the --cache directory, and loaded from a
+.brc file written with --compile-only. The cost of exec'ing /bin/true is
+shown as the floor a cached program should come close to.
+
+Usage: python3 benchmarks/startup_bench.py [--brainrot ./brainrot] [--runs 200] [--sizes 1000,100000]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def statements_program(n):
+    body = ["    rizz x = 0;"]
+    body += ["    x = x + 1;"] * n
+    body.append('    yapping("%d", x);')
+    return "skibidi main {\n" + "\n".join(body) + "\n}\n"
+
+
+def mean_time(command, path, runs, env):
+    start = time.perf_counter()
+    for _ in range(runs):
+        with open(path, "rb") as stdin:
+            result = subprocess.run(command, stdin=stdin, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, env=env)
+        if result.returncode != 0:
+            sys.exit("%s failed: %s" % (command[0], result.stderr.decode().strip()))
+    return (time.perf_counter() - start) / runs
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--brainrot", default="./brainrot")
+    parser.add_argument("--runs", type=int, default=200)
+    parser.add_argument("--sizes", default="1000,100000")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        env = dict(os.environ, BRAINROT_CACHE_DIR=os.path.join(directory, "cache"))
+        programs = [("hello", 'skibidi main {\n    yapping("Hello, World!");\n}\n')]
+        programs += [("%d stmts" % n, statements_program(n)) for n in map(int, args.sizes.split(","))]
+
+        print("%-14s %12s %12s %12s %12s" % ("program", "exec (ms)", "source (ms)", "cache (ms)", ".brc (ms)"))
+        for name, text in programs:
+            source = os.path.join(directory, "program.brainrot")
+            compiled = os.path.join(directory, "program.brc")
+            with open(source, "w") as f:
+                f.write(text)
+            # Fill the cache and write the .brc file before timing
+            mean_time([args.brainrot, "--compile-only", "-o", compiled], source, 1, env)
+            mean_time([args.brainrot, "--cache"], source, 1, env)
+
+            times = [
+                mean_time(["/bin/true"], source, args.runs, env),
+                mean_time([args.brainrot, "--engine=vm"], source, args.runs, env),
+                mean_time([args.brainrot, "--cache"], source, args.runs, env),
+                mean_time([args.brainrot], compiled, args.runs, env),
+            ]
+            print("%-14s %12.3f %12.3f %12.3f %12.3f" % ((name,) + tuple(t * 1e3 for t in times)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+/* brainrot.c */
+
+#include "brainrot.h"
+#include "ast.h"
+#include "compiler.h"
+#include "jit.h"
+#include "optimize.h"
+#include "output.h"
+#include "resolve.h"
+#include "typecheck.h"
+#include "vm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Defined in lang.y and lang.l */
+extern Program *parse_program(void);
+extern void lex_begin(char *data, size_t size);
+extern void lex_end(void);
+
+struct BrainrotProgram
+{
+    BrainrotOptions options;
+    char *text;     /* Copy of the source, which the program points into */
+    Program *program;
+    Chunk *chunk;   /* Compiled once for BRAINROT_ENGINE_VM */
+};
+
+/* What the calling thread was doing before a call into the library */
+typedef struct
+{
+    Program *program;
+    bool jit_enabled;
+    OutputTarget *output; /* Restored on leaving, for calls made from a write callback */
+} Saved;
+
+static void forward_output(void *context, OutputStream stream, const char *data, size_t length)
+{
+    const BrainrotOptions *options = context;
+    options->write(options->context, (BrainrotStream)stream, data, length);
+}
+
+/* Make program current on this thread, its output going where its options say */
+static Saved enter(BrainrotProgram *program)
+{
+    Saved saved = {current_program, jit_enabled, NULL};
+    if (program->options.write)
+        saved.output = output_attach(forward_output, &program->options, OUTPUT_DEFAULT_BUFFER_SIZE);
+    else
+        saved.output = output_attach(NULL, NULL, OUTPUT_DEFAULT_BUFFER_SIZE);
+    current_program = program->program;
+    jit_enabled = program->options.engine == BRAINROT_ENGINE_JIT;
+    return saved;
+}
+
+static void leave(Saved saved)
+{
+    output_detach(saved.output);
+    current_program = saved.program;
+    jit_enabled = saved.jit_enabled;
+}
+
+void brainrot_default_options(BrainrotOptions *options)
+{
+    memset(options, 0, sizeof(BrainrotOptions));
+    options->engine = BRAINROT_ENGINE_TREE;
+    options->opt_level = 2;
+}
+
+BrainrotProgram *brainrot_parse(const char *source, size_t length, const BrainrotOptions *options)
+{
+    BrainrotProgram *program = calloc(1, sizeof(BrainrotProgram));
+    if (options)
+        program->options = *options;
+    else
+        brainrot_default_options(&program->options);
+
+    // The scanner works in place and needs two NULs after the text
+    program->text = malloc(length + 2);
+    memcpy(program->text, source, length);
+    program->text[length] = '\0';
+    program->text[length + 1] = '\0';
+
+    Saved saved = enter(program);
+    lex_begin(program->text, length + 2);
+    program->program = parse_program();
+    lex_end();
+
+    bool valid = program->program && resolve_program(program->program->root) &&
+                 typecheck_program(program->program->root);
+    if (valid)
+    {
+        optimize_program(program->program->root, program->options.opt_level);
+        if (program->options.engine == BRAINROT_ENGINE_VM)
+        {
+            program->chunk = compile_program(program->program->root);
+            valid = program->chunk != NULL;
+        }
+    }
+    leave(saved);
+
+    if (!valid)
+    {
+        brainrot_free(program);
+        return NULL;
+    }
+    return program;
+}
+
+int brainrot_run(BrainrotProgram *program)
+{
+    Saved saved = enter(program);
+    Program *run = program->program;
+    run->halted = false;
+    run->result.lvalue = 0;
+    for (int i = 0; i < var_count; i++)
+    {
+        symbol_table[i].value.lvalue = 0;
+        release_array(&symbol_table[i]);
+    }
+    // The VM leaves main's result in the program; the tree walker leaves the last bussin's there
+    if (program->chunk)
+        vm_execute(program->chunk);
+    else if (execute_statement(run->root) != FLOW_RETURN)
+        run->result.lvalue = 0;
+    int status = run->result.ivalue;
+    leave(saved);
+    return status;
+}
+
+void brainrot_set_output(BrainrotProgram *program, BrainrotWrite write, void *context)
+{
+    program->options.write = write;
+    program->options.context = context;
+}
+
+void brainrot_free(BrainrotProgram *program)
+{
+    if (!program)
+        return;
+    free_chunk(program->chunk);
+    free_program(program->program);
+    free(program->text);
+    free(program);
+}
@@ -0,0 +1,64 @@
+/* brainrot.h */
+
+#ifndef BRAINROT_H
+#define BRAINROT_H
+
+#include <stddef.h>
+
+/*
+ * Embedding interface of libbrainrot.
+ *
+ * brainrot_parse checks and optimizes a program once; brainrot_run then
+ * runs it as often as needed, each run starting with every variable at
+ * zero and every array empty. What a program prints, and every error
+ * message, is passed to the write callback of its options, on
+ * BRAINROT_STDOUT for yapping and yappin and BRAINROT_STDERR for baka and
+ * errors, in the order it was printed.
+ *
+ * Each program keeps its own state, so different programs can be parsed
+ * and run on different threads at the same time. A single program must
+ * not be run by two threads at once.
+ */
+typedef struct BrainrotProgram BrainrotProgram;
+
+typedef enum
+{
+    BRAINROT_STDOUT,
+    BRAINROT_STDERR
+} BrainrotStream;
+
+typedef void (*BrainrotWrite)(void *context, BrainrotStream stream, const char *data, size_t length);
+
+typedef enum
+{
+    BRAINROT_ENGINE_TREE,
+    BRAINROT_ENGINE_VM,
+    BRAINROT_ENGINE_JIT /* The tree walker with its loops compiled to machine code */
+} BrainrotEngine;
+
+typedef struct
+{
+    BrainrotEngine engine;
+    int opt_level;       /* 0, 1 or 2 */
+    BrainrotWrite write; /* NULL writes to the process's stdout and stderr */
+    void *context;       /* Passed to write */
+} BrainrotOptions;
+
+/* The options of the brainrot command without flags: the tree walker at -O2 */
+void brainrot_default_options(BrainrotOptions *options);
+
+/*
+ * Parse the length bytes of source text, which are copied. Returns NULL
+ * after writing the error if the program does not parse or check.
+ */
+BrainrotProgram *brainrot_parse(const char *source, size_t length, const BrainrotOptions *options);
+
+/* Run the program; returns the value main gave bussin, or 0 if it had none */
+int brainrot_run(BrainrotProgram *program);
+
+/* Send the output of the program's later runs to write instead */
+void brainrot_set_output(BrainrotProgram *program, BrainrotWrite write, void *context);
+
+void brainrot_free(BrainrotProgram *program);
+
+#endif /* BRAINROT_H */
@@ -0,0 +1,699 @@
+/* brc.c */
+
+#include "brc.h"
+#include "format.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char brc_magic[4] = {'\177', 'B', 'R', 'C'};
+
+/* Tells a file written on a machine with the other byte order */
+#define BRC_BYTE_ORDER 0x01020304u
+
+/* The file starts with this header; every section after it is int32_t */
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    int32_t opt_level;
+    uint64_t source_hash;
+    uint64_t source_length;
+    int32_t line;          /* Line runtime errors are reported at */
+    int32_t max_stack;
+    int32_t code_count;
+    int32_t string_count;  /* Text offsets of NUL-terminated strings */
+    int32_t format_count;  /* BrcFormat records */
+    int32_t segment_count; /* BrcSegment records, all formats' in order */
+    int32_t text_size;
+    int32_t function_count; /* ChunkFunction records, in order of entry */
+} BrcHeader;
+
+typedef struct
+{
+    int32_t stream;
+    int32_t segment_count;
+    int32_t value_count;
+} BrcFormat;
+
+typedef struct
+{
+    int32_t kind;
+    int32_t text; /* Offset into the text area, NUL-terminated there */
+    int32_t length;
+    int32_t precision;
+} BrcSegment;
+
+/* A loaded chunk and the memory behind it, freed together */
+typedef struct
+{
+    Chunk chunk;
+    void *map; /* Set if brc_load_file mapped the file */
+    size_t map_size;
+    int32_t *code; /* Copy of the code with its element accesses checked */
+} Image;
+
+uint64_t brc_hash(const char *data, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+bool brc_is_image(const char *data, size_t length)
+{
+    return length >= sizeof(brc_magic) && memcmp(data, brc_magic, sizeof(brc_magic)) == 0;
+}
+
+/* Writing */
+
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} TextArea;
+
+static int32_t add_text(TextArea *text, const char *data, size_t length)
+{
+    if (text->length + length + 1 > text->capacity)
+    {
+        text->capacity = (text->length + length + 1) * 2;
+        text->data = realloc(text->data, text->capacity);
+    }
+    int32_t offset = (int32_t)text->length;
+    memcpy(text->data + text->length, data, length);
+    text->data[text->length + length] = '\0';
+    text->length += length + 1;
+    return offset;
+}
+
+static bool write_sections(const Chunk *chunk, const BrcSource *source, FILE *out)
+{
+    TextArea text = {0};
+    int32_t *strings = malloc((chunk->string_count + 1) * sizeof(int32_t));
+    BrcFormat *formats = malloc((chunk->format_count + 1) * sizeof(BrcFormat));
+    int segment_count = 0;
+    for (int i = 0; i < chunk->format_count; i++)
+        segment_count += chunk->formats[i]->segment_count;
+    BrcSegment *segments = malloc((segment_count + 1) * sizeof(BrcSegment));
+
+    for (int i = 0; i < chunk->string_count; i++)
+        strings[i] = add_text(&text, chunk->strings[i], strlen(chunk->strings[i]));
+    BrcSegment *segment = segments;
+    for (int i = 0; i < chunk->format_count; i++)
+    {
+        const Format *format = chunk->formats[i];
+        formats[i] = (BrcFormat){format->stream, format->segment_count, format->value_count};
+        for (int j = 0; j < format->segment_count; j++)
+        {
+            const FormatSegment *s = &format->segments[j];
+            *segment++ = (BrcSegment){s->kind, add_text(&text, s->text, s->length), (int32_t)s->length, s->precision};
+        }
+    }
+
+    BrcHeader header = {
+        .version = BRC_VERSION,
+        .byte_order = BRC_BYTE_ORDER,
+        .opt_level = source->opt_level,
+        .source_hash = source->hash,
+        .source_length = source->length,
+        .line = chunk->line,
+        .max_stack = chunk->max_stack,
+        .code_count = chunk->count,
+        .string_count = chunk->string_count,
+        .format_count = chunk->format_count,
+        .segment_count = segment_count,
+        .text_size = (int32_t)text.length,
+        .function_count = chunk->function_count,
+    };
+    memcpy(header.magic, brc_magic, sizeof(brc_magic));
+
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   fwrite(chunk->code, sizeof(int32_t), chunk->count, out) == (size_t)chunk->count &&
+                   fwrite(strings, sizeof(int32_t), chunk->string_count, out) == (size_t)chunk->string_count &&
+                   fwrite(formats, sizeof(BrcFormat), chunk->format_count, out) == (size_t)chunk->format_count &&
+                   fwrite(segments, sizeof(BrcSegment), segment_count, out) == (size_t)segment_count &&
+                   fwrite(chunk->functions, sizeof(ChunkFunction), chunk->function_count, out) ==
+                       (size_t)chunk->function_count &&
+                   fwrite(text.data, 1, text.length, out) == text.length;
+    free(text.data);
+    free(strings);
+    free(formats);
+    free(segments);
+    return written;
+}
+
+bool brc_write(const Chunk *chunk, const BrcSource *source, const char *path)
+{
+    // Something other than a regular file, such as /dev/null or a pipe,
+    // cannot be replaced by renaming and is written directly
+    struct stat st;
+    if (stat(path, &st) == 0 && !S_ISREG(st.st_mode))
+    {
+        FILE *out = fopen(path, "wb");
+        bool written = out && write_sections(chunk, source, out);
+        if (out && fclose(out) != 0)
+            written = false;
+        return written;
+    }
+
+    size_t length = strlen(path) + 32;
+    char *temporary = malloc(length);
+    snprintf(temporary, length, "%s.%ld.tmp", path, (long)getpid());
+
+    FILE *out = fopen(temporary, "wb");
+    bool written = out && write_sections(chunk, source, out);
+    if (out && fclose(out) != 0)
+        written = false;
+    if (written && rename(temporary, path) != 0)
+        written = false;
+    if (!written && out)
+        unlink(temporary);
+    free(temporary);
+    return written;
+}
+
+/* Loading */
+
+/* Operand words following the opcode at code[at], or -1 if they do not fit */
+static int operand_count(const int32_t *code, int at, int count)
+{
+    switch (code[at])
+    {
+    case BC_PUSH:
+    case BC_LOAD:
+    case BC_STORE:
+    case BC_NEW_ARRAY:
+    case BC_ALOAD:
+    case BC_ALOAD_UNCHECKED:
+    case BC_ASTORE:
+    case BC_ASTORE_UNCHECKED:
+    case BC_NEW_WIDE_ARRAY:
+    case BC_ALOAD_WIDE:
+    case BC_ALOAD_WIDE_UNCHECKED:
+    case BC_ASTORE_WIDE:
+    case BC_ASTORE_WIDE_UNCHECKED:
+    case BC_NEW_BYTE_ARRAY:
+    case BC_ALOAD_BYTE:
+    case BC_ALOAD_BYTE_UNCHECKED:
+    case BC_ASTORE_BYTE:
+    case BC_ASTORE_BYTE_UNCHECKED:
+    case BC_NEW_SHORT_ARRAY:
+    case BC_ALOAD_SHORT:
+    case BC_ALOAD_SHORT_UNCHECKED:
+    case BC_ASTORE_SHORT:
+    case BC_ASTORE_SHORT_UNCHECKED:
+    case BC_JUMP:
+    case BC_JUMP_IF_FALSE:
+    case BC_JUMP_IF_TRUE:
+    case BC_JUMP_ILT:
+    case BC_JUMP_IGT:
+    case BC_JUMP_ILE:
+    case BC_JUMP_IGE:
+    case BC_JUMP_IEQ:
+    case BC_JUMP_INE:
+    case BC_JUMP_ULT:
+    case BC_JUMP_UGT:
+    case BC_JUMP_ULE:
+    case BC_JUMP_UGE:
+    case BC_BAKA_VALUE:
+    case BC_CALL:
+        return 1;
+    case BC_PUSH_WIDE:
+    case BC_PRINT:
+        return 2;
+    case BC_SWITCH_DENSE:
+        if (count - at < 4 || code[at + 2] < 0 || code[at + 2] > count)
+            return -1;
+        return 3 + code[at + 2];
+    case BC_SWITCH_SPARSE:
+        if (count - at < 3 || code[at + 1] < 0 || code[at + 1] > count / 2)
+            return -1;
+        return 2 + 2 * code[at + 1];
+    default:
+        return 0;
+    }
+}
+
+/* Values an instruction pops and pushes */
+static int stack_effect(const Chunk *chunk, const int32_t *ip, int *pops)
+{
+    switch (ip[0])
+    {
+    case BC_PUSH:
+    case BC_PUSH_WIDE:
+    case BC_LOAD:
+        *pops = 0;
+        return 1;
+    case BC_ALOAD:
+    case BC_ALOAD_UNCHECKED:
+    case BC_ALOAD_WIDE:
+    case BC_ALOAD_WIDE_UNCHECKED:
+    case BC_ALOAD_BYTE:
+    case BC_ALOAD_BYTE_UNCHECKED:
+    case BC_ALOAD_SHORT:
+    case BC_ALOAD_SHORT_UNCHECKED:
+    case BC_INEG:
+    case BC_FNEG:
+    case BC_LNEG:
+    case BC_DNEG:
+    case BC_I2F:
+    case BC_U2F:
+    case BC_F2I:
+    case BC_F2U:
+    case BC_F2B:
+    case BC_I2B:
+    case BC_I2C:
+    case BC_I2S:
+    case BC_I2L:
+    case BC_U2L:
+    case BC_L2I:
+    case BC_L2B:
+    case BC_L2F:
+    case BC_L2D:
+    case BC_F2L:
+    case BC_D2L:
+    case BC_I2D:
+    case BC_U2D:
+    case BC_F2D:
+    case BC_D2F:
+    case BC_D2I:
+    case BC_D2U:
+    case BC_D2B:
+        *pops = 1;
+        return 1;
+    case BC_JUMP:
+        *pops = 0;
+        return 0;
+    case BC_RETURN:
+    case BC_HALT:
+        *pops = 1;
+        return 0;
+    case BC_CALL:
+        *pops = chunk->functions[ip[1]].parameter_count;
+        return 1;
+    case BC_STORE:
+    case BC_POP:
+    case BC_NEW_ARRAY:
+    case BC_NEW_WIDE_ARRAY:
+    case BC_NEW_BYTE_ARRAY:
+    case BC_NEW_SHORT_ARRAY:
+    case BC_JUMP_IF_FALSE:
+    case BC_JUMP_IF_TRUE:
+    case BC_SWITCH_DENSE:
+    case BC_SWITCH_SPARSE:
+        *pops = 1;
+        return 0;
+    case BC_ASTORE:
+    case BC_ASTORE_UNCHECKED:
+    case BC_ASTORE_WIDE:
+    case BC_ASTORE_WIDE_UNCHECKED:
+    case BC_ASTORE_BYTE:
+    case BC_ASTORE_BYTE_UNCHECKED:
+    case BC_ASTORE_SHORT:
+    case BC_ASTORE_SHORT_UNCHECKED:
+    case BC_JUMP_ILT:
+    case BC_JUMP_IGT:
+    case BC_JUMP_ILE:
+    case BC_JUMP_IGE:
+    case BC_JUMP_IEQ:
+    case BC_JUMP_INE:
+    case BC_JUMP_ULT:
+    case BC_JUMP_UGT:
+    case BC_JUMP_ULE:
+    case BC_JUMP_UGE:
+        *pops = 2;
+        return 0;
+    case BC_PRINT:
+        *pops = chunk->formats[ip[1]]->value_count;
+        return 0;
+    case BC_BAKA_VALUE:
+        *pops = ip[1] < 0;
+        return 0;
+    default: // The binary operators
+        *pops = 2;
+        return 1;
+    }
+}
+
+/* Instructions reached so far, with the stack depth on entry to each */
+typedef struct
+{
+    int start; /* Code of main or the function being walked */
+    int count;
+    int *depth;   /* Depth plus one: 0 if not reached yet, -1 for operands */
+    int *pending; /* Reached instructions whose successors are unchecked */
+    int pending_count;
+} Walk;
+
+/* Reach target with the given depth; false if that is not possible */
+static bool visit(Walk *walk, int target, int depth)
+{
+    if (target < walk->start || target >= walk->count || walk->depth[target] == -1)
+        return false;
+    if (walk->depth[target] == 0)
+    {
+        walk->depth[target] = depth + 1;
+        walk->pending[walk->pending_count++] = target;
+        return true;
+    }
+    return walk->depth[target] == depth + 1;
+}
+
+/*
+ * Check everything the VM takes on trust: that operands name existing
+ * variables, strings, formats and functions, that jumps land on
+ * instructions, that execution cannot run off the end, and that the
+ * operand stack never underflows or grows past max_stack. Depths are
+ * followed along every path and must agree wherever paths meet, as they
+ * do for compiled code. Main and each function are walked on their own
+ * from their entries: jumps stay inside the code they are in, variables
+ * are slots of its frame, only main halts and only functions return, and
+ * both do so with exactly their result on the stack.
+ */
+static bool verify_code(const Chunk *chunk)
+{
+    const int32_t *code = chunk->code;
+    int count = chunk->count;
+    Walk walk = {0, count, calloc(count + 1, sizeof(int)), malloc((count + 1) * sizeof(int)), 0};
+    bool valid = count > 0;
+
+    for (int at = 0; valid && at < count;)
+    {
+        int operands = code[at] >= 0 && code[at] <= BC_HALT ? operand_count(code, at, count) : -1;
+        if (operands < 0 || operands >= count - at)
+        {
+            valid = false;
+            break;
+        }
+        for (int i = 1; i <= operands; i++)
+            walk.depth[at + i] = -1;
+        at += 1 + operands;
+    }
+    for (int i = 0; valid && i < chunk->function_count; i++)
+    {
+        const ChunkFunction *function = &chunk->functions[i];
+        int previous = i > 0 ? chunk->functions[i - 1].entry : 0;
+        valid = function->entry > previous && function->entry < count && walk.depth[function->entry] != -1 &&
+                function->parameter_count >= 0 && function->parameter_count <= function->frame_size &&
+                function->frame_size <= MAX_VARS;
+    }
+
+    for (int region = 0; valid && region <= chunk->function_count; region++)
+    {
+        bool in_function = region > 0;
+        int slots = in_function ? chunk->functions[region - 1].frame_size : MAX_VARS;
+        walk.start = in_function ? chunk->functions[region - 1].entry : 0;
+        walk.count = region < chunk->function_count ? chunk->functions[region].entry : count;
+        valid = visit(&walk, walk.start, 0);
+        while (valid && walk.pending_count > 0)
+        {
+            int at = walk.pending[--walk.pending_count];
+            const int32_t *ip = code + at;
+            switch (ip[0])
+            {
+            case BC_LOAD:
+            case BC_STORE:
+            case BC_NEW_ARRAY:
+            case BC_ALOAD:
+            case BC_ALOAD_UNCHECKED:
+            case BC_ASTORE:
+            case BC_ASTORE_UNCHECKED:
+            case BC_NEW_WIDE_ARRAY:
+            case BC_ALOAD_WIDE:
+            case BC_ALOAD_WIDE_UNCHECKED:
+            case BC_ASTORE_WIDE:
+            case BC_ASTORE_WIDE_UNCHECKED:
+            case BC_NEW_BYTE_ARRAY:
+            case BC_ALOAD_BYTE:
+            case BC_ALOAD_BYTE_UNCHECKED:
+            case BC_ASTORE_BYTE:
+            case BC_ASTORE_BYTE_UNCHECKED:
+            case BC_NEW_SHORT_ARRAY:
+            case BC_ALOAD_SHORT:
+            case BC_ALOAD_SHORT_UNCHECKED:
+            case BC_ASTORE_SHORT:
+            case BC_ASTORE_SHORT_UNCHECKED:
+                valid = ip[1] >= 0 && ip[1] < slots;
+                break;
+            case BC_PRINT:
+                valid = ip[1] >= 0 && ip[1] < chunk->format_count && ip[2] == chunk->formats[ip[1]]->value_count;
+                break;
+            case BC_BAKA_VALUE:
+                valid = ip[1] >= -1 && ip[1] < chunk->string_count;
+                break;
+            case BC_CALL:
+                valid = ip[1] >= 0 && ip[1] < chunk->function_count;
+                break;
+            case BC_RETURN:
+                valid = in_function && walk.depth[at] - 1 == 1;
+                break;
+            case BC_HALT:
+                valid = !in_function && walk.depth[at] - 1 == 1;
+                break;
+            }
+            if (!valid)
+                break;
+
+            int pops;
+            int pushes = stack_effect(chunk, ip, &pops);
+            int after = walk.depth[at] - 1 - pops;
+            if (after < 0 || after + pushes > chunk->max_stack)
+            {
+                valid = false;
+                break;
+            }
+            after += pushes;
+
+            // Successors: the next instruction unless control never falls
+            // through, which must not be past the end, then every jump target
+            if (ip[0] != BC_HALT && ip[0] != BC_RETURN && ip[0] != BC_JUMP && ip[0] != BC_SWITCH_DENSE &&
+                ip[0] != BC_SWITCH_SPARSE)
+                valid = visit(&walk, at + 1 + operand_count(code, at, count), after);
+            if (ip[0] >= BC_JUMP && ip[0] <= BC_JUMP_UGE)
+                valid = valid && visit(&walk, ip[1], after);
+            else if (ip[0] == BC_SWITCH_DENSE)
+            {
+                for (int i = 0; valid && i <= ip[2]; i++)
+                    valid = visit(&walk, ip[3 + i], after);
+            }
+            else if (ip[0] == BC_SWITCH_SPARSE)
+            {
+                valid = visit(&walk, ip[2], after);
+                for (int i = 0; valid && i < ip[1]; i++)
+                    valid = visit(&walk, ip[4 + 2 * i], after);
+            }
+        }
+    }
+    free(walk.depth);
+    free(walk.pending);
+    return valid;
+}
+
+/*
+ * The compiler leaves out the bounds check of accesses it proved in
+ * range, a proof the verifier cannot repeat. Run every access in a
+ * loaded image checked, from a private copy of the code if there are any.
+ */
+static void check_element_accesses(Image *image)
+{
+    Chunk *chunk = &image->chunk;
+    for (int at = 0; at < chunk->count; at += 1 + operand_count(chunk->code, at, chunk->count))
+    {
+        int32_t op = chunk->code[at];
+        if (op != BC_ALOAD_UNCHECKED && op != BC_ASTORE_UNCHECKED && op != BC_ALOAD_WIDE_UNCHECKED &&
+            op != BC_ASTORE_WIDE_UNCHECKED && op != BC_ALOAD_BYTE_UNCHECKED && op != BC_ASTORE_BYTE_UNCHECKED &&
+            op != BC_ALOAD_SHORT_UNCHECKED && op != BC_ASTORE_SHORT_UNCHECKED)
+            continue;
+        if (!image->code)
+        {
+            image->code = malloc(chunk->count * sizeof(int32_t));
+            memcpy(image->code, chunk->code, chunk->count * sizeof(int32_t));
+            chunk->code = image->code;
+        }
+        // Each checked form comes just before its unchecked one
+        chunk->code[at] = op - 1;
+    }
+}
+
+Chunk *brc_load(const char *data, size_t length, const BrcSource *source)
+{
+    const BrcHeader *header = (const BrcHeader *)data;
+    if (length < sizeof(BrcHeader) || !brc_is_image(data, length) || header->version != BRC_VERSION ||
+        header->byte_order != BRC_BYTE_ORDER || header->max_stack < 0 || header->code_count < 0 ||
+        header->string_count < 0 || header->format_count < 0 || header->segment_count < 0 || header->text_size < 0 ||
+        header->function_count < 0)
+        return NULL;
+    if (source && (header->source_hash != source->hash || header->source_length != source->length ||
+                   header->opt_level != source->opt_level))
+        return NULL;
+
+    uint64_t size = sizeof(BrcHeader) + (uint64_t)header->code_count * sizeof(int32_t) +
+                    (uint64_t)header->string_count * sizeof(int32_t) +
+                    (uint64_t)header->format_count * sizeof(BrcFormat) +
+                    (uint64_t)header->segment_count * sizeof(BrcSegment) +
+                    (uint64_t)header->function_count * sizeof(ChunkFunction) + (uint64_t)header->text_size;
+    if (size != length)
+        return NULL;
+    const int32_t *code = (const int32_t *)(header + 1);
+    const int32_t *strings = code + header->code_count;
+    const BrcFormat *formats = (const BrcFormat *)(strings + header->string_count);
+    const BrcSegment *segments = (const BrcSegment *)(formats + header->format_count);
+    const ChunkFunction *functions = (const ChunkFunction *)(segments + header->segment_count);
+    const char *text = (const char *)(functions + header->function_count);
+    int32_t text_size = header->text_size;
+
+    // One allocation holds the chunk and every pointer table into the file
+    size_t table_size = sizeof(Image) + header->string_count * sizeof(char *) +
+                        header->format_count * (sizeof(Format *) + sizeof(Format)) +
+                        header->segment_count * sizeof(FormatSegment);
+    Image *image = calloc(1, table_size);
+    Chunk *chunk = &image->chunk;
+    chunk->code = (int32_t *)code;
+    chunk->count = header->code_count;
+    chunk->max_stack = header->max_stack;
+    chunk->line = header->line;
+    chunk->strings = (char **)(image + 1);
+    chunk->string_count = header->string_count;
+    chunk->formats = (const Format **)(chunk->strings + header->string_count);
+    chunk->format_count = header->format_count;
+    chunk->functions = (ChunkFunction *)functions;
+    chunk->function_count = header->function_count;
+    Format *format_table = (Format *)(chunk->formats + header->format_count);
+    FormatSegment *segment_table = (FormatSegment *)(format_table + header->format_count);
+
+    // Every text has to lie inside the text area and end there with a NUL
+    bool valid = true;
+    for (int i = 0; valid && i < header->string_count; i++)
+    {
+        valid = strings[i] >= 0 && strings[i] < text_size && memchr(text + strings[i], '\0', text_size - strings[i]);
+        chunk->strings[i] = (char *)text + strings[i];
+    }
+    int next_segment = 0;
+    for (int i = 0; valid && i < header->format_count; i++)
+    {
+        const BrcFormat *f = &formats[i];
+        Format *format = &format_table[i];
+        valid = (f->stream == OUTPUT_STDOUT || f->stream == OUTPUT_STDERR) && f->segment_count >= 0 &&
+                f->segment_count <= header->segment_count - next_segment;
+        if (!valid)
+            break;
+        format->stream = f->stream;
+        format->segments = segment_table + next_segment;
+        format->segment_count = f->segment_count;
+        int value_count = 0;
+        for (int j = 0; valid && j < f->segment_count; j++, next_segment++)
+        {
+            const BrcSegment *s = &segments[next_segment];
+            valid = s->kind >= SEGMENT_TEXT && s->kind <= SEGMENT_PRINTF_DOUBLE && s->text >= 0 && s->length >= 0 &&
+                    s->length < text_size - s->text && text[s->text + s->length] == '\0';
+            // Printing needs no arguments, only the values they evaluated to
+            segment_table[next_segment] = (FormatSegment){s->kind, text + s->text, s->length, s->precision, NULL};
+            value_count += s->kind != SEGMENT_TEXT;
+        }
+        valid = valid && value_count == f->value_count;
+        format->value_count = value_count;
+        chunk->formats[i] = format;
+    }
+    if (!valid || !verify_code(chunk))
+    {
+        free(image);
+        return NULL;
+    }
+    check_element_accesses(image);
+    return chunk;
+}
+
+Chunk *brc_load_file(const char *path, const BrcSource *source)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(BrcHeader))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    Chunk *chunk = brc_load(map, st.st_size, source);
+    if (!chunk)
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    Image *image = (Image *)chunk;
+    image->map = map;
+    image->map_size = st.st_size;
+    return chunk;
+}
+
+void brc_release(Chunk *chunk)
+{
+    Image *image = (Image *)chunk;
+    if (image->map)
+        munmap(image->map, image->map_size);
+    free(image->code);
+    free(image);
+}
+
+/* Create path and any missing parents */
+static bool make_directories(char *path)
+{
+    for (char *slash = strchr(path + 1, '/');; slash = strchr(slash + 1, '/'))
+    {
+        if (slash)
+            *slash = '\0';
+        bool made = mkdir(path, 0700) == 0 || errno == EEXIST;
+        if (slash)
+            *slash = '/';
+        if (!made)
+            return false;
+        if (!slash)
+            return true;
+    }
+}
+
+char *brc_cache_path(const BrcSource *source)
+{
+    const char *directory = getenv("BRAINROT_CACHE_DIR");
+    const char *base = NULL;
+    const char *suffix = "";
+    if (!directory || !*directory)
+    {
+        base = getenv("XDG_CACHE_HOME");
+        suffix = "/brainrot";
+        if (!base || !*base)
+        {
+            base = getenv("HOME");
+            suffix = "/.cache/brainrot";
+        }
+        if (!base || !*base)
+            return NULL;
+        directory = base;
+    }
+
+    size_t length = strlen(directory) + strlen(suffix) + 32;
+    char *path = malloc(length);
+    snprintf(path, length, "%s%s", directory, suffix);
+    if (!make_directories(path))
+    {
+        free(path);
+        return NULL;
+    }
+    size_t used = strlen(path);
+    snprintf(path + used, length - used, "/%016llx-O%d.brc", (unsigned long long)source->hash, source->opt_level);
+    return path;
+}
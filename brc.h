@@ -0,0 +1,71 @@
+/* brc.h */
+
+#ifndef BRC_H
+#define BRC_H
+
+#include "compiler.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Precompiled programs (.brc files).
+ *
+ * A .brc file is a compiled chunk laid out so it runs straight from a
+ * read-only mapping of the file: a fixed header, the code words, then the
+ * baka strings and print formats as offsets into a trailing text area,
+ * with the table of user-defined functions just before that area.
+ * Nothing in it is a pointer, so loading is one mmap plus a small table
+ * of pointers into the mapping; no parsing, checking or compiling.
+ *
+ * The header records the hash, length and optimization level of the
+ * source the chunk was compiled from, which is what keys the cache of
+ * programs kept by --cache. Files use the byte order of the machine that
+ * wrote them and are rejected elsewhere, as are files from another
+ * BRC_VERSION, which must change whenever the bytecode does.
+ */
+#define BRC_VERSION 6
+
+/* Identity of a program's source */
+typedef struct
+{
+    uint64_t hash;
+    uint64_t length;
+    int opt_level;
+} BrcSource;
+
+/* 64-bit FNV-1a hash of the source text */
+uint64_t brc_hash(const char *data, size_t length);
+
+/* True if data starts like a .brc file rather than a source program */
+bool brc_is_image(const char *data, size_t length);
+
+/*
+ * Write chunk to path as a .brc file for the given source. The file is
+ * written under a temporary name and renamed into place, so a reader
+ * never sees a partial file. Returns false if it cannot be written.
+ */
+bool brc_write(const Chunk *chunk, const BrcSource *source, const char *path);
+
+/*
+ * Chunk view of the .brc file in data, which must stay valid until
+ * brc_release. Returns NULL if data is not a well-formed .brc file of
+ * this version, or, when source is not NULL, one compiled from a
+ * different source.
+ */
+Chunk *brc_load(const char *data, size_t length, const BrcSource *source);
+
+/* Map the .brc file at path and load it as brc_load does */
+Chunk *brc_load_file(const char *path, const BrcSource *source);
+
+/* Release a chunk returned by brc_load or brc_load_file */
+void brc_release(Chunk *chunk);
+
+/*
+ * Path of the cached .brc file for source, in $BRAINROT_CACHE_DIR, else
+ * $XDG_CACHE_HOME/brainrot, else ~/.cache/brainrot, which is created if
+ * needed. Returns a malloc'd path, or NULL if there is no usable
+ * directory.
+ */
+char *brc_cache_path(const BrcSource *source);
+
+#endif /* BRC_H */
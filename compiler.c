@@ -0,0 +1,801 @@
+/* compiler.c */
+
+#include "compiler.h"
+#include "format.h"
+#include <stdbool.h>
+#include <string.h>
+
+extern void yyerror(const char *s);
+
+#define MAX_BREAK_DEPTH 64
+
+/*
+ * Forward jumps that share a target not emitted yet: the end of the
+ * construct for `bruh`, the loop's next iteration for `grind`, or either
+ * side of a branch for a condition.
+ */
+typedef struct
+{
+    int *patches;
+    int count;
+    int capacity;
+} JumpList;
+
+typedef struct
+{
+    Chunk *chunk;
+    int depth;
+    JumpList breaks[MAX_BREAK_DEPTH];
+    int break_depth;
+    JumpList continues[MAX_BREAK_DEPTH];
+    int continue_depth;
+    bool in_function; /* Compiling a user-defined function rather than main */
+    bool had_error;
+} Compiler;
+
+static void compile_statement(Compiler *c, ASTNode *node);
+static void compile_expression(Compiler *c, ASTNode *node);
+static void compile_call(Compiler *c, ASTNode *node);
+
+static void compile_error(Compiler *c, const char *message)
+{
+    yyerror(message);
+    c->had_error = true;
+}
+
+static void emit_word(Compiler *c, int32_t word)
+{
+    Chunk *chunk = c->chunk;
+    if (chunk->count == chunk->capacity)
+    {
+        chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 256;
+        chunk->code = realloc(chunk->code, chunk->capacity * sizeof(int32_t));
+    }
+    chunk->code[chunk->count++] = word;
+}
+
+/* Emit an opcode and account for its effect on the operand stack */
+static void emit_op(Compiler *c, OpCode op, int stack_effect)
+{
+    emit_word(c, op);
+    c->depth += stack_effect;
+    if (c->depth > c->chunk->max_stack)
+    {
+        c->chunk->max_stack = c->depth;
+    }
+}
+
+/*
+ * The array instruction for elements of the type, from the 4-byte one:
+ * each width's declaration and accesses are laid out in the same order
+ */
+static OpCode array_opcode(OpCode op, ValueType type)
+{
+    switch (element_size(type))
+    {
+    case sizeof(char):
+        return op + (BC_NEW_BYTE_ARRAY - BC_NEW_ARRAY);
+    case sizeof(short):
+        return op + (BC_NEW_SHORT_ARRAY - BC_NEW_ARRAY);
+    case sizeof(Value):
+        return op + (BC_NEW_WIDE_ARRAY - BC_NEW_ARRAY);
+    default:
+        return op;
+    }
+}
+
+/* Emit a jump with a placeholder target and return the operand's offset */
+static int emit_jump(Compiler *c, OpCode op, int stack_effect)
+{
+    emit_op(c, op, stack_effect);
+    emit_word(c, -1);
+    return c->chunk->count - 1;
+}
+
+static void patch_jump(Compiler *c, int operand, int target)
+{
+    c->chunk->code[operand] = target;
+}
+
+static int add_string(Compiler *c, char *string)
+{
+    Chunk *chunk = c->chunk;
+    if (chunk->string_count == chunk->string_capacity)
+    {
+        chunk->string_capacity = chunk->string_capacity ? chunk->string_capacity * 2 : 16;
+        chunk->strings = realloc(chunk->strings, chunk->string_capacity * sizeof(char *));
+    }
+    chunk->strings[chunk->string_count] = string;
+    return chunk->string_count++;
+}
+
+/* Emit a jump whose target will be set by patch_jumps */
+static void add_jump(Compiler *c, JumpList *list, OpCode op, int stack_effect)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->patches = realloc(list->patches, list->capacity * sizeof(int));
+    }
+    list->patches[list->count++] = emit_jump(c, op, stack_effect);
+}
+
+static void patch_jumps(Compiler *c, JumpList *list, int target)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        patch_jump(c, list->patches[i], target);
+    }
+    free(list->patches);
+    list->patches = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+static void push_context(Compiler *c, JumpList *stack, int *depth)
+{
+    if (*depth == MAX_BREAK_DEPTH)
+    {
+        compile_error(c, "Statements nested too deeply");
+        return;
+    }
+    stack[(*depth)++] = (JumpList){0};
+}
+
+static void pop_context(Compiler *c, JumpList *stack, int *depth, int target)
+{
+    if (*depth == 0)
+        return;
+    patch_jumps(c, &stack[--(*depth)], target);
+}
+
+static void emit_context_jump(Compiler *c, JumpList *stack, int depth, const char *message)
+{
+    if (depth == 0)
+    {
+        compile_error(c, message);
+        return;
+    }
+    add_jump(c, &stack[depth - 1], BC_JUMP, 0);
+}
+
+static void push_break_context(Compiler *c)
+{
+    push_context(c, c->breaks, &c->break_depth);
+}
+
+static void pop_break_context(Compiler *c, int target)
+{
+    pop_context(c, c->breaks, &c->break_depth, target);
+}
+
+/* Loops accept both `bruh` and `grind` */
+static void push_loop_context(Compiler *c)
+{
+    push_context(c, c->breaks, &c->break_depth);
+    push_context(c, c->continues, &c->continue_depth);
+}
+
+static void pop_continue_context(Compiler *c, int target)
+{
+    pop_context(c, c->continues, &c->continue_depth, target);
+}
+
+static void compile_break(Compiler *c)
+{
+    emit_context_jump(c, c->breaks, c->break_depth, "bruh outside of a loop or switch");
+}
+
+static void compile_continue(Compiler *c)
+{
+    emit_context_jump(c, c->continues, c->continue_depth, "grind outside of a loop");
+}
+
+/* Opcode implementing each type-specialized expression node */
+static const OpCode node_opcodes[] = {
+    [NODE_INT_ADD] = BC_IADD,
+    [NODE_INT_SUB] = BC_ISUB,
+    [NODE_INT_MUL] = BC_IMUL,
+    [NODE_INT_DIV] = BC_IDIV,
+    [NODE_INT_MOD] = BC_IMOD,
+    [NODE_INT_LT] = BC_ILT,
+    [NODE_INT_GT] = BC_IGT,
+    [NODE_INT_LE] = BC_ILE,
+    [NODE_INT_GE] = BC_IGE,
+    [NODE_INT_EQ] = BC_IEQ,
+    [NODE_INT_NE] = BC_INE,
+    [NODE_INT_NEG] = BC_INEG,
+    [NODE_UNSIGNED_DIV] = BC_UDIV,
+    [NODE_UNSIGNED_MOD] = BC_UMOD,
+    [NODE_UNSIGNED_LT] = BC_ULT,
+    [NODE_UNSIGNED_GT] = BC_UGT,
+    [NODE_UNSIGNED_LE] = BC_ULE,
+    [NODE_UNSIGNED_GE] = BC_UGE,
+    [NODE_FLOAT_ADD] = BC_FADD,
+    [NODE_FLOAT_SUB] = BC_FSUB,
+    [NODE_FLOAT_MUL] = BC_FMUL,
+    [NODE_FLOAT_DIV] = BC_FDIV,
+    [NODE_FLOAT_LT] = BC_FLT,
+    [NODE_FLOAT_GT] = BC_FGT,
+    [NODE_FLOAT_LE] = BC_FLE,
+    [NODE_FLOAT_GE] = BC_FGE,
+    [NODE_FLOAT_EQ] = BC_FEQ,
+    [NODE_FLOAT_NE] = BC_FNE,
+    [NODE_FLOAT_NEG] = BC_FNEG,
+    [NODE_LONG_ADD] = BC_LADD,
+    [NODE_LONG_SUB] = BC_LSUB,
+    [NODE_LONG_MUL] = BC_LMUL,
+    [NODE_LONG_DIV] = BC_LDIV,
+    [NODE_LONG_MOD] = BC_LMOD,
+    [NODE_LONG_LT] = BC_LLT,
+    [NODE_LONG_GT] = BC_LGT,
+    [NODE_LONG_LE] = BC_LLE,
+    [NODE_LONG_GE] = BC_LGE,
+    [NODE_LONG_EQ] = BC_LEQ,
+    [NODE_LONG_NE] = BC_LNE,
+    [NODE_DOUBLE_ADD] = BC_DADD,
+    [NODE_DOUBLE_SUB] = BC_DSUB,
+    [NODE_DOUBLE_MUL] = BC_DMUL,
+    [NODE_DOUBLE_DIV] = BC_DDIV,
+    [NODE_DOUBLE_LT] = BC_DLT,
+    [NODE_DOUBLE_GT] = BC_DGT,
+    [NODE_DOUBLE_LE] = BC_DLE,
+    [NODE_DOUBLE_GE] = BC_DGE,
+    [NODE_DOUBLE_EQ] = BC_DEQ,
+    [NODE_DOUBLE_NE] = BC_DNE,
+    [NODE_LONG_NEG] = BC_LNEG,
+    [NODE_DOUBLE_NEG] = BC_DNEG,
+    [NODE_INT_TO_FLOAT] = BC_I2F,
+    [NODE_UNSIGNED_TO_FLOAT] = BC_U2F,
+    [NODE_FLOAT_TO_INT] = BC_F2I,
+    [NODE_FLOAT_TO_UNSIGNED] = BC_F2U,
+    [NODE_FLOAT_TO_BOOL] = BC_F2B,
+    [NODE_INT_TO_BOOL] = BC_I2B,
+    [NODE_INT_TO_CHAR] = BC_I2C,
+    [NODE_INT_TO_SHORT] = BC_I2S,
+    [NODE_INT_TO_LONG] = BC_I2L,
+    [NODE_UNSIGNED_TO_LONG] = BC_U2L,
+    [NODE_LONG_TO_INT] = BC_L2I,
+    [NODE_LONG_TO_BOOL] = BC_L2B,
+    [NODE_LONG_TO_FLOAT] = BC_L2F,
+    [NODE_LONG_TO_DOUBLE] = BC_L2D,
+    [NODE_FLOAT_TO_LONG] = BC_F2L,
+    [NODE_DOUBLE_TO_LONG] = BC_D2L,
+    [NODE_INT_TO_DOUBLE] = BC_I2D,
+    [NODE_UNSIGNED_TO_DOUBLE] = BC_U2D,
+    [NODE_FLOAT_TO_DOUBLE] = BC_F2D,
+    [NODE_DOUBLE_TO_FLOAT] = BC_D2F,
+    [NODE_DOUBLE_TO_INT] = BC_D2I,
+    [NODE_DOUBLE_TO_UNSIGNED] = BC_D2U,
+    [NODE_DOUBLE_TO_BOOL] = BC_D2B,
+};
+
+/*
+ * Compare-and-branch opcode for each integer comparison, and the
+ * comparison that holds exactly when it does not. Float comparisons have
+ * no fused form since `!(a < b)` is not `a >= b` when either is NaN.
+ */
+static const OpCode branch_opcodes[] = {
+    [NODE_INT_LT] = BC_JUMP_ILT,
+    [NODE_INT_GT] = BC_JUMP_IGT,
+    [NODE_INT_LE] = BC_JUMP_ILE,
+    [NODE_INT_GE] = BC_JUMP_IGE,
+    [NODE_INT_EQ] = BC_JUMP_IEQ,
+    [NODE_INT_NE] = BC_JUMP_INE,
+    [NODE_UNSIGNED_LT] = BC_JUMP_ULT,
+    [NODE_UNSIGNED_GT] = BC_JUMP_UGT,
+    [NODE_UNSIGNED_LE] = BC_JUMP_ULE,
+    [NODE_UNSIGNED_GE] = BC_JUMP_UGE,
+};
+
+static const NodeType negated_comparisons[] = {
+    [NODE_INT_LT] = NODE_INT_GE,
+    [NODE_INT_GT] = NODE_INT_LE,
+    [NODE_INT_LE] = NODE_INT_GT,
+    [NODE_INT_GE] = NODE_INT_LT,
+    [NODE_INT_EQ] = NODE_INT_NE,
+    [NODE_INT_NE] = NODE_INT_EQ,
+    [NODE_UNSIGNED_LT] = NODE_UNSIGNED_GE,
+    [NODE_UNSIGNED_GT] = NODE_UNSIGNED_LE,
+    [NODE_UNSIGNED_LE] = NODE_UNSIGNED_GT,
+    [NODE_UNSIGNED_GE] = NODE_UNSIGNED_LT,
+};
+
+static bool is_integer_comparison(NodeType type)
+{
+    return (type >= NODE_INT_LT && type <= NODE_INT_NE) || (type >= NODE_UNSIGNED_LT && type <= NODE_UNSIGNED_GE);
+}
+
+/*
+ * Compile a condition as control flow: jump to the targets collected in
+ * `jumps` when it evaluates to `when`, and fall through otherwise. `&&`
+ * and `||` skip their right operand once the left one decides, and
+ * integer comparisons branch directly without producing a 0 or 1.
+ */
+static void compile_branch(Compiler *c, ASTNode *node, bool when, JumpList *jumps)
+{
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_BOOLEAN:
+    case NODE_CHAR:
+        if ((node->data.value != 0) == when)
+            add_jump(c, jumps, BC_JUMP, 0);
+        return;
+    case NODE_LOGICAL_AND:
+    case NODE_LOGICAL_OR:
+    {
+        /* a && b is false as soon as a is; a || b is true as soon as a is */
+        bool decides = node->type == NODE_LOGICAL_OR;
+        if (when == decides)
+        {
+            compile_branch(c, node->data.op.left, when, jumps);
+            compile_branch(c, node->data.op.right, when, jumps);
+        }
+        else
+        {
+            JumpList skip = {0};
+            compile_branch(c, node->data.op.left, decides, &skip);
+            compile_branch(c, node->data.op.right, when, jumps);
+            patch_jumps(c, &skip, c->chunk->count);
+        }
+        return;
+    }
+    case NODE_INT_TO_BOOL:
+        compile_branch(c, node->data.unary.operand, when, jumps);
+        return;
+    default:
+        break;
+    }
+
+    if (is_integer_comparison(node->type))
+    {
+        NodeType comparison = when ? node->type : negated_comparisons[node->type];
+        compile_expression(c, node->data.op.left);
+        compile_expression(c, node->data.op.right);
+        add_jump(c, jumps, branch_opcodes[comparison], -2);
+        return;
+    }
+
+    compile_expression(c, node);
+    add_jump(c, jumps, when ? BC_JUMP_IF_TRUE : BC_JUMP_IF_FALSE, -1);
+}
+
+/* Produce 0 or 1 for a condition used as a value, e.g. in an assignment */
+static void compile_condition_value(Compiler *c, ASTNode *node)
+{
+    JumpList false_jumps = {0};
+    compile_branch(c, node, false, &false_jumps);
+    emit_op(c, BC_PUSH, 1);
+    emit_word(c, 1);
+    int end_jump = emit_jump(c, BC_JUMP, -1);
+    patch_jumps(c, &false_jumps, c->chunk->count);
+    emit_op(c, BC_PUSH, 1);
+    emit_word(c, 0);
+    patch_jump(c, end_jump, c->chunk->count);
+}
+
+static void compile_expression(Compiler *c, ASTNode *node)
+{
+    if (!node)
+    {
+        emit_op(c, BC_PUSH, 1);
+        emit_word(c, 0);
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+        emit_op(c, BC_PUSH, 1);
+        emit_word(c, node->data.value);
+        break;
+    case NODE_FLOAT:
+    {
+        int32_t bits;
+        memcpy(&bits, &node->data.fvalue, sizeof(bits));
+        emit_op(c, BC_PUSH, 1);
+        emit_word(c, bits);
+        break;
+    }
+    case NODE_LONG:
+    case NODE_DOUBLE:
+    {
+        uint64_t bits;
+        memcpy(&bits, node->type == NODE_LONG ? (void *)&node->data.lvalue : (void *)&node->data.dvalue, sizeof(bits));
+        emit_op(c, BC_PUSH_WIDE, 1);
+        emit_word(c, (int32_t)(uint32_t)bits);
+        emit_word(c, (int32_t)(uint32_t)(bits >> 32));
+        break;
+    }
+    case NODE_IDENTIFIER:
+        emit_op(c, BC_LOAD, 1);
+        emit_word(c, node->slot);
+        break;
+    case NODE_INDEX:
+        compile_expression(c, node->data.element.index);
+        // Each unchecked form follows its checked one
+        emit_op(c, array_opcode(BC_ALOAD, node->value_type) + node->data.element.unchecked, 0);
+        emit_word(c, node->slot);
+        break;
+    case NODE_INT_NEG:
+    case NODE_FLOAT_NEG:
+        compile_expression(c, node->data.unary.operand);
+        emit_op(c, node_opcodes[node->type], 0);
+        break;
+    case NODE_LOGICAL_AND:
+    case NODE_LOGICAL_OR:
+        compile_condition_value(c, node);
+        break;
+    case NODE_FUNC_CALL:
+        if (node->slot >= 0)
+            compile_call(c, node);
+        else
+            compile_error(c, "Invalid expression");
+        break;
+    default:
+        if (node->type >= NODE_INT_ADD && node->type <= NODE_DOUBLE_NE)
+        {
+            compile_expression(c, node->data.op.left);
+            compile_expression(c, node->data.op.right);
+            emit_op(c, node_opcodes[node->type], -1);
+        }
+        else if (node->type >= NODE_LONG_NEG && node->type <= NODE_DOUBLE_TO_BOOL)
+        {
+            compile_expression(c, node->data.unary.operand);
+            emit_op(c, node_opcodes[node->type], 0);
+        }
+        else
+        {
+            compile_error(c, "Invalid expression");
+        }
+        break;
+    }
+}
+
+/* Push the arguments, converted by the type checker, and call the function */
+static void compile_call(Compiler *c, ASTNode *node)
+{
+    int count = 0;
+    for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+    {
+        compile_expression(c, arg->expr);
+        count++;
+    }
+    emit_op(c, BC_CALL, 1 - count);
+    emit_word(c, node->slot);
+}
+
+/* `bussin` leaves a function with its value, or ends the program from main */
+static void compile_return(Compiler *c, ASTNode *node)
+{
+    compile_expression(c, node->data.op.left);
+    if (c->in_function)
+    {
+        emit_op(c, BC_RETURN, -1);
+    }
+    else
+    {
+        emit_op(c, BC_HALT, -1);
+    }
+}
+
+static void compile_assignment(Compiler *c, ASTNode *node)
+{
+    int slot = node->data.op.left->slot;
+    compile_expression(c, node->data.op.right);
+    emit_op(c, BC_STORE, -1);
+    emit_word(c, slot);
+}
+
+static void compile_index_assignment(Compiler *c, ASTNode *node)
+{
+    compile_expression(c, node->data.element.index);
+    compile_expression(c, node->data.element.value);
+    emit_op(c, array_opcode(BC_ASTORE, node->value_type) + node->data.element.unchecked, -2);
+    emit_word(c, node->slot);
+}
+
+static int add_format(Compiler *c, const Format *format)
+{
+    Chunk *chunk = c->chunk;
+    if (chunk->format_count == chunk->format_capacity)
+    {
+        chunk->format_capacity = chunk->format_capacity ? chunk->format_capacity * 2 : 16;
+        chunk->formats = realloc(chunk->formats, chunk->format_capacity * sizeof(Format *));
+    }
+    chunk->formats[chunk->format_count] = format;
+    return chunk->format_count++;
+}
+
+/* Push the value of every placeholder, then print them all at once */
+static void compile_print_call(Compiler *c, ASTNode *node)
+{
+    const Format *format = node->data.func_call.format;
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        if (format->segments[i].argument)
+            compile_expression(c, format->segments[i].argument->expr);
+    }
+    emit_op(c, BC_PRINT, -format->value_count);
+    emit_word(c, add_format(c, format));
+    emit_word(c, format->value_count);
+}
+
+static void compile_error_statement(Compiler *c, ASTNode *node)
+{
+    ASTNode *expr = node->data.op.left;
+    if (expr->type == NODE_STRING_LITERAL)
+    {
+        emit_op(c, BC_BAKA_VALUE, 0);
+        emit_word(c, add_string(c, expr->data.name));
+    }
+    else
+    {
+        compile_expression(c, expr);
+        emit_op(c, BC_BAKA_VALUE, -1);
+        emit_word(c, -1);
+    }
+}
+
+static void compile_if(Compiler *c, ASTNode *node)
+{
+    JumpList else_jumps = {0};
+    compile_branch(c, node->data.if_stmt.condition, false, &else_jumps);
+    compile_statement(c, node->data.if_stmt.then_branch);
+
+    if (node->data.if_stmt.else_branch)
+    {
+        int end_jump = emit_jump(c, BC_JUMP, 0);
+        patch_jumps(c, &else_jumps, c->chunk->count);
+        compile_statement(c, node->data.if_stmt.else_branch);
+        patch_jump(c, end_jump, c->chunk->count);
+    }
+    else
+    {
+        patch_jumps(c, &else_jumps, c->chunk->count);
+    }
+}
+
+static void compile_for(Compiler *c, ASTNode *node)
+{
+    compile_statement(c, node->data.for_stmt.init);
+
+    int loop_start = c->chunk->count;
+    JumpList exit_jumps = {0};
+    if (node->data.for_stmt.cond)
+    {
+        compile_branch(c, node->data.for_stmt.cond, false, &exit_jumps);
+    }
+
+    push_loop_context(c);
+    compile_statement(c, node->data.for_stmt.body);
+    pop_continue_context(c, c->chunk->count);
+    compile_statement(c, node->data.for_stmt.incr);
+    emit_op(c, BC_JUMP, 0);
+    emit_word(c, loop_start);
+
+    patch_jumps(c, &exit_jumps, c->chunk->count);
+    pop_break_context(c, c->chunk->count);
+}
+
+static void compile_while(Compiler *c, ASTNode *node)
+{
+    int loop_start = c->chunk->count;
+    JumpList exit_jumps = {0};
+    compile_branch(c, node->data.while_stmt.cond, false, &exit_jumps);
+
+    push_loop_context(c);
+    compile_statement(c, node->data.while_stmt.body);
+    pop_continue_context(c, loop_start);
+    emit_op(c, BC_JUMP, 0);
+    emit_word(c, loop_start);
+
+    patch_jumps(c, &exit_jumps, c->chunk->count);
+    pop_break_context(c, c->chunk->count);
+}
+
+/* The condition is tested after the body, jumping back while it holds */
+static void compile_do_while(Compiler *c, ASTNode *node)
+{
+    int loop_start = c->chunk->count;
+
+    push_loop_context(c);
+    compile_statement(c, node->data.while_stmt.body);
+    pop_continue_context(c, c->chunk->count);
+    JumpList repeat_jumps = {0};
+    compile_branch(c, node->data.while_stmt.cond, true, &repeat_jumps);
+    patch_jumps(c, &repeat_jumps, loop_start);
+    pop_break_context(c, c->chunk->count);
+}
+
+/*
+ * The switch value selects an arm through a jump table built from the
+ * constant labels: BC_SWITCH_DENSE indexes it directly when the labels
+ * are close together, BC_SWITCH_SPARSE binary-searches sorted labels
+ * otherwise. Bodies are laid out contiguously so a matched arm falls
+ * through into the following ones. Like the tree walker, values without
+ * a label go to `based`, which leaves the switch, or past the switch if
+ * there is none.
+ */
+static void compile_switch(Compiler *c, ASTNode *node)
+{
+    SwitchTable *table = build_switch_table(node->data.switch_stmt.cases);
+    int *arm_starts = malloc((table->arm_count + 1) * sizeof(int));
+
+    compile_expression(c, node->data.switch_stmt.expression);
+    int table_start;
+    if (table->range)
+    {
+        emit_op(c, BC_SWITCH_DENSE, -1);
+        emit_word(c, table->min);
+        emit_word(c, table->range);
+        table_start = c->chunk->count;
+        emit_word(c, table->default_arm);
+        for (int i = 0; i < table->range; i++)
+        {
+            emit_word(c, table->dense[i]);
+        }
+    }
+    else
+    {
+        emit_op(c, BC_SWITCH_SPARSE, -1);
+        emit_word(c, table->entry_count);
+        table_start = c->chunk->count;
+        emit_word(c, table->default_arm);
+        for (int i = 0; i < table->entry_count; i++)
+        {
+            emit_word(c, table->entries[i].value);
+            emit_word(c, table->entries[i].arm);
+        }
+    }
+
+    push_break_context(c);
+    for (int i = 0; i < table->arm_count; i++)
+    {
+        arm_starts[i] = c->chunk->count;
+        compile_statement(c, table->arms[i]->statements);
+    }
+    int end = c->chunk->count;
+    pop_break_context(c, end);
+
+    // The table was emitted with arm indices; replace them with addresses
+    int32_t *code = c->chunk->code;
+    code[table_start] = table->default_arm >= 0 ? arm_starts[table->default_arm] : end;
+    if (table->range)
+    {
+        for (int i = 0; i < table->range; i++)
+        {
+            int32_t arm = code[table_start + 1 + i];
+            code[table_start + 1 + i] = arm >= 0 ? arm_starts[arm] : end;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < table->entry_count; i++)
+        {
+            int32_t *target = &code[table_start + 2 + 2 * i];
+            *target = arm_starts[*target];
+        }
+    }
+    free(arm_starts);
+}
+
+static void compile_statement(Compiler *c, ASTNode *node)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        compile_assignment(c, node);
+        break;
+    case NODE_ARRAY_DECLARATION:
+        compile_expression(c, node->data.element.index);
+        emit_op(c, array_opcode(BC_NEW_ARRAY, node->value_type), -1);
+        emit_word(c, node->slot);
+        break;
+    case NODE_INDEX_ASSIGNMENT:
+        compile_index_assignment(c, node);
+        break;
+    case NODE_FUNC_CALL:
+        if (node->data.func_call.format)
+        {
+            compile_print_call(c, node);
+        }
+        else if (node->slot >= 0)
+        {
+            compile_call(c, node);
+            emit_op(c, BC_POP, -1);
+        }
+        break;
+    case NODE_RETURN:
+        compile_return(c, node);
+        break;
+    case NODE_FOR_STATEMENT:
+        compile_for(c, node);
+        break;
+    case NODE_WHILE_STATEMENT:
+        compile_while(c, node);
+        break;
+    case NODE_DO_WHILE_STATEMENT:
+        compile_do_while(c, node);
+        break;
+    case NODE_ERROR_STATEMENT:
+        compile_error_statement(c, node);
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            compile_statement(c, sl->statement);
+        }
+        break;
+    case NODE_IF_STATEMENT:
+        compile_if(c, node);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        compile_switch(c, node);
+        break;
+    case NODE_BREAK_STATEMENT:
+        compile_break(c);
+        break;
+    case NODE_CONTINUE_STATEMENT:
+        compile_continue(c);
+        break;
+    default:
+        compile_expression(c, node);
+        emit_op(c, BC_POP, -1);
+        break;
+    }
+}
+
+Chunk *compile_program(ASTNode *root)
+{
+    Compiler compiler;
+    memset(&compiler, 0, sizeof(compiler));
+    compiler.chunk = calloc(1, sizeof(Chunk));
+    compiler.chunk->line = current_program->line;
+
+    compile_statement(&compiler, root);
+    emit_op(&compiler, BC_PUSH, 1);
+    emit_word(&compiler, 0);
+    emit_op(&compiler, BC_HALT, -1);
+
+    // Falling off the end of a function returns 0, which only a call
+    // statement can see and drops
+    Chunk *chunk = compiler.chunk;
+    chunk->function_count = current_program->function_count;
+    chunk->functions = calloc(chunk->function_count + 1, sizeof(ChunkFunction));
+    compiler.in_function = true;
+    for (int i = 0; i < chunk->function_count; i++)
+    {
+        Function *function = current_program->functions[i];
+        chunk->functions[i] = (ChunkFunction){chunk->count, function->parameter_count, function->scope.count};
+        compiler.depth = 0;
+        compile_statement(&compiler, function->body);
+        emit_op(&compiler, BC_PUSH, 1);
+        emit_word(&compiler, 0);
+        emit_op(&compiler, BC_RETURN, -1);
+    }
+
+    if (compiler.had_error)
+    {
+        free_chunk(compiler.chunk);
+        return NULL;
+    }
+    return compiler.chunk;
+}
+
+void free_chunk(Chunk *chunk)
+{
+    if (!chunk)
+        return;
+    free(chunk->code);
+    free(chunk->strings);
+    free(chunk->formats);
+    free(chunk->functions);
+    free(chunk);
+}
@@ -0,0 +1,196 @@
+/* compiler.h */
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "ast.h"
+#include <stdint.h>
+
+/*
+ * Bytecode instruction set.
+ *
+ * Every instruction is one int32_t opcode word followed by its operand
+ * words, so a chunk is a flat array of int32_t with no pointers in it.
+ * Jump operands are absolute offsets into the code array. Opcodes are
+ * specialized by the static types computed by typecheck_program, so the
+ * VM never inspects the type of a value.
+ *
+ * The code of `main` comes first and ends in BC_HALT; each user-defined
+ * function's code follows in order and ends in BC_RETURN. Variable
+ * operands are slots of the frame of the code they appear in.
+ */
+typedef enum
+{
+    BC_PUSH,         /* value bits            -> push int or float constant   */
+    BC_PUSH_WIDE,    /* low bits, high bits   -> push giga or gigachad
+                                                 constant                     */
+    BC_LOAD,         /* slot                  -> push variable                */
+    BC_STORE,        /* slot                  -> pop into variable            */
+    BC_POP,          /*                       -> drop top of stack            */
+    BC_NEW_ARRAY,    /* slot                  -> pop length, give the array
+                                                 that many zeroed elements    */
+    BC_ALOAD,        /* slot                  -> pop index, push element      */
+    BC_ALOAD_UNCHECKED,
+    BC_ASTORE,       /* slot                  -> pop value and index, store
+                                                 value into element           */
+    BC_ASTORE_UNCHECKED,
+    BC_NEW_WIDE_ARRAY, /* As above, for arrays of giga or gigachad          */
+    BC_ALOAD_WIDE,
+    BC_ALOAD_WIDE_UNCHECKED,
+    BC_ASTORE_WIDE,
+    BC_ASTORE_WIDE_UNCHECKED,
+    BC_NEW_BYTE_ARRAY, /* As above, for arrays of yap or cap                */
+    BC_ALOAD_BYTE,
+    BC_ALOAD_BYTE_UNCHECKED,
+    BC_ASTORE_BYTE,
+    BC_ASTORE_BYTE_UNCHECKED,
+    BC_NEW_SHORT_ARRAY, /* As above, for arrays of soy                      */
+    BC_ALOAD_SHORT,
+    BC_ALOAD_SHORT_UNCHECKED,
+    BC_ASTORE_SHORT,
+    BC_ASTORE_SHORT_UNCHECKED,
+    BC_IADD,
+    BC_ISUB,
+    BC_IMUL,
+    BC_IDIV,
+    BC_IMOD,
+    BC_ILT,
+    BC_IGT,
+    BC_ILE,
+    BC_IGE,
+    BC_IEQ,
+    BC_INE,
+    BC_INEG,
+    BC_UDIV,
+    BC_UMOD,
+    BC_ULT,
+    BC_UGT,
+    BC_ULE,
+    BC_UGE,
+    BC_FADD,
+    BC_FSUB,
+    BC_FMUL,
+    BC_FDIV,
+    BC_FLT,
+    BC_FGT,
+    BC_FLE,
+    BC_FGE,
+    BC_FEQ,
+    BC_FNE,
+    BC_FNEG,
+    BC_LADD,
+    BC_LSUB,
+    BC_LMUL,
+    BC_LDIV,
+    BC_LMOD,
+    BC_LLT,
+    BC_LGT,
+    BC_LLE,
+    BC_LGE,
+    BC_LEQ,
+    BC_LNE,
+    BC_LNEG,
+    BC_DADD,
+    BC_DSUB,
+    BC_DMUL,
+    BC_DDIV,
+    BC_DLT,
+    BC_DGT,
+    BC_DLE,
+    BC_DGE,
+    BC_DEQ,
+    BC_DNE,
+    BC_DNEG,
+    BC_I2F,
+    BC_U2F,
+    BC_F2I,
+    BC_F2U,
+    BC_F2B,
+    BC_I2B,
+    BC_I2C,
+    BC_I2S,
+    BC_I2L,
+    BC_U2L,
+    BC_L2I,
+    BC_L2B,
+    BC_L2F,
+    BC_L2D,
+    BC_F2L,
+    BC_D2L,
+    BC_I2D,
+    BC_U2D,
+    BC_F2D,
+    BC_D2F,
+    BC_D2I,
+    BC_D2U,
+    BC_D2B,
+    BC_JUMP,         /* target                                                */
+    BC_JUMP_IF_FALSE,/* target                -> pop condition                */
+    BC_JUMP_IF_TRUE, /* target                -> pop condition                */
+    BC_JUMP_ILT,     /* target                -> pop two ints, jump if the
+                                                 comparison holds             */
+    BC_JUMP_IGT,
+    BC_JUMP_ILE,
+    BC_JUMP_IGE,
+    BC_JUMP_IEQ,
+    BC_JUMP_INE,
+    BC_JUMP_ULT,
+    BC_JUMP_UGT,
+    BC_JUMP_ULE,
+    BC_JUMP_UGE,
+    BC_SWITCH_DENSE, /* min, range, default, range targets
+                                              -> pop value, jump to the target
+                                                 for value - min or default   */
+    BC_SWITCH_SPARSE,/* count, default, count (label, target) pairs sorted
+                        by label              -> pop value, jump to its
+                                                 label's target or default    */
+    BC_PRINT,        /* format, count         -> pop count placeholder values */
+    BC_BAKA_VALUE,   /* string or -1          -> pop int if string is -1      */
+    BC_CALL,         /* function              -> pop its arguments, run it in
+                                                 a new frame, push its result */
+    BC_RETURN,       /*                       -> pop the result, go back to
+                                                 the caller                   */
+    BC_HALT          /*                       -> pop main's result into the
+                                                 program's, end the program   */
+} OpCode;
+
+/* Where a user-defined function's code starts and the frame it runs in */
+typedef struct
+{
+    int32_t entry;
+    int32_t parameter_count; /* Passed in the first slots of the frame */
+    int32_t frame_size;
+} ChunkFunction;
+
+/* A compiled program */
+typedef struct
+{
+    int32_t *code;
+    int count;
+    int capacity;
+
+    /* Constant pool for baka messages */
+    char **strings;
+    int string_count;
+    int string_capacity;
+
+    /* Compiled formats of yapping, yappin and baka calls */
+    const Format **formats;
+    int format_count;
+    int format_capacity;
+
+    /* User-defined functions, in order of their code */
+    ChunkFunction *functions;
+    int function_count;
+
+    /* Deepest operand stack main or one call can reach */
+    int max_stack;
+
+    /* Line runtime errors are reported at */
+    int line;
+} Chunk;
+
+Chunk *compile_program(ASTNode *root);
+void free_chunk(Chunk *chunk);
+
+#endif /* COMPILER_H */
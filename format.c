@@ -0,0 +1,538 @@
+/* format.c */
+
+#include "format.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char digit_pairs[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+static const uint64_t powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+#define MAX_FAST_PRECISION 9
+
+/* Write value in decimal, two digits at a time, ending just before end */
+static char *write_digits(char *end, uint64_t value)
+{
+    while (value >= 100)
+    {
+        end -= 2;
+        memcpy(end, &digit_pairs[(value % 100) * 2], 2);
+        value /= 100;
+    }
+    if (value >= 10)
+    {
+        end -= 2;
+        memcpy(end, &digit_pairs[value * 2], 2);
+    }
+    else
+    {
+        *--end = (char)('0' + value);
+    }
+    return end;
+}
+
+static size_t finish(char *buffer, char *start, char *end)
+{
+    size_t length = end - start;
+    memmove(buffer, start, length);
+    return length;
+}
+
+size_t format_unsigned(char *buffer, unsigned int value)
+{
+    char *end = buffer + FORMAT_NUMBER_MAX;
+    return finish(buffer, write_digits(end, value), end);
+}
+
+size_t format_int(char *buffer, int value)
+{
+    char *end = buffer + FORMAT_NUMBER_MAX;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    char *start = write_digits(end, magnitude);
+    if (value < 0)
+        *--start = '-';
+    return finish(buffer, start, end);
+}
+
+size_t format_long(char *buffer, int64_t value)
+{
+    char *end = buffer + FORMAT_NUMBER_MAX;
+    uint64_t magnitude = value < 0 ? 0u - (uint64_t)value : (uint64_t)value;
+    char *start = write_digits(end, magnitude);
+    if (value < 0)
+        *--start = '-';
+    return finish(buffer, start, end);
+}
+
+static size_t format_float_slow(char *buffer, float value, int precision)
+{
+    int length = snprintf(buffer, FORMAT_NUMBER_MAX, "%.*f", precision, value);
+    return length < FORMAT_NUMBER_MAX ? (size_t)length : FORMAT_NUMBER_MAX - 1;
+}
+
+/*
+ * A float is m * 2^e with a 24-bit m, so m * 10^precision fits in 64 bits
+ * and shifting it by e gives the value in units of the last printed digit
+ * exactly, rounded half to even like printf. Values too large for that,
+ * infinities and NaNs go through snprintf.
+ */
+size_t format_float(char *buffer, float value, int precision)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int exponent = (bits >> 23) & 0xff;
+    uint64_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff || precision < 0 || precision > MAX_FAST_PRECISION)
+        return format_float_slow(buffer, value, precision);
+    if (exponent)
+        mantissa |= 0x800000;
+    else
+        exponent = 1;
+    int shift = exponent - 150;
+
+    uint64_t scaled = mantissa * powers_of_ten[precision];
+    if (shift >= 0)
+    {
+        if (shift >= 64 || scaled > (UINT64_MAX >> shift))
+            return format_float_slow(buffer, value, precision);
+        scaled <<= shift;
+    }
+    else if (-shift >= 64)
+    {
+        scaled = 0; // Less than half of the last digit
+    }
+    else
+    {
+        uint64_t remainder = scaled & ((UINT64_C(1) << -shift) - 1);
+        uint64_t half = UINT64_C(1) << (-shift - 1);
+        scaled >>= -shift;
+        if (remainder > half || (remainder == half && (scaled & 1)))
+            scaled++;
+    }
+
+    char *end = buffer + FORMAT_NUMBER_MAX;
+    char *start = end;
+    if (precision > 0)
+    {
+        uint64_t fraction = scaled % powers_of_ten[precision];
+        scaled /= powers_of_ten[precision];
+        start = write_digits(end, fraction);
+        while (end - start < precision)
+            *--start = '0';
+        *--start = '.';
+    }
+    start = write_digits(start, scaled);
+    if (bits >> 31)
+        *--start = '-';
+    return finish(buffer, start, end);
+}
+
+void format_write_int(OutputStream stream, int value, const char *suffix)
+{
+    char text[FORMAT_NUMBER_MAX];
+    output_write(stream, text, format_int(text, value));
+    output_write(stream, suffix, strlen(suffix));
+}
+
+static void add_segment(Format *format, SegmentKind kind, const char *text, size_t length, ArgumentList *argument)
+{
+    if (kind == SEGMENT_TEXT && length == 0)
+        return;
+    FormatSegment *segment = &format->segments[format->segment_count++];
+    segment->kind = kind;
+    segment->text = text;
+    segment->length = length;
+    segment->precision = -1;
+    segment->argument = argument;
+    if (argument)
+        format->value_count++;
+}
+
+static bool is_integer_type(ValueType type)
+{
+    return type == TYPE_INT || type == TYPE_UNSIGNED || type == TYPE_BOOL || type == TYPE_CHAR || type == TYPE_SHORT ||
+           type == TYPE_LONG;
+}
+
+/*
+ * Split text into segments, binding each placeholder to the next argument
+ * in *args. Placeholders are printf conversions: flags, a width and a
+ * precision are accepted, length modifiers are accepted and ignored, and
+ * `*` widths and %n are not supported.
+ */
+static bool parse_placeholders(Arena *arena, Format *format, const char *text, ArgumentList **args, char *error,
+                               size_t error_size)
+{
+    const char *run = text;
+    const char *p;
+    while ((p = strchr(run, '%')))
+    {
+        add_segment(format, SEGMENT_TEXT, run, p - run, NULL);
+        const char *spec = p++;
+        if (*p == '%')
+        {
+            add_segment(format, SEGMENT_TEXT, p, 1, NULL);
+            run = p + 1;
+            continue;
+        }
+
+        while (*p && strchr("-+ #0", *p))
+            p++;
+        while (*p >= '0' && *p <= '9')
+            p++;
+        bool plain = p == spec + 1;
+        int precision = -1;
+        if (*p == '.')
+        {
+            precision = 0;
+            for (p++; *p >= '0' && *p <= '9'; p++)
+            {
+                if (precision < 100)
+                    precision = precision * 10 + (*p - '0');
+            }
+        }
+        const char *modifiers = p;
+        while (*p && strchr("hlLqjzt", *p))
+            p++;
+        char conversion = *p;
+        size_t spec_length = p + 1 - spec;
+        if (!conversion)
+        {
+            snprintf(error, error_size, "Incomplete placeholder '%s' in format", spec);
+            return false;
+        }
+        run = p + 1;
+
+        if (!strchr("diuoxXcfFeEgGaAs", conversion))
+        {
+            snprintf(error, error_size, "Unsupported placeholder '%.*s' in format", (int)spec_length, spec);
+            return false;
+        }
+        ArgumentList *arg = *args;
+        if (!arg)
+        {
+            snprintf(error, error_size, "Not enough arguments for format placeholder '%.*s'", (int)spec_length, spec);
+            return false;
+        }
+        *args = arg->next;
+        ValueType type = arg->expr->value_type;
+
+        if (conversion == 's')
+        {
+            if (type == TYPE_BOOL && plain && precision < 0)
+            {
+                add_segment(format, SEGMENT_BOOL, NULL, 0, arg);
+                continue;
+            }
+            if (type != TYPE_STRING)
+            {
+                snprintf(error, error_size, "Placeholder '%.*s' needs a string argument", (int)spec_length, spec);
+                return false;
+            }
+            /* String arguments are literals, so the text is known now */
+            char *conversion_text = arena_strndup(arena, spec, spec_length);
+            int length = snprintf(NULL, 0, conversion_text, arg->expr->data.name);
+            char *rendered = arena_alloc(arena, length + 1);
+            snprintf(rendered, length + 1, conversion_text, arg->expr->data.name);
+            add_segment(format, SEGMENT_TEXT, rendered, length, NULL);
+            continue;
+        }
+
+        bool wants_float = strchr("fFeEgGaA", conversion) != NULL;
+        if (wants_float ? type != TYPE_FLOAT && type != TYPE_DOUBLE : !is_integer_type(type))
+        {
+            snprintf(error, error_size, "Placeholder '%.*s' needs %s argument", (int)spec_length, spec,
+                     wants_float ? "a float" : "an integer");
+            return false;
+        }
+        if (type == TYPE_LONG && conversion == 'c')
+        {
+            snprintf(error, error_size, "Placeholder '%.*s' cannot print a giga", (int)spec_length, spec);
+            return false;
+        }
+
+        /* Signed conversions of unsigned values print them unsigned */
+        if (type == TYPE_UNSIGNED && (conversion == 'd' || conversion == 'i'))
+            conversion = 'u';
+
+        SegmentKind kind;
+        if (type == TYPE_DOUBLE)
+            kind = SEGMENT_PRINTF_DOUBLE;
+        else if (type == TYPE_LONG)
+            kind = plain && precision < 0 && (conversion == 'd' || conversion == 'i') ? SEGMENT_LONG
+                                                                                       : SEGMENT_PRINTF_LONG;
+        else if (plain && precision < 0 && (conversion == 'd' || conversion == 'i'))
+            kind = SEGMENT_INT;
+        else if (plain && precision < 0 && conversion == 'u')
+            kind = SEGMENT_UNSIGNED;
+        else if (plain && precision < 0 && conversion == 'c')
+            kind = SEGMENT_CHAR;
+        else if (plain && precision <= MAX_FAST_PRECISION && conversion == 'f')
+            kind = SEGMENT_FLOAT;
+        else
+            kind = wants_float ? SEGMENT_PRINTF_FLOAT : SEGMENT_PRINTF_INT;
+
+        if (kind == SEGMENT_PRINTF_INT || kind == SEGMENT_PRINTF_FLOAT || kind == SEGMENT_PRINTF_DOUBLE)
+        {
+            size_t prefix = modifiers - spec;
+            char *conversion_text = arena_alloc(arena, prefix + 2);
+            memcpy(conversion_text, spec, prefix);
+            conversion_text[prefix] = conversion;
+            conversion_text[prefix + 1] = '\0';
+            add_segment(format, kind, conversion_text, prefix + 1, arg);
+        }
+        else if (kind == SEGMENT_PRINTF_LONG)
+        {
+            size_t prefix = modifiers - spec;
+            char *conversion_text = arena_alloc(arena, prefix + 4);
+            memcpy(conversion_text, spec, prefix);
+            memcpy(conversion_text + prefix, "ll", 2);
+            conversion_text[prefix + 2] = conversion;
+            conversion_text[prefix + 3] = '\0';
+            add_segment(format, kind, conversion_text, prefix + 3, arg);
+        }
+        else
+        {
+            add_segment(format, kind, NULL, 0, arg);
+            format->segments[format->segment_count - 1].precision = precision < 0 ? 6 : precision;
+        }
+    }
+    add_segment(format, SEGMENT_TEXT, run, strlen(run), NULL);
+    return true;
+}
+
+Format *compile_format(Arena *arena, OutputStream stream, ArgumentList *args, bool newline, char *error,
+                       size_t error_size)
+{
+    const char *text = "\n"; // What a call without arguments prints
+    if (args)
+    {
+        if (args->expr->type != NODE_STRING_LITERAL)
+        {
+            snprintf(error, error_size, "First argument to %s must be a string literal",
+                     stream == OUTPUT_STDERR ? "baka" : newline ? "yapping" : "yappin");
+            return NULL;
+        }
+        text = args->expr->data.name;
+        args = args->next;
+    }
+
+    Format *format = arena_calloc(arena, sizeof(Format));
+    format->stream = stream;
+    format->segments = arena_alloc(arena, (strlen(text) + 2) * sizeof(FormatSegment));
+
+    if (!args)
+    {
+        add_segment(format, SEGMENT_TEXT, text, strlen(text), NULL);
+    }
+    else if (!strchr(text, '%') && !args->next && args->expr->value_type == TYPE_BOOL)
+    {
+        add_segment(format, SEGMENT_BOOL, NULL, 0, args);
+        args = NULL;
+    }
+    else if (!parse_placeholders(arena, format, text, &args, error, error_size))
+    {
+        return NULL;
+    }
+
+    if (args)
+    {
+        snprintf(error, error_size, "Too many arguments for format \"%s\"", text);
+        return NULL;
+    }
+    if (format->value_count > MAX_FORMAT_ARGUMENTS)
+    {
+        snprintf(error, error_size, "Format \"%s\" has more than %d placeholders", text, MAX_FORMAT_ARGUMENTS);
+        return NULL;
+    }
+    if (newline)
+        add_segment(format, SEGMENT_TEXT, "\n", 1, NULL);
+    return format;
+}
+
+/* Text of a placeholder handled without printf; buffer holds FORMAT_NUMBER_MAX */
+static size_t render_value(const FormatSegment *segment, Value value, char *buffer)
+{
+    switch (segment->kind)
+    {
+    case SEGMENT_INT:
+        return format_int(buffer, value.ivalue);
+    case SEGMENT_LONG:
+        return format_long(buffer, value.lvalue);
+    case SEGMENT_UNSIGNED:
+        return format_unsigned(buffer, (unsigned int)value.ivalue);
+    case SEGMENT_CHAR:
+        buffer[0] = (char)value.ivalue;
+        return 1;
+    case SEGMENT_BOOL:
+        memcpy(buffer, value.ivalue ? "yes" : "no", 3);
+        return value.ivalue ? 3 : 2;
+    case SEGMENT_FLOAT:
+        return format_float(buffer, value.fvalue, segment->precision);
+    default:
+        return 0;
+    }
+}
+
+static bool is_constant(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+    case NODE_FLOAT:
+    case NODE_LONG:
+    case NODE_DOUBLE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool fold_format(Arena *arena, Format *format)
+{
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        FormatSegment *segment = &format->segments[i];
+        if (!segment->argument || !is_constant(segment->argument->expr))
+            continue;
+
+        ASTNode *constant = segment->argument->expr;
+        Value value;
+        if (constant->type == NODE_FLOAT)
+            value.fvalue = constant->data.fvalue;
+        else if (constant->type == NODE_DOUBLE)
+            value.dvalue = constant->data.dvalue;
+        else if (constant->type == NODE_LONG)
+            value.lvalue = constant->data.lvalue;
+        else
+            value.ivalue = constant->data.value;
+
+        char *text;
+        size_t length;
+        if (segment->kind == SEGMENT_PRINTF_FLOAT)
+        {
+            length = snprintf(NULL, 0, segment->text, (double)value.fvalue);
+            text = arena_alloc(arena, length + 1);
+            snprintf(text, length + 1, segment->text, (double)value.fvalue);
+        }
+        else if (segment->kind == SEGMENT_PRINTF_INT)
+        {
+            length = snprintf(NULL, 0, segment->text, value.ivalue);
+            text = arena_alloc(arena, length + 1);
+            snprintf(text, length + 1, segment->text, value.ivalue);
+        }
+        else if (segment->kind == SEGMENT_PRINTF_LONG)
+        {
+            length = snprintf(NULL, 0, segment->text, (long long)value.lvalue);
+            text = arena_alloc(arena, length + 1);
+            snprintf(text, length + 1, segment->text, (long long)value.lvalue);
+        }
+        else if (segment->kind == SEGMENT_PRINTF_DOUBLE)
+        {
+            length = snprintf(NULL, 0, segment->text, value.dvalue);
+            text = arena_alloc(arena, length + 1);
+            snprintf(text, length + 1, segment->text, value.dvalue);
+        }
+        else
+        {
+            char buffer[FORMAT_NUMBER_MAX];
+            length = render_value(segment, value, buffer);
+            text = arena_strndup(arena, buffer, length);
+        }
+        segment->kind = SEGMENT_TEXT;
+        segment->text = text;
+        segment->length = length;
+        segment->argument = NULL;
+        format->value_count--;
+    }
+
+    int count = 0;
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        FormatSegment *segment = &format->segments[i];
+        FormatSegment *previous = count ? &format->segments[count - 1] : NULL;
+        if (segment->kind == SEGMENT_TEXT && previous && previous->kind == SEGMENT_TEXT)
+        {
+            char *text = arena_alloc(arena, previous->length + segment->length + 1);
+            memcpy(text, previous->text, previous->length);
+            memcpy(text + previous->length, segment->text, segment->length);
+            text[previous->length + segment->length] = '\0';
+            previous->text = text;
+            previous->length += segment->length;
+            continue;
+        }
+        format->segments[count++] = *segment;
+    }
+    format->segment_count = count;
+    return format_is_text(format);
+}
+
+bool format_is_text(const Format *format)
+{
+    return format->segment_count == 0 || (format->segment_count == 1 && format->segments[0].kind == SEGMENT_TEXT);
+}
+
+void append_format_text(Arena *arena, Format *a, const Format *b)
+{
+    if (b->segment_count == 0)
+        return;
+    if (a->segment_count == 0)
+    {
+        a->segments[0] = b->segments[0];
+        a->segment_count = 1;
+        return;
+    }
+    FormatSegment *first = &a->segments[0];
+    const FormatSegment *second = &b->segments[0];
+    char *text = arena_alloc(arena, first->length + second->length + 1);
+    memcpy(text, first->text, first->length);
+    memcpy(text + first->length, second->text, second->length);
+    text[first->length + second->length] = '\0';
+    first->text = text;
+    first->length += second->length;
+}
+
+void print_format(const Format *format, const Value *values)
+{
+    char buffer[FORMAT_NUMBER_MAX];
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        const FormatSegment *segment = &format->segments[i];
+        switch (segment->kind)
+        {
+        case SEGMENT_TEXT:
+            output_write(format->stream, segment->text, segment->length);
+            break;
+        case SEGMENT_PRINTF_INT:
+            output_printf(format->stream, segment->text, (values++)->ivalue);
+            break;
+        case SEGMENT_PRINTF_FLOAT:
+            output_printf(format->stream, segment->text, (double)(values++)->fvalue);
+            break;
+        case SEGMENT_PRINTF_LONG:
+            output_printf(format->stream, segment->text, (long long)(values++)->lvalue);
+            break;
+        case SEGMENT_PRINTF_DOUBLE:
+            output_printf(format->stream, segment->text, (values++)->dvalue);
+            break;
+        default:
+            output_write(format->stream, buffer, render_value(segment, *values++, buffer));
+            break;
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/* format.h */
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "ast.h"
+#include "output.h"
+
+/* Longest text format_int, format_long, format_unsigned or format_float produce */
+#define FORMAT_NUMBER_MAX 64
+
+/* Most arguments a yapping, yappin or baka format can take */
+#define MAX_FORMAT_ARGUMENTS 32
+
+/*
+ * Number to text conversions matching printf's %d, %lld, %u and %.Nf.
+ * They write into buffer, which must hold FORMAT_NUMBER_MAX bytes, and
+ * return the length; the result is not NUL-terminated.
+ */
+size_t format_int(char *buffer, int value);
+size_t format_long(char *buffer, int64_t value);
+size_t format_unsigned(char *buffer, unsigned int value);
+size_t format_float(char *buffer, float value, int precision);
+
+/* Print value followed by suffix, e.g. for baka(expression) */
+void format_write_int(OutputStream stream, int value, const char *suffix);
+
+typedef enum
+{
+    SEGMENT_TEXT,         /* text, printed as is                         */
+    SEGMENT_INT,          /* %d, %i                                      */
+    SEGMENT_UNSIGNED,     /* %u, or %d of an unsigned value              */
+    SEGMENT_CHAR,         /* %c                                          */
+    SEGMENT_BOOL,         /* %s of a boolean: yes or no                  */
+    SEGMENT_FLOAT,        /* %f, %.Nf for N up to 9                      */
+    SEGMENT_PRINTF_INT,   /* any other integer conversion; text is the
+                             printf conversion without length modifier   */
+    SEGMENT_PRINTF_FLOAT, /* any other float conversion, likewise        */
+    SEGMENT_LONG,         /* %d, %i of a giga                            */
+    SEGMENT_PRINTF_LONG,  /* any other integer conversion of a giga; text
+                             is the printf conversion with ll            */
+    SEGMENT_PRINTF_DOUBLE /* any float conversion of a gigachad; text is
+                             the printf conversion without modifier      */
+} SegmentKind;
+
+typedef struct
+{
+    SegmentKind kind;
+    const char *text;
+    size_t length;
+    int precision;
+    ArgumentList *argument; /* The call argument a placeholder prints */
+} FormatSegment;
+
+/*
+ * A print call's format string, split once into literal text and
+ * placeholders bound to the arguments they print. Printing walks the
+ * segments with the values of the placeholder arguments, in order.
+ */
+struct Format
+{
+    OutputStream stream;
+    FormatSegment *segments;
+    int segment_count;
+    int value_count; /* Segments with an argument */
+};
+
+/*
+ * Build the Format for a yapping (newline set), yappin or baka call whose
+ * type-checked arguments follow the format string in args. Each
+ * placeholder takes the next argument and must suit its type. As before
+ * formats were compiled, a format given no arguments is printed exactly
+ * as written, and a boolean argument to a format with no placeholder is
+ * printed as yes or no in place of it. Returns NULL after writing a
+ * message to error if the call is invalid.
+ */
+Format *compile_format(Arena *arena, OutputStream stream, ArgumentList *args, bool newline, char *error,
+                       size_t error_size);
+
+/*
+ * Render placeholders whose argument has become a constant into text and
+ * merge neighboring text, so a print with only constants becomes a
+ * single write. Returns true if the format is now only text.
+ */
+bool fold_format(Arena *arena, Format *format);
+
+/* True if the format prints fixed text; see fold_format */
+bool format_is_text(const Format *format);
+
+/* Append the fixed text of b to the fixed text of a */
+void append_format_text(Arena *arena, Format *a, const Format *b);
+
+/* Print a format; values holds one value per placeholder, in order */
+void print_format(const Format *format, const Value *values);
+
+#endif /* FORMAT_H */
@@ -0,0 +1,93 @@
+/* intern.c */
+
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_INITIAL_BUCKETS 256
+
+static uint32_t hash_name(const char *text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Double the buckets once they are half full, keeping probe runs short */
+static void grow_buckets(InternTable *table)
+{
+    uint32_t mask = table->mask * 2 + 1;
+    Atom *buckets = malloc((mask + 1) * sizeof(Atom));
+    memset(buckets, -1, (mask + 1) * sizeof(Atom));
+    for (Atom atom = 0; atom < table->count; atom++)
+    {
+        uint32_t i = table->hashes[atom] & mask;
+        while (buckets[i] >= 0)
+            i = (i + 1) & mask;
+        buckets[i] = atom;
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->mask = mask;
+}
+
+void intern_init(InternTable *table, Arena *arena)
+{
+    table->arena = arena;
+    table->names = NULL;
+    table->hashes = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->mask = INTERN_INITIAL_BUCKETS - 1;
+    table->buckets = malloc(INTERN_INITIAL_BUCKETS * sizeof(Atom));
+    memset(table->buckets, -1, INTERN_INITIAL_BUCKETS * sizeof(Atom));
+
+    static const char *const builtins[ATOM_BUILTIN_COUNT] = {
+        [ATOM_YAPPING] = "yapping",
+        [ATOM_YAPPIN] = "yappin",
+        [ATOM_BAKA] = "baka",
+    };
+    for (int i = 0; i < ATOM_BUILTIN_COUNT; i++)
+        intern(table, builtins[i], strlen(builtins[i]));
+}
+
+void intern_free(InternTable *table)
+{
+    free(table->names);
+    free(table->hashes);
+    free(table->buckets);
+    table->names = NULL;
+    table->hashes = NULL;
+    table->buckets = NULL;
+    table->count = table->capacity = 0;
+}
+
+Atom intern(InternTable *table, const char *text, size_t length)
+{
+    uint32_t hash = hash_name(text, length);
+    uint32_t i = hash & table->mask;
+    for (Atom atom; (atom = table->buckets[i]) >= 0; i = (i + 1) & table->mask)
+    {
+        const char *name = table->names[atom];
+        if (table->hashes[atom] == hash && strncmp(name, text, length) == 0 && name[length] == '\0')
+            return atom;
+    }
+
+    if (table->count == table->capacity)
+    {
+        table->capacity = table->capacity ? table->capacity * 2 : 64;
+        table->names = realloc(table->names, table->capacity * sizeof(char *));
+        table->hashes = realloc(table->hashes, table->capacity * sizeof(uint32_t));
+    }
+    Atom atom = table->count++;
+    table->names[atom] = arena_strndup(table->arena, text, length);
+    table->hashes[atom] = hash;
+    table->buckets[i] = atom;
+    if ((uint32_t)table->count * 2 > table->mask)
+        grow_buckets(table);
+    return atom;
+}
@@ -0,0 +1,48 @@
+/* intern.h */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "arena.h"
+#include <stdint.h>
+
+/*
+ * Interned identifiers. The scanner stores each distinct name of a
+ * program once and hands the parser its atom, a small integer, so from
+ * then on names are compared as integers. Atoms count up from 0 in order
+ * of first appearance, after the builtin function names, which are
+ * interned first and have fixed atoms.
+ */
+typedef int Atom;
+
+enum
+{
+    ATOM_YAPPING,
+    ATOM_YAPPIN,
+    ATOM_BAKA,
+    ATOM_BUILTIN_COUNT
+};
+
+typedef struct
+{
+    Arena *arena;       /* Receives the names */
+    const char **names; /* Indexed by atom */
+    int count;
+    int capacity;
+    Atom *buckets;      /* Open addressing by name hash; -1 if empty */
+    uint32_t *hashes;   /* Hash of each atom's name, for growing */
+    uint32_t mask;      /* Bucket count minus one, a power of two */
+} InternTable;
+
+void intern_init(InternTable *table, Arena *arena);
+void intern_free(InternTable *table);
+
+/* The atom of the length bytes at text, interning them if they are new */
+Atom intern(InternTable *table, const char *text, size_t length);
+
+static inline const char *atom_name(const InternTable *table, Atom atom)
+{
+    return table->names[atom];
+}
+
+#endif /* INTERN_H */
@@ -0,0 +1,1481 @@
+/* jit.c */
+
+#include "jit.h"
+
+_Thread_local bool jit_enabled;
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include "format.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern void yyerror(const char *s);
+extern void baka(const char *format, ...);
+
+#define MAX_BREAK_DEPTH 64
+
+/* Variables kept in callee-saved registers for the whole loop */
+#define INT_REGISTER_COUNT 4
+#define FLOAT_REGISTER_COUNT 8
+
+/*
+ * Frame layout below rbp: the five saved registers, then room for the
+ * values of a print call. The size keeps rsp 16-byte aligned.
+ */
+#define SAVED_REGISTERS_SIZE 40
+#define VALUES_AREA_SIZE 264
+#define VALUES_OFFSET (-(SAVED_REGISTERS_SIZE + VALUES_AREA_SIZE))
+
+enum
+{
+    RAX,
+    RCX,
+    RDX,
+    RBX,
+    RSP,
+    RBP,
+    RSI,
+    RDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15
+};
+
+/* Condition codes, as added to the jcc and setcc opcodes */
+enum
+{
+    CC_B = 0x2,
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_BE = 0x6,
+    CC_A = 0x7,
+    CC_P = 0xA,
+    CC_NP = 0xB,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF,
+    CC_ALWAYS = -1
+};
+
+/* Two-byte opcodes are written with their 0x0F escape, e.g. 0x0FAF */
+enum
+{
+    OP_ADD = 0x03,
+    OP_OR8 = 0x08,
+    OP_AND8 = 0x20,
+    OP_SUB = 0x2B,
+    OP_CMP = 0x3B,
+    OP_TEST8 = 0x84,
+    OP_TEST = 0x85,
+    OP_MOV_STORE8 = 0x88,
+    OP_MOV_STORE = 0x89,
+    OP_MOV_LOAD = 0x8B,
+    OP_LEA = 0x8D,
+    OP_MOVSS_LOAD = 0x0F10,
+    OP_MOVSS_STORE = 0x0F11,
+    OP_MOVAPS = 0x0F28,
+    OP_CVTSI2SS = 0x0F2A,
+    OP_CVTTSS2SI = 0x0F2C,
+    OP_UCOMISS = 0x0F2E,
+    OP_XORPS = 0x0F57,
+    OP_ADDSS = 0x0F58,
+    OP_MULSS = 0x0F59,
+    OP_SUBSS = 0x0F5C,
+    OP_DIVSS = 0x0F5E,
+    OP_MOVD_TO_XMM = 0x0F6E,
+    OP_MOVD_FROM_XMM = 0x0F7E,
+    OP_SETCC = 0x0F90,
+    OP_IMUL = 0x0FAF,
+    OP_MOVZX8 = 0x0FB6,
+    OP_MOVSX8 = 0x0FBE,
+    OP_MOVSX16 = 0x0FBF
+};
+
+/* A register, or the 32-bit memory at base + displacement */
+typedef struct
+{
+    bool memory;
+    int reg;
+    int32_t displacement;
+} Operand;
+
+/* Forward jumps to one target: offsets of their rel32 fields */
+typedef struct
+{
+    int *patches;
+    int count;
+    int capacity;
+} JumpList;
+
+struct JitCode
+{
+    void (*entry)(void);
+    void *memory;
+    size_t size;
+    JitCode *next;
+};
+
+typedef struct
+{
+    unsigned char *code;
+    int count;
+    int capacity;
+    int depth; /* 8-byte slots pushed since the frame was set up */
+    int int_register[MAX_VARS];
+    int float_register[MAX_VARS]; /* xmm number, or -1 */
+    JumpList breaks[MAX_BREAK_DEPTH];
+    int break_depth;
+    JumpList continues[MAX_BREAK_DEPTH];
+    int continue_depth;
+    JumpList halts; /* Jumps out of the loop once the program has halted */
+    bool failed;
+} Jit;
+
+static const int int_registers[INT_REGISTER_COUNT] = {RBX, R12, R13, R14};
+
+/* Marks a loop the code generator gave up on */
+static JitCode unsupported;
+
+static void compile_statement(Jit *j, ASTNode *node);
+static void compile_int(Jit *j, ASTNode *node);
+static void compile_float(Jit *j, ASTNode *node);
+
+/* Runtime entry points called from generated code */
+
+static void report_division_by_zero(void)
+{
+    yyerror("Division by zero");
+}
+
+static void print_error_text(const char *text)
+{
+    baka("%s\n", text);
+}
+
+static void print_error_value(int value)
+{
+    format_write_int(OUTPUT_STDERR, value, "\n");
+}
+
+/* Instruction encoding */
+
+static void emit_byte(Jit *j, int byte)
+{
+    if (j->count == j->capacity)
+    {
+        j->capacity = j->capacity ? j->capacity * 2 : 4096;
+        j->code = realloc(j->code, j->capacity);
+    }
+    j->code[j->count++] = (unsigned char)byte;
+}
+
+static void emit_u32(Jit *j, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        emit_byte(j, (value >> (8 * i)) & 0xff);
+    }
+}
+
+static void emit_u64(Jit *j, uint64_t value)
+{
+    emit_u32(j, (uint32_t)value);
+    emit_u32(j, (uint32_t)(value >> 32));
+}
+
+static Operand reg_operand(int reg)
+{
+    return (Operand){false, reg, 0};
+}
+
+static Operand mem_operand(int base, int32_t displacement)
+{
+    return (Operand){true, base, displacement};
+}
+
+/*
+ * Emit prefix, REX, opcode and ModRM for an instruction whose ModRM reg
+ * field is reg and whose r/m field is rm. Memory operands always use a
+ * 32-bit displacement.
+ */
+static void emit_instruction(Jit *j, int prefix, bool wide, int opcode, int reg, Operand rm)
+{
+    if (prefix)
+        emit_byte(j, prefix);
+    int rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm.reg & 8) ? 1 : 0);
+    if (rex != 0x40)
+        emit_byte(j, rex);
+    if (opcode > 0xff)
+        emit_byte(j, opcode >> 8);
+    emit_byte(j, opcode & 0xff);
+
+    if (!rm.memory)
+    {
+        emit_byte(j, 0xc0 | (reg & 7) << 3 | (rm.reg & 7));
+        return;
+    }
+    emit_byte(j, 0x80 | (reg & 7) << 3 | (rm.reg & 7));
+    if ((rm.reg & 7) == RSP)
+        emit_byte(j, 0x24); // SIB: base only
+    emit_u32(j, (uint32_t)rm.displacement);
+}
+
+static void emit_mov_imm(Jit *j, int reg, uint32_t value)
+{
+    if (reg & 8)
+        emit_byte(j, 0x41);
+    emit_byte(j, 0xb8 + (reg & 7));
+    emit_u32(j, value);
+}
+
+static void emit_mov_imm64(Jit *j, int reg, uint64_t value)
+{
+    emit_byte(j, 0x48 | ((reg & 8) ? 1 : 0));
+    emit_byte(j, 0xb8 + (reg & 7));
+    emit_u64(j, value);
+}
+
+/* Group 1 instruction with a 32-bit immediate, e.g. cmp r/m32, imm32 */
+static void emit_alu_imm(Jit *j, bool wide, int extension, Operand rm, uint32_t value)
+{
+    emit_instruction(j, 0, wide, 0x81, extension, rm);
+    emit_u32(j, value);
+}
+
+static void emit_push(Jit *j, int reg)
+{
+    if (reg & 8)
+        emit_byte(j, 0x41);
+    emit_byte(j, 0x50 + (reg & 7));
+}
+
+static void emit_pop(Jit *j, int reg)
+{
+    if (reg & 8)
+        emit_byte(j, 0x41);
+    emit_byte(j, 0x58 + (reg & 7));
+}
+
+/* A 0 or 1 in eax from the flags */
+static void emit_set(Jit *j, int cc)
+{
+    emit_instruction(j, 0, false, OP_SETCC + cc, 0, reg_operand(RAX));
+    emit_instruction(j, 0, false, OP_MOVZX8, RAX, reg_operand(RAX));
+}
+
+/* Jump with an unknown target; returns the offset of its rel32 field */
+static int emit_jump(Jit *j, int cc)
+{
+    if (cc == CC_ALWAYS)
+    {
+        emit_byte(j, 0xe9);
+    }
+    else
+    {
+        emit_byte(j, 0x0f);
+        emit_byte(j, 0x80 + cc);
+    }
+    emit_u32(j, 0);
+    return j->count - 4;
+}
+
+static void patch_jump(Jit *j, int patch, int target)
+{
+    int32_t relative = target - (patch + 4);
+    memcpy(j->code + patch, &relative, sizeof(relative));
+}
+
+static void emit_jump_back(Jit *j, int cc, int target)
+{
+    patch_jump(j, emit_jump(j, cc), target);
+}
+
+static void add_jump(Jit *j, JumpList *list, int cc)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->patches = realloc(list->patches, list->capacity * sizeof(int));
+    }
+    list->patches[list->count++] = emit_jump(j, cc);
+}
+
+static void patch_jumps(Jit *j, JumpList *list, int target)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        patch_jump(j, list->patches[i], target);
+    }
+    free(list->patches);
+    *list = (JumpList){0};
+}
+
+static void push_context(Jit *j, JumpList *stack, int *depth)
+{
+    if (*depth == MAX_BREAK_DEPTH)
+    {
+        j->failed = true;
+        return;
+    }
+    stack[(*depth)++] = (JumpList){0};
+}
+
+static void pop_context(Jit *j, JumpList *stack, int *depth, int target)
+{
+    if (*depth == 0)
+        return;
+    patch_jumps(j, &stack[--(*depth)], target);
+}
+
+/* Variables */
+
+static Operand home_operand(int slot)
+{
+    return mem_operand(R15, (int32_t)(slot * sizeof(variable) + offsetof(variable, value)));
+}
+
+static Operand int_variable(Jit *j, int slot)
+{
+    return j->int_register[slot] >= 0 ? reg_operand(j->int_register[slot]) : home_operand(slot);
+}
+
+static Operand float_variable(Jit *j, int slot)
+{
+    return j->float_register[slot] >= 0 ? reg_operand(j->float_register[slot]) : home_operand(slot);
+}
+
+/* Copy register-allocated floats to or from their symbol table slots */
+static void sync_float_registers(Jit *j, bool store)
+{
+    for (int slot = 0; slot < var_count; slot++)
+    {
+        int reg = j->float_register[slot];
+        if (reg < 0)
+            continue;
+        if (store)
+            emit_instruction(j, 0xf3, false, OP_MOVSS_STORE, reg, home_operand(slot));
+        else
+            emit_instruction(j, 0xf3, false, OP_MOVSS_LOAD, reg, home_operand(slot));
+    }
+}
+
+/*
+ * Call a runtime function whose arguments are already in place. Floats in
+ * registers do not survive the call, and rsp must be 16-byte aligned.
+ */
+static void emit_call(Jit *j, void *function)
+{
+    sync_float_registers(j, true);
+    bool pad = j->depth % 2 != 0;
+    if (pad)
+        emit_alu_imm(j, true, 5, reg_operand(RSP), 8);
+    emit_mov_imm64(j, RAX, (uint64_t)(uintptr_t)function);
+    emit_instruction(j, 0, false, 0xff, 2, reg_operand(RAX));
+    if (pad)
+        emit_alu_imm(j, true, 0, reg_operand(RSP), 8);
+    sync_float_registers(j, false);
+}
+
+/* Arrays */
+
+static Operand array_field(int slot, size_t offset)
+{
+    return mem_operand(R15, (int32_t)(slot * sizeof(variable) + offset));
+}
+
+/*
+ * Point rcx at the element of node's array whose index is in eax. A
+ * checked access out of bounds reports the error and gets the scratch
+ * value from array_index_error instead.
+ */
+static void emit_element_address(Jit *j, ASTNode *node)
+{
+    int size = element_size(node->value_type);
+    int in_bounds = -1;
+    int done = -1;
+    if (!node->data.element.unchecked)
+    {
+        emit_instruction(j, 0, false, OP_CMP, RAX, array_field(node->slot, offsetof(variable, length)));
+        in_bounds = emit_jump(j, CC_B);
+        if (size == sizeof(char))
+            emit_call(j, byte_array_index_error);
+        else if (size == sizeof(short))
+            emit_call(j, short_array_index_error);
+        else
+            emit_call(j, array_index_error);
+        emit_instruction(j, 0, true, OP_MOV_STORE, RAX, reg_operand(RCX));
+        done = emit_jump(j, CC_ALWAYS);
+        patch_jump(j, in_bounds, j->count);
+    }
+    emit_instruction(j, 0, true, OP_MOV_LOAD, RCX, array_field(node->slot, offsetof(variable, elements)));
+    // lea rcx, [rcx + rax * size]; eax is zero-extended and proven in range
+    emit_byte(j, 0x48);
+    emit_byte(j, OP_LEA);
+    emit_byte(j, 0x0c);
+    emit_byte(j, (size == sizeof(char) ? 0x00 : size == sizeof(short) ? 0x40 : 0x80) | 0x01);
+    if (done >= 0)
+        patch_jump(j, done, j->count);
+}
+
+static void compile_index_assignment(Jit *j, ASTNode *node)
+{
+    compile_int(j, node->data.element.index);
+    emit_push(j, RAX);
+    j->depth++;
+    if (node->value_type == TYPE_FLOAT)
+    {
+        compile_float(j, node->data.element.value);
+        emit_instruction(j, 0x66, false, OP_MOVD_FROM_XMM, 0, reg_operand(RAX));
+    }
+    else
+    {
+        compile_int(j, node->data.element.value);
+    }
+    // The value waits on the stack, where a call to report an error leaves it
+    emit_instruction(j, 0, false, OP_MOV_STORE, RAX, reg_operand(RDX));
+    emit_pop(j, RAX);
+    emit_push(j, RDX);
+    emit_element_address(j, node);
+    emit_pop(j, RDX);
+    j->depth--;
+    int size = element_size(node->value_type);
+    if (size == sizeof(char))
+        emit_instruction(j, 0, false, OP_MOV_STORE8, RDX, mem_operand(RCX, 0));
+    else
+        emit_instruction(j, size == sizeof(short) ? 0x66 : 0, false, OP_MOV_STORE, RDX, mem_operand(RCX, 0));
+}
+
+static void compile_array_declaration(Jit *j, ASTNode *node)
+{
+    compile_int(j, node->data.element.index);
+    emit_instruction(j, 0, false, OP_MOV_STORE, RAX, reg_operand(RSI));
+    emit_instruction(j, 0, true, OP_LEA, RDI, array_field(node->slot, 0));
+    emit_mov_imm(j, RDX, element_size(node->value_type));
+    emit_call(j, declare_array);
+    emit_instruction(j, 0, false, OP_TEST8, RAX, reg_operand(RAX));
+    add_jump(j, &j->halts, CC_E);
+}
+
+/* Integer expressions, computed into eax */
+
+static bool is_int_constant(ASTNode *node)
+{
+    return node->type == NODE_NUMBER || node->type == NODE_CHAR || node->type == NODE_BOOLEAN;
+}
+
+/* An operand for right once eax holds left; may use ecx */
+static Operand int_right_operand(Jit *j, ASTNode *right)
+{
+    if (right->type == NODE_IDENTIFIER)
+        return int_variable(j, right->slot);
+
+    emit_push(j, RAX);
+    j->depth++;
+    compile_int(j, right);
+    emit_instruction(j, 0, false, OP_MOV_STORE, RAX, reg_operand(RCX));
+    emit_pop(j, RAX);
+    j->depth--;
+    return reg_operand(RCX);
+}
+
+/* eax = eax op right, where op takes a ModRM source or a group 1 immediate */
+static void compile_int_operation(Jit *j, int opcode, int extension, ASTNode *right)
+{
+    if (is_int_constant(right))
+    {
+        if (opcode == OP_IMUL)
+        {
+            emit_instruction(j, 0, false, 0x69, RAX, reg_operand(RAX));
+            emit_u32(j, (uint32_t)right->data.value);
+        }
+        else
+        {
+            emit_alu_imm(j, false, extension, reg_operand(RAX), (uint32_t)right->data.value);
+        }
+        return;
+    }
+    emit_instruction(j, 0, false, opcode, RAX, int_right_operand(j, right));
+}
+
+static void compile_division(Jit *j, ASTNode *node)
+{
+    compile_int(j, node->data.op.left);
+    ASTNode *right = node->data.op.right;
+    bool checked = !(is_int_constant(right) && right->data.value != 0);
+    if (is_int_constant(right))
+        emit_mov_imm(j, RCX, (uint32_t)right->data.value);
+    else
+        emit_instruction(j, 0, false, OP_MOV_LOAD, RCX, int_right_operand(j, right));
+
+    int nonzero = -1;
+    int done = -1;
+    if (checked)
+    {
+        emit_instruction(j, 0, false, OP_TEST, RCX, reg_operand(RCX));
+        nonzero = emit_jump(j, CC_NE);
+        emit_call(j, report_division_by_zero);
+        emit_mov_imm(j, RAX, 0);
+        done = emit_jump(j, CC_ALWAYS);
+        patch_jump(j, nonzero, j->count);
+    }
+
+    bool is_signed = node->type == NODE_INT_DIV || node->type == NODE_INT_MOD;
+    int negated = -1;
+    if (is_signed && !(is_int_constant(right) && right->data.value != -1))
+    {
+        // idiv traps on INT_MIN / -1; dividing by -1 negates instead, as the tree walker does
+        emit_alu_imm(j, false, 7, reg_operand(RCX), (uint32_t)-1); // cmp ecx, -1
+        int other = emit_jump(j, CC_NE);
+        if (node->type == NODE_INT_DIV)
+            emit_instruction(j, 0, false, 0xf7, 3, reg_operand(RAX)); // neg eax
+        else
+            emit_instruction(j, 0, false, 0x33, RAX, reg_operand(RAX));
+        negated = emit_jump(j, CC_ALWAYS);
+        patch_jump(j, other, j->count);
+    }
+    if (is_signed)
+    {
+        emit_byte(j, 0x99); // cdq
+        emit_instruction(j, 0, false, 0xf7, 7, reg_operand(RCX));
+    }
+    else
+    {
+        emit_instruction(j, 0, false, 0x33, RDX, reg_operand(RDX));
+        emit_instruction(j, 0, false, 0xf7, 6, reg_operand(RCX));
+    }
+    if (node->type == NODE_INT_MOD || node->type == NODE_UNSIGNED_MOD)
+        emit_instruction(j, 0, false, OP_MOV_LOAD, RAX, reg_operand(RDX));
+
+    if (negated >= 0)
+        patch_jump(j, negated, j->count);
+    if (checked)
+        patch_jump(j, done, j->count);
+}
+
+static int int_condition_code(NodeType type)
+{
+    switch (type)
+    {
+    case NODE_INT_LT:
+        return CC_L;
+    case NODE_INT_GT:
+        return CC_G;
+    case NODE_INT_LE:
+        return CC_LE;
+    case NODE_INT_GE:
+        return CC_GE;
+    case NODE_INT_EQ:
+        return CC_E;
+    case NODE_INT_NE:
+        return CC_NE;
+    case NODE_UNSIGNED_LT:
+        return CC_B;
+    case NODE_UNSIGNED_GT:
+        return CC_A;
+    case NODE_UNSIGNED_LE:
+        return CC_BE;
+    case NODE_UNSIGNED_GE:
+        return CC_AE;
+    default:
+        return -1;
+    }
+}
+
+/* cmp left, right, leaving the flags for int_condition_code */
+static void compile_int_comparison(Jit *j, ASTNode *node)
+{
+    compile_int(j, node->data.op.left);
+    compile_int_operation(j, OP_CMP, 7, node->data.op.right);
+}
+
+/*
+ * ucomiss for a float comparison with xmm0 = left. Returns the condition
+ * code that is set when it holds for <, >, <= and >=, all of which are
+ * false for NaN; == and != return -1 and leave the flags for the caller.
+ */
+static int compile_float_comparison(Jit *j, ASTNode *node)
+{
+    compile_float(j, node->data.op.left);
+    ASTNode *right = node->data.op.right;
+    Operand operand;
+    if (right->type == NODE_IDENTIFIER)
+    {
+        operand = float_variable(j, right->slot);
+    }
+    else
+    {
+        emit_alu_imm(j, true, 5, reg_operand(RSP), 8);
+        j->depth++;
+        emit_instruction(j, 0xf3, false, OP_MOVSS_STORE, 0, mem_operand(RSP, 0));
+        compile_float(j, right);
+        emit_instruction(j, 0, false, OP_MOVAPS, 1, reg_operand(0));
+        emit_instruction(j, 0xf3, false, OP_MOVSS_LOAD, 0, mem_operand(RSP, 0));
+        emit_alu_imm(j, true, 0, reg_operand(RSP), 8);
+        j->depth--;
+        operand = reg_operand(1);
+    }
+
+    // a < b is b > a; ucomiss needs its first operand in a register
+    if (node->type == NODE_FLOAT_LT || node->type == NODE_FLOAT_LE)
+    {
+        if (operand.memory)
+        {
+            emit_instruction(j, 0xf3, false, OP_MOVSS_LOAD, 1, operand);
+            operand = reg_operand(1);
+        }
+        emit_instruction(j, 0, false, OP_UCOMISS, operand.reg, reg_operand(0));
+        return node->type == NODE_FLOAT_LT ? CC_A : CC_AE;
+    }
+    emit_instruction(j, 0, false, OP_UCOMISS, 0, operand);
+    switch (node->type)
+    {
+    case NODE_FLOAT_GT:
+        return CC_A;
+    case NODE_FLOAT_GE:
+        return CC_AE;
+    default:
+        return -1;
+    }
+}
+
+/* eax = flags say equal and ordered (==), or not (!=) */
+static void emit_float_equality(Jit *j, bool equal)
+{
+    emit_instruction(j, 0, false, OP_SETCC + (equal ? CC_E : CC_NE), 0, reg_operand(RAX));
+    emit_instruction(j, 0, false, OP_SETCC + (equal ? CC_NP : CC_P), 0, reg_operand(RCX));
+    emit_instruction(j, 0, false, equal ? OP_AND8 : OP_OR8, RCX, reg_operand(RAX));
+    emit_instruction(j, 0, false, OP_MOVZX8, RAX, reg_operand(RAX));
+}
+
+static void compile_branch(Jit *j, ASTNode *node, bool when, JumpList *jumps);
+
+static void compile_int(Jit *j, ASTNode *node)
+{
+    if (!node)
+    {
+        emit_mov_imm(j, RAX, 0);
+        return;
+    }
+    // giga and gigachad values stay with the tree walker
+    if (is_wide_type(node->value_type))
+    {
+        j->failed = true;
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+        emit_mov_imm(j, RAX, (uint32_t)node->data.value);
+        break;
+    case NODE_IDENTIFIER:
+        emit_instruction(j, 0, false, OP_MOV_LOAD, RAX, int_variable(j, node->slot));
+        break;
+    case NODE_INDEX:
+    {
+        // yap, cap and soy elements are sign-extended like their conversions
+        int size = element_size(node->value_type);
+        compile_int(j, node->data.element.index);
+        emit_element_address(j, node);
+        emit_instruction(j, 0, false,
+                         size == sizeof(char) ? OP_MOVSX8 : size == sizeof(short) ? OP_MOVSX16 : OP_MOV_LOAD, RAX,
+                         mem_operand(RCX, 0));
+        break;
+    }
+    case NODE_INT_ADD:
+        compile_int(j, node->data.op.left);
+        compile_int_operation(j, OP_ADD, 0, node->data.op.right);
+        break;
+    case NODE_INT_SUB:
+        compile_int(j, node->data.op.left);
+        compile_int_operation(j, OP_SUB, 5, node->data.op.right);
+        break;
+    case NODE_INT_MUL:
+        compile_int(j, node->data.op.left);
+        compile_int_operation(j, OP_IMUL, 0, node->data.op.right);
+        break;
+    case NODE_INT_DIV:
+    case NODE_INT_MOD:
+    case NODE_UNSIGNED_DIV:
+    case NODE_UNSIGNED_MOD:
+        compile_division(j, node);
+        break;
+    case NODE_INT_LT:
+    case NODE_INT_GT:
+    case NODE_INT_LE:
+    case NODE_INT_GE:
+    case NODE_INT_EQ:
+    case NODE_INT_NE:
+    case NODE_UNSIGNED_LT:
+    case NODE_UNSIGNED_GT:
+    case NODE_UNSIGNED_LE:
+    case NODE_UNSIGNED_GE:
+        compile_int_comparison(j, node);
+        emit_set(j, int_condition_code(node->type));
+        break;
+    case NODE_FLOAT_LT:
+    case NODE_FLOAT_GT:
+    case NODE_FLOAT_LE:
+    case NODE_FLOAT_GE:
+    case NODE_FLOAT_EQ:
+    case NODE_FLOAT_NE:
+    {
+        int cc = compile_float_comparison(j, node);
+        if (cc >= 0)
+            emit_set(j, cc);
+        else
+            emit_float_equality(j, node->type == NODE_FLOAT_EQ);
+        break;
+    }
+    case NODE_LOGICAL_AND:
+    case NODE_LOGICAL_OR:
+    {
+        JumpList false_jumps = {0};
+        compile_branch(j, node, false, &false_jumps);
+        emit_mov_imm(j, RAX, 1);
+        int done = emit_jump(j, CC_ALWAYS);
+        patch_jumps(j, &false_jumps, j->count);
+        emit_mov_imm(j, RAX, 0);
+        patch_jump(j, done, j->count);
+        break;
+    }
+    case NODE_INT_NEG:
+        compile_int(j, node->data.unary.operand);
+        emit_instruction(j, 0, false, 0xf7, 3, reg_operand(RAX));
+        break;
+    case NODE_FLOAT_TO_INT:
+        compile_float(j, node->data.unary.operand);
+        emit_instruction(j, 0xf3, false, OP_CVTTSS2SI, RAX, reg_operand(0));
+        break;
+    case NODE_FLOAT_TO_UNSIGNED:
+        // Convert to 64 bits and keep the low half, as C does
+        compile_float(j, node->data.unary.operand);
+        emit_instruction(j, 0xf3, true, OP_CVTTSS2SI, RAX, reg_operand(0));
+        emit_instruction(j, 0, false, OP_MOV_STORE, RAX, reg_operand(RAX));
+        break;
+    case NODE_FLOAT_TO_BOOL:
+        compile_float(j, node->data.unary.operand);
+        emit_instruction(j, 0, false, OP_XORPS, 1, reg_operand(1));
+        emit_instruction(j, 0, false, OP_UCOMISS, 0, reg_operand(1));
+        emit_float_equality(j, false);
+        break;
+    case NODE_INT_TO_BOOL:
+        compile_int(j, node->data.unary.operand);
+        emit_instruction(j, 0, false, OP_TEST, RAX, reg_operand(RAX));
+        emit_set(j, CC_NE);
+        break;
+    case NODE_INT_TO_CHAR:
+        compile_int(j, node->data.unary.operand);
+        emit_instruction(j, 0, false, OP_MOVSX8, RAX, reg_operand(RAX));
+        break;
+    case NODE_INT_TO_SHORT:
+        compile_int(j, node->data.unary.operand);
+        emit_instruction(j, 0, false, OP_MOVSX16, RAX, reg_operand(RAX));
+        break;
+    default:
+        j->failed = true;
+        break;
+    }
+}
+
+/* Float expressions, computed into xmm0 */
+
+static void compile_float_operation(Jit *j, int opcode, ASTNode *node)
+{
+    compile_float(j, node->data.op.left);
+    ASTNode *right = node->data.op.right;
+    Operand operand;
+    if (right->type == NODE_IDENTIFIER)
+    {
+        operand = float_variable(j, right->slot);
+    }
+    else if (right->type == NODE_FLOAT)
+    {
+        uint32_t bits;
+        memcpy(&bits, &right->data.fvalue, sizeof(bits));
+        emit_mov_imm(j, RAX, bits);
+        emit_instruction(j, 0x66, false, OP_MOVD_TO_XMM, 1, reg_operand(RAX));
+        operand = reg_operand(1);
+    }
+    else
+    {
+        emit_alu_imm(j, true, 5, reg_operand(RSP), 8);
+        j->depth++;
+        emit_instruction(j, 0xf3, false, OP_MOVSS_STORE, 0, mem_operand(RSP, 0));
+        compile_float(j, right);
+        emit_instruction(j, 0, false, OP_MOVAPS, 1, reg_operand(0));
+        emit_instruction(j, 0xf3, false, OP_MOVSS_LOAD, 0, mem_operand(RSP, 0));
+        emit_alu_imm(j, true, 0, reg_operand(RSP), 8);
+        j->depth--;
+        operand = reg_operand(1);
+    }
+
+    if (opcode != OP_DIVSS || (right->type == NODE_FLOAT && right->data.fvalue != 0.0f))
+    {
+        emit_instruction(j, 0xf3, false, opcode, 0, operand);
+        return;
+    }
+
+    // Division by zero, but not by NaN, reports an error and yields 0
+    if (operand.memory)
+    {
+        emit_instruction(j, 0xf3, false, OP_MOVSS_LOAD, 1, operand);
+        operand = reg_operand(1);
+    }
+    emit_instruction(j, 0, false, OP_XORPS, 2, reg_operand(2));
+    emit_instruction(j, 0, false, OP_UCOMISS, operand.reg, reg_operand(2));
+    int unordered = emit_jump(j, CC_P);
+    int nonzero = emit_jump(j, CC_NE);
+    emit_call(j, report_division_by_zero);
+    emit_instruction(j, 0, false, OP_XORPS, 0, reg_operand(0));
+    int done = emit_jump(j, CC_ALWAYS);
+    patch_jump(j, unordered, j->count);
+    patch_jump(j, nonzero, j->count);
+    emit_instruction(j, 0xf3, false, OP_DIVSS, 0, operand);
+    patch_jump(j, done, j->count);
+}
+
+static void compile_float(Jit *j, ASTNode *node)
+{
+    if (!node)
+    {
+        emit_instruction(j, 0, false, OP_XORPS, 0, reg_operand(0));
+        return;
+    }
+    if (is_wide_type(node->value_type))
+    {
+        j->failed = true;
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_FLOAT:
+    {
+        uint32_t bits;
+        memcpy(&bits, &node->data.fvalue, sizeof(bits));
+        emit_mov_imm(j, RAX, bits);
+        emit_instruction(j, 0x66, false, OP_MOVD_TO_XMM, 0, reg_operand(RAX));
+        break;
+    }
+    case NODE_IDENTIFIER:
+        emit_instruction(j, 0xf3, false, OP_MOVSS_LOAD, 0, float_variable(j, node->slot));
+        break;
+    case NODE_INDEX:
+        compile_int(j, node->data.element.index);
+        emit_element_address(j, node);
+        emit_instruction(j, 0xf3, false, OP_MOVSS_LOAD, 0, mem_operand(RCX, 0));
+        break;
+    case NODE_FLOAT_ADD:
+        compile_float_operation(j, OP_ADDSS, node);
+        break;
+    case NODE_FLOAT_SUB:
+        compile_float_operation(j, OP_SUBSS, node);
+        break;
+    case NODE_FLOAT_MUL:
+        compile_float_operation(j, OP_MULSS, node);
+        break;
+    case NODE_FLOAT_DIV:
+        compile_float_operation(j, OP_DIVSS, node);
+        break;
+    case NODE_FLOAT_NEG:
+        compile_float(j, node->data.unary.operand);
+        emit_instruction(j, 0x66, false, OP_MOVD_FROM_XMM, 0, reg_operand(RAX));
+        emit_alu_imm(j, false, 6, reg_operand(RAX), 0x80000000u);
+        emit_instruction(j, 0x66, false, OP_MOVD_TO_XMM, 0, reg_operand(RAX));
+        break;
+    case NODE_INT_TO_FLOAT:
+        compile_int(j, node->data.unary.operand);
+        emit_instruction(j, 0xf3, false, OP_CVTSI2SS, 0, reg_operand(RAX));
+        break;
+    case NODE_UNSIGNED_TO_FLOAT:
+        // The 32-bit result in eax is zero-extended, so rax is its unsigned value
+        compile_int(j, node->data.unary.operand);
+        emit_instruction(j, 0xf3, true, OP_CVTSI2SS, 0, reg_operand(RAX));
+        break;
+    default:
+        j->failed = true;
+        break;
+    }
+}
+
+/* Conditions */
+
+/*
+ * Jump to jumps when node evaluates to when; mirrors compile_branch in
+ * the bytecode compiler.
+ */
+static void compile_branch(Jit *j, ASTNode *node, bool when, JumpList *jumps)
+{
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_BOOLEAN:
+    case NODE_CHAR:
+        if ((node->data.value != 0) == when)
+            add_jump(j, jumps, CC_ALWAYS);
+        return;
+    case NODE_LOGICAL_AND:
+    case NODE_LOGICAL_OR:
+    {
+        bool decides = node->type == NODE_LOGICAL_OR;
+        if (when == decides)
+        {
+            compile_branch(j, node->data.op.left, when, jumps);
+            compile_branch(j, node->data.op.right, when, jumps);
+        }
+        else
+        {
+            JumpList skip = {0};
+            compile_branch(j, node->data.op.left, decides, &skip);
+            compile_branch(j, node->data.op.right, when, jumps);
+            patch_jumps(j, &skip, j->count);
+        }
+        return;
+    }
+    case NODE_INT_TO_BOOL:
+        compile_branch(j, node->data.unary.operand, when, jumps);
+        return;
+    case NODE_FLOAT_LT:
+    case NODE_FLOAT_GT:
+    case NODE_FLOAT_LE:
+    case NODE_FLOAT_GE:
+    {
+        // The negated condition codes are also taken for NaN
+        int cc = compile_float_comparison(j, node);
+        add_jump(j, jumps, when ? cc : cc ^ 1);
+        return;
+    }
+    default:
+        break;
+    }
+
+    int cc = int_condition_code(node->type);
+    if (cc >= 0)
+    {
+        compile_int_comparison(j, node);
+        add_jump(j, jumps, when ? cc : cc ^ 1);
+        return;
+    }
+
+    compile_int(j, node);
+    emit_instruction(j, 0, false, OP_TEST, RAX, reg_operand(RAX));
+    add_jump(j, jumps, when ? CC_NE : CC_E);
+}
+
+/* Statements */
+
+static void compile_statements(Jit *j, ASTNode *node)
+{
+    if (node && node->type == NODE_STATEMENT_LIST)
+    {
+        for (StatementList *current = node->data.statements; current; current = current->next)
+        {
+            compile_statement(j, current->statement);
+        }
+        return;
+    }
+    compile_statement(j, node);
+}
+
+static void compile_assignment(Jit *j, ASTNode *node)
+{
+    int slot = node->data.op.left->slot;
+    if (node->value_type == TYPE_FLOAT)
+    {
+        compile_float(j, node->data.op.right);
+        emit_instruction(j, 0xf3, false, OP_MOVSS_STORE, 0, float_variable(j, slot));
+    }
+    else
+    {
+        compile_int(j, node->data.op.right);
+        emit_instruction(j, 0, false, OP_MOV_STORE, RAX, int_variable(j, slot));
+    }
+}
+
+/* Evaluate each placeholder argument into the frame and call print_format */
+static void compile_print_call(Jit *j, const Format *format)
+{
+    int count = 0;
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        ArgumentList *arg = format->segments[i].argument;
+        if (!arg)
+            continue;
+        Operand value = mem_operand(RBP, VALUES_OFFSET + count++ * (int32_t)sizeof(Value));
+        if (arg->expr->value_type == TYPE_FLOAT)
+        {
+            compile_float(j, arg->expr);
+            emit_instruction(j, 0xf3, false, OP_MOVSS_STORE, 0, value);
+        }
+        else
+        {
+            compile_int(j, arg->expr);
+            emit_instruction(j, 0, false, OP_MOV_STORE, RAX, value);
+        }
+    }
+    emit_mov_imm64(j, RDI, (uint64_t)(uintptr_t)format);
+    emit_instruction(j, 0, true, OP_LEA, RSI, mem_operand(RBP, VALUES_OFFSET));
+    emit_call(j, print_format);
+}
+
+static void compile_error_statement(Jit *j, ASTNode *node)
+{
+    ASTNode *expr = node->data.op.left;
+    if (expr->type == NODE_STRING_LITERAL)
+    {
+        emit_mov_imm64(j, RDI, (uint64_t)(uintptr_t)expr->data.name);
+        emit_call(j, print_error_text);
+        return;
+    }
+    if (expr->value_type == TYPE_FLOAT)
+    {
+        compile_float(j, expr);
+        emit_instruction(j, 0xf3, false, OP_CVTTSS2SI, RAX, reg_operand(0));
+    }
+    else
+    {
+        compile_int(j, expr);
+    }
+    emit_instruction(j, 0, false, OP_MOV_STORE, RAX, reg_operand(RDI));
+    emit_call(j, print_error_value);
+}
+
+static void compile_if(Jit *j, ASTNode *node)
+{
+    JumpList else_jumps = {0};
+    compile_branch(j, node->data.if_stmt.condition, false, &else_jumps);
+    compile_statement(j, node->data.if_stmt.then_branch);
+    if (node->data.if_stmt.else_branch)
+    {
+        JumpList end_jumps = {0};
+        add_jump(j, &end_jumps, CC_ALWAYS);
+        patch_jumps(j, &else_jumps, j->count);
+        compile_statement(j, node->data.if_stmt.else_branch);
+        patch_jumps(j, &end_jumps, j->count);
+    }
+    else
+    {
+        patch_jumps(j, &else_jumps, j->count);
+    }
+}
+
+/*
+ * The loops are rotated so each iteration ends in one conditional jump
+ * back to the body; the condition is also tested once on entry, except
+ * for mewing.
+ */
+static void compile_loop(Jit *j, ASTNode *condition, ASTNode *body, ASTNode *increment, bool test_first)
+{
+    push_context(j, j->breaks, &j->break_depth);
+    push_context(j, j->continues, &j->continue_depth);
+    if (j->failed)
+        return;
+
+    if (test_first && condition)
+        compile_branch(j, condition, false, &j->breaks[j->break_depth - 1]);
+    int top = j->count;
+    compile_statement(j, body);
+    pop_context(j, j->continues, &j->continue_depth, j->count);
+    compile_statement(j, increment);
+    if (condition)
+    {
+        JumpList repeat = {0};
+        compile_branch(j, condition, true, &repeat);
+        patch_jumps(j, &repeat, top);
+    }
+    else
+    {
+        emit_jump_back(j, CC_ALWAYS, top);
+    }
+    pop_context(j, j->breaks, &j->break_depth, j->count);
+}
+
+/* Binary search over the sorted labels, jumping to the arm that matches */
+static void compile_switch_search(Jit *j, const SwitchTable *table, int low, int high, JumpList *arms,
+                                  JumpList *default_jumps)
+{
+    if (high - low < 4)
+    {
+        for (int i = low; i <= high; i++)
+        {
+            emit_alu_imm(j, false, 7, reg_operand(RAX), (uint32_t)table->entries[i].value);
+            add_jump(j, &arms[table->entries[i].arm], CC_E);
+        }
+        add_jump(j, default_jumps, CC_ALWAYS);
+        return;
+    }
+
+    int mid = low + (high - low) / 2;
+    JumpList upper = {0};
+    emit_alu_imm(j, false, 7, reg_operand(RAX), (uint32_t)table->entries[mid].value);
+    add_jump(j, &arms[table->entries[mid].arm], CC_E);
+    add_jump(j, &upper, CC_G);
+    compile_switch_search(j, table, low, mid - 1, arms, default_jumps);
+    patch_jumps(j, &upper, j->count);
+    compile_switch_search(j, table, mid + 1, high, arms, default_jumps);
+}
+
+static void compile_switch(Jit *j, ASTNode *node)
+{
+    SwitchTable *table = node->data.switch_stmt.table;
+    if (!table)
+    {
+        table = node->data.switch_stmt.table = build_switch_table(node->data.switch_stmt.cases);
+    }
+
+    push_context(j, j->breaks, &j->break_depth);
+    if (j->failed)
+        return;
+    JumpList *breaks = &j->breaks[j->break_depth - 1];
+
+    compile_int(j, node->data.switch_stmt.expression);
+    JumpList *arms = calloc(table->arm_count ? table->arm_count : 1, sizeof(JumpList));
+    JumpList *default_jumps = table->default_arm >= 0 ? &arms[table->default_arm] : breaks;
+    compile_switch_search(j, table, 0, table->entry_count - 1, arms, default_jumps);
+
+    for (int i = 0; i < table->arm_count; i++)
+    {
+        patch_jumps(j, &arms[i], j->count);
+        compile_statements(j, table->arms[i]->statements);
+    }
+    free(arms);
+    pop_context(j, j->breaks, &j->break_depth, j->count);
+}
+
+static void compile_statement(Jit *j, ASTNode *node)
+{
+    if (!node || j->failed)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        compile_assignment(j, node);
+        break;
+    case NODE_ARRAY_DECLARATION:
+        compile_array_declaration(j, node);
+        break;
+    case NODE_INDEX_ASSIGNMENT:
+        compile_index_assignment(j, node);
+        break;
+    case NODE_FUNC_CALL:
+        if (node->data.func_call.format)
+            compile_print_call(j, node->data.func_call.format);
+        else if (node->slot >= 0)
+            j->failed = true;
+        break;
+    case NODE_ERROR_STATEMENT:
+        compile_error_statement(j, node);
+        break;
+    case NODE_STATEMENT_LIST:
+        compile_statements(j, node);
+        break;
+    case NODE_IF_STATEMENT:
+        compile_if(j, node);
+        break;
+    case NODE_FOR_STATEMENT:
+        compile_statement(j, node->data.for_stmt.init);
+        compile_loop(j, node->data.for_stmt.cond, node->data.for_stmt.body, node->data.for_stmt.incr, true);
+        break;
+    case NODE_WHILE_STATEMENT:
+        compile_loop(j, node->data.while_stmt.cond, node->data.while_stmt.body, NULL, true);
+        break;
+    case NODE_DO_WHILE_STATEMENT:
+        compile_loop(j, node->data.while_stmt.cond, node->data.while_stmt.body, NULL, false);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        compile_switch(j, node);
+        break;
+    case NODE_BREAK_STATEMENT:
+        if (j->break_depth == 0)
+            j->failed = true;
+        else
+            add_jump(j, &j->breaks[j->break_depth - 1], CC_ALWAYS);
+        break;
+    case NODE_CONTINUE_STATEMENT:
+        if (j->continue_depth == 0)
+            j->failed = true;
+        else
+            add_jump(j, &j->continues[j->continue_depth - 1], CC_ALWAYS);
+        break;
+    case NODE_STRING_LITERAL:
+    case NODE_PRINT_STATEMENT:
+    case NODE_RETURN:
+        j->failed = true;
+        break;
+    default:
+        // An expression evaluated for its effects
+        if (node->value_type == TYPE_FLOAT)
+            compile_float(j, node);
+        else
+            compile_int(j, node);
+        break;
+    }
+}
+
+/* Register allocation */
+
+static bool is_binary(NodeType type)
+{
+    return type >= NODE_INT_ADD && type <= NODE_LOGICAL_OR && type != NODE_INT_NEG && type != NODE_FLOAT_NEG;
+}
+
+static bool is_unary(NodeType type)
+{
+    return type == NODE_INT_NEG || type == NODE_FLOAT_NEG || (type >= NODE_LONG_NEG && type <= NODE_DOUBLE_TO_BOOL);
+}
+
+/* Weigh every variable use in node, counting uses in nested loops more */
+static void count_uses(ASTNode *node, long weight, long *uses)
+{
+    if (!node)
+        return;
+
+    long inner = weight < (1L << 40) ? weight * 16 : weight;
+    switch (node->type)
+    {
+    case NODE_IDENTIFIER:
+        uses[node->slot] += weight;
+        break;
+    case NODE_ASSIGNMENT:
+        uses[node->data.op.left->slot] += weight;
+        count_uses(node->data.op.right, weight, uses);
+        break;
+    case NODE_INDEX:
+    case NODE_INDEX_ASSIGNMENT:
+    case NODE_ARRAY_DECLARATION:
+        // Arrays stay in memory; only their indices and values are counted
+        count_uses(node->data.element.index, weight, uses);
+        count_uses(node->data.element.value, weight, uses);
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *current = node->data.statements; current; current = current->next)
+        {
+            count_uses(current->statement, weight, uses);
+        }
+        break;
+    case NODE_IF_STATEMENT:
+        count_uses(node->data.if_stmt.condition, weight, uses);
+        count_uses(node->data.if_stmt.then_branch, weight, uses);
+        count_uses(node->data.if_stmt.else_branch, weight, uses);
+        break;
+    case NODE_FOR_STATEMENT:
+        count_uses(node->data.for_stmt.init, weight, uses);
+        count_uses(node->data.for_stmt.cond, inner, uses);
+        count_uses(node->data.for_stmt.incr, inner, uses);
+        count_uses(node->data.for_stmt.body, inner, uses);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        count_uses(node->data.while_stmt.cond, inner, uses);
+        count_uses(node->data.while_stmt.body, inner, uses);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        count_uses(node->data.switch_stmt.expression, weight, uses);
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            count_uses(cn->statements, weight, uses);
+        }
+        break;
+    case NODE_FUNC_CALL:
+        for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+        {
+            count_uses(arg->expr, weight, uses);
+        }
+        break;
+    case NODE_ERROR_STATEMENT:
+        count_uses(node->data.op.left, weight, uses);
+        break;
+    default:
+        if (is_binary(node->type))
+        {
+            count_uses(node->data.op.left, weight, uses);
+            count_uses(node->data.op.right, weight, uses);
+        }
+        else if (is_unary(node->type))
+        {
+            count_uses(node->data.unary.operand, weight, uses);
+        }
+        break;
+    }
+}
+
+/* Give the most used variables of the loop the registers of their class */
+static void allocate_registers(Jit *j, ASTNode *loop)
+{
+    long uses[MAX_VARS] = {0};
+    count_uses(loop, 1, uses);
+    for (int slot = 0; slot < MAX_VARS; slot++)
+    {
+        j->int_register[slot] = -1;
+        j->float_register[slot] = -1;
+    }
+
+    int int_count = 0;
+    int float_count = 0;
+    for (;;)
+    {
+        int best = -1;
+        for (int slot = 0; slot < var_count; slot++)
+        {
+            if (uses[slot] > 0 && (best < 0 || uses[slot] > uses[best]))
+                best = slot;
+        }
+        if (best < 0)
+            break;
+        uses[best] = 0;
+
+        const variable *var = &symbol_table[best];
+        if (var->modifiers.is_volatile || is_wide_type(var->type))
+            continue;
+        if (var->type == TYPE_FLOAT)
+        {
+            if (float_count < FLOAT_REGISTER_COUNT)
+                j->float_register[best] = 8 + float_count++;
+        }
+        else if (int_count < INT_REGISTER_COUNT)
+        {
+            j->int_register[best] = int_registers[int_count++];
+        }
+    }
+}
+
+/* Move register-allocated ints to or from their symbol table slots */
+static void sync_int_registers(Jit *j, bool store)
+{
+    for (int slot = 0; slot < var_count; slot++)
+    {
+        int reg = j->int_register[slot];
+        if (reg < 0)
+            continue;
+        emit_instruction(j, 0, false, store ? OP_MOV_STORE : OP_MOV_LOAD, reg, home_operand(slot));
+    }
+}
+
+/* Translate a loop into a function that runs it against the symbol table */
+static JitCode *compile_loop_code(ASTNode *node)
+{
+    Jit *j = calloc(1, sizeof(Jit));
+    allocate_registers(j, node);
+
+    // Prologue: save callee-saved registers and point r15 at the variables
+    emit_push(j, RBP);
+    emit_instruction(j, 0, true, OP_MOV_STORE, RSP, reg_operand(RBP));
+    emit_push(j, RBX);
+    emit_push(j, R12);
+    emit_push(j, R13);
+    emit_push(j, R14);
+    emit_push(j, R15);
+    emit_alu_imm(j, true, 5, reg_operand(RSP), VALUES_AREA_SIZE);
+    emit_mov_imm64(j, R15, (uint64_t)(uintptr_t)symbol_table);
+    sync_int_registers(j, false);
+    sync_float_registers(j, false);
+
+    compile_statement(j, node);
+    patch_jumps(j, &j->halts, j->count);
+
+    sync_int_registers(j, true);
+    sync_float_registers(j, true);
+    emit_alu_imm(j, true, 0, reg_operand(RSP), VALUES_AREA_SIZE);
+    emit_pop(j, R15);
+    emit_pop(j, R14);
+    emit_pop(j, R13);
+    emit_pop(j, R12);
+    emit_pop(j, RBX);
+    emit_pop(j, RBP);
+    emit_byte(j, 0xc3);
+
+    JitCode *code = &unsupported;
+    if (!j->failed)
+    {
+        long page = sysconf(_SC_PAGESIZE);
+        size_t size = (j->count + page - 1) / page * page;
+        void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            memcpy(memory, j->code, j->count);
+            if (mprotect(memory, size, PROT_READ | PROT_EXEC) == 0)
+            {
+                code = malloc(sizeof(JitCode));
+                code->memory = memory;
+                code->size = size;
+                code->entry = (void (*)(void))memory;
+                code->next = current_program->jit_code;
+                current_program->jit_code = code;
+            }
+            else
+            {
+                munmap(memory, size);
+            }
+        }
+    }
+
+    for (int i = 0; i < j->break_depth; i++)
+    {
+        free(j->breaks[i].patches);
+    }
+    for (int i = 0; i < j->continue_depth; i++)
+    {
+        free(j->continues[i].patches);
+    }
+    free(j->code);
+    free(j);
+    return code;
+}
+
+bool jit_execute_loop(ASTNode *node)
+{
+    // The code addresses main's variables directly
+    if (symbol_table != current_program->main.symbols)
+        return false;
+
+    JitCode **code = node->type == NODE_FOR_STATEMENT ? &node->data.for_stmt.jit : &node->data.while_stmt.jit;
+    if (!*code)
+    {
+        *code = compile_loop_code(node);
+    }
+    if (*code == &unsupported)
+        return false;
+    (*code)->entry();
+    return true;
+}
+
+void jit_release(Program *program)
+{
+    while (program->jit_code)
+    {
+        JitCode *next = program->jit_code->next;
+        munmap(program->jit_code->memory, program->jit_code->size);
+        free(program->jit_code);
+        program->jit_code = next;
+    }
+}
+
+#else
+
+bool jit_execute_loop(ASTNode *node)
+{
+    (void)node;
+    return false;
+}
+
+void jit_release(Program *program)
+{
+    (void)program;
+}
+
+#endif
@@ -0,0 +1,32 @@
+/* jit.h */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "ast.h"
+
+/*
+ * Native code for the tree walker's loops, enabled with --jit.
+ *
+ * The first time a `flex`, `goon` or `mewing` loop runs, the whole loop
+ * is translated to x86-64 machine code in memory mapped for execution,
+ * and that code runs in place of the tree walker from then on. The most
+ * used variables live in registers for the duration of the loop and are
+ * written back to the symbol table when it ends. Prints and errors call
+ * into the interpreter's runtime, so output is identical.
+ *
+ * A loop containing anything the code generator does not handle, such as
+ * a call to a user-defined function, is left to the tree walker, which
+ * then tries each loop nested in it in turn. Loops inside functions are
+ * always interpreted, as their variables move with each call's frame.
+ * On other platforms nothing is compiled and every loop is interpreted.
+ */
+extern _Thread_local bool jit_enabled;
+
+/* Run a loop natively; returns false if the tree walker has to run it */
+bool jit_execute_loop(ASTNode *node);
+
+/* Release the code of every loop compiled for program */
+void jit_release(Program *program);
+
+#endif /* JIT_H */
@@ -1,74 +1,33 @@
 %{
 #include "ast.h"
+#include "output.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdbool.h>
 
-int yylex(void);
 void yyerror(const char *s);
 void yapping(const char* format, ...);
 void yappin(const char* format, ...);
 void baka(const char* format, ...);
-TypeModifiers get_variable_modifiers(const char* name);
-extern TypeModifiers current_modifiers;
-
-/* Function to add or update variables in the symbol table */
-bool set_variable(char *name, int value, TypeModifiers mods) {
-    for (int i = 0; i < var_count; i++) {
-        if (strcmp(symbol_table[i].name, name) == 0) {
-            if (mods.is_unsigned) {
-                symbol_table[i].value.ivalue = (unsigned int)value;
-            } else if (mods.is_signed) {
-                symbol_table[i].value.ivalue = value;
-            } else {
-                symbol_table[i].value.ivalue = value;
-            }
-            symbol_table[i].modifiers = mods;
-            return true;
-        }
-    }
-    
-    if (var_count < MAX_VARS) {
-        symbol_table[var_count].name = strdup(name);
-        if (mods.is_unsigned) {
-            symbol_table[var_count].value.ivalue = (unsigned int)value;
-        } else {
-            symbol_table[var_count].value.ivalue = value;
-        }
-        symbol_table[var_count].modifiers = mods;
-        var_count++;
-        return true;
-    }
-    return false;
-}
-
-/* Fix get_variable function: */
-int get_variable(char *name) {
-    for (int i = 0; i < var_count; i++) {
-        if (strcmp(symbol_table[i].name, name) == 0) {
-            if (symbol_table[i].modifiers.is_volatile) {
-                asm volatile("" ::: "memory");
-            }
-            return symbol_table[i].value.ivalue;
-        }
-    }
-    yyerror("Undefined variable");
-    exit(1);
-}
+int lex_line(void);
+%}
 
-extern int yylineno;
+/* Reentrant: the parser keeps its state on the stack, so threads can parse at once */
+%define api.pure full
 
-/* Root of the AST */
-ASTNode *root = NULL;
-%}
+%code {
+int yylex(YYSTYPE *lval);
+}
 
 %union {
     int ival;
-    float fval;
+    int64_t lval;
+    double fval;
     char cval;
     char *sval;
+    Atom atom;
     ASTNode *node;
     CaseNode *case_node;
     ArgumentList *args;
@@ -77,32 +36,36 @@ ASTNode *root = NULL;
 /* Define token types */
 %token SKIBIDI RIZZ YAP BAKA MAIN BUSSIN FLEX CAP
 %token PLUS MINUS TIMES DIVIDE MOD SEMICOLON COLON COMMA
-%token LPAREN RPAREN LBRACE RBRACE
+%token LPAREN RPAREN LBRACE RBRACE LBRACKET RBRACKET
 %token LT GT LE GE EQ NE EQUALS AND OR
 %token BREAK CASE CONST CONTINUE DEFAULT DO DOUBLE ELSE ENUM
 %token EXTERN CHAD FOR GOTO IF INT LONG REGISTER SHORT SIGNED
 %token SIZEOF STATIC STRUCT SWITCH TYPEDEF UNION UNSIGNED VOID VOLATILE GOON
-%token <sval> IDENTIFIER
+%token <atom> IDENTIFIER
 %token <ival> NUMBER
+%token <lval> LONG_LITERAL
 %token <sval> STRING_LITERAL
 %token <cval> CHAR
 %token <ival> BOOLEAN
 %token <fval> FLOAT_LITERAL
 
 /* Declare types for non-terminals */
-%type <node> program skibidi_function
+%type <node> skibidi_function
 %type <node> statements statement
 %type <node> declaration
 %type <node> expression
 %type <node> for_statement
-%type <node> while_statement
+%type <node> while_statement do_while_statement
 %type <node> function_call
 %type <args> arg_list argument_list
+%type <args> parameters parameter_list
+%type <node> parameter
+%type <ival> return_type
 %type <node> error_statement
 %type <node> return_statement
 %type <node> init_expr condition increment
 %type <node> if_statement
-%type <node> switch_statement break_statement
+%type <node> switch_statement break_statement continue_statement
 %type <case_node> case_list case_clause
 
 %start program
@@ -123,8 +86,8 @@ ASTNode *root = NULL;
 %%
 
 program:
-    skibidi_function
-        { root = $1; }
+    function_definitions skibidi_function function_definitions
+        { current_program->root = $2; }
     ;
 
 skibidi_function:
@@ -132,6 +95,69 @@ skibidi_function:
         { $$ = $4; }
     ;
 
+function_definitions:
+      /* empty */
+    | function_definitions function_definition
+    ;
+
+function_definition:
+    SKIBIDI return_type IDENTIFIER LPAREN parameters RPAREN LBRACE statements RBRACE
+        { define_function($3, $2, $5, $8); }
+    | SKIBIDI IDENTIFIER LPAREN parameters RPAREN LBRACE statements RBRACE
+        { define_function($2, TYPE_UNKNOWN, $4, $7); }
+    ;
+
+return_type:
+    optional_modifiers RIZZ
+        { $$ = get_current_modifiers().is_unsigned ? TYPE_UNSIGNED : TYPE_INT; reset_modifiers(); }
+    | optional_modifiers CHAD
+        { reset_modifiers(); $$ = TYPE_FLOAT; }
+    | optional_modifiers YAP
+        { reset_modifiers(); $$ = TYPE_CHAR; }
+    | optional_modifiers CAP
+        { reset_modifiers(); $$ = TYPE_BOOL; }
+    | optional_modifiers LONG
+        { reset_modifiers(); $$ = TYPE_LONG; }
+    | optional_modifiers SHORT
+        { reset_modifiers(); $$ = TYPE_SHORT; }
+    | optional_modifiers DOUBLE
+        { reset_modifiers(); $$ = TYPE_DOUBLE; }
+    ;
+
+parameters:
+      /* empty */
+        { $$ = NULL; }
+    | parameter_list
+        { $$ = $1; }
+    ;
+
+parameter_list:
+    parameter
+        { $$ = create_argument_list($1, NULL); }
+    | parameter_list COMMA parameter
+        { $$ = create_argument_list($3, $1); }
+    ;
+
+parameter:
+    optional_modifiers RIZZ IDENTIFIER
+        { $$ = create_declaration_node(TYPE_INT, $3, create_number_node(0)); }
+    | optional_modifiers CHAD IDENTIFIER
+        { $$ = create_declaration_node(TYPE_FLOAT, $3, create_float_node(0.0f)); }
+    | optional_modifiers YAP IDENTIFIER
+        { $$ = create_declaration_node(TYPE_CHAR, $3, create_char_node(0)); }
+    | optional_modifiers CAP IDENTIFIER
+        {
+            current_modifiers.is_boolean = true;
+            $$ = create_declaration_node(TYPE_BOOL, $3, create_boolean_node(0));
+        }
+    | optional_modifiers LONG IDENTIFIER
+        { $$ = create_declaration_node(TYPE_LONG, $3, create_long_node(0)); }
+    | optional_modifiers SHORT IDENTIFIER
+        { $$ = create_declaration_node(TYPE_SHORT, $3, create_number_node(0)); }
+    | optional_modifiers DOUBLE IDENTIFIER
+        { $$ = create_declaration_node(TYPE_DOUBLE, $3, create_float_node(0.0)); }
+    ;
+
 statements:
       /* empty */
         { $$ = NULL; }
@@ -146,7 +172,7 @@ statement:
         { $$ = $1; }
     | while_statement
         { $$ = $1; }
-    | function_call SEMICOLON
+    | do_while_statement
         { $$ = $1; }
     | error_statement SEMICOLON
         { $$ = $1; }
@@ -158,6 +184,8 @@ statement:
         { $$ = $1; }
     | break_statement SEMICOLON
         { $$ = $1; }
+    | continue_statement SEMICOLON
+        { $$ = $1; }
     | expression SEMICOLON
         { $$ = $1; }
     ;
@@ -186,6 +214,11 @@ break_statement:
         { $$ = create_break_node(); }
     ;  
 
+continue_statement:
+    CONTINUE
+        { $$ = create_continue_node(); }
+    ;
+
 if_statement:
       IF LPAREN expression RPAREN LBRACE statements RBRACE %prec LOWER_THAN_ELSE
         { $$ = create_if_statement_node($3, $6, NULL); }
@@ -197,27 +230,56 @@ if_statement:
 
 declaration:
     optional_modifiers RIZZ IDENTIFIER
-        { $$ = create_assignment_node($3, create_number_node(0)); }
+        { $$ = create_declaration_node(TYPE_INT, $3, create_number_node(0)); }
     | optional_modifiers RIZZ IDENTIFIER EQUALS expression
-        { $$ = create_assignment_node($3, $5); }
+        { $$ = create_declaration_node(TYPE_INT, $3, $5); }
     | optional_modifiers CHAD IDENTIFIER
-        { $$ = create_assignment_node($3, create_float_node(0.0f)); }
+        { $$ = create_declaration_node(TYPE_FLOAT, $3, create_float_node(0.0f)); }
     | optional_modifiers CHAD IDENTIFIER EQUALS expression
-        { $$ = create_assignment_node($3, $5); }
+        { $$ = create_declaration_node(TYPE_FLOAT, $3, $5); }
     |  optional_modifiers YAP IDENTIFIER
-        { $$ = create_assignment_node($3, create_char_node(0)); }
+        { $$ = create_declaration_node(TYPE_CHAR, $3, create_char_node(0)); }
     | optional_modifiers YAP IDENTIFIER EQUALS expression
-        { $$ = create_assignment_node($3, $5); }
+        { $$ = create_declaration_node(TYPE_CHAR, $3, $5); }
     | optional_modifiers CAP IDENTIFIER
         { 
             current_modifiers.is_boolean = true; 
-            $$ = create_assignment_node($3, create_boolean_node(0)); 
+            $$ = create_declaration_node(TYPE_BOOL, $3, create_boolean_node(0)); 
         }
     | optional_modifiers CAP IDENTIFIER EQUALS expression
         { 
             current_modifiers.is_boolean = true; 
-            $$ = create_assignment_node($3, $5); 
+            $$ = create_declaration_node(TYPE_BOOL, $3, $5); 
         }
+    | optional_modifiers RIZZ IDENTIFIER LBRACKET expression RBRACKET
+        { $$ = create_array_declaration_node(TYPE_INT, $3, $5); }
+    | optional_modifiers CHAD IDENTIFIER LBRACKET expression RBRACKET
+        { $$ = create_array_declaration_node(TYPE_FLOAT, $3, $5); }
+    | optional_modifiers YAP IDENTIFIER LBRACKET expression RBRACKET
+        { $$ = create_array_declaration_node(TYPE_CHAR, $3, $5); }
+    | optional_modifiers CAP IDENTIFIER LBRACKET expression RBRACKET
+        {
+            current_modifiers.is_boolean = true;
+            $$ = create_array_declaration_node(TYPE_BOOL, $3, $5);
+        }
+    | optional_modifiers LONG IDENTIFIER
+        { $$ = create_declaration_node(TYPE_LONG, $3, create_long_node(0)); }
+    | optional_modifiers LONG IDENTIFIER EQUALS expression
+        { $$ = create_declaration_node(TYPE_LONG, $3, $5); }
+    | optional_modifiers SHORT IDENTIFIER
+        { $$ = create_declaration_node(TYPE_SHORT, $3, create_number_node(0)); }
+    | optional_modifiers SHORT IDENTIFIER EQUALS expression
+        { $$ = create_declaration_node(TYPE_SHORT, $3, $5); }
+    | optional_modifiers DOUBLE IDENTIFIER
+        { $$ = create_declaration_node(TYPE_DOUBLE, $3, create_float_node(0.0)); }
+    | optional_modifiers DOUBLE IDENTIFIER EQUALS expression
+        { $$ = create_declaration_node(TYPE_DOUBLE, $3, $5); }
+    | optional_modifiers LONG IDENTIFIER LBRACKET expression RBRACKET
+        { $$ = create_array_declaration_node(TYPE_LONG, $3, $5); }
+    | optional_modifiers SHORT IDENTIFIER LBRACKET expression RBRACKET
+        { $$ = create_array_declaration_node(TYPE_SHORT, $3, $5); }
+    | optional_modifiers DOUBLE IDENTIFIER LBRACKET expression RBRACKET
+        { $$ = create_array_declaration_node(TYPE_DOUBLE, $3, $5); }
     ;
 
 optional_modifiers:
@@ -236,6 +298,8 @@ modifier:
         { current_modifiers.is_unsigned = true; }
     | CAP
         { current_modifiers.is_boolean = true; } 
+    | CONST
+        { current_modifiers.is_const = true; }
     ;
 
 for_statement:
@@ -252,6 +316,13 @@ while_statement:
         }
     ;
 
+do_while_statement:
+    DO LBRACE statements RBRACE GOON LPAREN expression RPAREN SEMICOLON
+        {
+            $$ = create_do_while_statement_node($3, $7);
+        }
+    ;
+
 
 init_expr:
       declaration
@@ -307,16 +378,22 @@ argument_list
 error_statement:
     BAKA LPAREN expression RPAREN
         { $$ = create_error_statement_node($3); }
+    | BAKA LPAREN expression COMMA argument_list RPAREN
+        { $$ = create_function_call_node(ATOM_BAKA, prepend_argument($3, $5)); }
     ;
 
 return_statement:
     BUSSIN expression
-        { $$ = $2; }
+        { $$ = create_return_node($2); }
+    | BUSSIN
+        { $$ = create_return_node(NULL); }
     ;
 
 expression:
       NUMBER
         { $$ = create_number_node($1); }
+    | LONG_LITERAL
+        { $$ = create_long_node($1); }
     | FLOAT_LITERAL
         { $$ = create_float_node($1); } 
     | CHAR
@@ -325,10 +402,16 @@ expression:
         { $$ = create_boolean_node($1); }
     | IDENTIFIER
         { $$ = create_identifier_node($1); }
+    | function_call
+        { $$ = $1; }
     | SIZEOF LPAREN IDENTIFIER RPAREN
         { $$ = create_sizeof_node($3); }
     | IDENTIFIER EQUALS expression
         { $$ = create_assignment_node($1, $3); }
+    | IDENTIFIER LBRACKET expression RBRACKET
+        { $$ = create_index_node($1, $3); }
+    | IDENTIFIER LBRACKET expression RBRACKET EQUALS expression
+        { $$ = create_index_assignment_node($1, $3, $6); }
     | expression PLUS expression
         { $$ = create_operation_node(OP_PLUS, $1, $3); }
     | expression MINUS expression
@@ -365,45 +448,52 @@ expression:
 
 %%
 
-int main(void) {
-    if (yyparse() == 0) {
-        execute_statement(root);
+/*
+ * Parse the source this thread's scanner was pointed at into a new
+ * program, which becomes the current one, or return NULL on a syntax
+ * error
+ */
+Program *parse_program(void) {
+    Program *program = create_program();
+    current_program = program;
+    reset_modifiers();
+
+    if (yyparse() != 0) {
+        free_program(program);
+        return NULL;
     }
-    return 0;
+    program->line = lex_line();
+    return program;
 }
 
 void yyerror(const char *s) {
-    fprintf(stderr, "Error: %s at line %d\n", s, yylineno);
+    // The scanner's line while parsing, afterwards the program's last line
+    int line = lex_line();
+    if (line == 0 && current_program) {
+        line = current_program->line;
+    }
+    output_printf(OUTPUT_STDERR, "Error: %s at line %d\n", s, line);
 }
 
 void yapping(const char* format, ...) {
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    output_vprintf(OUTPUT_STDOUT, format, args);
     va_end(args);
-    printf("\n");
+    output_write(OUTPUT_STDOUT, "\n", 1);
 }
 
 void yappin(const char* format, ...) {
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    output_vprintf(OUTPUT_STDOUT, format, args);
     va_end(args);
 }
 
 void baka(const char* format, ...) {
     va_list args;
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    output_vprintf(OUTPUT_STDERR, format, args);
     va_end(args);
 }
 
-TypeModifiers get_variable_modifiers(const char* name) {
-    TypeModifiers mods = {false, false, false};  // Default modifiers
-    for (int i = 0; i < var_count; i++) {
-        if (strcmp(symbol_table[i].name, name) == 0) {
-            return symbol_table[i].modifiers;
-        }
-    }
-    return mods;  // Return default modifiers if not found
-}
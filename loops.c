@@ -0,0 +1,948 @@
+/* loops.c */
+
+#include "loops.h"
+#include "vector.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MAX_REDUCTIONS 8
+
+/* Number of hidden variables created so far, used to name them */
+static _Thread_local int temporary_count;
+
+/* A strength-reduced `i * factor`, replaced by a variable stepped with i */
+typedef struct
+{
+    int factor;
+    int slot;
+} Reduction;
+
+static bool is_binary(NodeType type)
+{
+    return type >= NODE_INT_ADD && type <= NODE_LOGICAL_OR && type != NODE_INT_NEG && type != NODE_FLOAT_NEG;
+}
+
+static bool is_unary(NodeType type)
+{
+    return type == NODE_INT_NEG || type == NODE_FLOAT_NEG || (type >= NODE_LONG_NEG && type <= NODE_DOUBLE_TO_BOOL);
+}
+
+static bool is_constant(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+    case NODE_FLOAT:
+    case NODE_LONG:
+    case NODE_DOUBLE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool is_identifier(ASTNode *node, int slot)
+{
+    return node && node->type == NODE_IDENTIFIER && node->slot == slot;
+}
+
+/* Mark every variable assigned anywhere inside node */
+static void collect_assigned(ASTNode *node, bool *assigned)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        assigned[node->data.op.left->slot] = true;
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            collect_assigned(sl->statement, assigned);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        collect_assigned(node->data.for_stmt.init, assigned);
+        collect_assigned(node->data.for_stmt.incr, assigned);
+        collect_assigned(node->data.for_stmt.body, assigned);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        collect_assigned(node->data.while_stmt.body, assigned);
+        break;
+    case NODE_IF_STATEMENT:
+        collect_assigned(node->data.if_stmt.then_branch, assigned);
+        collect_assigned(node->data.if_stmt.else_branch, assigned);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            collect_assigned(cn->statements, assigned);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Division and modulo report an error unless the divisor is a nonzero constant */
+static bool may_fail(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_INT_DIV:
+    case NODE_INT_MOD:
+    case NODE_UNSIGNED_DIV:
+    case NODE_UNSIGNED_MOD:
+        return node->data.op.right->type != NODE_NUMBER || node->data.op.right->data.value == 0;
+    case NODE_FLOAT_DIV:
+        return node->data.op.right->type != NODE_FLOAT || node->data.op.right->data.fvalue == 0.0f;
+    case NODE_LONG_DIV:
+    case NODE_LONG_MOD:
+        return node->data.op.right->type != NODE_LONG || node->data.op.right->data.lvalue == 0;
+    case NODE_DOUBLE_DIV:
+        return node->data.op.right->type != NODE_DOUBLE || node->data.op.right->data.dvalue == 0.0;
+    default:
+        return false;
+    }
+}
+
+/* True if node reads no variable in assigned and can be evaluated early */
+static bool is_invariant(ASTNode *node, const bool *assigned)
+{
+    if (node->type == NODE_IDENTIFIER)
+        return !assigned[node->slot];
+    if (is_constant(node))
+        return true;
+    if (is_binary(node->type))
+        return !may_fail(node) && is_invariant(node->data.op.left, assigned) &&
+               is_invariant(node->data.op.right, assigned);
+    if (is_unary(node->type))
+        return is_invariant(node->data.unary.operand, assigned);
+    return false;
+}
+
+/* Register a hidden variable; returns its slot, or -1 if the table is full */
+static int new_temporary(ValueType type)
+{
+    if (var_count >= MAX_VARS)
+        return -1;
+
+    /* '$' cannot start an identifier, so the name never clashes */
+    char name[32];
+    snprintf(name, sizeof(name), "$loop%d", temporary_count++);
+    int slot = define_variable_slot(intern(ast_atoms, name, strlen(name)));
+
+    variable *var = &symbol_table[slot];
+    var->type = type;
+    var->modifiers.is_unsigned = type == TYPE_UNSIGNED;
+    var->modifiers.is_boolean = type == TYPE_BOOL;
+    return slot;
+}
+
+static ASTNode *read_variable(int slot)
+{
+    ASTNode *node = create_identifier_node(symbol_table[slot].atom);
+    node->slot = slot;
+    node->value_type = symbol_table[slot].type;
+    return node;
+}
+
+static ASTNode *store_variable(int slot, ASTNode *value)
+{
+    ASTNode *node = create_assignment_node(symbol_table[slot].atom, value);
+    node->data.op.left->slot = slot;
+    node->data.op.left->value_type = symbol_table[slot].type;
+    node->value_type = symbol_table[slot].type;
+    return node;
+}
+
+static ASTNode *typed_number(int value, ValueType type)
+{
+    ASTNode *node = create_number_node(value);
+    node->value_type = type;
+    return node;
+}
+
+/* Append a statement to a possibly empty statement list */
+static ASTNode *append_statement(ASTNode *list, ASTNode *statement)
+{
+    return statement ? create_statement_list(statement, list) : list;
+}
+
+/*
+ * Replace the largest invariant subexpressions under *expression with
+ * hidden variables assigned in the preheader.
+ */
+static void hoist_expression(ASTNode **expression, const bool *assigned, ASTNode **preheader)
+{
+    ASTNode *node = *expression;
+    if (!node || (!is_binary(node->type) && !is_unary(node->type)))
+        return;
+
+    if (is_invariant(node, assigned))
+    {
+        int slot = new_temporary(node->value_type);
+        if (slot >= 0)
+        {
+            *preheader = append_statement(*preheader, store_variable(slot, node));
+            *expression = read_variable(slot);
+        }
+        return;
+    }
+
+    if (is_binary(node->type))
+    {
+        hoist_expression(&node->data.op.left, assigned, preheader);
+        hoist_expression(&node->data.op.right, assigned, preheader);
+    }
+    else
+    {
+        hoist_expression(&node->data.unary.operand, assigned, preheader);
+    }
+}
+
+static void hoist_statement(ASTNode *node, const bool *assigned, ASTNode **preheader)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        hoist_expression(&node->data.op.right, assigned, preheader);
+        break;
+    case NODE_FUNC_CALL:
+        for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+        {
+            hoist_expression(&arg->expr, assigned, preheader);
+        }
+        break;
+    case NODE_PRINT_STATEMENT:
+    case NODE_ERROR_STATEMENT:
+    case NODE_RETURN:
+        hoist_expression(&node->data.op.left, assigned, preheader);
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            hoist_statement(sl->statement, assigned, preheader);
+        }
+        break;
+    case NODE_IF_STATEMENT:
+        hoist_expression(&node->data.if_stmt.condition, assigned, preheader);
+        hoist_statement(node->data.if_stmt.then_branch, assigned, preheader);
+        hoist_statement(node->data.if_stmt.else_branch, assigned, preheader);
+        break;
+    case NODE_FOR_STATEMENT:
+        hoist_statement(node->data.for_stmt.init, assigned, preheader);
+        hoist_expression(&node->data.for_stmt.cond, assigned, preheader);
+        hoist_statement(node->data.for_stmt.incr, assigned, preheader);
+        hoist_statement(node->data.for_stmt.body, assigned, preheader);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        hoist_expression(&node->data.while_stmt.cond, assigned, preheader);
+        hoist_statement(node->data.while_stmt.body, assigned, preheader);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        hoist_expression(&node->data.switch_stmt.expression, assigned, preheader);
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            hoist_statement(cn->statements, assigned, preheader);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * The counter of a `flex` loop whose increment is `i = i + c` or
+ * `i = i - c` on an int or unsigned variable, or -1. *step receives the
+ * signed amount added per iteration.
+ */
+static int induction_variable(ASTNode *node, int *step)
+{
+    ASTNode *incr = node->data.for_stmt.incr;
+    if (!incr || incr->type != NODE_ASSIGNMENT)
+        return -1;
+
+    int slot = incr->data.op.left->slot;
+    ValueType type = symbol_table[slot].type;
+    ASTNode *value = incr->data.op.right;
+    if ((type != TYPE_INT && type != TYPE_UNSIGNED) || symbol_table[slot].modifiers.is_volatile)
+        return -1;
+    if ((value->type != NODE_INT_ADD && value->type != NODE_INT_SUB) || !is_identifier(value->data.op.left, slot) ||
+        value->data.op.right->type != NODE_NUMBER)
+        return -1;
+
+    int amount = value->data.op.right->data.value;
+    *step = value->type == NODE_INT_ADD ? amount : (int)(0u - (unsigned int)amount);
+    return slot;
+}
+
+/*
+ * Replace `i * c` and `c * i` under *expression with a variable that the
+ * loop increment keeps equal to it. The first occurrence of each factor
+ * moves its multiplication into the preheader as the initial value.
+ */
+static void reduce_expression(ASTNode **expression, int induction, Reduction *reductions, int *count,
+                              ASTNode **preheader)
+{
+    ASTNode *node = *expression;
+    if (!node)
+        return;
+
+    if (node->type == NODE_INT_MUL)
+    {
+        ASTNode *factor = NULL;
+        if (is_identifier(node->data.op.left, induction) && node->data.op.right->type == NODE_NUMBER)
+            factor = node->data.op.right;
+        else if (is_identifier(node->data.op.right, induction) && node->data.op.left->type == NODE_NUMBER)
+            factor = node->data.op.left;
+
+        if (factor)
+        {
+            for (int i = 0; i < *count; i++)
+            {
+                if (reductions[i].factor == factor->data.value &&
+                    symbol_table[reductions[i].slot].type == node->value_type)
+                {
+                    *expression = read_variable(reductions[i].slot);
+                    return;
+                }
+            }
+            if (*count < MAX_REDUCTIONS)
+            {
+                int slot = new_temporary(node->value_type);
+                if (slot >= 0)
+                {
+                    reductions[*count].factor = factor->data.value;
+                    reductions[*count].slot = slot;
+                    (*count)++;
+                    *preheader = append_statement(*preheader, store_variable(slot, node));
+                    *expression = read_variable(slot);
+                }
+            }
+            return;
+        }
+    }
+
+    if (is_binary(node->type))
+    {
+        reduce_expression(&node->data.op.left, induction, reductions, count, preheader);
+        reduce_expression(&node->data.op.right, induction, reductions, count, preheader);
+    }
+    else if (is_unary(node->type))
+    {
+        reduce_expression(&node->data.unary.operand, induction, reductions, count, preheader);
+    }
+}
+
+static void reduce_statement(ASTNode *node, int induction, Reduction *reductions, int *count, ASTNode **preheader)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        reduce_expression(&node->data.op.right, induction, reductions, count, preheader);
+        break;
+    case NODE_FUNC_CALL:
+        for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+        {
+            reduce_expression(&arg->expr, induction, reductions, count, preheader);
+        }
+        break;
+    case NODE_PRINT_STATEMENT:
+    case NODE_ERROR_STATEMENT:
+    case NODE_RETURN:
+        reduce_expression(&node->data.op.left, induction, reductions, count, preheader);
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            reduce_statement(sl->statement, induction, reductions, count, preheader);
+        }
+        break;
+    case NODE_IF_STATEMENT:
+        reduce_expression(&node->data.if_stmt.condition, induction, reductions, count, preheader);
+        reduce_statement(node->data.if_stmt.then_branch, induction, reductions, count, preheader);
+        reduce_statement(node->data.if_stmt.else_branch, induction, reductions, count, preheader);
+        break;
+    case NODE_FOR_STATEMENT:
+        reduce_statement(node->data.for_stmt.init, induction, reductions, count, preheader);
+        reduce_expression(&node->data.for_stmt.cond, induction, reductions, count, preheader);
+        reduce_statement(node->data.for_stmt.incr, induction, reductions, count, preheader);
+        reduce_statement(node->data.for_stmt.body, induction, reductions, count, preheader);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        reduce_expression(&node->data.while_stmt.cond, induction, reductions, count, preheader);
+        reduce_statement(node->data.while_stmt.body, induction, reductions, count, preheader);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        reduce_expression(&node->data.switch_stmt.expression, induction, reductions, count, preheader);
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            reduce_statement(cn->statements, induction, reductions, count, preheader);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Strength-reduce multiplications of the loop counter. The initial
+ * values are computed after the loop's own initialization, so that moves
+ * into the preheader too.
+ */
+static void strength_reduce(ASTNode *node, ASTNode **preheader)
+{
+    int step;
+    int induction = induction_variable(node, &step);
+    if (induction < 0)
+        return;
+
+    bool body_assigned[MAX_VARS] = {false};
+    collect_assigned(node->data.for_stmt.body, body_assigned);
+    if (body_assigned[induction])
+        return;
+
+    Reduction reductions[MAX_REDUCTIONS];
+    int count = 0;
+    ASTNode *initial = NULL;
+    reduce_expression(&node->data.for_stmt.cond, induction, reductions, &count, &initial);
+    reduce_statement(node->data.for_stmt.body, induction, reductions, &count, &initial);
+    if (count == 0)
+        return;
+
+    *preheader = append_statement(*preheader, node->data.for_stmt.init);
+    node->data.for_stmt.init = NULL;
+    for (StatementList *sl = initial->data.statements; sl; sl = sl->next)
+    {
+        *preheader = append_statement(*preheader, sl->statement);
+    }
+
+    ASTNode *incr = create_statement_list(node->data.for_stmt.incr, NULL);
+    for (int i = 0; i < count; i++)
+    {
+        int slot = reductions[i].slot;
+        ValueType type = symbol_table[slot].type;
+        int delta = (int)((unsigned int)step * (unsigned int)reductions[i].factor);
+        ASTNode *sum = create_operation_node(OP_PLUS, read_variable(slot), typed_number(delta, type));
+        sum->type = NODE_INT_ADD;
+        sum->value_type = type;
+        incr = append_statement(incr, store_variable(slot, sum));
+    }
+    node->data.for_stmt.incr = incr;
+}
+
+long long loop_trip_count(NodeType comparison, long long start, long long bound, long long step)
+{
+    long long trips;
+    switch (comparison)
+    {
+    case NODE_INT_LT:
+        if (step <= 0)
+            return -1;
+        trips = start < bound ? (bound - start + step - 1) / step : 0;
+        break;
+    case NODE_INT_LE:
+        if (step <= 0)
+            return -1;
+        trips = start <= bound ? (bound - start) / step + 1 : 0;
+        break;
+    case NODE_INT_GT:
+        if (step >= 0)
+            return -1;
+        trips = start > bound ? (start - bound - step - 1) / -step : 0;
+        break;
+    case NODE_INT_GE:
+        if (step >= 0)
+            return -1;
+        trips = start >= bound ? (start - bound) / -step + 1 : 0;
+        break;
+    case NODE_INT_NE:
+        if (step == 0 || (bound - start) % step != 0 || (bound - start) / step < 0)
+            return -1;
+        trips = (bound - start) / step;
+        break;
+    default:
+        return -1;
+    }
+
+    long long last = start + trips * step;
+    if (last < INT_MIN || last > INT_MAX)
+        return -1;
+    return trips;
+}
+
+/* An accumulation `acc = acc + term` or `acc = acc - term` the closed form can replace */
+static bool is_accumulation(ASTNode *node, int induction, bool *seen)
+{
+    if (!node || node->type != NODE_ASSIGNMENT)
+        return false;
+
+    int slot = node->data.op.left->slot;
+    ValueType type = symbol_table[slot].type;
+    ASTNode *value = node->data.op.right;
+    if (slot == induction || seen[slot] || symbol_table[slot].modifiers.is_volatile)
+        return false;
+    if (type != TYPE_INT && type != TYPE_UNSIGNED)
+        return false;
+    if ((value->type != NODE_INT_ADD && value->type != NODE_INT_SUB) || !is_identifier(value->data.op.left, slot))
+        return false;
+    if (value->data.op.right->type != NODE_NUMBER && !is_identifier(value->data.op.right, induction))
+        return false;
+
+    seen[slot] = true;
+    return true;
+}
+
+/*
+ * Replace a counting loop whose body only accumulates constants or the
+ * counter with straight-line assignments of the final values. Integer
+ * arithmetic wraps, so the totals are computed modulo 2^32.
+ */
+static ASTNode *closed_form(ASTNode *node)
+{
+    ASTNode *init = node->data.for_stmt.init;
+    ASTNode *cond = node->data.for_stmt.cond;
+    ASTNode *body = node->data.for_stmt.body;
+    int step;
+    int induction = induction_variable(node, &step);
+
+    if (induction < 0 || symbol_table[induction].type != TYPE_INT || !init || init->type != NODE_ASSIGNMENT ||
+        init->data.op.left->slot != induction || init->data.op.right->type != NODE_NUMBER || !cond ||
+        cond->type < NODE_INT_LT || cond->type > NODE_INT_NE || !is_identifier(cond->data.op.left, induction) ||
+        cond->data.op.right->type != NODE_NUMBER)
+        return NULL;
+
+    if (body && body->type != NODE_STATEMENT_LIST)
+        body = create_statement_list(body, NULL);
+
+    bool seen[MAX_VARS] = {false};
+    for (StatementList *sl = body ? body->data.statements : NULL; sl; sl = sl->next)
+    {
+        if (!is_accumulation(sl->statement, induction, seen))
+            return NULL;
+    }
+
+    long long start = init->data.op.right->data.value;
+    long long trips = loop_trip_count(cond->type, start, cond->data.op.right->data.value, step);
+    if (trips < 0)
+        return NULL;
+
+    /* The counter takes the values start, start + step, ... */
+    unsigned long long count = (unsigned long long)trips & 0xffffffffu;
+    unsigned long long pairs = (trips % 2 == 0 ? (unsigned long long)(trips / 2) * (unsigned long long)(trips - 1)
+                                               : (unsigned long long)trips * (unsigned long long)((trips - 1) / 2));
+    unsigned int counter_sum = (unsigned int)(count * (unsigned int)start + (pairs & 0xffffffffu) * (unsigned int)step);
+
+    ASTNode *result = NULL;
+    for (StatementList *sl = body && trips > 0 ? body->data.statements : NULL; sl; sl = sl->next)
+    {
+        ASTNode *value = sl->statement->data.op.right;
+        unsigned int total = value->data.op.right->type == NODE_NUMBER
+                                 ? (unsigned int)count * (unsigned int)value->data.op.right->data.value
+                                 : counter_sum;
+        value->data.op.right = typed_number((int)total, value->value_type);
+        result = append_statement(result, sl->statement);
+    }
+
+    init->data.op.right = typed_number((int)(start + trips * step), TYPE_INT);
+    return append_statement(result, init);
+}
+
+/*
+ * What the declarations and assignments of the program tell about the
+ * length of each array, and which of them the top-level statements run so
+ * far have executed.
+ */
+typedef struct
+{
+    int assignments[MAX_VARS];  /* Of each scalar, anywhere in the program */
+    int declarations[MAX_VARS]; /* Of each array, anywhere in the program */
+    bool fixed[MAX_VARS];       /* Every declaration gives the array the same literal length */
+    int length[MAX_VARS];
+    int length_of[MAX_VARS];    /* Variable whose value is the array's length for good, or -1 */
+    bool assigned[MAX_VARS];    /* By a top-level statement already run */
+    bool declared[MAX_VARS];
+} ArrayFacts;
+
+/* The values a loop counter takes in the loop body */
+typedef struct
+{
+    int induction;
+    long long first;
+    long long last;  /* Unless bound is set */
+    int bound;       /* Variable the counter stays below, or -1 */
+} CounterRange;
+
+static void count_definitions(ASTNode *node, ArrayFacts *facts)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        facts->assignments[node->data.op.left->slot]++;
+        break;
+    case NODE_ARRAY_DECLARATION:
+    {
+        int slot = node->slot;
+        ASTNode *length = node->data.element.index;
+        bool literal = length->type == NODE_NUMBER;
+        if (facts->declarations[slot]++ == 0)
+        {
+            facts->fixed[slot] = literal;
+            facts->length[slot] = literal ? length->data.value : 0;
+        }
+        else if (!literal || length->data.value != facts->length[slot])
+        {
+            facts->fixed[slot] = false;
+        }
+        break;
+    }
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            count_definitions(sl->statement, facts);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        count_definitions(node->data.for_stmt.init, facts);
+        count_definitions(node->data.for_stmt.incr, facts);
+        count_definitions(node->data.for_stmt.body, facts);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        count_definitions(node->data.while_stmt.body, facts);
+        break;
+    case NODE_IF_STATEMENT:
+        count_definitions(node->data.if_stmt.then_branch, facts);
+        count_definitions(node->data.if_stmt.else_branch, facts);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            count_definitions(cn->statements, facts);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Record what a top-level statement leaves behind once it has run */
+static void record_top_level(ASTNode *node, ArrayFacts *facts)
+{
+    if (node->type == NODE_ASSIGNMENT)
+    {
+        facts->assigned[node->data.op.left->slot] = true;
+    }
+    else if (node->type == NODE_ARRAY_DECLARATION)
+    {
+        int slot = node->slot;
+        ASTNode *length = node->data.element.index;
+        facts->declared[slot] = true;
+        if (length->type == NODE_IDENTIFIER && facts->declarations[slot] == 1 && facts->assigned[length->slot] &&
+            facts->assignments[length->slot] == 1)
+            facts->length_of[slot] = length->slot;
+    }
+}
+
+/* The constant k when index is `i`, `i + k`, `k + i` or `i - k` for the counter i */
+static bool counter_offset(ASTNode *index, int induction, long long *offset)
+{
+    if (is_identifier(index, induction))
+    {
+        *offset = 0;
+        return true;
+    }
+    if (index->type != NODE_INT_ADD && index->type != NODE_INT_SUB)
+        return false;
+
+    ASTNode *left = index->data.op.left;
+    ASTNode *right = index->data.op.right;
+    if (is_identifier(left, induction) && right->type == NODE_NUMBER)
+    {
+        *offset = index->type == NODE_INT_ADD ? right->data.value : -(long long)right->data.value;
+        return true;
+    }
+    if (index->type == NODE_INT_ADD && left->type == NODE_NUMBER && is_identifier(right, induction))
+    {
+        *offset = left->data.value;
+        return true;
+    }
+    return false;
+}
+
+/* True if the index of an element node stays inside its array on every iteration */
+static bool in_range(ASTNode *node, const CounterRange *range, const ArrayFacts *facts)
+{
+    long long offset;
+    int slot = node->slot;
+    if (!counter_offset(node->data.element.index, range->induction, &offset) || range->first + offset < 0)
+        return false;
+    if (range->bound >= 0)
+        return facts->length_of[slot] == range->bound && offset <= 0;
+    return facts->declared[slot] && facts->fixed[slot] && range->last + offset < facts->length[slot];
+}
+
+/* Drop the bounds check of every element access under node that in_range proves */
+static void mark_in_range(ASTNode *node, const CounterRange *range, const ArrayFacts *facts)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_INDEX:
+    case NODE_INDEX_ASSIGNMENT:
+        if (in_range(node, range, facts))
+            node->data.element.unchecked = true;
+        mark_in_range(node->data.element.index, range, facts);
+        mark_in_range(node->data.element.value, range, facts);
+        break;
+    case NODE_ARRAY_DECLARATION:
+        mark_in_range(node->data.element.index, range, facts);
+        break;
+    case NODE_ASSIGNMENT:
+        mark_in_range(node->data.op.right, range, facts);
+        break;
+    case NODE_FUNC_CALL:
+        for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+        {
+            mark_in_range(arg->expr, range, facts);
+        }
+        break;
+    case NODE_PRINT_STATEMENT:
+    case NODE_ERROR_STATEMENT:
+    case NODE_RETURN:
+        mark_in_range(node->data.op.left, range, facts);
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            mark_in_range(sl->statement, range, facts);
+        }
+        break;
+    case NODE_IF_STATEMENT:
+        mark_in_range(node->data.if_stmt.condition, range, facts);
+        mark_in_range(node->data.if_stmt.then_branch, range, facts);
+        mark_in_range(node->data.if_stmt.else_branch, range, facts);
+        break;
+    case NODE_FOR_STATEMENT:
+        mark_in_range(node->data.for_stmt.init, range, facts);
+        mark_in_range(node->data.for_stmt.cond, range, facts);
+        mark_in_range(node->data.for_stmt.incr, range, facts);
+        mark_in_range(node->data.for_stmt.body, range, facts);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        mark_in_range(node->data.while_stmt.cond, range, facts);
+        mark_in_range(node->data.while_stmt.body, range, facts);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        mark_in_range(node->data.switch_stmt.expression, range, facts);
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            mark_in_range(cn->statements, range, facts);
+        }
+        break;
+    default:
+        if (is_binary(node->type))
+        {
+            mark_in_range(node->data.op.left, range, facts);
+            mark_in_range(node->data.op.right, range, facts);
+        }
+        else if (is_unary(node->type))
+        {
+            mark_in_range(node->data.unary.operand, range, facts);
+        }
+        break;
+    }
+}
+
+/*
+ * In `flex (i = first; i < bound; i = i + step)`, with `<=` allowed for a
+ * constant bound and i assigned nowhere in the body, i stays between first
+ * and the last value below the bound in the body. An access `a[i + k]`
+ * there is in range without a check when a has a fixed length that covers
+ * it, or when a's length is the bound itself and k <= 0. The step must not
+ * let the counter wrap past the bound.
+ */
+static void eliminate_bounds_checks(ASTNode *node, const ArrayFacts *facts)
+{
+    ASTNode *init = node->data.for_stmt.init;
+    ASTNode *cond = node->data.for_stmt.cond;
+    int step;
+    int induction = induction_variable(node, &step);
+
+    if (induction < 0 || symbol_table[induction].type != TYPE_INT || step <= 0 || !init ||
+        init->type != NODE_ASSIGNMENT || init->data.op.left->slot != induction ||
+        init->data.op.right->type != NODE_NUMBER || !cond ||
+        (cond->type != NODE_INT_LT && cond->type != NODE_INT_LE) || !is_identifier(cond->data.op.left, induction))
+        return;
+
+    bool assigned[MAX_VARS] = {false};
+    collect_assigned(node->data.for_stmt.body, assigned);
+    if (assigned[induction])
+        return;
+
+    CounterRange range = {induction, init->data.op.right->data.value, 0, -1};
+    ASTNode *bound = cond->data.op.right;
+    if (bound->type == NODE_NUMBER)
+    {
+        range.last = cond->type == NODE_INT_LT ? (long long)bound->data.value - 1 : bound->data.value;
+        if (range.last + step > INT_MAX)
+            return;
+    }
+    else if (bound->type == NODE_IDENTIFIER && cond->type == NODE_INT_LT && step == 1 && !assigned[bound->slot])
+    {
+        range.bound = bound->slot;
+    }
+    else
+    {
+        return;
+    }
+    mark_in_range(node->data.for_stmt.body, &range, facts);
+}
+
+/* Apply eliminate_bounds_checks to every `flex` loop under node */
+static void find_counting_loops(ASTNode *node, const ArrayFacts *facts)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            find_counting_loops(sl->statement, facts);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        eliminate_bounds_checks(node, facts);
+        find_counting_loops(node->data.for_stmt.body, facts);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        find_counting_loops(node->data.while_stmt.body, facts);
+        break;
+    case NODE_IF_STATEMENT:
+        find_counting_loops(node->data.if_stmt.then_branch, facts);
+        find_counting_loops(node->data.if_stmt.else_branch, facts);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            find_counting_loops(cn->statements, facts);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Top-level statements run in order, each once, so an array declared by
+ * an earlier one has been given its length by the time a later one runs.
+ */
+static void eliminate_program_bounds_checks(ASTNode *root)
+{
+    ArrayFacts *facts = calloc(1, sizeof(ArrayFacts));
+    memset(facts->length_of, 0xff, sizeof(facts->length_of));
+    count_definitions(root, facts);
+    for (StatementList *sl = root->data.statements; sl; sl = sl->next)
+    {
+        find_counting_loops(sl->statement, facts);
+        record_top_level(sl->statement, facts);
+    }
+    free(facts);
+}
+
+static ASTNode *optimize_statement(ASTNode *node);
+
+static ASTNode *optimize_loop(ASTNode *node)
+{
+    bool assigned[MAX_VARS] = {false};
+    ASTNode *preheader = NULL;
+
+    if (node->type == NODE_FOR_STATEMENT)
+    {
+        ASTNode *replacement = closed_form(node);
+        if (replacement)
+            return replacement;
+
+        collect_assigned(node, assigned);
+        hoist_expression(&node->data.for_stmt.cond, assigned, &preheader);
+        hoist_statement(node->data.for_stmt.incr, assigned, &preheader);
+        hoist_statement(node->data.for_stmt.body, assigned, &preheader);
+        // Blocks step the counter past strength-reduced temporaries
+        node->data.for_stmt.vector = vector_plan_loop(node);
+        if (!node->data.for_stmt.vector)
+            strength_reduce(node, &preheader);
+        node->data.for_stmt.body = optimize_statement(node->data.for_stmt.body);
+    }
+    else
+    {
+        collect_assigned(node, assigned);
+        hoist_expression(&node->data.while_stmt.cond, assigned, &preheader);
+        hoist_statement(node->data.while_stmt.body, assigned, &preheader);
+        node->data.while_stmt.body = optimize_statement(node->data.while_stmt.body);
+    }
+
+    return preheader ? append_statement(preheader, node) : node;
+}
+
+static ASTNode *optimize_statement(ASTNode *node)
+{
+    if (!node)
+        return NULL;
+
+    switch (node->type)
+    {
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            sl->statement = optimize_statement(sl->statement);
+        }
+        return node;
+    case NODE_FOR_STATEMENT:
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        return optimize_loop(node);
+    case NODE_IF_STATEMENT:
+        node->data.if_stmt.then_branch = optimize_statement(node->data.if_stmt.then_branch);
+        node->data.if_stmt.else_branch = optimize_statement(node->data.if_stmt.else_branch);
+        return node;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            cn->statements = optimize_statement(cn->statements);
+        }
+        return node;
+    default:
+        return node;
+    }
+}
+
+void optimize_loops(ASTNode *root)
+{
+    temporary_count = 0;
+    eliminate_program_bounds_checks(root);
+    optimize_statement(root);
+}
@@ -0,0 +1,31 @@
+/* loops.h */
+
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include "ast.h"
+
+/*
+ * Loop optimizations over a type-checked, constant-folded tree.
+ *
+ * Counting `flex` loops whose body only adds constants or the loop
+ * counter to integer accumulators are replaced by their closed form.
+ * Expressions inside `flex` and `goon` loops that read no variable the
+ * loop assigns, and that cannot fail, are computed once before the loop
+ * into hidden variables. Multiplications of a `flex` counter by a constant
+ * are strength-reduced to an addition in the increment. Element accesses
+ * in `flex` loops whose index provably stays inside the array lose their
+ * bounds check. Other counting loops with independent iterations are
+ * planned for batch execution (see vector.h). root is the program's
+ * statement list and is updated in place.
+ */
+void optimize_loops(ASTNode *root);
+
+/*
+ * Number of iterations of `flex (i = start; i OP bound; i = i + step)`
+ * for a signed counter, or -1 if it cannot be computed or the counter
+ * would overflow.
+ */
+long long loop_trip_count(NodeType comparison, long long start, long long bound, long long step);
+
+#endif /* LOOPS_H */
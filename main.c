@@ -0,0 +1,362 @@
+/* main.c */
+
+#include "ast.h"
+#include "batch.h"
+#include "brc.h"
+#include "compiler.h"
+#include "jit.h"
+#include "lang.tab.h"
+#include "optimize.h"
+#include "output.h"
+#include "resolve.h"
+#include "serve.h"
+#include "source.h"
+#include "transpile.h"
+#include "typecheck.h"
+#include "vm.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Defined in lang.y and lang.l */
+extern Program *parse_program(void);
+extern void yyerror(const char *s);
+extern int yylex(YYSTYPE *lval);
+
+static int usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--engine=tree|vm] [--jit] [-O0|-O1|-O2] [--unbuffered] [--buffer-size=BYTES]\n"
+                    "       %*s [--emit-c | --native | --compile-only | --lex-only] [-o FILE] [--cache] [FILE...]\n"
+                    "       %*s [--batch DIR|LIST | --serve SOCKET] [-j THREADS]\n",
+            program, (int)strlen(program), "", (int)strlen(program), "");
+    return 1;
+}
+
+/* How every program named on the command line is run */
+typedef struct
+{
+    bool use_vm;
+    int opt_level;
+    bool emit_c;
+    bool native;
+    bool compile_only;
+    bool use_cache;
+    bool lex_only;
+    const char *output_path;
+    const char *batch_path;
+    const char *socket_path;
+    int threads; /* 0 for one per processor */
+} Options;
+
+/* Run a compiled chunk loaded from a file, with a program to hold its variables */
+static void run_chunk(Chunk *chunk)
+{
+    Program *program = create_program();
+    program->line = chunk->line;
+    current_program = program;
+    vm_execute(chunk);
+    free_program(program);
+}
+
+/* Run, translate or compile one program; returns the exit status */
+static int run_source(const Options *options, Source *source)
+{
+    bool use_vm = options->use_vm;
+    bool translate = options->emit_c || options->native || options->compile_only;
+    if (options->lex_only)
+    {
+        // Only scan, to measure the scanner on its own
+        current_program = create_program();
+        YYSTYPE value;
+        source_scan(source);
+        while (yylex(&value) != 0)
+        {
+        }
+        source_end_scan();
+        free_program(current_program);
+        return 0;
+    }
+    if (brc_is_image(source->data, source->length) && !translate)
+    {
+        Chunk *chunk = brc_load(source->data, source->length, NULL);
+        if (!chunk)
+        {
+            yyerror("Invalid precompiled program");
+            return 1;
+        }
+        run_chunk(chunk);
+        brc_release(chunk);
+        return 0;
+    }
+
+    BrcSource identity = {0, source->length, options->opt_level};
+    char *cache_path = NULL;
+    if (options->use_cache || options->compile_only)
+    {
+        identity.hash = brc_hash(source->data, source->length);
+    }
+    if (options->use_cache)
+    {
+        cache_path = brc_cache_path(&identity);
+        Chunk *chunk = cache_path ? brc_load_file(cache_path, &identity) : NULL;
+        if (chunk)
+        {
+            free(cache_path);
+            run_chunk(chunk);
+            brc_release(chunk);
+            return 0;
+        }
+        use_vm = true;
+    }
+
+    // Identifiers and string literals point into the source, which
+    // therefore outlives the program
+    source_scan(source);
+    Program *program = parse_program();
+    source_end_scan();
+    if (!program)
+    {
+        // A run reports the syntax error and ends normally, but a
+        // translation or compilation that produced nothing has failed
+        free(cache_path);
+        return translate ? 1 : 0;
+    }
+    if (!resolve_program(program->root) || !typecheck_program(program->root))
+    {
+        free_program(program);
+        free(cache_path);
+        return 1;
+    }
+    optimize_program(program->root, options->opt_level);
+    if (options->emit_c || options->native)
+    {
+        bool translated;
+        if (options->native)
+        {
+            translated = build_native_program(program->root, options->output_path ? options->output_path : "a.out");
+        }
+        else if (options->output_path)
+        {
+            FILE *out = fopen(options->output_path, "w");
+            translated = out && emit_c_program(program->root, out);
+            if (!out)
+            {
+                yyerror("Cannot open output file");
+            }
+            else if (fclose(out) != 0)
+            {
+                translated = false;
+            }
+        }
+        else
+        {
+            translated = emit_c_program(program->root, stdout);
+        }
+        free_program(program);
+        return translated ? 0 : 1;
+    }
+    if (use_vm || options->compile_only)
+    {
+        Chunk *chunk = compile_program(program->root);
+        if (!chunk)
+        {
+            free_program(program);
+            free(cache_path);
+            return 1;
+        }
+        if (options->compile_only)
+        {
+            bool written = brc_write(chunk, &identity, options->output_path);
+            if (!written)
+            {
+                yyerror("Cannot write output file");
+            }
+            free_chunk(chunk);
+            free_program(program);
+            return written ? 0 : 1;
+        }
+        // A cache that cannot be written only costs the next run its speed
+        if (cache_path)
+        {
+            brc_write(chunk, &identity, cache_path);
+            free(cache_path);
+        }
+        vm_execute(chunk);
+        free_chunk(chunk);
+    }
+    else
+    {
+        execute_statement(program->root);
+    }
+    free_program(program);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Options options = {.opt_level = 2};
+    bool unbuffered = false;
+    bool use_tree = false; /* --engine=tree was asked for, not just left as the default */
+    size_t buffer_size = OUTPUT_DEFAULT_BUFFER_SIZE;
+    const char **paths = malloc(argc * sizeof(char *));
+    int path_count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--engine=vm") == 0)
+        {
+            options.use_vm = true;
+            use_tree = false;
+        }
+        else if (strcmp(argv[i], "--engine=tree") == 0)
+        {
+            options.use_vm = false;
+            use_tree = true;
+        }
+        else if (strcmp(argv[i], "--jit") == 0)
+        {
+            jit_enabled = true;
+        }
+        else if (strcmp(argv[i], "-O0") == 0)
+        {
+            options.opt_level = 0;
+        }
+        else if (strcmp(argv[i], "-O1") == 0)
+        {
+            options.opt_level = 1;
+        }
+        else if (strcmp(argv[i], "-O2") == 0)
+        {
+            options.opt_level = 2;
+        }
+        else if (strcmp(argv[i], "--unbuffered") == 0)
+        {
+            unbuffered = true;
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0)
+        {
+            options.emit_c = true;
+        }
+        else if (strcmp(argv[i], "--native") == 0)
+        {
+            options.native = true;
+        }
+        else if (strcmp(argv[i], "--compile-only") == 0)
+        {
+            options.compile_only = true;
+        }
+        else if (strcmp(argv[i], "--lex-only") == 0)
+        {
+            options.lex_only = true;
+        }
+        else if (strcmp(argv[i], "--cache") == 0)
+        {
+            options.use_cache = true;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            options.output_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            options.batch_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            options.socket_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            char *end;
+            long threads = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || threads <= 0 || threads > 1024)
+            {
+                free(paths);
+                return usage(argv[0]);
+            }
+            options.threads = threads;
+        }
+        else if (strncmp(argv[i], "--buffer-size=", 14) == 0)
+        {
+            char *end;
+            long size = strtol(argv[i] + 14, &end, 10);
+            if (*end != '\0' || size <= 0)
+            {
+                free(paths);
+                return usage(argv[0]);
+            }
+            buffer_size = size;
+        }
+        else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0)
+        {
+            paths[path_count++] = argv[i];
+        }
+        else
+        {
+            free(paths);
+            return usage(argv[0]);
+        }
+    }
+    // The JIT compiles the tree walker's loops, cached programs are bytecode
+    // that only the VM runs, -o names the output of a translation of a
+    // single program, and a batch or a server only runs the scripts it is given
+    bool translate = options.emit_c || options.native || options.compile_only;
+    if (options.emit_c + options.native + options.compile_only + options.lex_only > 1 ||
+        (jit_enabled && (options.use_vm || options.use_cache || options.compile_only)) ||
+        (use_tree && options.use_cache) ||
+        (options.use_cache && (options.emit_c || options.native)) || (options.compile_only && !options.output_path) ||
+        (options.output_path && !translate) || (translate && path_count > 1) ||
+        ((options.batch_path || options.socket_path) &&
+         (translate || options.lex_only || options.use_cache || path_count > 0)) ||
+        (options.batch_path && options.socket_path) || (options.threads && !options.batch_path && !options.socket_path))
+    {
+        free(paths);
+        return usage(argv[0]);
+    }
+    output_init(buffer_size, unbuffered);
+
+    if (options.batch_path || options.socket_path)
+    {
+        BrainrotOptions script_options;
+        brainrot_default_options(&script_options);
+        script_options.engine = jit_enabled       ? BRAINROT_ENGINE_JIT
+                                : options.use_vm ? BRAINROT_ENGINE_VM
+                                                 : BRAINROT_ENGINE_TREE;
+        script_options.opt_level = options.opt_level;
+        int threads = options.threads ? options.threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        threads = threads > 0 ? threads : 1;
+        free(paths);
+        if (options.socket_path)
+        {
+            return serve(options.socket_path, threads, &script_options);
+        }
+        return batch_run(options.batch_path, threads, &script_options);
+    }
+
+    // Programs run one after another, each from a fresh symbol table; the
+    // exit status is that of the last one to fail
+    int status = 0;
+    for (int i = 0; i < path_count || (i == 0 && path_count == 0); i++)
+    {
+        const char *path = path_count ? paths[i] : "-";
+        Source source;
+        if (!source_open(&source, path))
+        {
+            output_printf(OUTPUT_STDERR, "Error: Cannot read %s: %s\n", strcmp(path, "-") == 0 ? "standard input" : path,
+                          strerror(errno));
+            status = 1;
+            continue;
+        }
+        int result = run_source(&options, &source);
+        source_release(&source);
+        if (result != 0)
+        {
+            status = result;
+        }
+    }
+    free(paths);
+    return status;
+}
@@ -0,0 +1,525 @@
+/* optimize.c */
+
+#include "optimize.h"
+#include "format.h"
+#include "loops.h"
+#include <stdbool.h>
+#include <string.h>
+
+/* Number of assignments to each variable anywhere in the program */
+static _Thread_local int assignment_count[MAX_VARS];
+
+/* Constant node a variable is known to hold from here on, or NULL */
+static _Thread_local ASTNode *known_value[MAX_VARS];
+
+/* Largest expression, in nodes, that a call is replaced by */
+#define INLINE_MAX_NODES 32
+
+static bool is_constant(ASTNode *node)
+{
+    if (!node)
+        return false;
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+    case NODE_FLOAT:
+    case NODE_LONG:
+    case NODE_DOUBLE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool is_binary(NodeType type)
+{
+    return type >= NODE_INT_ADD && type <= NODE_LOGICAL_OR && type != NODE_INT_NEG && type != NODE_FLOAT_NEG;
+}
+
+static bool is_unary(NodeType type)
+{
+    return type == NODE_INT_NEG || type == NODE_FLOAT_NEG || (type >= NODE_LONG_NEG && type <= NODE_DOUBLE_TO_BOOL);
+}
+
+/* A constant operation that must still run to report its error at run time */
+static bool divides_by_zero(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_INT_DIV:
+    case NODE_INT_MOD:
+    case NODE_UNSIGNED_DIV:
+    case NODE_UNSIGNED_MOD:
+        return node->data.op.right->data.value == 0;
+    case NODE_FLOAT_DIV:
+        return node->data.op.right->data.fvalue == 0.0f;
+    case NODE_LONG_DIV:
+    case NODE_LONG_MOD:
+        return node->data.op.right->data.lvalue == 0;
+    case NODE_DOUBLE_DIV:
+        return node->data.op.right->data.dvalue == 0.0;
+    default:
+        return false;
+    }
+}
+
+/* True if node has no effect and cannot fail: no call, element access or risky division */
+static bool is_pure(ASTNode *node)
+{
+    if (node->type == NODE_IDENTIFIER || is_constant(node))
+        return true;
+    if (is_binary(node->type))
+    {
+        ASTNode *divisor = node->data.op.right;
+        switch (node->type)
+        {
+        case NODE_INT_DIV:
+        case NODE_INT_MOD:
+        case NODE_UNSIGNED_DIV:
+        case NODE_UNSIGNED_MOD:
+        case NODE_FLOAT_DIV:
+        case NODE_LONG_DIV:
+        case NODE_LONG_MOD:
+        case NODE_DOUBLE_DIV:
+            if (!is_constant(divisor) || divides_by_zero(node))
+                return false;
+            break;
+        default:
+            break;
+        }
+        return is_pure(node->data.op.left) && is_pure(divisor);
+    }
+    if (is_unary(node->type))
+        return is_pure(node->data.unary.operand);
+    return false;
+}
+
+/*
+ * Count the nodes of an expression made only of constants, parameters and
+ * operators, counting each parameter's uses; false if it has anything
+ * else or more than INLINE_MAX_NODES nodes.
+ */
+static bool measure_inline_body(ASTNode *node, const Function *function, int *nodes, int *uses)
+{
+    if (++*nodes > INLINE_MAX_NODES)
+        return false;
+    if (is_constant(node))
+        return true;
+    if (node->type == NODE_IDENTIFIER)
+    {
+        if (node->slot >= function->parameter_count)
+            return false;
+        uses[node->slot]++;
+        return true;
+    }
+    if (is_binary(node->type))
+        return measure_inline_body(node->data.op.left, function, nodes, uses) &&
+               measure_inline_body(node->data.op.right, function, nodes, uses);
+    if (is_unary(node->type))
+        return measure_inline_body(node->data.unary.operand, function, nodes, uses);
+    return false;
+}
+
+/* The value of a function whose whole body is `bussin value`, or NULL */
+static ASTNode *returned_value(const Function *function)
+{
+    ASTNode *body = function->body;
+    if (body && body->type == NODE_STATEMENT_LIST && body->data.statements && !body->data.statements->next)
+        body = body->data.statements->statement;
+    if (!body || body->type != NODE_RETURN || function->return_type == TYPE_UNKNOWN)
+        return NULL;
+    return body->data.op.left;
+}
+
+static ASTNode *copy_expression(ASTNode *node)
+{
+    ASTNode *copy = arena_alloc(ast_arena, sizeof(ASTNode));
+    *copy = *node;
+    if (is_binary(node->type))
+    {
+        copy->data.op.left = copy_expression(node->data.op.left);
+        copy->data.op.right = copy_expression(node->data.op.right);
+    }
+    else if (is_unary(node->type))
+    {
+        copy->data.unary.operand = copy_expression(node->data.unary.operand);
+    }
+    return copy;
+}
+
+/* A copy of a function's value with each parameter replaced by a copy of its argument */
+static ASTNode *substitute(ASTNode *node, ASTNode **arguments)
+{
+    if (node->type == NODE_IDENTIFIER)
+        return copy_expression(arguments[node->slot]);
+
+    ASTNode *copy = arena_alloc(ast_arena, sizeof(ASTNode));
+    *copy = *node;
+    if (is_binary(node->type))
+    {
+        copy->data.op.left = substitute(node->data.op.left, arguments);
+        copy->data.op.right = substitute(node->data.op.right, arguments);
+    }
+    else if (is_unary(node->type))
+    {
+        copy->data.unary.operand = substitute(node->data.unary.operand, arguments);
+    }
+    return copy;
+}
+
+/*
+ * Replace a call by the expression its function returns when the whole
+ * function is one small `bussin` of its parameters, which also rules out
+ * recursion. Arguments are already converted to their parameters' types,
+ * so the result has the call's type. To keep every effect and error of
+ * the call, each argument must be pure, and one that is not a constant
+ * or a variable must be used exactly once.
+ */
+static bool inline_call(ASTNode *node)
+{
+    Function *function = current_program->functions[node->slot];
+    ASTNode *value = returned_value(function);
+    int nodes = 0;
+    int uses[MAX_VARS] = {0};
+    if (!value || !measure_inline_body(value, function, &nodes, uses))
+        return false;
+
+    ASTNode *arguments[MAX_VARS];
+    int count = 0;
+    for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+    {
+        ASTNode *argument = arg->expr;
+        bool simple = is_constant(argument) || argument->type == NODE_IDENTIFIER;
+        if (!is_pure(argument) || (!simple && uses[count] != 1))
+            return false;
+        arguments[count++] = argument;
+    }
+
+    *node = *substitute(value, arguments);
+    return true;
+}
+
+/*
+ * Fold an expression bottom-up. A node whose operands are all constant is
+ * evaluated with the interpreter's own evaluators and rewritten in place
+ * into a constant of the same static type, so folding can never disagree
+ * with execution. Calls that inline_call can replace are folded in their
+ * replacement.
+ */
+static void fold_expression(ASTNode *node)
+{
+    if (!node)
+        return;
+
+    if (node->type == NODE_FUNC_CALL)
+    {
+        for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+        {
+            fold_expression(arg->expr);
+        }
+        if (node->slot < 0 || !inline_call(node))
+            return;
+    }
+
+    if (node->type == NODE_IDENTIFIER)
+    {
+        ASTNode *value = known_value[node->slot];
+        if (value)
+        {
+            node->type = value->type;
+            node->data = value->data;
+        }
+        return;
+    }
+    if (node->type == NODE_INDEX)
+    {
+        fold_expression(node->data.element.index);
+        return;
+    }
+
+    if (is_binary(node->type))
+    {
+        fold_expression(node->data.op.left);
+        fold_expression(node->data.op.right);
+        if (!is_constant(node->data.op.left) || !is_constant(node->data.op.right) || divides_by_zero(node))
+            return;
+    }
+    else if (is_unary(node->type))
+    {
+        fold_expression(node->data.unary.operand);
+        if (!is_constant(node->data.unary.operand))
+            return;
+    }
+    else
+    {
+        return;
+    }
+
+    if (node->value_type == TYPE_FLOAT)
+    {
+        float value = evaluate_expression_float(node);
+        node->type = NODE_FLOAT;
+        node->data.fvalue = value;
+        node->data.dvalue = value;
+    }
+    else if (node->value_type == TYPE_DOUBLE)
+    {
+        double value = evaluate_expression_double(node);
+        node->type = NODE_DOUBLE;
+        node->data.dvalue = value;
+    }
+    else if (node->value_type == TYPE_LONG)
+    {
+        int64_t value = evaluate_expression_long(node);
+        node->type = NODE_LONG;
+        node->data.lvalue = value;
+    }
+    else
+    {
+        int value = evaluate_expression_int(node);
+        node->type = NODE_NUMBER;
+        node->data.value = value;
+    }
+}
+
+static void count_assignments(ASTNode *node)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        assignment_count[node->data.op.left->slot]++;
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            count_assignments(sl->statement);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        count_assignments(node->data.for_stmt.init);
+        count_assignments(node->data.for_stmt.incr);
+        count_assignments(node->data.for_stmt.body);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        count_assignments(node->data.while_stmt.body);
+        break;
+    case NODE_IF_STATEMENT:
+        count_assignments(node->data.if_stmt.then_branch);
+        count_assignments(node->data.if_stmt.else_branch);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            count_assignments(cn->statements);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Record the value of a top-level assignment if it can never change */
+static void propagate_assignment(ASTNode *node)
+{
+    int slot = node->data.op.left->slot;
+    if (assignment_count[slot] == 1 && !symbol_table[slot].modifiers.is_volatile &&
+        is_constant(node->data.op.right))
+    {
+        known_value[slot] = node->data.op.right;
+    }
+}
+
+static ASTNode *optimize_statement(ASTNode *node);
+
+/*
+ * Drop everything after a `based` arm, which always leaves the switch,
+ * and, when the switch value is constant, every arm before the one that
+ * execution starts in. Returns NULL if no arm can run.
+ */
+static CaseNode *prune_cases(ASTNode *expression, CaseNode *cases)
+{
+    for (CaseNode *cn = cases; cn; cn = cn->next)
+    {
+        if (!cn->value)
+        {
+            cn->next = NULL;
+            break;
+        }
+    }
+
+    if (!is_constant(expression))
+        return cases;
+
+    for (CaseNode *cn = cases; cn; cn = cn->next)
+    {
+        if (!cn->value || (is_constant(cn->value) && cn->value->data.value == expression->data.value))
+            return cn;
+        if (!is_constant(cn->value))
+            return cases;
+    }
+    return NULL;
+}
+
+static ASTNode *optimize_switch(ASTNode *node)
+{
+    fold_expression(node->data.switch_stmt.expression);
+    for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+    {
+        fold_expression(cn->value);
+        cn->statements = optimize_statement(cn->statements);
+    }
+
+    node->data.switch_stmt.cases = prune_cases(node->data.switch_stmt.expression, node->data.switch_stmt.cases);
+    return node->data.switch_stmt.cases ? node : NULL;
+}
+
+/* A print call whose output is fixed text, or NULL */
+static Format *text_print(ASTNode *node)
+{
+    if (node->type != NODE_FUNC_CALL || !node->data.func_call.format)
+        return NULL;
+    return format_is_text(node->data.func_call.format) ? node->data.func_call.format : NULL;
+}
+
+/*
+ * Optimize each statement of a list, dropping those that do nothing and
+ * merging runs of prints of fixed text to the same stream into one.
+ */
+static ASTNode *optimize_list(ASTNode *node, bool top_level)
+{
+    StatementList **link = &node->data.statements;
+    Format *previous_text = NULL;
+    while (*link)
+    {
+        StatementList *item = *link;
+        item->statement = optimize_statement(item->statement);
+        if (!item->statement)
+        {
+            *link = item->next;
+            continue;
+        }
+        Format *text = text_print(item->statement);
+        if (text && previous_text && text->stream == previous_text->stream)
+        {
+            append_format_text(ast_arena, previous_text, text);
+            *link = item->next;
+            continue;
+        }
+        previous_text = text;
+        if (top_level && item->statement->type == NODE_ASSIGNMENT)
+        {
+            propagate_assignment(item->statement);
+        }
+        link = &item->next;
+    }
+    return node;
+}
+
+/* Optimize a statement, returning its replacement or NULL if it does nothing */
+static ASTNode *optimize_statement(ASTNode *node)
+{
+    if (!node)
+        return NULL;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        fold_expression(node->data.op.right);
+        return node;
+    case NODE_ARRAY_DECLARATION:
+        fold_expression(node->data.element.index);
+        return node;
+    case NODE_INDEX_ASSIGNMENT:
+        fold_expression(node->data.element.index);
+        fold_expression(node->data.element.value);
+        return node;
+    case NODE_FUNC_CALL:
+        fold_expression(node);
+        if (node->type == NODE_FUNC_CALL && node->data.func_call.format)
+            fold_format(ast_arena, node->data.func_call.format);
+        return node;
+    case NODE_PRINT_STATEMENT:
+    case NODE_ERROR_STATEMENT:
+    case NODE_RETURN:
+        fold_expression(node->data.op.left);
+        return node;
+    case NODE_STATEMENT_LIST:
+        return optimize_list(node, false);
+    case NODE_IF_STATEMENT:
+        fold_expression(node->data.if_stmt.condition);
+        if (is_constant(node->data.if_stmt.condition))
+        {
+            return optimize_statement(node->data.if_stmt.condition->data.value ? node->data.if_stmt.then_branch
+                                                                               : node->data.if_stmt.else_branch);
+        }
+        node->data.if_stmt.then_branch = optimize_statement(node->data.if_stmt.then_branch);
+        node->data.if_stmt.else_branch = optimize_statement(node->data.if_stmt.else_branch);
+        return node;
+    case NODE_WHILE_STATEMENT:
+        fold_expression(node->data.while_stmt.cond);
+        if (is_constant(node->data.while_stmt.cond) && !node->data.while_stmt.cond->data.value)
+            return NULL;
+        node->data.while_stmt.body = optimize_statement(node->data.while_stmt.body);
+        return node;
+    case NODE_DO_WHILE_STATEMENT:
+        /* The body always runs once, and may contain bruh or grind */
+        fold_expression(node->data.while_stmt.cond);
+        node->data.while_stmt.body = optimize_statement(node->data.while_stmt.body);
+        return node;
+    case NODE_FOR_STATEMENT:
+        node->data.for_stmt.init = optimize_statement(node->data.for_stmt.init);
+        fold_expression(node->data.for_stmt.cond);
+        if (is_constant(node->data.for_stmt.cond) && !node->data.for_stmt.cond->data.value)
+            return node->data.for_stmt.init;
+        node->data.for_stmt.incr = optimize_statement(node->data.for_stmt.incr);
+        node->data.for_stmt.body = optimize_statement(node->data.for_stmt.body);
+        return node;
+    case NODE_SWITCH_STATEMENT:
+        return optimize_switch(node);
+    default:
+        /* Expression statements have no effect beyond their errors */
+        fold_expression(node);
+        return node;
+    }
+}
+
+/* Optimize main or a function body in its own scope */
+static void optimize_scope(Scope *scope, ASTNode *body, int level)
+{
+    if (!body)
+        return;
+
+    enter_scope(scope);
+    memset(assignment_count, 0, sizeof(assignment_count));
+    memset(known_value, 0, sizeof(known_value));
+    count_assignments(body);
+
+    if (body->type == NODE_STATEMENT_LIST)
+        optimize_list(body, true);
+    else
+        optimize_statement(body);
+
+    if (level >= 2 && body->type == NODE_STATEMENT_LIST)
+        optimize_loops(body);
+}
+
+void optimize_program(ASTNode *root, int level)
+{
+    if (level < 1)
+        return;
+
+    // Functions first, so calls inline their optimized bodies
+    for (int i = 0; i < current_program->function_count; i++)
+    {
+        Function *function = current_program->functions[i];
+        optimize_scope(&function->scope, function->body, level);
+    }
+    optimize_scope(&current_program->main, root, level);
+    enter_scope(&current_program->main);
+}
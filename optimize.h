@@ -0,0 +1,20 @@
+/* optimize.h */
+
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "ast.h"
+
+/*
+ * Simplify a type-checked tree in place before it is executed or compiled.
+ *
+ * Level 0 leaves the tree untouched. Level 1 folds constant subexpressions,
+ * replaces reads of variables that are assigned exactly once (by a
+ * non-volatile top-level declaration with a constant value) by that value,
+ * and removes `edging`/`amogus` branches, loops and `ohio` arms that can
+ * never run. Level 2 adds the loop optimizations in loops.h. Program
+ * output is the same at every level.
+ */
+void optimize_program(ASTNode *root, int level);
+
+#endif /* OPTIMIZE_H */
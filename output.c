@@ -0,0 +1,212 @@
+/* output.c */
+
+#include "output.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+typedef struct
+{
+    int fd;
+    char *data;
+    size_t length;
+    size_t capacity; /* 0 writes every call straight through */
+    bool flush_on_newline;
+} OutputBuffer;
+
+struct OutputTarget
+{
+    OutputBuffer streams[2];
+    OutputWriter writer; /* NULL writes to each stream's fd */
+    void *context;
+};
+
+static OutputTarget process_output = {
+    .streams = {
+        [OUTPUT_STDOUT] = {.fd = STDOUT_FILENO},
+        [OUTPUT_STDERR] = {.fd = STDERR_FILENO},
+    },
+};
+
+/* Where this thread's output goes: the process's streams unless attached */
+static _Thread_local OutputTarget *output = &process_output;
+
+/* Write every byte described by iov, resuming after short writes */
+static void write_all(int fd, struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return; // Nothing useful to do if the reader went away
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+/* Send the buffered bytes followed by extra, in a single writev */
+static void flush_stream(OutputBuffer *out, const char *extra, size_t extra_length)
+{
+    if (output->writer)
+    {
+        OutputStream stream = out == &output->streams[OUTPUT_STDOUT] ? OUTPUT_STDOUT : OUTPUT_STDERR;
+        if (out->length)
+            output->writer(output->context, stream, out->data, out->length);
+        if (extra_length)
+            output->writer(output->context, stream, extra, extra_length);
+        out->length = 0;
+        return;
+    }
+    struct iovec iov[2];
+    int count = 0;
+    if (out->length)
+        iov[count++] = (struct iovec){out->data, out->length};
+    if (extra_length)
+        iov[count++] = (struct iovec){(void *)extra, extra_length};
+    write_all(out->fd, iov, count);
+    out->length = 0;
+}
+
+/* Keep the two streams in program order when they share a file */
+static OutputBuffer *select_stream(OutputStream stream)
+{
+    OutputBuffer *other = &output->streams[stream == OUTPUT_STDOUT ? OUTPUT_STDERR : OUTPUT_STDOUT];
+    if (other->length)
+        flush_stream(other, NULL, 0);
+    return &output->streams[stream];
+}
+
+/* Apply the flush policy to bytes just appended to the buffer */
+static void appended(OutputBuffer *out, const char *text, size_t length)
+{
+    if (out->flush_on_newline && memchr(text, '\n', length))
+        flush_stream(out, NULL, 0);
+}
+
+void output_init(size_t buffer_size, bool unbuffered)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        OutputBuffer *out = &process_output.streams[i];
+        out->capacity = unbuffered ? 0 : buffer_size;
+        out->data = out->capacity ? malloc(out->capacity) : NULL;
+        if (!out->data)
+            out->capacity = 0;
+        out->length = 0;
+        out->flush_on_newline = isatty(out->fd);
+    }
+    atexit(output_flush);
+}
+
+void output_write(OutputStream stream, const char *data, size_t length)
+{
+    OutputBuffer *out = select_stream(stream);
+    if (out->length + length > out->capacity)
+    {
+        if (length >= out->capacity)
+        {
+            flush_stream(out, data, length);
+            return;
+        }
+        flush_stream(out, NULL, 0);
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+    appended(out, data, length);
+}
+
+void output_printf(OutputStream stream, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    output_vprintf(stream, format, args);
+    va_end(args);
+}
+
+/*
+ * Format straight into the buffer when the result fits in its free space,
+ * otherwise into a temporary that output_write then takes over.
+ */
+void output_vprintf(OutputStream stream, const char *format, va_list args)
+{
+    OutputBuffer *out = select_stream(stream);
+    size_t space = out->capacity - out->length;
+    char *start = out->data ? out->data + out->length : NULL;
+
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(start, space, format, copy);
+    va_end(copy);
+    if (length < 0)
+        return;
+    if ((size_t)length < space)
+    {
+        out->length += length;
+        appended(out, start, length);
+        return;
+    }
+
+    char local[256];
+    char *text = (size_t)length < sizeof(local) ? local : malloc(length + 1);
+    if (!text)
+        return;
+    vsnprintf(text, length + 1, format, args);
+    output_write(stream, text, length);
+    if (text != local)
+        free(text);
+}
+
+void output_flush(void)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (output->streams[i].length)
+            flush_stream(&output->streams[i], NULL, 0);
+    }
+}
+
+OutputTarget *output_attach(OutputWriter writer, void *context, size_t buffer_size)
+{
+    OutputTarget *previous = output;
+    OutputTarget *target = calloc(1, sizeof(OutputTarget));
+    target->writer = writer;
+    target->context = context;
+    for (int i = 0; i < 2; i++)
+    {
+        OutputBuffer *out = &target->streams[i];
+        out->fd = i == OUTPUT_STDOUT ? STDOUT_FILENO : STDERR_FILENO;
+        out->capacity = buffer_size;
+        out->data = buffer_size ? malloc(buffer_size) : NULL;
+        if (!out->data)
+            out->capacity = 0;
+    }
+    output = target;
+    return previous;
+}
+
+void output_detach(OutputTarget *previous)
+{
+    if (output == &process_output)
+        return;
+    output_flush();
+    for (int i = 0; i < 2; i++)
+        free(output->streams[i].data);
+    free(output);
+    output = previous;
+}
@@ -0,0 +1,56 @@
+/* output.h */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Interpreter-owned buffering for everything a program prints. yapping and
+ * yappin go to OUTPUT_STDOUT, baka and diagnostics to OUTPUT_STDERR.
+ *
+ * Each stream collects output in its own buffer and hands it to the
+ * kernel in large write/writev calls: when the buffer fills, after every
+ * newline if the stream is a terminal, and at exit. Before one stream
+ * takes new output the other is flushed, so the two interleave in program
+ * order even when they share a file. With unbuffered set, every call is
+ * written immediately.
+ *
+ * Output goes to the process's stdout and stderr unless the thread
+ * writing it has attached buffers of its own, which is how programs
+ * running on other threads keep their output apart.
+ */
+typedef enum
+{
+    OUTPUT_STDOUT,
+    OUTPUT_STDERR
+} OutputStream;
+
+#define OUTPUT_DEFAULT_BUFFER_SIZE (64 * 1024)
+
+/* Set up both streams; output written before this goes out unbuffered */
+void output_init(size_t buffer_size, bool unbuffered);
+void output_write(OutputStream stream, const char *data, size_t length);
+void output_printf(OutputStream stream, const char *format, ...);
+void output_vprintf(OutputStream stream, const char *format, va_list args);
+void output_flush(void);
+
+/* Where a thread's output goes: the process's streams or attached buffers */
+typedef struct OutputTarget OutputTarget;
+
+/* Receives a stream's buffered output when it is flushed */
+typedef void (*OutputWriter)(void *context, OutputStream stream, const char *data, size_t length);
+
+/*
+ * Give the calling thread streams of its own, buffered in buffer_size
+ * bytes each (0 for unbuffered) and flushed to writer, or to the
+ * process's file descriptors if writer is NULL, until output_detach,
+ * which flushes and releases them. Attaching returns the target output
+ * went to before, which output_detach restores, so attachments nest.
+ */
+OutputTarget *output_attach(OutputWriter writer, void *context, size_t buffer_size);
+void output_detach(OutputTarget *previous);
+
+#endif /* OUTPUT_H */
@@ -0,0 +1,272 @@
+/* resolve.c */
+
+#include "resolve.h"
+#include <stdbool.h>
+#include <string.h>
+
+extern void yyerror(const char *s);
+
+static _Thread_local bool resolve_error;
+
+static void report(const char *message, const char *name)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s '%s'", message, name);
+    yyerror(buffer);
+    resolve_error = true;
+}
+
+/* Find the slot of a variable that has already been defined */
+static int find_slot(Atom atom)
+{
+    for (int i = 0; i < var_count; i++)
+    {
+        if (symbol_table[i].atom == atom)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* First pass: give every assigned variable a slot */
+static void define_targets(ASTNode *node)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+    {
+        ASTNode *target = node->data.op.left;
+        target->slot = define_variable_slot(target->data.atom);
+        if (target->slot < 0)
+        {
+            report("Too many variables, cannot define", atom_name(ast_atoms, target->data.atom));
+        }
+        break;
+    }
+    case NODE_ARRAY_DECLARATION:
+        node->slot = define_variable_slot(node->data.element.array);
+        if (node->slot < 0)
+        {
+            report("Too many variables, cannot define", atom_name(ast_atoms, node->data.element.array));
+        }
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            define_targets(sl->statement);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        define_targets(node->data.for_stmt.init);
+        define_targets(node->data.for_stmt.incr);
+        define_targets(node->data.for_stmt.body);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        define_targets(node->data.while_stmt.body);
+        break;
+    case NODE_IF_STATEMENT:
+        define_targets(node->data.if_stmt.then_branch);
+        define_targets(node->data.if_stmt.else_branch);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            define_targets(cn->statements);
+        }
+        break;
+    case NODE_RETURN:
+        define_targets(node->data.op.left);
+        break;
+    default:
+        break;
+    }
+}
+
+static bool is_builtin(Atom function)
+{
+    return function == ATOM_YAPPING || function == ATOM_YAPPIN || function == ATOM_BAKA;
+}
+
+/* Second pass: bind every use to the slot of its definition */
+static void bind_uses(ASTNode *node)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_IDENTIFIER:
+    case NODE_SIZEOF:
+        node->slot = find_slot(node->data.atom);
+        if (node->slot < 0)
+        {
+            report(node->type == NODE_SIZEOF ? "Undefined variable in sizeof" : "Undefined variable",
+                   atom_name(ast_atoms, node->data.atom));
+        }
+        break;
+    case NODE_ASSIGNMENT:
+        bind_uses(node->data.op.right);
+        break;
+    case NODE_ARRAY_DECLARATION:
+        bind_uses(node->data.element.index);
+        break;
+    case NODE_INDEX:
+    case NODE_INDEX_ASSIGNMENT:
+        node->slot = find_slot(node->data.element.array);
+        if (node->slot < 0)
+        {
+            report("Undefined array", atom_name(ast_atoms, node->data.element.array));
+        }
+        bind_uses(node->data.element.index);
+        bind_uses(node->data.element.value);
+        break;
+    case NODE_OPERATION:
+        bind_uses(node->data.op.left);
+        bind_uses(node->data.op.right);
+        break;
+    case NODE_UNARY_OPERATION:
+        bind_uses(node->data.unary.operand);
+        break;
+    case NODE_PRINT_STATEMENT:
+    case NODE_ERROR_STATEMENT:
+    case NODE_RETURN:
+        bind_uses(node->data.op.left);
+        break;
+    case NODE_FUNC_CALL:
+        if (!is_builtin(node->data.func_call.function))
+        {
+            node->slot = find_function(node->data.func_call.function);
+            if (node->slot < 0)
+                report("Undefined function", atom_name(ast_atoms, node->data.func_call.function));
+        }
+        for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+        {
+            bind_uses(arg->expr);
+        }
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            bind_uses(sl->statement);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        bind_uses(node->data.for_stmt.init);
+        bind_uses(node->data.for_stmt.cond);
+        bind_uses(node->data.for_stmt.incr);
+        bind_uses(node->data.for_stmt.body);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        bind_uses(node->data.while_stmt.cond);
+        bind_uses(node->data.while_stmt.body);
+        break;
+    case NODE_IF_STATEMENT:
+        bind_uses(node->data.if_stmt.condition);
+        bind_uses(node->data.if_stmt.then_branch);
+        bind_uses(node->data.if_stmt.else_branch);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        bind_uses(node->data.switch_stmt.expression);
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            bind_uses(cn->value);
+            bind_uses(cn->statements);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Third pass: `bruh` must be inside a loop or switch and `grind` inside a loop */
+static void check_jumps(ASTNode *node, bool in_loop, bool in_switch)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_BREAK_STATEMENT:
+        if (!in_loop && !in_switch)
+        {
+            yyerror("bruh outside of a loop or switch");
+            resolve_error = true;
+        }
+        break;
+    case NODE_CONTINUE_STATEMENT:
+        if (!in_loop)
+        {
+            yyerror("grind outside of a loop");
+            resolve_error = true;
+        }
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            check_jumps(sl->statement, in_loop, in_switch);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        check_jumps(node->data.for_stmt.body, true, in_switch);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        check_jumps(node->data.while_stmt.body, true, in_switch);
+        break;
+    case NODE_IF_STATEMENT:
+        check_jumps(node->data.if_stmt.then_branch, in_loop, in_switch);
+        check_jumps(node->data.if_stmt.else_branch, in_loop, in_switch);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            check_jumps(cn->statements, in_loop, true);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Resolve main or a function body in its own scope, parameters first */
+static void resolve_scope(Scope *scope, Function *function, ASTNode *body)
+{
+    enter_scope(scope);
+    for (int i = 0; function && i < function->parameter_count; i++)
+    {
+        define_targets(function->parameters[i]);
+        if (function->parameters[i]->data.op.left->slot != i)
+            report("Duplicate parameter", atom_name(ast_atoms, function->parameters[i]->data.op.left->data.atom));
+    }
+    define_targets(body);
+    bind_uses(body);
+    check_jumps(body, false, false);
+}
+
+bool resolve_program(ASTNode *root)
+{
+    Program *program = current_program;
+    resolve_error = false;
+    for (int i = 0; i < program->function_count; i++)
+    {
+        Atom name = program->functions[i]->name;
+        if (is_builtin(name))
+            report("Cannot redefine built-in function", atom_name(ast_atoms, name));
+        else if (find_function(name) != i)
+            report("Function defined twice", atom_name(ast_atoms, name));
+    }
+
+    resolve_scope(&program->main, NULL, root);
+    for (int i = 0; i < program->function_count; i++)
+    {
+        resolve_scope(&program->functions[i]->scope, program->functions[i], program->functions[i]->body);
+    }
+    enter_scope(&program->main);
+    return !resolve_error;
+}
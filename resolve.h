@@ -0,0 +1,21 @@
+/* resolve.h */
+
+#ifndef RESOLVE_H
+#define RESOLVE_H
+
+#include "ast.h"
+
+/*
+ * Bind every identifier, array, sizeof operand and assignment target in
+ * the tree to its symbol table slot so execution never looks variables up
+ * by name, and every call to the function it names. Main and each
+ * function have their own variables, a function's parameters taking its
+ * first slots. Returns false (after reporting through yyerror) if a
+ * variable is read but never assigned anywhere in its function, an array
+ * is indexed but never declared, the table overflows, a function is
+ * undefined or defined twice, or a `bruh` or `grind` is outside a
+ * construct it can leave.
+ */
+bool resolve_program(ASTNode *root);
+
+#endif /* RESOLVE_H */
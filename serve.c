@@ -0,0 +1,519 @@
+/* serve.c */
+
+#include "serve.h"
+#include "brc.h"
+#include "output.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CACHE_BUCKETS (SERVE_CACHE_SIZE * 2)
+
+/* Seconds a client may take to finish sending a request it has started */
+#define REQUEST_TIMEOUT 10
+
+/* A cached script and the programs parsed from it that are not running */
+typedef struct Entry
+{
+    uint64_t hash;
+    char *text;
+    size_t length;
+    BrainrotProgram **idle;
+    int idle_count;
+    int idle_capacity;
+    int users;            /* Requests running one of its programs */
+    struct Entry *newer;  /* Least recently used order */
+    struct Entry *older;
+    struct Entry *chain;  /* Next entry in the same bucket */
+} Entry;
+
+typedef struct
+{
+    Entry *buckets[CACHE_BUCKETS];
+    Entry *newest;
+    Entry *oldest;
+    int count;
+    pthread_mutex_t lock;
+} Cache;
+
+/* A connection with a request waiting for a thread, or one handed back after its request */
+typedef struct Pending
+{
+    int fd;
+    struct Pending *next;
+} Pending;
+
+typedef struct
+{
+    BrainrotOptions options;
+    Cache cache;
+    Pending *first;
+    Pending *last;
+    Pending *returned; /* Connections to watch for their next request */
+    int wake[2];       /* A byte written to wake[1] tells the listener about returned connections */
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+} Server;
+
+typedef struct
+{
+    int fd;
+    bool broken; /* The client went away; output is dropped */
+} Connection;
+
+static volatile sig_atomic_t stopping;
+
+static void stop(int signal)
+{
+    (void)signal;
+    stopping = 1;
+}
+
+/* Send every byte described by iov, resuming after short writes */
+static void send_all(Connection *connection, struct iovec *iov, int count)
+{
+    while (count > 0 && !connection->broken)
+    {
+        struct msghdr message = {.msg_iov = iov, .msg_iovlen = count};
+        ssize_t sent = sendmsg(connection->fd, &message, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno != EINTR)
+                connection->broken = true;
+            continue;
+        }
+        while (count > 0 && (size_t)sent >= iov->iov_len)
+        {
+            sent -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+}
+
+static void send_frame(Connection *connection, char type, const void *data, uint32_t length)
+{
+    char header[5];
+    header[0] = type;
+    memcpy(header + 1, &length, sizeof(length));
+    struct iovec iov[2] = {{header, sizeof(header)}, {(void *)data, length}};
+    send_all(connection, iov, length ? 2 : 1);
+}
+
+static void send_output(void *context, BrainrotStream stream, const char *data, size_t length)
+{
+    send_frame(context, stream == BRAINROT_STDOUT ? 'O' : 'E', data, length);
+}
+
+static bool receive(int fd, void *data, size_t length)
+{
+    char *at = data;
+    while (length > 0)
+    {
+        ssize_t received = read(fd, at, length);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        at += received;
+        length -= received;
+    }
+    return true;
+}
+
+/* Cache; callers hold cache->lock */
+
+static Entry **find_link(Cache *cache, uint64_t hash)
+{
+    Entry **link = &cache->buckets[hash % CACHE_BUCKETS];
+    while (*link && (*link)->hash != hash)
+        link = &(*link)->chain;
+    return link;
+}
+
+static void unlink_entry(Cache *cache, Entry *entry)
+{
+    if (entry->newer)
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+    if (entry->older)
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+    entry->newer = entry->older = NULL;
+}
+
+static void make_newest(Cache *cache, Entry *entry)
+{
+    if (cache->newest == entry)
+        return;
+    if (entry->newer || entry->older || cache->oldest == entry)
+        unlink_entry(cache, entry);
+    entry->older = cache->newest;
+    if (cache->newest)
+        cache->newest->newer = entry;
+    cache->newest = entry;
+    if (!cache->oldest)
+        cache->oldest = entry;
+}
+
+static void free_entry(Entry *entry)
+{
+    for (int i = 0; i < entry->idle_count; i++)
+        brainrot_free(entry->idle[i]);
+    free(entry->idle);
+    free(entry->text);
+    free(entry);
+}
+
+/* Drop the least recently used scripts nobody is running until the cache fits */
+static void evict(Cache *cache)
+{
+    Entry *entry = cache->oldest;
+    while (cache->count > SERVE_CACHE_SIZE && entry)
+    {
+        Entry *newer = entry->newer;
+        if (entry->users == 0)
+        {
+            *find_link(cache, entry->hash) = entry->chain;
+            unlink_entry(cache, entry);
+            free_entry(entry);
+            cache->count--;
+        }
+        entry = newer;
+    }
+}
+
+/*
+ * A program to run the script with the given hash, and the entry it is to
+ * be returned to. With text, the script is parsed and cached if it is not
+ * there already; without, NULL if the cache does not know the hash. The
+ * entry is NULL if the program is not cached, after a hash collision.
+ */
+static BrainrotProgram *check_out(Server *server, Connection *connection, uint64_t hash, const char *text,
+                                  size_t length, Entry **found)
+{
+    Cache *cache = &server->cache;
+    BrainrotOptions options = server->options;
+    options.write = send_output;
+    options.context = connection;
+
+    pthread_mutex_lock(&cache->lock);
+    Entry *entry = *find_link(cache, hash);
+    if (entry && text && (entry->length != length || memcmp(entry->text, text, length) != 0))
+    {
+        pthread_mutex_unlock(&cache->lock);
+        *found = NULL;
+        return brainrot_parse(text, length, &options);
+    }
+    if (entry)
+    {
+        entry->users++;
+        make_newest(cache, entry);
+        BrainrotProgram *program = entry->idle_count ? entry->idle[--entry->idle_count] : NULL;
+        pthread_mutex_unlock(&cache->lock);
+        *found = entry;
+        // Another request is running every copy parsed so far
+        return program ? program : brainrot_parse(entry->text, entry->length, &options);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    *found = NULL;
+    if (!text)
+        return NULL;
+
+    BrainrotProgram *program = brainrot_parse(text, length, &options);
+    if (!program)
+        return NULL;
+    pthread_mutex_lock(&cache->lock);
+    Entry **link = find_link(cache, hash);
+    entry = *link;
+    if (!entry)
+    {
+        entry = calloc(1, sizeof(Entry));
+        entry->hash = hash;
+        entry->text = malloc(length);
+        memcpy(entry->text, text, length);
+        entry->length = length;
+        *link = entry;
+        cache->count++;
+    }
+    entry->users++;
+    make_newest(cache, entry);
+    evict(cache);
+    pthread_mutex_unlock(&cache->lock);
+    *found = entry;
+    return program;
+}
+
+static void check_in(Server *server, Entry *entry, BrainrotProgram *program)
+{
+    if (!entry)
+    {
+        brainrot_free(program);
+        return;
+    }
+    Cache *cache = &server->cache;
+    pthread_mutex_lock(&cache->lock);
+    if (entry->idle_count == entry->idle_capacity)
+    {
+        entry->idle_capacity = entry->idle_capacity ? entry->idle_capacity * 2 : 2;
+        entry->idle = realloc(entry->idle, entry->idle_capacity * sizeof(BrainrotProgram *));
+    }
+    entry->idle[entry->idle_count++] = program;
+    entry->users--;
+    evict(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/* Answer one request; false if it is malformed and the connection should close */
+static bool handle_request(Server *server, Connection *connection, char type, const char *payload, uint32_t length)
+{
+    uint64_t hash;
+    if (type == 'H' && length == sizeof(hash))
+        memcpy(&hash, payload, sizeof(hash));
+    else if (type == 'S')
+        hash = brc_hash(payload, length);
+    else
+        return false;
+
+    Entry *entry;
+    BrainrotProgram *program = check_out(server, connection, hash, type == 'S' ? payload : NULL, length, &entry);
+    if (!program && type == 'H' && !entry)
+    {
+        send_frame(connection, 'M', NULL, 0);
+        return true;
+    }
+    int32_t status = 1;
+    if (program)
+    {
+        brainrot_set_output(program, send_output, connection);
+        status = brainrot_run(program);
+        check_in(server, entry, program);
+    }
+    send_frame(connection, 'X', &status, sizeof(status));
+    return true;
+}
+
+/* Read and answer the request waiting on fd; false once the connection should close */
+static bool serve_request(Server *server, int fd)
+{
+    Connection connection = {fd, false};
+    char header[5];
+    if (!receive(fd, header, sizeof(header)))
+        return false;
+    uint32_t length;
+    memcpy(&length, header + 1, sizeof(length));
+    if (length > SERVE_MAX_SOURCE)
+        return false;
+    char *payload = malloc(length ? length : 1);
+    bool handled = receive(fd, payload, length) && handle_request(server, &connection, header[0], payload, length);
+    free(payload);
+    return handled && !connection.broken;
+}
+
+/*
+ * Threads take one request at a time, not whole connections, so clients
+ * that stay connected between requests do not hold on to a thread. A
+ * connection goes back to the listener after each request.
+ */
+static void *work(void *argument)
+{
+    Server *server = argument;
+    for (;;)
+    {
+        pthread_mutex_lock(&server->lock);
+        while (!server->first)
+            pthread_cond_wait(&server->available, &server->lock);
+        Pending *pending = server->first;
+        server->first = pending->next;
+        if (!server->first)
+            server->last = NULL;
+        pthread_mutex_unlock(&server->lock);
+
+        if (!serve_request(server, pending->fd))
+        {
+            close(pending->fd);
+            free(pending);
+            continue;
+        }
+        pthread_mutex_lock(&server->lock);
+        pending->next = server->returned;
+        server->returned = pending;
+        pthread_mutex_unlock(&server->lock);
+        char byte = 0;
+        while (write(server->wake[1], &byte, 1) < 0 && errno == EINTR)
+            ;
+    }
+    return NULL;
+}
+
+static void queue(Server *server, int fd)
+{
+    Pending *pending = malloc(sizeof(Pending));
+    pending->fd = fd;
+    pending->next = NULL;
+    pthread_mutex_lock(&server->lock);
+    if (server->last)
+        server->last->next = pending;
+    else
+        server->first = pending;
+    server->last = pending;
+    pthread_cond_signal(&server->available);
+    pthread_mutex_unlock(&server->lock);
+}
+
+/* Connections between requests, watched for the start of the next one */
+typedef struct
+{
+    struct pollfd *fds; /* The listener and wake pipe first */
+    int count;
+    int capacity;
+} Watched;
+
+static void watch(Watched *watched, int fd)
+{
+    if (watched->count == watched->capacity)
+    {
+        watched->capacity *= 2;
+        watched->fds = realloc(watched->fds, watched->capacity * sizeof(struct pollfd));
+    }
+    watched->fds[watched->count++] = (struct pollfd){.fd = fd, .events = POLLIN};
+}
+
+int serve(const char *path, int threads, const BrainrotOptions *options)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        output_printf(OUTPUT_STDERR, "Error: Socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+
+    // A socket left behind by a server that did not shut down cleanly is
+    // replaced, but one a server still listens on is not taken over
+    struct stat info;
+    if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode))
+    {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (live)
+        {
+            output_printf(OUTPUT_STDERR, "Error: A server is already listening on %s\n", path);
+            return 1;
+        }
+        unlink(path);
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 128) != 0)
+    {
+        output_printf(OUTPUT_STDERR, "Error: Cannot listen on %s: %s\n", path, strerror(errno));
+        if (listener >= 0)
+            close(listener);
+        return 1;
+    }
+
+    // No SA_RESTART, so a signal interrupts poll
+    struct sigaction action = {.sa_handler = stop};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    Server *server = calloc(1, sizeof(Server));
+    server->options = *options;
+    pthread_mutex_init(&server->cache.lock, NULL);
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->available, NULL);
+    if (pipe(server->wake) != 0)
+    {
+        output_printf(OUTPUT_STDERR, "Error: Cannot listen on %s: %s\n", path, strerror(errno));
+        close(listener);
+        unlink(path);
+        return 1;
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_t thread;
+        pthread_create(&thread, NULL, work, server);
+        pthread_detach(thread);
+    }
+
+    Watched watched = {malloc(16 * sizeof(struct pollfd)), 0, 16};
+    watch(&watched, listener);
+    watch(&watched, server->wake[0]);
+    bool failed = false;
+    while (!stopping && !failed)
+    {
+        if (poll(watched.fds, watched.count, -1) < 0)
+        {
+            failed = errno != EINTR;
+            continue;
+        }
+
+        // A connection whose next request has started goes to a thread
+        for (int i = 2; i < watched.count; i++)
+        {
+            if (!watched.fds[i].revents)
+                continue;
+            queue(server, watched.fds[i].fd);
+            watched.fds[i--] = watched.fds[--watched.count];
+        }
+        if (watched.fds[1].revents)
+        {
+            char bytes[64];
+            while (read(server->wake[0], bytes, sizeof(bytes)) < 0 && errno == EINTR)
+                ;
+            pthread_mutex_lock(&server->lock);
+            Pending *returned = server->returned;
+            server->returned = NULL;
+            pthread_mutex_unlock(&server->lock);
+            while (returned)
+            {
+                Pending *next = returned->next;
+                watch(&watched, returned->fd);
+                free(returned);
+                returned = next;
+            }
+        }
+        if (watched.fds[0].revents)
+        {
+            int fd = accept(listener, NULL, NULL);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                output_printf(OUTPUT_STDERR, "Error: Cannot accept connections on %s: %s\n", path, strerror(errno));
+                failed = true;
+                continue;
+            }
+            // A client that stops partway through a request releases its thread
+            struct timeval timeout = {.tv_sec = REQUEST_TIMEOUT};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            watch(&watched, fd);
+        }
+    }
+    free(watched.fds);
+
+    // Requests still running end with the process
+    close(listener);
+    unlink(path);
+    return failed ? 1 : 0;
+}
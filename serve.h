@@ -0,0 +1,46 @@
+/* serve.h */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "brainrot.h"
+
+/*
+ * Server mode (--serve): a daemon that runs scripts sent to it over a
+ * Unix domain socket, so a request pays for neither starting a process
+ * nor, for a script seen before, parsing it.
+ *
+ * Checked programs are kept in a cache of SERVE_CACHE_SIZE entries keyed
+ * by the 64-bit FNV-1a hash of their source (as brc_hash computes it),
+ * evicting the least recently used. Requests are served by a fixed pool
+ * of threads, each running one request at a time; a connection only
+ * holds a thread while one of its requests is being read and run, so
+ * clients may stay connected between requests. A client has
+ * REQUEST_TIMEOUT seconds to finish sending a request it has started.
+ *
+ * Every message, in both directions, is a frame: a type byte, the payload
+ * length as a 4-byte integer in the server's byte order, then the
+ * payload. A connection may carry any number of requests in turn:
+ *
+ *   'S' source text      Run this script.
+ *   'H' 8-byte hash      Run the script with this hash sent earlier.
+ *
+ * The server answers a request with the script's output as it is
+ * flushed, in 'O' (stdout) and 'E' (stderr) frames, and ends it with an
+ * 'X' frame whose 4-byte payload is the exit status: the value main gave
+ * bussin, 0 if it ended without one, or 1 if the script did not parse or
+ * check. An 'H' request for a hash the cache does not hold is answered
+ * with an empty 'M' frame instead; the client then sends the source.
+ */
+#define SERVE_CACHE_SIZE 256
+
+/* Largest script accepted, in bytes */
+#define SERVE_MAX_SOURCE (16 * 1024 * 1024)
+
+/*
+ * Listen on the socket at path and serve requests on the given number of
+ * threads until interrupted or terminated. Returns the exit status.
+ */
+int serve(const char *path, int threads, const BrainrotOptions *options);
+
+#endif /* SERVE_H */
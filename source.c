@@ -0,0 +1,121 @@
+/* source.c */
+
+#include "source.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The scanner's in-place buffer, defined in lang.l */
+extern void lex_begin(char *data, size_t size);
+extern void lex_end(void);
+
+/*
+ * Map a regular file followed by at least two zero bytes. The file is
+ * mapped over an anonymous reservation one page longer than it needs, so
+ * the terminator never lands on a page past the end of the file, which
+ * would fault. The mapping is private and writable: writes stay in this
+ * process, which lets a scanner terminate tokens in place.
+ */
+static bool map_file(Source *source, int fd, size_t length)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (length + 2 + page - 1) & ~(page - 1);
+    char *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return false;
+    if (mmap(data, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(data, size);
+        return false;
+    }
+    source->data = data;
+    source->length = length;
+    source->mapped_size = size;
+    return true;
+}
+
+static bool read_stream(Source *source, FILE *file)
+{
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *data = malloc(capacity);
+    if (!data)
+        return false;
+    for (;;)
+    {
+        if (capacity - length <= 2)
+        {
+            capacity *= 2;
+            char *grown = realloc(data, capacity);
+            if (!grown)
+            {
+                free(data);
+                return false;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + length, 1, capacity - length - 2, file);
+        if (n == 0)
+            break;
+        length += n;
+    }
+    if (ferror(file))
+    {
+        free(data);
+        return false;
+    }
+    data[length] = '\0';
+    data[length + 1] = '\0';
+    source->data = data;
+    source->length = length;
+    source->mapped_size = 0;
+    return true;
+}
+
+bool source_read(Source *source, FILE *file)
+{
+    memset(source, 0, sizeof(*source));
+    int fd = fileno(file);
+    struct stat st;
+    // Only a whole regular file can be mapped; /proc files report size 0
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0 &&
+        map_file(source, fd, (size_t)st.st_size))
+        return true;
+    return read_stream(source, file);
+}
+
+bool source_open(Source *source, const char *path)
+{
+    if (strcmp(path, "-") == 0)
+        return source_read(source, stdin);
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    bool read = source_read(source, file);
+    int saved = errno;
+    fclose(file);
+    errno = saved;
+    return read;
+}
+
+void source_scan(Source *source)
+{
+    lex_begin(source->data, source->length + 2);
+}
+
+void source_end_scan(void)
+{
+    lex_end();
+}
+
+void source_release(Source *source)
+{
+    if (source->mapped_size)
+        munmap(source->data, source->mapped_size);
+    else
+        free(source->data);
+    memset(source, 0, sizeof(*source));
+}
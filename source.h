@@ -0,0 +1,44 @@
+/* source.h */
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * The bytes of a program, read in full before parsing so they can be
+ * hashed for the program cache or recognized as a precompiled .brc file.
+ * A regular file is mapped rather than copied; anything else (a pipe or a
+ * terminal) is read into a heap buffer. Either way data is followed by
+ * two NUL bytes that are not counted in length, and is private and
+ * writable, so the scanner works on it in place: string literals are
+ * unescaped where they stand and the program points at them there.
+ */
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t mapped_size; /* 0 if data is a heap buffer */
+} Source;
+
+/* Read all of file; false with errno set if it cannot be read */
+bool source_read(Source *source, FILE *file);
+
+/* Read the file at path, or standard input for "-", as source_read does */
+bool source_open(Source *source, const char *path);
+
+/*
+ * Point this thread's scanner at the source, from line 1. A program
+ * parsed from it refers into data, so the source has to outlive the
+ * program.
+ */
+void source_scan(Source *source);
+
+/* Detach the scanner from the source once parsing is done */
+void source_end_scan(void);
+
+void source_release(Source *source);
+
+#endif /* SOURCE_H */
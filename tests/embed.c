@@ -0,0 +1,183 @@
+/* embed.c */
+
+/*
+ * Runs programs through libbrainrot: each one is parsed once and run
+ * twice, first alone and then on a thread of its own while the others
+ * run too. Both runs must print the same; the first run's output is then
+ * written to stdout and stderr as the brainrot command would print it.
+ *
+ * With --nested, a program is run from inside the write callback of
+ * another one instead, and what each printed goes to stdout.
+ *
+ * Usage: embed tree|vm|jit FILE...
+ *        embed tree|vm|jit --nested
+ */
+
+#include "brainrot.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    char *data;
+    size_t length;
+} Buffer;
+
+typedef struct
+{
+    BrainrotProgram *program;
+    Buffer output[2][2]; /* By run, then by stream */
+    int run;
+} Script;
+
+static void collect(void *context, BrainrotStream stream, const char *data, size_t length)
+{
+    Script *script = context;
+    Buffer *buffer = &script->output[script->run][stream];
+    buffer->data = realloc(buffer->data, buffer->length + length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void *run_again(void *argument)
+{
+    Script *script = argument;
+    script->run = 1;
+    brainrot_run(script->program);
+    return NULL;
+}
+
+/* The outer program of --nested, which runs the inner one whenever it writes */
+typedef struct
+{
+    BrainrotProgram *inner;
+    Buffer output;
+} Nesting;
+
+static void append(Buffer *buffer, const char *data, size_t length)
+{
+    buffer->data = realloc(buffer->data, buffer->length + length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void collect_inner(void *context, BrainrotStream stream, const char *data, size_t length)
+{
+    (void)stream;
+    append(context, data, length);
+}
+
+static void run_inner(void *context, BrainrotStream stream, const char *data, size_t length)
+{
+    Nesting *nesting = context;
+    (void)stream;
+    brainrot_run(nesting->inner);
+    append(&nesting->output, data, length);
+}
+
+static int run_nested(const BrainrotOptions *defaults)
+{
+    static const char outer_source[] = "skibidi main { yapping(\"outer\"); baka(\"outer error\"); }";
+    static const char inner_source[] = "skibidi main { yapping(\"inner\"); }";
+    Nesting nesting = {0};
+    Buffer inner_output = {0};
+
+    BrainrotOptions options = *defaults;
+    options.write = collect_inner;
+    options.context = &inner_output;
+    nesting.inner = brainrot_parse(inner_source, strlen(inner_source), &options);
+    options.write = run_inner;
+    options.context = &nesting;
+    BrainrotProgram *outer = brainrot_parse(outer_source, strlen(outer_source), &options);
+    if (!nesting.inner || !outer)
+        return 1;
+
+    // Twice, so the second run starts from whatever the first one restored
+    brainrot_run(outer);
+    brainrot_run(outer);
+    fwrite(nesting.output.data, 1, nesting.output.length, stdout);
+    fwrite(inner_output.data, 1, inner_output.length, stdout);
+    brainrot_free(outer);
+    brainrot_free(nesting.inner);
+    free(nesting.output.data);
+    free(inner_output.data);
+    return 0;
+}
+
+static bool same(const Buffer *a, const Buffer *b)
+{
+    return a->length == b->length && (a->length == 0 || memcmp(a->data, b->data, a->length) == 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s tree|vm|jit FILE...|--nested\n", argv[0]);
+        return 2;
+    }
+    BrainrotOptions options;
+    brainrot_default_options(&options);
+    options.engine = strcmp(argv[1], "vm") == 0    ? BRAINROT_ENGINE_VM
+                     : strcmp(argv[1], "jit") == 0 ? BRAINROT_ENGINE_JIT
+                                                   : BRAINROT_ENGINE_TREE;
+    if (strcmp(argv[2], "--nested") == 0)
+        return run_nested(&options);
+    options.write = collect;
+
+    int count = argc - 2;
+    Script *scripts = calloc(count, sizeof(Script));
+    for (int i = 0; i < count; i++)
+    {
+        FILE *file = fopen(argv[i + 2], "rb");
+        if (!file)
+        {
+            perror(argv[i + 2]);
+            return 2;
+        }
+        char text[1 << 16];
+        size_t length = fread(text, 1, sizeof(text), file);
+        fclose(file);
+
+        options.context = &scripts[i];
+        scripts[i].program = brainrot_parse(text, length, &options);
+        if (scripts[i].program)
+            brainrot_run(scripts[i].program);
+    }
+
+    pthread_t *threads = calloc(count, sizeof(pthread_t));
+    for (int i = 0; i < count; i++)
+    {
+        if (scripts[i].program)
+            pthread_create(&threads[i], NULL, run_again, &scripts[i]);
+    }
+    int status = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Script *script = &scripts[i];
+        if (script->program)
+        {
+            pthread_join(threads[i], NULL);
+            if (!same(&script->output[0][0], &script->output[1][0]) ||
+                !same(&script->output[0][1], &script->output[1][1]))
+            {
+                fprintf(stderr, "%s: runs printed different output\n", argv[i + 2]);
+                status = 1;
+            }
+        }
+        fwrite(script->output[0][BRAINROT_STDOUT].data, 1, script->output[0][BRAINROT_STDOUT].length, stdout);
+        fwrite(script->output[0][BRAINROT_STDERR].data, 1, script->output[0][BRAINROT_STDERR].length, stderr);
+        brainrot_free(script->program);
+        for (int run = 0; run < 2; run++)
+        {
+            free(script->output[run][0].data);
+            free(script->output[run][1].data);
+        }
+    }
+    free(threads);
+    free(scripts);
+    return status;
+}
@@ -2,15 +2,27 @@ import subprocess
 import json
 import os
 import pytest
+import resource
+import shutil
+import socket
+import struct
+import time
 
 # Load expected results from JSON file
 with open("expected_results.json", "r") as file:
     expected_results = json.load(file)
 
+# Every example must behave identically on each execution engine and
+# optimization level
+ENGINES = ["--engine=tree", "--engine=vm", "--jit"]
+OPT_LEVELS = ["-O0", "-O1", "-O2"]
+
+@pytest.mark.parametrize("opt_level", OPT_LEVELS)
+@pytest.mark.parametrize("engine", ENGINES)
 @pytest.mark.parametrize("example,expected_output", expected_results.items())
-def test_brainrot_examples(example, expected_output):
+def test_brainrot_examples(example, expected_output, engine, opt_level):
     # Define the command to execute
-    command = f".././brainrot < ../examples/{example}"
+    command = f".././brainrot {engine} {opt_level} < ../examples/{example}"
 
     # Run the command and capture the output
     result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True, shell=True)
@@ -33,5 +45,382 @@ def test_brainrot_examples(example, expected_output):
     )
 
 
+# Programs translated to C and compiled with gcc must print the same
+@pytest.mark.skipif(shutil.which("gcc") is None, reason="gcc is not installed")
+@pytest.mark.parametrize("example,expected_output", expected_results.items())
+def test_brainrot_native(example, expected_output, tmp_path):
+    binary = tmp_path / "program"
+    build = subprocess.run(
+        f".././brainrot --native -o {binary} < ../examples/{example}",
+        stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True, shell=True,
+    )
+    assert build.returncode == 0, f"Could not build {example}:\n{build.stderr}"
+
+    result = subprocess.run(str(binary), stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    actual_output = result.stdout.strip() if result.stdout.strip() else result.stderr.strip()
+    assert actual_output == expected_output.strip(), (
+        f"Output for {example} did not match.\n"
+        f"Expected:\n{expected_output}\n"
+        f"Actual:\n{actual_output}\n"
+        f"Stderr:\n{result.stderr}"
+    )
+    assert result.returncode == 0
+
+
+# Buffered output, whatever the buffer size, reads the same as unbuffered
+# output, including the order of yapping and baka on a shared pipe. Four
+# bytes is smaller than any single line written.
+BUFFER_FLAGS = ["--buffer-size=4", "--buffer-size=64", "--buffer-size=65536"]
+MIXED_OUTPUT_PROGRAM = """
+skibidi main {
+    rizz i;
+    flex (i = 0; i < 5; i = i + 1) {
+        yapping("line %d of the regular output", i);
+        edging (i % 2 == 0) {
+            baka("error after line %d", i);
+        }
+    }
+    yappin("no newline ");
+    baka("last error");
+    yapping("done");
+    bussin 0;
+}
+"""
+
+
+def combined_output(flags, source):
+    result = subprocess.run([".././brainrot", *flags], input=source, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, text=True)
+    assert result.returncode == 0
+    return result.stdout
+
+
+@pytest.mark.parametrize("buffer_flag", BUFFER_FLAGS)
+@pytest.mark.parametrize("example", expected_results.keys())
+def test_brainrot_buffered_examples(example, buffer_flag):
+    with open(f"../examples/{example}") as f:
+        source = f.read()
+    assert combined_output([buffer_flag], source) == combined_output(["--unbuffered"], source)
+
+
+@pytest.mark.parametrize("buffer_flag", [None] + BUFFER_FLAGS)
+@pytest.mark.parametrize("engine", ENGINES)
+def test_brainrot_buffered_order(engine, buffer_flag):
+    unbuffered = combined_output([engine, "--unbuffered"], MIXED_OUTPUT_PROGRAM)
+    assert unbuffered.startswith("line 0 of the regular output\nerror after line 0\nline 1")
+    assert unbuffered.endswith("no newline last error\ndone\n")
+    flags = [engine] + ([buffer_flag] if buffer_flag else [])
+    assert combined_output(flags, MIXED_OUTPUT_PROGRAM) == unbuffered
+
+
+# Errors from several operands of one expression are reported in the order
+# the other engines evaluate them, not in whatever order C picks
+ERROR_ORDER_PROGRAM = """
+skibidi rizz noisy(rizz x) {
+    yapping("noisy %d", x);
+    bussin x;
+}
+
+skibidi main {
+    rizz a[3];
+    rizz z = 0;
+    rizz n = 5;
+    yapping("%d", a[n] / a[n + 1] + n / z);
+    yapping("%d %d", n / z, a[n]);
+    a[n + 2] = n / z;
+    a[noisy(4)] = a[n] + noisy(1);
+    edging (a[n] < n / z) {
+        yapping("less");
+    }
+    yapping("%d", noisy(2) / z + a[7] * noisy(3));
+    bussin 0;
+}
+"""
+
+
+@pytest.mark.skipif(shutil.which("gcc") is None, reason="gcc is not installed")
+def test_brainrot_native_error_order(tmp_path):
+    binary = tmp_path / "program"
+    build = subprocess.run([".././brainrot", "--native", "-o", str(binary)], input=ERROR_ORDER_PROGRAM,
+                           stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert build.returncode == 0, build.stderr
+
+    expected = subprocess.run([".././brainrot", "--engine=tree"], input=ERROR_ORDER_PROGRAM,
+                              stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    result = subprocess.run(str(binary), stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stderr.count("Error:") == 14
+    assert (result.stdout, result.stderr) == (expected.stdout, expected.stderr)
+
+
+# A program that does not parse is not translated, and the translation fails
+@pytest.mark.parametrize("mode", ["--emit-c", "--native"])
+def test_brainrot_translate_syntax_error(mode, tmp_path):
+    output = tmp_path / "program"
+    result = subprocess.run([".././brainrot", mode, "-o", str(output)], input="skibidi main { rizz x = ; }",
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert "syntax error" in result.stderr
+    assert result.returncode == 1
+    assert not output.exists()
+
+
+# Programs precompiled with --compile-only, or reused from the --cache
+# directory on a second run, must print the same
+@pytest.mark.parametrize("example,expected_output", expected_results.items())
+def test_brainrot_precompiled(example, expected_output, tmp_path):
+    compiled = tmp_path / "program.brc"
+    build = subprocess.run(
+        f".././brainrot --compile-only -o {compiled} < ../examples/{example}",
+        stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True, shell=True,
+    )
+    assert build.returncode == 0, f"Could not compile {example}:\n{build.stderr}"
+
+    env = dict(os.environ, BRAINROT_CACHE_DIR=str(tmp_path / "cache"))
+    commands = [
+        f".././brainrot < {compiled}",
+        f".././brainrot --cache < ../examples/{example}",
+        f".././brainrot --cache < ../examples/{example}",
+    ]
+    for command in commands:
+        result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True, shell=True,
+                                env=env)
+        actual_output = result.stdout.strip() if result.stdout.strip() else result.stderr.strip()
+        assert actual_output == expected_output.strip(), (
+            f"Output of {command} did not match.\n"
+            f"Expected:\n{expected_output}\n"
+            f"Actual:\n{actual_output}\n"
+            f"Stderr:\n{result.stderr}"
+        )
+        assert result.returncode == 0
+    assert len(list((tmp_path / "cache").iterdir())) == 1
+
+
+# Cached programs are bytecode, which only the virtual machine runs
+@pytest.mark.parametrize("engine", ["--engine=tree", "--jit"])
+def test_brainrot_cache_engine_conflict(engine):
+    result = subprocess.run([".././brainrot", engine, "--cache"], input="skibidi main { yapping(\"hi\"); }",
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stdout == ""
+    assert "Usage:" in result.stderr
+    assert result.returncode != 0
+
+
+# A program that does not parse is not compiled, and compiling it fails
+def test_brainrot_compile_syntax_error(tmp_path):
+    compiled = tmp_path / "program.brc"
+    result = subprocess.run([".././brainrot", "--compile-only", "-o", str(compiled)],
+                            input="skibidi main { rizz x = ; }", stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                            text=True)
+    assert "syntax error" in result.stderr
+    assert result.returncode == 1
+    assert not compiled.exists()
+
+
+# Programs named on the command line run one after another, each as if it
+# had been given alone on stdin
+@pytest.mark.parametrize("example", expected_results.keys())
+def test_brainrot_file_arguments(example):
+    alone = subprocess.run(f".././brainrot < ../examples/{example}", stdout=subprocess.PIPE,
+                           stderr=subprocess.PIPE, text=True, shell=True)
+    result = subprocess.run([".././brainrot", f"../examples/{example}", "missing.brainrot", f"../examples/{example}"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stdout == alone.stdout * 2
+    assert "Cannot read missing.brainrot" in result.stderr
+    assert result.returncode == 1
+
+
+# A batch prints what running its scripts one after another would print,
+# whichever thread ran each of them, followed by each script's time
+@pytest.mark.parametrize("engine", ENGINES)
+def test_brainrot_batch(engine):
+    sequential = subprocess.run([".././brainrot", engine] + [f"../examples/{example}" for example in sorted(expected_results)],
+                                stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    result = subprocess.run([".././brainrot", engine, "--batch", "../examples", "-j", "4"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stdout == sequential.stdout
+    timings = [line for line in result.stderr.splitlines() if line.endswith(" ms")]
+    assert [line.split(":")[0] for line in timings] == [f"../examples/{example}" for example in sorted(expected_results)]
+    assert result.stderr.splitlines()[-1].startswith(f"{len(expected_results)} scripts in ")
+    assert result.returncode == 0
+
+
+def test_brainrot_batch_list(tmp_path):
+    listing = tmp_path / "scripts.txt"
+    listing.write_text("../examples/hello_world.brainrot\n\nmissing.brainrot\n../examples/int.brainrot\n")
+    result = subprocess.run([".././brainrot", "--batch", str(listing), "-j", "2"],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stdout == expected_results["hello_world.brainrot"].strip() + "\n" + \
+        subprocess.run(".././brainrot < ../examples/int.brainrot", shell=True, stdout=subprocess.PIPE, text=True).stdout
+    assert "Error: Cannot read missing.brainrot" in result.stderr
+    assert "3 scripts in " in result.stderr
+    assert result.returncode == 1
+
+
+# A script whose array cannot be allocated stops with an error, and the
+# rest of the batch still runs. The address space limit makes the
+# allocation fail however much memory the machine has.
+@pytest.mark.parametrize("engine", ENGINES)
+def test_brainrot_batch_out_of_memory(engine, tmp_path):
+    (tmp_path / "a.brainrot").write_text('skibidi main { yapping("first"); }')
+    (tmp_path / "b.brainrot").write_text(
+        'skibidi main {\n    yapping("before");\n    giga huge[2000000000];\n    huge[1] = 2;\n    yapping("after");\n}\n')
+    (tmp_path / "c.brainrot").write_text('skibidi main { yapping("last"); }')
+    limit = lambda: resource.setrlimit(resource.RLIMIT_AS, (4 << 30, 4 << 30))
+    result = subprocess.run([".././brainrot", engine, "--batch", str(tmp_path), "-j", "2"], preexec_fn=limit,
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stdout == "first\nbefore\nlast\n"
+    assert "Error: Out of memory at line " in result.stderr
+    assert "3 scripts in " in result.stderr
+    assert result.returncode == 0
+
+
+# A yap array takes a byte per element: 300 million of them fit in an
+# address space of 768 MiB, which 4-byte elements would not
+@pytest.mark.parametrize("engine", ENGINES)
+def test_brainrot_byte_array_size(engine):
+    program = 'skibidi main {\n    yap text[300000000];\n    text[299999999] = 65;\n    yapping("%c", text[299999999]);\n}\n'
+    limit = lambda: resource.setrlimit(resource.RLIMIT_AS, (768 << 20, 768 << 20))
+    result = subprocess.run([".././brainrot", engine], input=program, preexec_fn=limit,
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert (result.returncode, result.stdout, result.stderr) == (0, "A\n", "")
+
+
+# Programs and batch lists read through a pipe are not cut off at the
+# first read buffer
+def test_brainrot_piped_input_over_4k():
+    padding = "".join(f"    // padding line {i:03} to push the program well past one read buffer\n" for i in range(120))
+    program = "skibidi main {\n" + padding + "    yapping(\"piped\");\n}\n"
+    assert len(program) > 8192
+    result = subprocess.run([".././brainrot"], input=program, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert (result.returncode, result.stdout, result.stderr) == (0, "piped\n", "")
+
+    listing = "../examples/hello_world.brainrot\n" * 200
+    assert len(listing) > 4096
+    result = subprocess.run([".././brainrot", "--batch", "-", "-j", "4"], input=listing,
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stdout == "Hello, World!\n" * 200
+    assert "200 scripts in " in result.stderr
+    assert result.returncode == 0
+
+
+def serve_request(sock, kind, payload):
+    """Send one --serve request; returns (status, stdout, stderr), status None if the hash is unknown"""
+    sock.sendall(kind + struct.pack("=I", len(payload)) + payload)
+    received = {b"O": b"", b"E": b""}
+    while True:
+        header = sock.recv(5, socket.MSG_WAITALL)
+        kind, length = header[:1], struct.unpack("=I", header[1:])[0]
+        data = sock.recv(length, socket.MSG_WAITALL) if length else b""
+        if kind == b"X":
+            return struct.unpack("=i", data)[0], received[b"O"].decode(), received[b"E"].decode()
+        if kind == b"M":
+            return None, "", ""
+        received[kind] += data
+
+
+def fnv1a(data):
+    value = 0xcbf29ce484222325
+    for byte in data:
+        value = ((value ^ byte) * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+# A server runs scripts sent as source or, once it has seen them, by hash
+@pytest.mark.parametrize("engine", ENGINES)
+def test_brainrot_serve(engine, tmp_path):
+    path = str(tmp_path / "brainrot.sock")
+    server = subprocess.Popen([".././brainrot", engine, "--serve", path, "-j", "2"])
+    try:
+        while not os.path.exists(path):
+            time.sleep(0.01)
+        with socket.socket(socket.AF_UNIX) as sock:
+            sock.connect(path)
+            for example, expected_output in expected_results.items():
+                with open(f"../examples/{example}", "rb") as f:
+                    source = f.read()
+                by_hash = struct.pack("=Q", fnv1a(source))
+                assert serve_request(sock, b"H", by_hash)[0] is None
+                for kind, payload in ((b"S", source), (b"H", by_hash)):
+                    status, stdout, stderr = serve_request(sock, kind, payload)
+                    assert (stdout.strip() or stderr.strip()) == expected_output.strip()
+                    assert status == 0
+            status, _, stderr = serve_request(sock, b"S", b"skibidi main { yapping(\"%d\", y); }")
+            assert status == 1
+            assert "Undefined variable 'y'" in stderr
+            # The status is the value main gave bussin
+            assert serve_request(sock, b"S", b"skibidi main { bussin 3; }") == (3, "", "")
+            status, stdout, _ = serve_request(sock, b"S", b"skibidi rizz f() { bussin 7; } skibidi main { yapping(\"%d\", f()); }")
+            assert (status, stdout) == (0, "7\n")
+    finally:
+        server.terminate()
+        assert server.wait() == 0
+    assert not os.path.exists(path)
+
+
+# Clients idling between requests do not hold the threads, and a second
+# server does not take over the socket of a live one
+def test_brainrot_serve_idle_clients(tmp_path):
+    path = str(tmp_path / "brainrot.sock")
+    server = subprocess.Popen([".././brainrot", "--serve", path, "-j", "2"])
+    try:
+        while not os.path.exists(path):
+            time.sleep(0.01)
+        second = subprocess.run([".././brainrot", "--serve", path], stderr=subprocess.PIPE, text=True, timeout=5)
+        assert second.returncode == 1
+        assert "already listening" in second.stderr
+
+        idle = [socket.socket(socket.AF_UNIX) for _ in range(3)]
+        try:
+            for sock in idle:
+                sock.connect(path)
+            serve_request(idle[0], b"S", b"skibidi main { yapping(\"warm\"); }")
+            with socket.socket(socket.AF_UNIX) as sock:
+                sock.settimeout(3)
+                sock.connect(path)
+                assert serve_request(sock, b"S", b"skibidi main { yapping(\"served\"); }") == (0, "served\n", "")
+        finally:
+            for sock in idle:
+                sock.close()
+    finally:
+        server.terminate()
+        assert server.wait() == 0
+
+
+# libbrainrot parses each example once and runs it twice, the second time
+# concurrently with the others, with output collected through its callback
+@pytest.fixture(scope="module")
+def embed(tmp_path_factory):
+    if not os.path.exists("../libbrainrot.a"):
+        pytest.skip("libbrainrot.a is not built")
+    binary = str(tmp_path_factory.mktemp("embed") / "embed")
+    subprocess.run(["gcc", "-O2", "-pthread", "-I..", "-o", binary, "embed.c", "../libbrainrot.a"], check=True)
+    return binary
+
+
+@pytest.mark.parametrize("engine", ["tree", "vm", "jit"])
+@pytest.mark.parametrize("example,expected_output", expected_results.items())
+def test_libbrainrot(embed, example, expected_output, engine):
+    result = subprocess.run([embed, engine, f"../examples/{example}"], stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE, text=True)
+    actual_output = result.stdout.strip() if result.stdout.strip() else result.stderr.strip()
+    assert actual_output == expected_output.strip()
+    assert result.returncode == 0, result.stderr
+
+
+@pytest.mark.parametrize("engine", ["tree", "vm", "jit"])
+def test_libbrainrot_threads(embed, engine):
+    examples = [f"../examples/{example}" for example in expected_results]
+    result = subprocess.run([embed, engine] + examples, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert "different output" not in result.stderr
+    assert result.returncode == 0
+
+
+# A program run from the write callback of another restores the outer one's output
+@pytest.mark.parametrize("engine", ["tree", "vm", "jit"])
+def test_libbrainrot_nested(embed, engine):
+    result = subprocess.run([embed, engine, "--nested"], stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    assert result.stdout == "outer\nouter error\n" * 2 + "inner\n" * 4
+    assert result.returncode == 0, result.stderr
+
+
 if __name__ == "__main__":
     pytest.main(["-v", os.path.basename(__file__)])
@@ -0,0 +1,1505 @@
+/* transpile.c */
+
+#include "transpile.h"
+#include "format.h"
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern void yyerror(const char *s);
+
+typedef struct
+{
+    FILE *out;
+    int indent;
+    Function *function; /* Being emitted, or NULL for main */
+    int temporaries;    /* Named so far, to keep their names unique */
+    bool had_error;
+} Emitter;
+
+static void emit_statement(Emitter *e, ASTNode *node);
+static void emit_int(Emitter *e, ASTNode *node);
+static void emit_float(Emitter *e, ASTNode *node);
+static void emit_long(Emitter *e, ASTNode *node);
+static void emit_double(Emitter *e, ASTNode *node);
+
+/*
+ * Runtime support, a fprintf format taking the line errors are reported
+ * at. The helpers mirror evaluate_expression_int and its float, giga and
+ * gigachad counterparts: arithmetic on two's complement ints wraps, and a
+ * zero divisor prints the interpreter's error and yields 0. Arrays
+ * keep their native element type, and an access out of bounds reads 0.
+ */
+static const char *prelude =
+    "#include <stdbool.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "static void br_error(const char *message)\n"
+    "{\n"
+    "    fflush(stdout);\n"
+    "    fprintf(stderr, \"Error: %%s at line %d\\n\", message);\n"
+    "}\n"
+    "\n"
+    "static void division_by_zero(void)\n"
+    "{\n"
+    "    br_error(\"Division by zero\");\n"
+    "}\n"
+    "\n"
+    "/* Elements of size bytes, plus one past the end that out of bounds accesses use */\n"
+    "typedef struct { void *data; int length; int size; } br_array;\n"
+    "\n"
+    "static long long br_empty;\n"
+    "\n"
+    "static void br_declare(br_array *a, int length)\n"
+    "{\n"
+    "    if (a->data != &br_empty)\n"
+    "        free(a->data);\n"
+    "    a->data = &br_empty;\n"
+    "    a->length = 0;\n"
+    "    if (length < 0) { br_error(\"Negative array length\"); return; }\n"
+    "    size_t size = ((size_t)(length + 1) * a->size + 63) & ~(size_t)63;\n"
+    "    a->data = aligned_alloc(64, size);\n"
+    "    if (!a->data) { br_error(\"Out of memory\"); exit(0); }\n"
+    "    memset(a->data, 0, size);\n"
+    "    a->length = length;\n"
+    "}\n"
+    "\n"
+    "static int br_index(br_array *a, int index)\n"
+    "{\n"
+    "    if ((unsigned int)index < (unsigned int)a->length)\n"
+    "        return index;\n"
+    "    br_error(\"Array index out of bounds\");\n"
+    "    memset((char *)a->data + (size_t)a->length * a->size, 0, a->size);\n"
+    "    return a->length;\n"
+    "}\n"
+    "\n"
+    "static inline int br_add(int a, int b) { return (int)((unsigned int)a + (unsigned int)b); }\n"
+    "static inline int br_sub(int a, int b) { return (int)((unsigned int)a - (unsigned int)b); }\n"
+    "static inline int br_mul(int a, int b) { return (int)((unsigned int)a * (unsigned int)b); }\n"
+    "static inline int br_neg(int a) { return (int)(0u - (unsigned int)a); }\n"
+    "\n"
+    "static inline int br_div(int a, int b)\n"
+    "{\n"
+    "    if (b == 0) { division_by_zero(); return 0; }\n"
+    "    return b == -1 ? br_neg(a) : a / b;\n"
+    "}\n"
+    "\n"
+    "static inline int br_mod(int a, int b)\n"
+    "{\n"
+    "    if (b == 0) { division_by_zero(); return 0; }\n"
+    "    return b == -1 ? 0 : a %% b;\n"
+    "}\n"
+    "\n"
+    "static inline int br_udiv(int a, int b)\n"
+    "{\n"
+    "    if (b == 0) { division_by_zero(); return 0; }\n"
+    "    return (int)((unsigned int)a / (unsigned int)b);\n"
+    "}\n"
+    "\n"
+    "static inline int br_umod(int a, int b)\n"
+    "{\n"
+    "    if (b == 0) { division_by_zero(); return 0; }\n"
+    "    return (int)((unsigned int)a %% (unsigned int)b);\n"
+    "}\n"
+    "\n"
+    "static inline float br_fdiv(float a, float b)\n"
+    "{\n"
+    "    if (b == 0.0f) { division_by_zero(); return 0.0f; }\n"
+    "    return a / b;\n"
+    "}\n"
+    "\n"
+    "static inline long long br_ladd(long long a, long long b) { return (long long)((unsigned long long)a + (unsigned long long)b); }\n"
+    "static inline long long br_lsub(long long a, long long b) { return (long long)((unsigned long long)a - (unsigned long long)b); }\n"
+    "static inline long long br_lmul(long long a, long long b) { return (long long)((unsigned long long)a * (unsigned long long)b); }\n"
+    "static inline long long br_lneg(long long a) { return (long long)(0ull - (unsigned long long)a); }\n"
+    "\n"
+    "static inline long long br_ldiv(long long a, long long b)\n"
+    "{\n"
+    "    if (b == 0) { division_by_zero(); return 0; }\n"
+    "    return b == -1 ? br_lneg(a) : a / b;\n"
+    "}\n"
+    "\n"
+    "static inline long long br_lmod(long long a, long long b)\n"
+    "{\n"
+    "    if (b == 0) { division_by_zero(); return 0; }\n"
+    "    return b == -1 ? 0 : a %% b;\n"
+    "}\n"
+    "\n"
+    "static inline double br_ddiv(double a, double b)\n"
+    "{\n"
+    "    if (b == 0.0) { division_by_zero(); return 0.0; }\n"
+    "    return a / b;\n"
+    "}\n"
+    "\n";
+
+/*
+ * Calls keep the interpreter's count of frames and variables in use, so
+ * recursion fails at the same depth with the same error.
+ */
+static const char *call_prelude =
+    "static int br_depth;\n"
+    "static int br_frame_top;\n"
+    "\n"
+    "static int br_enter(int size)\n"
+    "{\n"
+    "    if (br_depth == %d || size > %d - br_frame_top)\n"
+    "    {\n"
+    "        br_error(\"Recursion too deep\");\n"
+    "        return 0;\n"
+    "    }\n"
+    "    br_depth++;\n"
+    "    br_frame_top += size;\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static void br_leave(int size)\n"
+    "{\n"
+    "    br_depth--;\n"
+    "    br_frame_top -= size;\n"
+    "}\n"
+    "\n"
+    "static void br_release(br_array *a)\n"
+    "{\n"
+    "    if (a->data != &br_empty)\n"
+    "        free(a->data);\n"
+    "}\n"
+    "\n";
+
+static void error(Emitter *e, const char *message)
+{
+    if (!e->had_error)
+        yyerror(message);
+    e->had_error = true;
+}
+
+static void emit_indent(Emitter *e)
+{
+    fprintf(e->out, "%*s", e->indent * 4, "");
+}
+
+/* Variables */
+
+/* The C name of a variable; hidden variables from the optimizer are not valid C names */
+static void emit_variable_name(Emitter *e, int slot)
+{
+    const char *name = variable_name(&symbol_table[slot]);
+    bool valid = isalpha((unsigned char)name[0]) || name[0] == '_';
+    for (const char *p = name; *p && valid; p++)
+    {
+        valid = isalnum((unsigned char)*p) || *p == '_';
+    }
+    if (valid)
+        fprintf(e->out, "v_%s", name);
+    else
+        fprintf(e->out, "t%d", slot);
+}
+
+static const char *c_value_type(ValueType type)
+{
+    switch (type)
+    {
+    case TYPE_UNSIGNED:
+        return "unsigned int";
+    case TYPE_SHORT:
+        return "short";
+    case TYPE_LONG:
+        return "long long";
+    case TYPE_FLOAT:
+        return "float";
+    case TYPE_DOUBLE:
+        return "double";
+    case TYPE_BOOL:
+        return "bool";
+    case TYPE_CHAR:
+        return "char";
+    default:
+        return "int";
+    }
+}
+
+static const char *c_type(const variable *var)
+{
+    return c_value_type(var->type);
+}
+
+/* Declare every variable from slot first on, zeroed as a new frame is */
+static void emit_declarations(Emitter *e, int first)
+{
+    for (int slot = first; slot < var_count; slot++)
+    {
+        const variable *var = &symbol_table[slot];
+        emit_indent(e);
+        if (var->is_array)
+        {
+            fprintf(e->out, "br_array ");
+            emit_variable_name(e, slot);
+            fprintf(e->out, " = {&br_empty, 0, sizeof(%s)};\n", c_type(var));
+            continue;
+        }
+        fprintf(e->out, "%s%s ", var->modifiers.is_volatile ? "volatile " : "", c_type(var));
+        emit_variable_name(e, slot);
+        fprintf(e->out, " = 0;\n");
+    }
+}
+
+/* Expressions */
+
+static bool is_binary(NodeType type)
+{
+    return type >= NODE_INT_ADD && type <= NODE_LOGICAL_OR && type != NODE_INT_NEG && type != NODE_FLOAT_NEG;
+}
+
+static bool is_unary(NodeType type)
+{
+    return type == NODE_INT_NEG || type == NODE_FLOAT_NEG || (type >= NODE_LONG_NEG && type <= NODE_DOUBLE_TO_BOOL);
+}
+
+/* True if evaluating node calls a user-defined function */
+static bool has_call(ASTNode *node)
+{
+    if (!node)
+        return false;
+    if (node->type == NODE_FUNC_CALL)
+        return true;
+    if (node->type == NODE_INDEX)
+        return has_call(node->data.element.index);
+    if (is_binary(node->type))
+        return has_call(node->data.op.left) || has_call(node->data.op.right);
+    if (is_unary(node->type))
+        return has_call(node->data.unary.operand);
+    return false;
+}
+
+/* True if evaluating node can call a function or report an error */
+static bool has_effects(ASTNode *node)
+{
+    if (!node)
+        return false;
+    switch (node->type)
+    {
+    case NODE_FUNC_CALL:
+    case NODE_INT_DIV:
+    case NODE_INT_MOD:
+    case NODE_UNSIGNED_DIV:
+    case NODE_UNSIGNED_MOD:
+    case NODE_FLOAT_DIV:
+    case NODE_LONG_DIV:
+    case NODE_LONG_MOD:
+    case NODE_DOUBLE_DIV:
+        return true;
+    case NODE_INDEX:
+        return !node->data.element.unchecked || has_effects(node->data.element.index);
+    default:
+        break;
+    }
+    if (is_binary(node->type))
+        return has_effects(node->data.op.left) || has_effects(node->data.op.right);
+    if (is_unary(node->type))
+        return has_effects(node->data.unary.operand);
+    return false;
+}
+
+/*
+ * C leaves the order in which operands and arguments are evaluated
+ * unspecified. That is visible once several of them can report an error
+ * or call a function that prints, so they are then evaluated left to
+ * right into temporaries first.
+ */
+static bool needs_sequencing(ASTNode **operands, int count)
+{
+    int with_effects = 0;
+    for (int i = 0; i < count; i++)
+    {
+        with_effects += has_effects(operands[i]);
+    }
+    return with_effects > 1;
+}
+
+/* A C expression for node as a value of type; every integer type narrower than giga is an int */
+static void emit_value(Emitter *e, ASTNode *node, ValueType type)
+{
+    switch (type)
+    {
+    case TYPE_FLOAT:
+        emit_float(e, node);
+        break;
+    case TYPE_DOUBLE:
+        emit_double(e, node);
+        break;
+    case TYPE_LONG:
+        emit_long(e, node);
+        break;
+    default:
+        emit_int(e, node);
+        break;
+    }
+}
+
+/* Open a statement expression declaring a temporary set to node; returns its number */
+static int emit_temporary(Emitter *e, ASTNode *node, ValueType type)
+{
+    int temporary = e->temporaries++;
+    bool native = type == TYPE_FLOAT || is_wide_type(type);
+    fprintf(e->out, "%s br_t%d = ", native ? c_value_type(type) : "int", temporary);
+    emit_value(e, node, type);
+    fprintf(e->out, "; ");
+    return temporary;
+}
+
+/* Node, or the temporary already holding its value unless that is -1 */
+static void emit_operand(Emitter *e, ASTNode *node, int temporary, ValueType type)
+{
+    if (temporary >= 0)
+        fprintf(e->out, "br_t%d", temporary);
+    else
+        emit_value(e, node, type);
+}
+
+/* Start a binary operation; the left operand's temporary, or -1 if order does not matter */
+static int begin_binary(Emitter *e, ASTNode *node, ValueType type)
+{
+    ASTNode *operands[] = {node->data.op.left, node->data.op.right};
+    if (!needs_sequencing(operands, 2))
+        return -1;
+    fprintf(e->out, "({ ");
+    return emit_temporary(e, node->data.op.left, type);
+}
+
+static void end_binary(Emitter *e, int left)
+{
+    if (left >= 0)
+        fprintf(e->out, "; })");
+}
+
+static void emit_int_literal(Emitter *e, int value)
+{
+    if (value == INT_MIN)
+        fprintf(e->out, "(-2147483647 - 1)");
+    else if (value < 0)
+        fprintf(e->out, "(%d)", value);
+    else
+        fprintf(e->out, "%d", value);
+}
+
+/* A float literal that reads back as exactly the same value */
+static void emit_float_literal(Emitter *e, float value)
+{
+    if (isnan(value))
+    {
+        fprintf(e->out, signbit(value) ? "(-__builtin_nanf(\"\"))" : "__builtin_nanf(\"\")");
+        return;
+    }
+    if (isinf(value))
+    {
+        fprintf(e->out, value < 0 ? "(-__builtin_inff())" : "__builtin_inff()");
+        return;
+    }
+
+    char text[64];
+    snprintf(text, sizeof(text), "%.9g", value);
+    bool has_point = strpbrk(text, ".e") != NULL;
+    fprintf(e->out, value < 0 || signbit(value) ? "(%s%sf)" : "%s%sf", text, has_point ? "" : ".0");
+}
+
+static void emit_long_literal(Emitter *e, int64_t value)
+{
+    if (value == INT64_MIN)
+        fprintf(e->out, "(-9223372036854775807LL - 1)");
+    else
+        fprintf(e->out, value < 0 ? "(%lldLL)" : "%lldLL", (long long)value);
+}
+
+/* A double literal that reads back as exactly the same value */
+static void emit_double_literal(Emitter *e, double value)
+{
+    if (isnan(value))
+    {
+        fprintf(e->out, signbit(value) ? "(-__builtin_nan(\"\"))" : "__builtin_nan(\"\")");
+        return;
+    }
+    if (isinf(value))
+    {
+        fprintf(e->out, value < 0 ? "(-__builtin_inf())" : "__builtin_inf()");
+        return;
+    }
+
+    char text[64];
+    snprintf(text, sizeof(text), "%.17g", value);
+    bool has_point = strpbrk(text, ".e") != NULL;
+    fprintf(e->out, value < 0 || signbit(value) ? "(%s%s)" : "%s%s", text, has_point ? "" : ".0");
+}
+
+/* A call to a runtime helper taking both operands in type */
+static void emit_call(Emitter *e, const char *function, ASTNode *node, ValueType type)
+{
+    int left = begin_binary(e, node, type);
+    fprintf(e->out, "%s(", function);
+    emit_operand(e, node->data.op.left, left, type);
+    fprintf(e->out, ", ");
+    emit_value(e, node->data.op.right, type);
+    fprintf(e->out, ")");
+    end_binary(e, left);
+}
+
+/* A C operator applied to both operands in type */
+static void emit_binary(Emitter *e, ASTNode *node, const char *operator, ValueType type)
+{
+    int left = begin_binary(e, node, type);
+    fprintf(e->out, "(");
+    emit_operand(e, node->data.op.left, left, type);
+    fprintf(e->out, " %s ", operator);
+    emit_value(e, node->data.op.right, type);
+    fprintf(e->out, ")");
+    end_binary(e, left);
+}
+
+static void emit_unsigned_comparison(Emitter *e, ASTNode *node, const char *operator)
+{
+    int left = begin_binary(e, node, TYPE_INT);
+    fprintf(e->out, "((unsigned int)");
+    emit_operand(e, node->data.op.left, left, TYPE_INT);
+    fprintf(e->out, " %s (unsigned int)", operator);
+    emit_int(e, node->data.op.right);
+    fprintf(e->out, ")");
+    end_binary(e, left);
+}
+
+/* The C name of a user-defined function */
+static void emit_function_name(Emitter *e, const Function *function)
+{
+    fprintf(e->out, "f_%s", atom_name(ast_atoms, function->name));
+}
+
+/* A call to a user-defined function, with its arguments in their parameters' types */
+static void emit_function_call(Emitter *e, ASTNode *node)
+{
+    Function *function = current_program->functions[node->slot];
+    const variable *parameters = function->scope.symbols;
+    ASTNode *arguments[MAX_VARS];
+    int count = 0;
+    for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next)
+    {
+        arguments[count++] = arg->expr;
+    }
+
+    int temporaries[MAX_VARS];
+    bool sequenced = needs_sequencing(arguments, count);
+    if (sequenced)
+        fprintf(e->out, "({ ");
+    for (int i = 0; i < count; i++)
+    {
+        temporaries[i] = sequenced ? emit_temporary(e, arguments[i], parameters[i].type) : -1;
+    }
+    emit_function_name(e, function);
+    fprintf(e->out, "(");
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0)
+            fprintf(e->out, ", ");
+        if (parameters[i].type == TYPE_UNSIGNED)
+            fprintf(e->out, "(unsigned int)");
+        emit_operand(e, arguments[i], temporaries[i], parameters[i].type);
+    }
+    fprintf(e->out, ")");
+    if (sequenced)
+        fprintf(e->out, "; })");
+}
+
+/* The operand, as a value of type, between two pieces of C */
+static void emit_unary(Emitter *e, ValueType type, const char *before, ASTNode *operand, const char *after)
+{
+    fprintf(e->out, "%s", before);
+    emit_value(e, operand, type);
+    fprintf(e->out, "%s", after);
+}
+
+/*
+ * The lvalue of the element an index or index assignment node accesses,
+ * at the index held by a temporary unless that is -1.
+ */
+static void emit_element(Emitter *e, ASTNode *node, int index)
+{
+    fprintf(e->out, "((%s *)", c_type(&symbol_table[node->slot]));
+    emit_variable_name(e, node->slot);
+    fprintf(e->out, ".data)[");
+    if (node->data.element.unchecked)
+    {
+        emit_operand(e, node->data.element.index, index, TYPE_INT);
+    }
+    else
+    {
+        fprintf(e->out, "br_index(&");
+        emit_variable_name(e, node->slot);
+        fprintf(e->out, ", ");
+        emit_operand(e, node->data.element.index, index, TYPE_INT);
+        fprintf(e->out, ")");
+    }
+    fprintf(e->out, "]");
+}
+
+/* A C expression of type int, or promoted to int, for an integer-valued node */
+static void emit_int(Emitter *e, ASTNode *node)
+{
+    if (!node)
+    {
+        fprintf(e->out, "0");
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+        emit_int_literal(e, node->data.value);
+        break;
+    case NODE_IDENTIFIER:
+        if (symbol_table[node->slot].type == TYPE_UNSIGNED)
+            fprintf(e->out, "(int)");
+        emit_variable_name(e, node->slot);
+        break;
+    case NODE_INDEX:
+        if (symbol_table[node->slot].type == TYPE_UNSIGNED)
+            fprintf(e->out, "(int)");
+        emit_element(e, node, -1);
+        break;
+    case NODE_FUNC_CALL:
+        if (node->slot < 0 || node->value_type == TYPE_FLOAT || is_wide_type(node->value_type))
+        {
+            error(e, "Expression cannot be translated to C");
+            break;
+        }
+        if (node->value_type == TYPE_UNSIGNED)
+            fprintf(e->out, "(int)");
+        emit_function_call(e, node);
+        break;
+    case NODE_INT_ADD:
+        emit_call(e, "br_add", node, TYPE_INT);
+        break;
+    case NODE_INT_SUB:
+        emit_call(e, "br_sub", node, TYPE_INT);
+        break;
+    case NODE_INT_MUL:
+        emit_call(e, "br_mul", node, TYPE_INT);
+        break;
+    case NODE_INT_DIV:
+        emit_call(e, "br_div", node, TYPE_INT);
+        break;
+    case NODE_INT_MOD:
+        emit_call(e, "br_mod", node, TYPE_INT);
+        break;
+    case NODE_UNSIGNED_DIV:
+        emit_call(e, "br_udiv", node, TYPE_INT);
+        break;
+    case NODE_UNSIGNED_MOD:
+        emit_call(e, "br_umod", node, TYPE_INT);
+        break;
+    case NODE_INT_LT:
+        emit_binary(e, node, "<", TYPE_INT);
+        break;
+    case NODE_INT_GT:
+        emit_binary(e, node, ">", TYPE_INT);
+        break;
+    case NODE_INT_LE:
+        emit_binary(e, node, "<=", TYPE_INT);
+        break;
+    case NODE_INT_GE:
+        emit_binary(e, node, ">=", TYPE_INT);
+        break;
+    case NODE_INT_EQ:
+        emit_binary(e, node, "==", TYPE_INT);
+        break;
+    case NODE_INT_NE:
+        emit_binary(e, node, "!=", TYPE_INT);
+        break;
+    case NODE_UNSIGNED_LT:
+        emit_unsigned_comparison(e, node, "<");
+        break;
+    case NODE_UNSIGNED_GT:
+        emit_unsigned_comparison(e, node, ">");
+        break;
+    case NODE_UNSIGNED_LE:
+        emit_unsigned_comparison(e, node, "<=");
+        break;
+    case NODE_UNSIGNED_GE:
+        emit_unsigned_comparison(e, node, ">=");
+        break;
+    case NODE_FLOAT_LT:
+        emit_binary(e, node, "<", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_GT:
+        emit_binary(e, node, ">", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_LE:
+        emit_binary(e, node, "<=", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_GE:
+        emit_binary(e, node, ">=", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_EQ:
+        emit_binary(e, node, "==", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_NE:
+        emit_binary(e, node, "!=", TYPE_FLOAT);
+        break;
+    case NODE_LONG_LT:
+        emit_binary(e, node, "<", TYPE_LONG);
+        break;
+    case NODE_LONG_GT:
+        emit_binary(e, node, ">", TYPE_LONG);
+        break;
+    case NODE_LONG_LE:
+        emit_binary(e, node, "<=", TYPE_LONG);
+        break;
+    case NODE_LONG_GE:
+        emit_binary(e, node, ">=", TYPE_LONG);
+        break;
+    case NODE_LONG_EQ:
+        emit_binary(e, node, "==", TYPE_LONG);
+        break;
+    case NODE_LONG_NE:
+        emit_binary(e, node, "!=", TYPE_LONG);
+        break;
+    case NODE_DOUBLE_LT:
+        emit_binary(e, node, "<", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_GT:
+        emit_binary(e, node, ">", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_LE:
+        emit_binary(e, node, "<=", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_GE:
+        emit_binary(e, node, ">=", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_EQ:
+        emit_binary(e, node, "==", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_NE:
+        emit_binary(e, node, "!=", TYPE_DOUBLE);
+        break;
+    case NODE_LOGICAL_AND:
+        emit_binary(e, node, "&&", TYPE_INT);
+        break;
+    case NODE_LOGICAL_OR:
+        emit_binary(e, node, "||", TYPE_INT);
+        break;
+    case NODE_INT_NEG:
+        emit_unary(e, TYPE_INT, "br_neg(", node->data.unary.operand, ")");
+        break;
+    case NODE_FLOAT_TO_INT:
+        emit_unary(e, TYPE_FLOAT, "(int)", node->data.unary.operand, "");
+        break;
+    case NODE_FLOAT_TO_UNSIGNED:
+        emit_unary(e, TYPE_FLOAT, "(int)(unsigned int)", node->data.unary.operand, "");
+        break;
+    case NODE_FLOAT_TO_BOOL:
+        emit_unary(e, TYPE_FLOAT, "(", node->data.unary.operand, " != 0.0f)");
+        break;
+    case NODE_INT_TO_BOOL:
+        emit_unary(e, TYPE_INT, "(", node->data.unary.operand, " != 0)");
+        break;
+    case NODE_INT_TO_CHAR:
+        emit_unary(e, TYPE_INT, "(char)", node->data.unary.operand, "");
+        break;
+    case NODE_INT_TO_SHORT:
+        emit_unary(e, TYPE_INT, "(short)", node->data.unary.operand, "");
+        break;
+    case NODE_LONG_TO_INT:
+        emit_unary(e, TYPE_LONG, "(int)", node->data.unary.operand, "");
+        break;
+    case NODE_LONG_TO_BOOL:
+        emit_unary(e, TYPE_LONG, "(", node->data.unary.operand, " != 0)");
+        break;
+    case NODE_DOUBLE_TO_INT:
+        emit_unary(e, TYPE_DOUBLE, "(int)", node->data.unary.operand, "");
+        break;
+    case NODE_DOUBLE_TO_UNSIGNED:
+        emit_unary(e, TYPE_DOUBLE, "(int)(unsigned int)", node->data.unary.operand, "");
+        break;
+    case NODE_DOUBLE_TO_BOOL:
+        emit_unary(e, TYPE_DOUBLE, "(", node->data.unary.operand, " != 0.0)");
+        break;
+    default:
+        error(e, "Expression cannot be translated to C");
+        break;
+    }
+}
+
+/* A C expression of type float for a float-valued node */
+static void emit_float(Emitter *e, ASTNode *node)
+{
+    if (!node)
+    {
+        fprintf(e->out, "0.0f");
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_FLOAT:
+        emit_float_literal(e, node->data.fvalue);
+        break;
+    case NODE_IDENTIFIER:
+        emit_variable_name(e, node->slot);
+        break;
+    case NODE_INDEX:
+        emit_element(e, node, -1);
+        break;
+    case NODE_FUNC_CALL:
+        if (node->slot < 0 || node->value_type != TYPE_FLOAT)
+        {
+            error(e, "Expression cannot be translated to C");
+            break;
+        }
+        emit_function_call(e, node);
+        break;
+    case NODE_FLOAT_ADD:
+        emit_binary(e, node, "+", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_SUB:
+        emit_binary(e, node, "-", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_MUL:
+        emit_binary(e, node, "*", TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_DIV:
+        emit_call(e, "br_fdiv", node, TYPE_FLOAT);
+        break;
+    case NODE_FLOAT_NEG:
+        emit_unary(e, TYPE_FLOAT, "(-", node->data.unary.operand, ")");
+        break;
+    case NODE_INT_TO_FLOAT:
+        emit_unary(e, TYPE_INT, "(float)", node->data.unary.operand, "");
+        break;
+    case NODE_UNSIGNED_TO_FLOAT:
+        emit_unary(e, TYPE_INT, "(float)(unsigned int)", node->data.unary.operand, "");
+        break;
+    case NODE_LONG_TO_FLOAT:
+        emit_unary(e, TYPE_LONG, "(float)", node->data.unary.operand, "");
+        break;
+    case NODE_DOUBLE_TO_FLOAT:
+        emit_unary(e, TYPE_DOUBLE, "(float)", node->data.unary.operand, "");
+        break;
+    default:
+        error(e, "Expression cannot be translated to C");
+        break;
+    }
+}
+
+/* A C expression of type long long for a giga-valued node */
+static void emit_long(Emitter *e, ASTNode *node)
+{
+    if (!node)
+    {
+        fprintf(e->out, "0LL");
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_LONG:
+        emit_long_literal(e, node->data.lvalue);
+        break;
+    case NODE_IDENTIFIER:
+        emit_variable_name(e, node->slot);
+        break;
+    case NODE_INDEX:
+        emit_element(e, node, -1);
+        break;
+    case NODE_FUNC_CALL:
+        if (node->slot < 0 || node->value_type != TYPE_LONG)
+        {
+            error(e, "Expression cannot be translated to C");
+            break;
+        }
+        emit_function_call(e, node);
+        break;
+    case NODE_LONG_ADD:
+        emit_call(e, "br_ladd", node, TYPE_LONG);
+        break;
+    case NODE_LONG_SUB:
+        emit_call(e, "br_lsub", node, TYPE_LONG);
+        break;
+    case NODE_LONG_MUL:
+        emit_call(e, "br_lmul", node, TYPE_LONG);
+        break;
+    case NODE_LONG_DIV:
+        emit_call(e, "br_ldiv", node, TYPE_LONG);
+        break;
+    case NODE_LONG_MOD:
+        emit_call(e, "br_lmod", node, TYPE_LONG);
+        break;
+    case NODE_LONG_NEG:
+        emit_unary(e, TYPE_LONG, "br_lneg(", node->data.unary.operand, ")");
+        break;
+    case NODE_INT_TO_LONG:
+        emit_unary(e, TYPE_INT, "(long long)", node->data.unary.operand, "");
+        break;
+    case NODE_UNSIGNED_TO_LONG:
+        emit_unary(e, TYPE_INT, "(long long)(unsigned int)", node->data.unary.operand, "");
+        break;
+    case NODE_FLOAT_TO_LONG:
+        emit_unary(e, TYPE_FLOAT, "(long long)", node->data.unary.operand, "");
+        break;
+    case NODE_DOUBLE_TO_LONG:
+        emit_unary(e, TYPE_DOUBLE, "(long long)", node->data.unary.operand, "");
+        break;
+    default:
+        error(e, "Expression cannot be translated to C");
+        break;
+    }
+}
+
+/* A C expression of type double for a gigachad-valued node */
+static void emit_double(Emitter *e, ASTNode *node)
+{
+    if (!node)
+    {
+        fprintf(e->out, "0.0");
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_DOUBLE:
+        emit_double_literal(e, node->data.dvalue);
+        break;
+    case NODE_IDENTIFIER:
+        emit_variable_name(e, node->slot);
+        break;
+    case NODE_INDEX:
+        emit_element(e, node, -1);
+        break;
+    case NODE_FUNC_CALL:
+        if (node->slot < 0 || node->value_type != TYPE_DOUBLE)
+        {
+            error(e, "Expression cannot be translated to C");
+            break;
+        }
+        emit_function_call(e, node);
+        break;
+    case NODE_DOUBLE_ADD:
+        emit_binary(e, node, "+", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_SUB:
+        emit_binary(e, node, "-", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_MUL:
+        emit_binary(e, node, "*", TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_DIV:
+        emit_call(e, "br_ddiv", node, TYPE_DOUBLE);
+        break;
+    case NODE_DOUBLE_NEG:
+        emit_unary(e, TYPE_DOUBLE, "(-", node->data.unary.operand, ")");
+        break;
+    case NODE_INT_TO_DOUBLE:
+        emit_unary(e, TYPE_INT, "(double)", node->data.unary.operand, "");
+        break;
+    case NODE_UNSIGNED_TO_DOUBLE:
+        emit_unary(e, TYPE_INT, "(double)(unsigned int)", node->data.unary.operand, "");
+        break;
+    case NODE_LONG_TO_DOUBLE:
+        emit_unary(e, TYPE_LONG, "(double)", node->data.unary.operand, "");
+        break;
+    case NODE_FLOAT_TO_DOUBLE:
+        emit_unary(e, TYPE_FLOAT, "(double)", node->data.unary.operand, "");
+        break;
+    default:
+        error(e, "Expression cannot be translated to C");
+        break;
+    }
+}
+
+/*
+ * An assignment or other expression, written as a C expression. A list of
+ * them, as in the increment of a strength-reduced loop, becomes a comma
+ * expression.
+ */
+static void emit_expression(Emitter *e, ASTNode *node)
+{
+    if (node->type == NODE_STATEMENT_LIST)
+    {
+        if (!node->data.statements)
+        {
+            fprintf(e->out, "(void)0");
+            return;
+        }
+        fprintf(e->out, "(");
+        for (StatementList *current = node->data.statements; current; current = current->next)
+        {
+            emit_expression(e, current->statement);
+            if (current->next)
+                fprintf(e->out, ", ");
+        }
+        fprintf(e->out, ")");
+        return;
+    }
+    if (node->type == NODE_ASSIGNMENT)
+    {
+        int slot = node->data.op.left->slot;
+        emit_variable_name(e, slot);
+        fprintf(e->out, symbol_table[slot].type == TYPE_UNSIGNED ? " = (unsigned int)" : " = ");
+        emit_value(e, node->data.op.right, node->value_type);
+        return;
+    }
+    if (node->type == NODE_INDEX_ASSIGNMENT)
+    {
+        // The index, then the value, then the bounds check, as in the interpreter
+        ValueType type = node->value_type;
+        int index = -1;
+        int value = -1;
+        // The bounds check is part of the element, which C need not evaluate after the value
+        ASTNode *operands[] = {node->data.element.index, node->data.element.value};
+        bool sequenced = has_call(operands[0]) || has_call(operands[1]) || needs_sequencing(operands, 2) ||
+                         (!node->data.element.unchecked && has_effects(operands[1]));
+        if (sequenced)
+        {
+            fprintf(e->out, "({ ");
+            index = emit_temporary(e, node->data.element.index, TYPE_INT);
+            value = emit_temporary(e, node->data.element.value, type);
+        }
+        emit_element(e, node, index);
+        fprintf(e->out, node->value_type == TYPE_UNSIGNED ? " = (unsigned int)" : " = ");
+        emit_operand(e, node->data.element.value, value, type);
+        if (sequenced)
+            fprintf(e->out, "; })");
+        return;
+    }
+    if (node->type == NODE_ARRAY_DECLARATION)
+    {
+        fprintf(e->out, "br_declare(&");
+        emit_variable_name(e, node->slot);
+        fprintf(e->out, ", ");
+        emit_int(e, node->data.element.index);
+        fprintf(e->out, ")");
+        return;
+    }
+
+    // Evaluated for its effects, like evaluate_expression
+    fprintf(e->out, "(void)");
+    emit_value(e, node, node->value_type);
+}
+
+/* Prints */
+
+/* Write text as the inside of a C string literal; in a format, % is doubled */
+static void emit_string_text(Emitter *e, const char *text, size_t length, bool format)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        switch (c)
+        {
+        case '\\':
+            fputs("\\\\", e->out);
+            break;
+        case '"':
+            fputs("\\\"", e->out);
+            break;
+        case '\n':
+            fputs("\\n", e->out);
+            break;
+        case '\t':
+            fputs("\\t", e->out);
+            break;
+        case '%':
+            fputs(format ? "%%" : "%", e->out);
+            break;
+        case '?':
+            // Keep "??" from starting a trigraph
+            fputs(i > 0 && text[i - 1] == '?' ? "\\?" : "?", e->out);
+            break;
+        default:
+            if (c < 0x20 || c == 0x7f)
+                fprintf(e->out, "\\%03o", c);
+            else
+                fputc(c, e->out);
+            break;
+        }
+    }
+}
+
+/* One fprintf for the whole format, with the placeholders rendered by printf */
+static void emit_print(Emitter *e, const Format *format)
+{
+    if (format->segment_count == 0)
+        return;
+
+    // Values are all computed before anything is printed
+    ASTNode *values[MAX_FORMAT_ARGUMENTS];
+    int temporaries[MAX_FORMAT_ARGUMENTS];
+    int value = 0;
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        if (format->segments[i].argument)
+            values[value++] = format->segments[i].argument->expr;
+    }
+    bool sequenced = needs_sequencing(values, value);
+    for (int i = 0; i < value; i++)
+    {
+        sequenced = sequenced || has_call(values[i]);
+    }
+    if (sequenced)
+    {
+        emit_indent(e);
+        fprintf(e->out, "{ ");
+    }
+    for (int i = 0; i < value; i++)
+    {
+        temporaries[i] = sequenced ? emit_temporary(e, values[i], values[i]->value_type) : -1;
+    }
+    if (sequenced)
+        fprintf(e->out, "\n");
+    value = 0;
+
+    const char *stream = format->stream == OUTPUT_STDOUT ? "stdout" : "stderr";
+    emit_indent(e);
+    if (format->stream == OUTPUT_STDERR)
+    {
+        // Keep stdout and stderr in program order, as the interpreter does
+        fprintf(e->out, "fflush(stdout);\n");
+        emit_indent(e);
+    }
+    fprintf(e->out, "fprintf(%s, \"", stream);
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        const FormatSegment *segment = &format->segments[i];
+        switch (segment->kind)
+        {
+        case SEGMENT_TEXT:
+            emit_string_text(e, segment->text, segment->length, true);
+            break;
+        case SEGMENT_INT:
+            fputs("%d", e->out);
+            break;
+        case SEGMENT_UNSIGNED:
+            fputs("%u", e->out);
+            break;
+        case SEGMENT_CHAR:
+            fputs("%c", e->out);
+            break;
+        case SEGMENT_BOOL:
+            fputs("%s", e->out);
+            break;
+        case SEGMENT_FLOAT:
+            fprintf(e->out, "%%.%df", segment->precision);
+            break;
+        case SEGMENT_LONG:
+            fputs("%lld", e->out);
+            break;
+        case SEGMENT_PRINTF_INT:
+        case SEGMENT_PRINTF_FLOAT:
+        case SEGMENT_PRINTF_LONG:
+        case SEGMENT_PRINTF_DOUBLE:
+            emit_string_text(e, segment->text, strlen(segment->text), false);
+            break;
+        }
+    }
+    fputc('"', e->out);
+
+    for (int i = 0; i < format->segment_count; i++)
+    {
+        const FormatSegment *segment = &format->segments[i];
+        if (!segment->argument)
+            continue;
+        ASTNode *expr = segment->argument->expr;
+        int temporary = temporaries[value++];
+        fprintf(e->out, ", ");
+        switch (segment->kind)
+        {
+        case SEGMENT_UNSIGNED:
+            fprintf(e->out, "(unsigned int)");
+            emit_operand(e, expr, temporary, TYPE_INT);
+            break;
+        case SEGMENT_BOOL:
+            fprintf(e->out, "(");
+            emit_operand(e, expr, temporary, TYPE_INT);
+            fprintf(e->out, " ? \"yes\" : \"no\")");
+            break;
+        case SEGMENT_FLOAT:
+        case SEGMENT_PRINTF_FLOAT:
+            fprintf(e->out, "(double)");
+            emit_operand(e, expr, temporary, TYPE_FLOAT);
+            break;
+        default:
+            emit_operand(e, expr, temporary, expr->value_type);
+            break;
+        }
+    }
+    fprintf(e->out, sequenced ? "); }\n" : ");\n");
+}
+
+static void emit_error_statement(Emitter *e, ASTNode *node)
+{
+    ASTNode *expr = node->data.op.left;
+    ValueType type = expr->value_type;
+    int temporary = -1;
+    if (expr->type != NODE_STRING_LITERAL && has_call(expr))
+    {
+        // What the call prints comes before the flush
+        emit_indent(e);
+        fprintf(e->out, "{ ");
+        temporary = emit_temporary(e, expr, type);
+        fprintf(e->out, "\n");
+    }
+    emit_indent(e);
+    fprintf(e->out, "fflush(stdout);\n");
+    emit_indent(e);
+    if (expr->type == NODE_STRING_LITERAL)
+    {
+        fprintf(e->out, "fputs(\"");
+        emit_string_text(e, expr->data.name, strlen(expr->data.name), false);
+        fprintf(e->out, "\\n\", stderr);\n");
+        return;
+    }
+    fprintf(e->out, "fprintf(stderr, \"%%d\\n\", ");
+    if (type == TYPE_FLOAT || is_wide_type(type))
+        fprintf(e->out, "(int)");
+    emit_operand(e, expr, temporary, type);
+    fprintf(e->out, temporary >= 0 ? "); }\n" : ");\n");
+}
+
+/* Statements */
+
+static void emit_block(Emitter *e, ASTNode *node)
+{
+    fprintf(e->out, "{\n");
+    e->indent++;
+    emit_statement(e, node);
+    e->indent--;
+    emit_indent(e);
+    fprintf(e->out, "}\n");
+}
+
+static void emit_if(Emitter *e, ASTNode *node)
+{
+    emit_indent(e);
+    fprintf(e->out, "if (");
+    emit_int(e, node->data.if_stmt.condition);
+    fprintf(e->out, ")\n");
+    emit_indent(e);
+    emit_block(e, node->data.if_stmt.then_branch);
+    if (node->data.if_stmt.else_branch)
+    {
+        emit_indent(e);
+        fprintf(e->out, "else\n");
+        emit_indent(e);
+        emit_block(e, node->data.if_stmt.else_branch);
+    }
+}
+
+static void emit_for(Emitter *e, ASTNode *node)
+{
+    if (node->data.for_stmt.init)
+        emit_statement(e, node->data.for_stmt.init);
+    emit_indent(e);
+    fprintf(e->out, "for (; ");
+    if (node->data.for_stmt.cond)
+        emit_int(e, node->data.for_stmt.cond);
+    fprintf(e->out, ";");
+    if (node->data.for_stmt.incr)
+    {
+        fprintf(e->out, " ");
+        emit_expression(e, node->data.for_stmt.incr);
+    }
+    fprintf(e->out, ")\n");
+    emit_indent(e);
+    emit_block(e, node->data.for_stmt.body);
+}
+
+/*
+ * The arms reachable through the switch table, each labeled with the
+ * values that start there; arms after based are never reached.
+ */
+static void emit_switch(Emitter *e, ASTNode *node)
+{
+    SwitchTable *table = node->data.switch_stmt.table;
+    if (!table)
+    {
+        table = node->data.switch_stmt.table = build_switch_table(node->data.switch_stmt.cases);
+    }
+
+    emit_indent(e);
+    fprintf(e->out, "switch (");
+    emit_int(e, node->data.switch_stmt.expression);
+    fprintf(e->out, ")\n");
+    emit_indent(e);
+    fprintf(e->out, "{\n");
+    for (int arm = 0; arm < table->arm_count; arm++)
+    {
+        for (int i = 0; i < table->entry_count; i++)
+        {
+            if (table->entries[i].arm != arm)
+                continue;
+            emit_indent(e);
+            fprintf(e->out, "case ");
+            emit_int_literal(e, table->entries[i].value);
+            fprintf(e->out, ":\n");
+        }
+        if (arm == table->default_arm)
+        {
+            emit_indent(e);
+            fprintf(e->out, "default:\n");
+        }
+        emit_indent(e);
+        emit_block(e, table->arms[arm]->statements);
+    }
+    emit_indent(e);
+    fprintf(e->out, "}\n");
+}
+
+/* `bussin` leaves a function through its cleanup with the result set, or ends main */
+static void emit_return(Emitter *e, ASTNode *node)
+{
+    ASTNode *value = node->data.op.left;
+    if (!e->function)
+    {
+        emit_statement(e, value);
+        emit_indent(e);
+        fprintf(e->out, "return 0;\n");
+        return;
+    }
+
+    if (value)
+    {
+        emit_indent(e);
+        fprintf(e->out, e->function->return_type == TYPE_UNSIGNED ? "br_result = (unsigned int)" : "br_result = ");
+        emit_value(e, value, e->function->return_type);
+        fprintf(e->out, ";\n");
+    }
+    emit_indent(e);
+    fprintf(e->out, "goto br_return;\n");
+}
+
+static void emit_statement(Emitter *e, ASTNode *node)
+{
+    if (!node || e->had_error)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_STATEMENT_LIST:
+        for (StatementList *current = node->data.statements; current; current = current->next)
+        {
+            emit_statement(e, current->statement);
+        }
+        break;
+    case NODE_FUNC_CALL:
+        if (node->data.func_call.format)
+        {
+            emit_print(e, node->data.func_call.format);
+        }
+        else if (node->slot >= 0)
+        {
+            emit_indent(e);
+            emit_expression(e, node);
+            fprintf(e->out, ";\n");
+        }
+        break;
+    case NODE_RETURN:
+        emit_return(e, node);
+        break;
+    case NODE_ERROR_STATEMENT:
+        emit_error_statement(e, node);
+        break;
+    case NODE_IF_STATEMENT:
+        emit_if(e, node);
+        break;
+    case NODE_FOR_STATEMENT:
+        emit_for(e, node);
+        break;
+    case NODE_WHILE_STATEMENT:
+        emit_indent(e);
+        fprintf(e->out, "while (");
+        emit_int(e, node->data.while_stmt.cond);
+        fprintf(e->out, ")\n");
+        emit_indent(e);
+        emit_block(e, node->data.while_stmt.body);
+        break;
+    case NODE_DO_WHILE_STATEMENT:
+        emit_indent(e);
+        fprintf(e->out, "do\n");
+        emit_indent(e);
+        emit_block(e, node->data.while_stmt.body);
+        emit_indent(e);
+        fprintf(e->out, "while (");
+        emit_int(e, node->data.while_stmt.cond);
+        fprintf(e->out, ");\n");
+        break;
+    case NODE_SWITCH_STATEMENT:
+        emit_switch(e, node);
+        break;
+    case NODE_BREAK_STATEMENT:
+        emit_indent(e);
+        fprintf(e->out, "break;\n");
+        break;
+    case NODE_CONTINUE_STATEMENT:
+        emit_indent(e);
+        fprintf(e->out, "continue;\n");
+        break;
+    case NODE_STRING_LITERAL:
+    case NODE_PRINT_STATEMENT:
+        error(e, "Statement cannot be translated to C");
+        break;
+    case NODE_NUMBER:
+    case NODE_FLOAT:
+    case NODE_LONG:
+    case NODE_DOUBLE:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+    case NODE_IDENTIFIER:
+        // Nothing to evaluate, e.g. the value main returns
+        break;
+    default:
+        emit_indent(e);
+        emit_expression(e, node);
+        fprintf(e->out, ";\n");
+        break;
+    }
+}
+
+/* The function's C declaration; its scope must be entered */
+static void emit_signature(Emitter *e, const Function *function)
+{
+    const char *type = function->return_type == TYPE_UNKNOWN ? "void" : c_value_type(function->return_type);
+    fprintf(e->out, "static %s ", type);
+    emit_function_name(e, function);
+    fprintf(e->out, "(");
+    if (function->parameter_count == 0)
+        fprintf(e->out, "void");
+    for (int slot = 0; slot < function->parameter_count; slot++)
+    {
+        const variable *var = &symbol_table[slot];
+        fprintf(e->out, "%s%s%s ", slot > 0 ? ", " : "", var->modifiers.is_volatile ? "volatile " : "", c_type(var));
+        emit_variable_name(e, slot);
+    }
+    fprintf(e->out, ")");
+}
+
+/*
+ * A function runs its body in a frame of C locals once br_enter admits
+ * it; every `bussin` jumps to the end, where its arrays are freed.
+ */
+static void emit_function(Emitter *e, Function *function)
+{
+    int size = function->scope.count;
+    bool returns_value = function->return_type != TYPE_UNKNOWN;
+    enter_scope(&function->scope);
+    e->function = function;
+
+    emit_signature(e, function);
+    fprintf(e->out, "\n{\n");
+    if (returns_value)
+        fprintf(e->out, "    %s br_result = 0;\n", c_value_type(function->return_type));
+    emit_declarations(e, function->parameter_count);
+    fprintf(e->out, "    if (!br_enter(%d))\n        return%s;\n", size, returns_value ? " br_result" : "");
+    emit_statement(e, function->body);
+    fprintf(e->out, "br_return:\n");
+    for (int slot = 0; slot < var_count; slot++)
+    {
+        if (!symbol_table[slot].is_array)
+            continue;
+        fprintf(e->out, "    br_release(&");
+        emit_variable_name(e, slot);
+        fprintf(e->out, ");\n");
+    }
+    fprintf(e->out, "    br_leave(%d);\n", size);
+    if (returns_value)
+        fprintf(e->out, "    return br_result;\n");
+    fprintf(e->out, "}\n\n");
+}
+
+bool emit_c_program(ASTNode *root, FILE *out)
+{
+    Emitter e = {out, 1, NULL, 0, false};
+    fprintf(out, "/* Generated by brainrot --emit-c */\n\n");
+    fprintf(out, prelude, current_program->line);
+    if (current_program->function_count > 0)
+    {
+        fprintf(out, call_prelude, MAX_CALL_DEPTH, FRAME_STACK_SIZE);
+        for (int i = 0; i < current_program->function_count; i++)
+        {
+            enter_scope(&current_program->functions[i]->scope);
+            emit_signature(&e, current_program->functions[i]);
+            fprintf(out, ";\n");
+        }
+        fprintf(out, "\n");
+        for (int i = 0; i < current_program->function_count; i++)
+        {
+            emit_function(&e, current_program->functions[i]);
+        }
+        enter_scope(&current_program->main);
+        e.function = NULL;
+    }
+    fprintf(out, "int main(void)\n{\n");
+    emit_declarations(&e, 0);
+    emit_statement(&e, root);
+    fprintf(out, "    return 0;\n}\n");
+    return !e.had_error;
+}
+
+bool build_native_program(ASTNode *root, const char *path)
+{
+    // Translate first, so a program that cannot be translated never reaches gcc
+    char *source = NULL;
+    size_t length = 0;
+    FILE *memory = open_memstream(&source, &length);
+    if (!memory)
+    {
+        yyerror("Out of memory");
+        return false;
+    }
+    bool translated = emit_c_program(root, memory);
+    fclose(memory);
+    if (!translated)
+    {
+        free(source);
+        return false;
+    }
+
+    int fds[2];
+    pid_t pid = -1;
+    if (pipe(fds) == 0)
+    {
+        pid = fork();
+        if (pid == 0)
+        {
+            dup2(fds[0], STDIN_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+            execlp("gcc", "gcc", "-O2", "-ffp-contract=off", "-x", "c", "-o", path, "-", (char *)NULL);
+            _exit(127);
+        }
+        close(fds[0]);
+        if (pid > 0)
+        {
+            // A failing gcc may stop reading; its exit status reports that
+            signal(SIGPIPE, SIG_IGN);
+            // gcc reads the whole translation unit before it can exit successfully
+            for (size_t written = 0; written < length;)
+            {
+                ssize_t count = write(fds[1], source + written, length - written);
+                if (count <= 0)
+                    break;
+                written += count;
+            }
+        }
+        close(fds[1]);
+    }
+    free(source);
+
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        yyerror("C compiler failed");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+/* transpile.h */
+
+#ifndef TRANSPILE_H
+#define TRANSPILE_H
+
+#include "ast.h"
+
+/*
+ * Translation of a type-checked, optimized program into a standalone C
+ * translation unit that prints exactly what the interpreter prints.
+ *
+ * Variables become typed locals of main, loops and `ohio` become C loops
+ * and switches, and every print call becomes one fprintf with its format
+ * string compiled at translation time. Integer arithmetic wraps and
+ * division by zero reports the interpreter's error and yields 0, through
+ * small inline helpers at the top of the file.
+ */
+
+/* Write the C translation of root to out; false after yyerror if it cannot */
+bool emit_c_program(ASTNode *root, FILE *out);
+
+/*
+ * Translate root and compile it with the system gcc at -O2 into an
+ * executable at path. Returns false after yyerror if either step fails.
+ */
+bool build_native_program(ASTNode *root, const char *path);
+
+#endif /* TRANSPILE_H */
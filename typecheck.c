@@ -0,0 +1,989 @@
+/* typecheck.c */
+
+#include "typecheck.h"
+#include "format.h"
+#include <stdbool.h>
+#include <string.h>
+
+extern void yyerror(const char *s);
+
+static _Thread_local bool type_error;
+
+/* The length every declaration of an array gives it, when that is a literal */
+#define LENGTH_UNSEEN -1
+#define LENGTH_VARIES -2
+static _Thread_local int array_length[MAX_VARS];
+
+/* The function being checked, or NULL for main */
+static _Thread_local Function *current_function;
+
+static void report(const char *message, const char *name)
+{
+    char buffer[256];
+    if (name)
+    {
+        snprintf(buffer, sizeof(buffer), "%s '%s'", message, name);
+        yyerror(buffer);
+    }
+    else
+    {
+        yyerror(message);
+    }
+    type_error = true;
+}
+
+static bool is_integer_type(ValueType type)
+{
+    return type == TYPE_INT || type == TYPE_UNSIGNED || type == TYPE_BOOL || type == TYPE_CHAR || type == TYPE_SHORT ||
+           type == TYPE_LONG;
+}
+
+static bool is_numeric_type(ValueType type)
+{
+    return is_integer_type(type) || type == TYPE_FLOAT || type == TYPE_DOUBLE;
+}
+
+/* The type both operands of an arithmetic or relational operator are converted to */
+static ValueType common_type(ValueType left, ValueType right)
+{
+    if (left == TYPE_DOUBLE || right == TYPE_DOUBLE)
+        return TYPE_DOUBLE;
+    if (left == TYPE_FLOAT || right == TYPE_FLOAT)
+        return TYPE_FLOAT;
+    if (left == TYPE_LONG || right == TYPE_LONG)
+        return TYPE_LONG;
+    if (left == TYPE_UNSIGNED || right == TYPE_UNSIGNED)
+        return TYPE_UNSIGNED;
+    return TYPE_INT;
+}
+
+static ASTNode *new_conversion(NodeType kind, ASTNode *operand, ValueType type)
+{
+    ASTNode *node = create_unary_operation_node(OP_NEG, operand);
+    node->type = kind;
+    node->value_type = type;
+    return node;
+}
+
+/* True if node is a chad expression computed from literals only, such as -0.1 */
+static bool is_float_literal(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_FLOAT:
+        return true;
+    case NODE_FLOAT_ADD:
+    case NODE_FLOAT_SUB:
+    case NODE_FLOAT_MUL:
+    case NODE_FLOAT_DIV:
+        return is_float_literal(node->data.op.left) && is_float_literal(node->data.op.right);
+    case NODE_FLOAT_NEG:
+        return is_float_literal(node->data.unary.operand);
+    case NODE_INT_TO_FLOAT:
+    case NODE_UNSIGNED_TO_FLOAT:
+        return node->data.unary.operand->type == NODE_NUMBER;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Turn a float literal expression into the same gigachad expression, so
+ * that a literal stored into a gigachad keeps the digits it was written
+ * with instead of being rounded to a chad first
+ */
+static void retype_as_double(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_FLOAT:
+        node->type = NODE_DOUBLE;
+        break;
+    case NODE_FLOAT_ADD:
+    case NODE_FLOAT_SUB:
+    case NODE_FLOAT_MUL:
+    case NODE_FLOAT_DIV:
+        node->type = NODE_DOUBLE_ADD + (node->type - NODE_FLOAT_ADD);
+        retype_as_double(node->data.op.left);
+        retype_as_double(node->data.op.right);
+        break;
+    case NODE_FLOAT_NEG:
+        node->type = NODE_DOUBLE_NEG;
+        retype_as_double(node->data.unary.operand);
+        break;
+    case NODE_INT_TO_FLOAT:
+        node->type = NODE_INT_TO_DOUBLE;
+        break;
+    default:
+        node->type = NODE_UNSIGNED_TO_DOUBLE;
+        break;
+    }
+    node->value_type = TYPE_DOUBLE;
+}
+
+/* Wrap node so that it produces a value of the requested type */
+static ASTNode *convert(ASTNode *node, ValueType to)
+{
+    ValueType from = node->value_type;
+    if (from == to)
+        return node;
+
+    if (to == TYPE_DOUBLE)
+    {
+        if (from == TYPE_FLOAT && is_float_literal(node))
+        {
+            retype_as_double(node);
+            return node;
+        }
+        NodeType kind = from == TYPE_FLOAT      ? NODE_FLOAT_TO_DOUBLE
+                        : from == TYPE_LONG     ? NODE_LONG_TO_DOUBLE
+                        : from == TYPE_UNSIGNED ? NODE_UNSIGNED_TO_DOUBLE
+                                                : NODE_INT_TO_DOUBLE;
+        return new_conversion(kind, node, to);
+    }
+    if (to == TYPE_FLOAT)
+    {
+        NodeType kind = from == TYPE_DOUBLE     ? NODE_DOUBLE_TO_FLOAT
+                        : from == TYPE_LONG     ? NODE_LONG_TO_FLOAT
+                        : from == TYPE_UNSIGNED ? NODE_UNSIGNED_TO_FLOAT
+                                                : NODE_INT_TO_FLOAT;
+        return new_conversion(kind, node, to);
+    }
+    if (to == TYPE_LONG)
+    {
+        NodeType kind = from == TYPE_DOUBLE     ? NODE_DOUBLE_TO_LONG
+                        : from == TYPE_FLOAT    ? NODE_FLOAT_TO_LONG
+                        : from == TYPE_UNSIGNED ? NODE_UNSIGNED_TO_LONG
+                                                : NODE_INT_TO_LONG;
+        return new_conversion(kind, node, to);
+    }
+
+    /* The remaining types are held in an int */
+    if (to == TYPE_BOOL)
+    {
+        NodeType kind = from == TYPE_DOUBLE  ? NODE_DOUBLE_TO_BOOL
+                        : from == TYPE_FLOAT ? NODE_FLOAT_TO_BOOL
+                        : from == TYPE_LONG  ? NODE_LONG_TO_BOOL
+                                             : NODE_INT_TO_BOOL;
+        return new_conversion(kind, node, to);
+    }
+    if (node->type == NODE_LONG)
+    {
+        // A literal too large for a rizz, such as a nonut rizz's, keeps its low 32 bits
+        node->type = NODE_NUMBER;
+        node->data.value = (int)node->data.lvalue;
+        node->value_type = to == TYPE_UNSIGNED ? TYPE_UNSIGNED : TYPE_INT;
+        from = node->value_type;
+    }
+    else if (from == TYPE_FLOAT || from == TYPE_DOUBLE || from == TYPE_LONG)
+    {
+        bool is_unsigned = to == TYPE_UNSIGNED;
+        NodeType kind = from == TYPE_LONG    ? NODE_LONG_TO_INT
+                        : from == TYPE_FLOAT ? (is_unsigned ? NODE_FLOAT_TO_UNSIGNED : NODE_FLOAT_TO_INT)
+                                             : (is_unsigned ? NODE_DOUBLE_TO_UNSIGNED : NODE_DOUBLE_TO_INT);
+        node = new_conversion(kind, node, is_unsigned ? TYPE_UNSIGNED : TYPE_INT);
+        from = node->value_type;
+    }
+    if (to == TYPE_CHAR && from != TYPE_BOOL && from != TYPE_CHAR)
+        return new_conversion(NODE_INT_TO_CHAR, node, to);
+    if (to == TYPE_SHORT && from != TYPE_BOOL && from != TYPE_CHAR)
+        return new_conversion(NODE_INT_TO_SHORT, node, to);
+
+    /* Every other integer conversion keeps the same 32-bit representation */
+    return node;
+}
+
+/* Conditions are integers tested against zero */
+static ASTNode *convert_condition(ASTNode *node)
+{
+    if (node && (node->value_type == TYPE_FLOAT || is_wide_type(node->value_type)))
+        return convert(node, TYPE_BOOL);
+    return node;
+}
+
+/* Type of an expression using the variable types known so far, without rewriting */
+static ValueType infer_type(ASTNode *node)
+{
+    if (!node)
+        return TYPE_INT;
+
+    switch (node->type)
+    {
+    case NODE_FLOAT:
+        return TYPE_FLOAT;
+    case NODE_LONG:
+        return TYPE_LONG;
+    case NODE_CHAR:
+        return TYPE_CHAR;
+    case NODE_BOOLEAN:
+        return TYPE_BOOL;
+    case NODE_STRING_LITERAL:
+        return TYPE_STRING;
+    case NODE_IDENTIFIER:
+    case NODE_INDEX:
+        return symbol_table[node->slot].type != TYPE_UNKNOWN ? symbol_table[node->slot].type : TYPE_INT;
+    case NODE_OPERATION:
+        switch (node->data.op.op)
+        {
+        case OP_PLUS:
+        case OP_MINUS:
+        case OP_TIMES:
+        case OP_DIVIDE:
+        case OP_MOD:
+            return common_type(infer_type(node->data.op.left), infer_type(node->data.op.right));
+        default:
+            return TYPE_INT;
+        }
+    case NODE_UNARY_OPERATION:
+    {
+        ValueType type = infer_type(node->data.unary.operand);
+        return type == TYPE_FLOAT || is_wide_type(type) ? type : TYPE_INT;
+    }
+    case NODE_FUNC_CALL:
+        if (node->slot >= 0 && current_program->functions[node->slot]->return_type != TYPE_UNKNOWN)
+            return current_program->functions[node->slot]->return_type;
+        return TYPE_INT;
+    default:
+        return TYPE_INT;
+    }
+}
+
+static void declare_variable(int slot, ValueType type, TypeModifiers mods, bool is_array)
+{
+    variable *var = &symbol_table[slot];
+    if (var->type == TYPE_UNKNOWN)
+    {
+        var->type = type;
+        var->modifiers = mods;
+        var->is_array = is_array;
+    }
+    else if (var->type != type || var->is_array != is_array)
+    {
+        report("Conflicting types for variable", variable_name(var));
+    }
+}
+
+static void declare_array_length(int slot, ASTNode *length)
+{
+    int value = length->type == NODE_NUMBER ? length->data.value : LENGTH_VARIES;
+    if (array_length[slot] == LENGTH_UNSEEN)
+        array_length[slot] = value;
+    else if (array_length[slot] != value)
+        array_length[slot] = LENGTH_VARIES;
+}
+
+/*
+ * Give each variable its type: first from declarations in program order,
+ * then (when infer is set) from the first assignment of undeclared ones.
+ */
+static void collect_variable_types(ASTNode *node, bool infer)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+    {
+        int slot = node->data.op.left->slot;
+        if (!infer && node->value_type != TYPE_UNKNOWN)
+        {
+            declare_variable(slot, node->value_type, node->modifiers, false);
+        }
+        else if (infer && symbol_table[slot].type == TYPE_UNKNOWN)
+        {
+            ValueType type = infer_type(node->data.op.right);
+            declare_variable(slot, type == TYPE_STRING ? TYPE_INT : type, node->modifiers, false);
+        }
+        break;
+    }
+    case NODE_ARRAY_DECLARATION:
+        if (!infer)
+        {
+            declare_variable(node->slot, node->value_type, node->modifiers, true);
+            declare_array_length(node->slot, node->data.element.index);
+        }
+        break;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            collect_variable_types(sl->statement, infer);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        collect_variable_types(node->data.for_stmt.init, infer);
+        collect_variable_types(node->data.for_stmt.body, infer);
+        collect_variable_types(node->data.for_stmt.incr, infer);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        collect_variable_types(node->data.while_stmt.body, infer);
+        break;
+    case NODE_IF_STATEMENT:
+        collect_variable_types(node->data.if_stmt.then_branch, infer);
+        collect_variable_types(node->data.if_stmt.else_branch, infer);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            collect_variable_types(cn->statements, infer);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static NodeType specialize_binary(OperatorType op, ValueType operands)
+{
+    if (operands == TYPE_DOUBLE)
+    {
+        switch (op)
+        {
+        case OP_PLUS:
+            return NODE_DOUBLE_ADD;
+        case OP_MINUS:
+            return NODE_DOUBLE_SUB;
+        case OP_TIMES:
+            return NODE_DOUBLE_MUL;
+        case OP_DIVIDE:
+            return NODE_DOUBLE_DIV;
+        case OP_LT:
+            return NODE_DOUBLE_LT;
+        case OP_GT:
+            return NODE_DOUBLE_GT;
+        case OP_LE:
+            return NODE_DOUBLE_LE;
+        case OP_GE:
+            return NODE_DOUBLE_GE;
+        case OP_EQ:
+            return NODE_DOUBLE_EQ;
+        case OP_NE:
+            return NODE_DOUBLE_NE;
+        default:
+            return NODE_OPERATION;
+        }
+    }
+    if (operands == TYPE_LONG)
+    {
+        switch (op)
+        {
+        case OP_PLUS:
+            return NODE_LONG_ADD;
+        case OP_MINUS:
+            return NODE_LONG_SUB;
+        case OP_TIMES:
+            return NODE_LONG_MUL;
+        case OP_DIVIDE:
+            return NODE_LONG_DIV;
+        case OP_MOD:
+            return NODE_LONG_MOD;
+        case OP_LT:
+            return NODE_LONG_LT;
+        case OP_GT:
+            return NODE_LONG_GT;
+        case OP_LE:
+            return NODE_LONG_LE;
+        case OP_GE:
+            return NODE_LONG_GE;
+        case OP_EQ:
+            return NODE_LONG_EQ;
+        case OP_NE:
+            return NODE_LONG_NE;
+        default:
+            return NODE_OPERATION;
+        }
+    }
+    if (operands == TYPE_FLOAT)
+    {
+        switch (op)
+        {
+        case OP_PLUS:
+            return NODE_FLOAT_ADD;
+        case OP_MINUS:
+            return NODE_FLOAT_SUB;
+        case OP_TIMES:
+            return NODE_FLOAT_MUL;
+        case OP_DIVIDE:
+            return NODE_FLOAT_DIV;
+        case OP_LT:
+            return NODE_FLOAT_LT;
+        case OP_GT:
+            return NODE_FLOAT_GT;
+        case OP_LE:
+            return NODE_FLOAT_LE;
+        case OP_GE:
+            return NODE_FLOAT_GE;
+        case OP_EQ:
+            return NODE_FLOAT_EQ;
+        case OP_NE:
+            return NODE_FLOAT_NE;
+        default:
+            return NODE_OPERATION;
+        }
+    }
+
+    switch (op)
+    {
+    case OP_PLUS:
+        return NODE_INT_ADD;
+    case OP_MINUS:
+        return NODE_INT_SUB;
+    case OP_TIMES:
+        return NODE_INT_MUL;
+    case OP_DIVIDE:
+        return operands == TYPE_UNSIGNED ? NODE_UNSIGNED_DIV : NODE_INT_DIV;
+    case OP_MOD:
+        return operands == TYPE_UNSIGNED ? NODE_UNSIGNED_MOD : NODE_INT_MOD;
+    case OP_LT:
+        return operands == TYPE_UNSIGNED ? NODE_UNSIGNED_LT : NODE_INT_LT;
+    case OP_GT:
+        return operands == TYPE_UNSIGNED ? NODE_UNSIGNED_GT : NODE_INT_GT;
+    case OP_LE:
+        return operands == TYPE_UNSIGNED ? NODE_UNSIGNED_LE : NODE_INT_LE;
+    case OP_GE:
+        return operands == TYPE_UNSIGNED ? NODE_UNSIGNED_GE : NODE_INT_GE;
+    case OP_EQ:
+        return NODE_INT_EQ;
+    case OP_NE:
+        return NODE_INT_NE;
+    default:
+        return NODE_OPERATION;
+    }
+}
+
+static ASTNode *check_expression(ASTNode *node);
+static ASTNode *check_call(ASTNode *node, bool needs_value);
+
+/* Indices and array lengths are ints */
+static ASTNode *check_index(ASTNode *node)
+{
+    node = check_expression(node);
+    if (!is_integer_type(node->value_type))
+    {
+        report("Array index is not an integer", NULL);
+        return node;
+    }
+    return convert(node, TYPE_INT);
+}
+
+static ASTNode *check_operation(ASTNode *node)
+{
+    OperatorType op = node->data.op.op;
+    ASTNode *left = check_expression(node->data.op.left);
+    ASTNode *right = check_expression(node->data.op.right);
+
+    if (op == OP_AND || op == OP_OR)
+    {
+        node->type = op == OP_AND ? NODE_LOGICAL_AND : NODE_LOGICAL_OR;
+        node->data.op.left = convert_condition(left);
+        node->data.op.right = convert_condition(right);
+        node->value_type = TYPE_INT;
+        return node;
+    }
+
+    if (!is_numeric_type(left->value_type))
+    {
+        report("Invalid operand type for operator", NULL);
+        return node;
+    }
+    if (!is_numeric_type(right->value_type))
+    {
+        report("Invalid operand type for operator", NULL);
+        return node;
+    }
+
+    ValueType operands = common_type(left->value_type, right->value_type);
+    NodeType kind = specialize_binary(op, operands);
+    if (kind == NODE_OPERATION)
+    {
+        report("Invalid operator for float operation", NULL);
+        return node;
+    }
+
+    node->type = kind;
+    node->data.op.left = convert(left, operands);
+    node->data.op.right = convert(right, operands);
+    switch (op)
+    {
+    case OP_PLUS:
+    case OP_MINUS:
+    case OP_TIMES:
+    case OP_DIVIDE:
+    case OP_MOD:
+        node->value_type = operands;
+        break;
+    default:
+        node->value_type = TYPE_INT;
+        break;
+    }
+    return node;
+}
+
+static ASTNode *check_expression(ASTNode *node)
+{
+    if (!node)
+        return NULL;
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        node->value_type = TYPE_INT;
+        break;
+    case NODE_FLOAT:
+        node->value_type = TYPE_FLOAT;
+        break;
+    case NODE_LONG:
+        node->value_type = TYPE_LONG;
+        break;
+    case NODE_CHAR:
+        node->value_type = TYPE_CHAR;
+        break;
+    case NODE_BOOLEAN:
+        node->value_type = TYPE_BOOL;
+        break;
+    case NODE_STRING_LITERAL:
+        node->value_type = TYPE_STRING;
+        break;
+    case NODE_IDENTIFIER:
+        node->value_type = symbol_table[node->slot].type;
+        if (symbol_table[node->slot].is_array)
+            report("Array used without an index", variable_name(&symbol_table[node->slot]));
+        break;
+    case NODE_INDEX:
+        if (!symbol_table[node->slot].is_array)
+            report("Indexed variable is not an array", variable_name(&symbol_table[node->slot]));
+        node->data.element.index = check_index(node->data.element.index);
+        node->value_type = symbol_table[node->slot].type;
+        break;
+    case NODE_SIZEOF:
+    {
+        variable *var = &symbol_table[node->slot];
+        int size = variable_sizeof(var);
+        if (var->is_array)
+        {
+            if (array_length[node->slot] < 0)
+                report("maxxing of an array without a fixed length", variable_name(var));
+            else
+                size = (int)((unsigned int)size * (unsigned int)array_length[node->slot]);
+        }
+        node->type = NODE_NUMBER;
+        node->data.value = size;
+        node->value_type = TYPE_INT;
+        break;
+    }
+    case NODE_OPERATION:
+        return check_operation(node);
+    case NODE_FUNC_CALL:
+        return check_call(node, true);
+    case NODE_UNARY_OPERATION:
+    {
+        ASTNode *operand = check_expression(node->data.unary.operand);
+        if (operand->value_type == TYPE_FLOAT)
+        {
+            node->type = NODE_FLOAT_NEG;
+            node->value_type = TYPE_FLOAT;
+        }
+        else if (operand->value_type == TYPE_DOUBLE)
+        {
+            node->type = NODE_DOUBLE_NEG;
+            node->value_type = TYPE_DOUBLE;
+        }
+        else if (operand->value_type == TYPE_LONG)
+        {
+            node->type = NODE_LONG_NEG;
+            node->value_type = TYPE_LONG;
+        }
+        else if (is_integer_type(operand->value_type))
+        {
+            node->type = NODE_INT_NEG;
+            node->value_type = operand->value_type == TYPE_UNSIGNED ? TYPE_UNSIGNED : TYPE_INT;
+        }
+        else
+        {
+            report("Invalid operand type for unary minus", NULL);
+        }
+        node->data.unary.operand = operand;
+        break;
+    }
+    default:
+        report("Invalid expression", NULL);
+        break;
+    }
+    return node;
+}
+
+/* An expression used where a plain int is required, such as a case label */
+static ASTNode *check_int_expression(ASTNode *node)
+{
+    node = check_expression(node);
+    if (node && node->value_type == TYPE_STRING)
+    {
+        report("String used where a number is required", NULL);
+        return node;
+    }
+    if (node && (node->value_type == TYPE_FLOAT || is_wide_type(node->value_type)))
+        return convert(node, TYPE_INT);
+    return node;
+}
+
+static bool is_constant_expression(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+    case NODE_FLOAT:
+    case NODE_LONG:
+    case NODE_DOUBLE:
+        return true;
+    case NODE_INT_DIV:
+    case NODE_INT_MOD:
+    case NODE_UNSIGNED_DIV:
+    case NODE_UNSIGNED_MOD:
+        return is_constant_expression(node->data.op.left) && is_constant_expression(node->data.op.right) &&
+               evaluate_expression_int(node->data.op.right) != 0;
+    case NODE_FLOAT_DIV:
+        return is_constant_expression(node->data.op.left) && is_constant_expression(node->data.op.right) &&
+               evaluate_expression_float(node->data.op.right) != 0.0f;
+    case NODE_LONG_DIV:
+    case NODE_LONG_MOD:
+        return is_constant_expression(node->data.op.left) && is_constant_expression(node->data.op.right) &&
+               evaluate_expression_long(node->data.op.right) != 0;
+    case NODE_DOUBLE_DIV:
+        return is_constant_expression(node->data.op.left) && is_constant_expression(node->data.op.right) &&
+               evaluate_expression_double(node->data.op.right) != 0.0;
+    case NODE_INT_NEG:
+    case NODE_FLOAT_NEG:
+        return is_constant_expression(node->data.unary.operand);
+    default:
+        if (node->type >= NODE_INT_ADD && node->type <= NODE_LOGICAL_OR)
+            return is_constant_expression(node->data.op.left) && is_constant_expression(node->data.op.right);
+        if (node->type >= NODE_LONG_NEG && node->type <= NODE_DOUBLE_TO_BOOL)
+            return is_constant_expression(node->data.unary.operand);
+        return false;
+    }
+}
+
+/* Case labels are integer constant expressions, folded here to a number */
+static ASTNode *check_case_label(ASTNode *node)
+{
+    if (!node)
+        return NULL;
+
+    node = check_int_expression(node);
+    if (node->value_type == TYPE_STRING)
+        return node;
+    if (!is_constant_expression(node))
+    {
+        report("Case label is not a constant", NULL);
+        return node;
+    }
+    int value = evaluate_expression_int(node);
+    node->type = NODE_NUMBER;
+    node->data.value = value;
+    return node;
+}
+
+static int compare_labels(const void *a, const void *b)
+{
+    int left = *(const int *)a;
+    int right = *(const int *)b;
+    return (left > right) - (left < right);
+}
+
+static void check_duplicate_labels(CaseNode *cases)
+{
+    int count = 0;
+    for (CaseNode *cn = cases; cn; cn = cn->next)
+    {
+        if (cn->value && cn->value->type == NODE_NUMBER)
+            count++;
+    }
+
+    int *labels = malloc(count * sizeof(int));
+    int n = 0;
+    for (CaseNode *cn = cases; cn; cn = cn->next)
+    {
+        if (cn->value && cn->value->type == NODE_NUMBER)
+            labels[n++] = cn->value->data.value;
+    }
+
+    qsort(labels, count, sizeof(int), compare_labels);
+    for (int i = 1; i < count; i++)
+    {
+        if (labels[i] == labels[i - 1])
+        {
+            char value[16];
+            snprintf(value, sizeof(value), "%d", labels[i]);
+            report("Duplicate case label", value);
+            break;
+        }
+    }
+    free(labels);
+}
+
+static ASTNode *check_condition(ASTNode *node)
+{
+    node = check_expression(node);
+    if (node && node->value_type == TYPE_STRING)
+    {
+        report("String used as a condition", NULL);
+        return node;
+    }
+    return convert_condition(node);
+}
+
+static void check_statement(ASTNode *node);
+
+static void check_arguments(ArgumentList *args)
+{
+    for (ArgumentList *arg = args; arg; arg = arg->next)
+    {
+        arg->expr = check_expression(arg->expr);
+    }
+}
+
+/*
+ * A call to a user-defined function takes one argument per parameter,
+ * each converted to the parameter's type, and has the function's return
+ * type; used as a value, the function must return one. Builtins print
+ * and never have a value.
+ */
+static ASTNode *check_call(ASTNode *node, bool needs_value)
+{
+    const char *name = atom_name(ast_atoms, node->data.func_call.function);
+    if (node->slot < 0)
+    {
+        report("Function does not return a value", name);
+        return node;
+    }
+
+    Function *function = current_program->functions[node->slot];
+    int count = 0;
+    for (ArgumentList *arg = node->data.func_call.arguments; arg; arg = arg->next, count++)
+    {
+        ASTNode *value = check_expression(arg->expr);
+        if (count >= function->parameter_count)
+            continue;
+        if (value->value_type == TYPE_STRING)
+        {
+            report("String passed as an argument to", name);
+            continue;
+        }
+        arg->expr = convert(value, function->parameters[count]->value_type);
+    }
+    if (count != function->parameter_count)
+        report("Wrong number of arguments to", name);
+    if (needs_value && function->return_type == TYPE_UNKNOWN)
+        report("Function does not return a value", name);
+    node->value_type = function->return_type == TYPE_UNKNOWN ? TYPE_INT : function->return_type;
+    return node;
+}
+
+/* `bussin` converts its value to the function's return type; in main it only ends the program */
+static void check_return(ASTNode *node)
+{
+    if (!current_function)
+    {
+        node->data.op.left = check_int_expression(node->data.op.left);
+        node->value_type = TYPE_INT;
+        return;
+    }
+
+    ValueType type = current_function->return_type;
+    const char *name = atom_name(ast_atoms, current_function->name);
+    node->value_type = type == TYPE_UNKNOWN ? TYPE_INT : type;
+    if (!node->data.op.left)
+        return;
+    if (type == TYPE_UNKNOWN)
+    {
+        report("bussin with a value in a function without a return type", name);
+        return;
+    }
+    ASTNode *value = check_expression(node->data.op.left);
+    if (value->value_type == TYPE_STRING)
+    {
+        report("String returned from", name);
+        return;
+    }
+    node->data.op.left = convert(value, type);
+}
+
+/* Compile the format of a yapping, yappin or baka call against its arguments */
+static void check_print_call(ASTNode *node)
+{
+    Atom function = node->data.func_call.function;
+    OutputStream stream = OUTPUT_STDOUT;
+    bool newline = true;
+    if (function == ATOM_YAPPIN)
+        newline = false;
+    else if (function == ATOM_BAKA)
+        stream = OUTPUT_STDERR;
+    else if (function != ATOM_YAPPING)
+        return;
+
+    char error[256];
+    node->data.func_call.format =
+        compile_format(ast_arena, stream, node->data.func_call.arguments, newline, error, sizeof(error));
+    if (!node->data.func_call.format)
+        report(error, NULL);
+}
+
+static void check_statement(ASTNode *node)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+    {
+        ValueType type = symbol_table[node->data.op.left->slot].type;
+        if (symbol_table[node->data.op.left->slot].is_array)
+        {
+            report("Cannot assign to array", variable_name(&symbol_table[node->data.op.left->slot]));
+            return;
+        }
+        if (node->value_type == TYPE_UNKNOWN && symbol_table[node->data.op.left->slot].modifiers.is_const)
+        {
+            report("Cannot assign to constant variable", variable_name(&symbol_table[node->data.op.left->slot]));
+            return;
+        }
+        ASTNode *value = check_expression(node->data.op.right);
+        if (value->value_type == TYPE_STRING)
+        {
+            report("Cannot assign a string to variable", variable_name(&symbol_table[node->data.op.left->slot]));
+            return;
+        }
+        node->data.op.left->value_type = type;
+        node->data.op.right = convert(value, type);
+        node->value_type = type;
+        break;
+    }
+    case NODE_ARRAY_DECLARATION:
+        node->data.element.index = check_index(node->data.element.index);
+        break;
+    case NODE_INDEX_ASSIGNMENT:
+    {
+        variable *var = &symbol_table[node->slot];
+        if (!var->is_array)
+        {
+            report("Indexed variable is not an array", variable_name(var));
+            return;
+        }
+        if (var->modifiers.is_const)
+        {
+            report("Cannot assign to constant array", variable_name(var));
+            return;
+        }
+        node->data.element.index = check_index(node->data.element.index);
+        ASTNode *value = check_expression(node->data.element.value);
+        if (value->value_type == TYPE_STRING)
+        {
+            report("Cannot assign a string to array", variable_name(var));
+            return;
+        }
+        node->data.element.value = convert(value, var->type);
+        node->value_type = var->type;
+        break;
+    }
+    case NODE_FUNC_CALL:
+        if (node->slot >= 0)
+        {
+            check_call(node, false);
+            break;
+        }
+        check_arguments(node->data.func_call.arguments);
+        check_print_call(node);
+        break;
+    case NODE_RETURN:
+        check_return(node);
+        break;
+    case NODE_PRINT_STATEMENT:
+    case NODE_ERROR_STATEMENT:
+    {
+        ASTNode *expr = node->data.op.left;
+        node->data.op.left = expr->type == NODE_STRING_LITERAL ? check_expression(expr) : check_int_expression(expr);
+        break;
+    }
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            check_statement(sl->statement);
+        }
+        break;
+    case NODE_FOR_STATEMENT:
+        check_statement(node->data.for_stmt.init);
+        node->data.for_stmt.cond = check_condition(node->data.for_stmt.cond);
+        check_statement(node->data.for_stmt.incr);
+        check_statement(node->data.for_stmt.body);
+        break;
+    case NODE_WHILE_STATEMENT:
+    case NODE_DO_WHILE_STATEMENT:
+        node->data.while_stmt.cond = check_condition(node->data.while_stmt.cond);
+        check_statement(node->data.while_stmt.body);
+        break;
+    case NODE_IF_STATEMENT:
+        node->data.if_stmt.condition = check_condition(node->data.if_stmt.condition);
+        check_statement(node->data.if_stmt.then_branch);
+        check_statement(node->data.if_stmt.else_branch);
+        break;
+    case NODE_SWITCH_STATEMENT:
+        node->data.switch_stmt.expression = check_int_expression(node->data.switch_stmt.expression);
+        for (CaseNode *cn = node->data.switch_stmt.cases; cn; cn = cn->next)
+        {
+            cn->value = check_case_label(cn->value);
+            check_statement(cn->statements);
+        }
+        check_duplicate_labels(node->data.switch_stmt.cases);
+        break;
+    case NODE_BREAK_STATEMENT:
+    case NODE_CONTINUE_STATEMENT:
+        break;
+    default:
+        /* Expression statement; the node itself never needs replacing */
+        check_expression(node);
+        break;
+    }
+}
+
+/* Type the variables of main or a function, parameters first, then check its body */
+static void check_scope(Scope *scope, Function *function, ASTNode *body)
+{
+    enter_scope(scope);
+    current_function = function;
+    memset(array_length, 0xff, sizeof(array_length));
+
+    for (int i = 0; function && i < function->parameter_count; i++)
+    {
+        collect_variable_types(function->parameters[i], false);
+    }
+    collect_variable_types(body, false);
+    collect_variable_types(body, true);
+    for (int i = 0; i < var_count; i++)
+    {
+        variable *var = &symbol_table[i];
+        if (var->type == TYPE_UNKNOWN)
+            var->type = TYPE_INT;
+        var->modifiers.is_unsigned = var->type == TYPE_UNSIGNED;
+        var->modifiers.is_boolean = var->type == TYPE_BOOL;
+    }
+
+    check_statement(body);
+}
+
+bool typecheck_program(ASTNode *root)
+{
+    Program *program = current_program;
+    type_error = false;
+    check_scope(&program->main, NULL, root);
+    for (int i = 0; i < program->function_count; i++)
+    {
+        check_scope(&program->functions[i]->scope, program->functions[i], program->functions[i]->body);
+    }
+    enter_scope(&program->main);
+    current_function = NULL;
+    return !type_error;
+}
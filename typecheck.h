@@ -0,0 +1,28 @@
+/* typecheck.h */
+
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "ast.h"
+
+/*
+ * Compute the static type of every expression in a resolved tree and
+ * rewrite generic operations into their type-specialized node kinds.
+ *
+ * A variable takes the type of its first declaration (`rizz`, `nonut rizz`,
+ * `chad`, `yap`, `cap`); a variable that is only ever assigned takes the
+ * type of its first assigned value. Assignments, conditions and case labels
+ * get explicit conversion nodes, and `maxxing` is folded to a constant.
+ * Assigning to a `grimace` (const) variable outside a declaration is an
+ * error. An array variable must always be indexed, with an integer, and
+ * is declared as an array everywhere; `maxxing` of one is its size in
+ * bytes, which needs every declaration to give it the same literal
+ * length. `sigma rule` labels must be constant, are folded to numbers and
+ * may not repeat within a switch. Arguments are converted to the types
+ * of their parameters and `bussin` values to the function's return type;
+ * a function without one cannot be called for a value.
+ * Returns false after reporting through yyerror on a type error.
+ */
+bool typecheck_program(ASTNode *root);
+
+#endif /* TYPECHECK_H */
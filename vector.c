@@ -0,0 +1,869 @@
+/* vector.c */
+
+#include "vector.h"
+#include "loops.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+
+#define MAX_REGISTERS 64
+#define MAX_INSTRUCTIONS 256
+#define MAX_ACCUMULATORS 16
+
+/* Register 0 holds the counter values, 1 the mask selecting every lane */
+#define ALL_LANES 1
+
+typedef enum
+{
+    VOP_NONE,
+    /* Run once, before the first block */
+    VOP_CONSTANT, /* bits in every lane                                   */
+    VOP_VARIABLE, /* slot's value in every lane                           */
+    /* Run for every block */
+    VOP_ELEMENTS, /* slot's elements at the counter values plus bits      */
+    VOP_IADD,
+    VOP_ISUB,
+    VOP_IMUL,
+    VOP_INEG,
+    VOP_IDIV,     /* divisions take their divisor from a register set up
+                     once or, with bits 1, from the counter; either is
+                     checked before the first block                       */
+    VOP_IMOD,
+    VOP_UDIV,
+    VOP_UMOD,
+    VOP_ILT,
+    VOP_IGT,
+    VOP_ILE,
+    VOP_IGE,
+    VOP_IEQ,
+    VOP_INE,
+    VOP_ULT,
+    VOP_UGT,
+    VOP_ULE,
+    VOP_UGE,
+    VOP_FADD,
+    VOP_FSUB,
+    VOP_FMUL,
+    VOP_FDIV,
+    VOP_FNEG,
+    VOP_FLT,
+    VOP_FGT,
+    VOP_FLE,
+    VOP_FGE,
+    VOP_FEQ,
+    VOP_FNE,
+    VOP_AND,
+    VOP_OR,
+    VOP_I2F,
+    VOP_U2F,
+    VOP_F2I,
+    VOP_F2B,
+    VOP_I2B,
+    VOP_I2C,
+    VOP_MASK,     /* lanes of mask left where right is nonzero            */
+    VOP_MASK_NOT, /* lanes of mask left where right is zero               */
+    VOP_STORE,    /* left into slot's elements at the counter values plus
+                     bits, in the lanes of mask right                     */
+    VOP_ADD_TO,   /* left to int accumulator bits, in the lanes of mask
+                     right                                                */
+    VOP_SUBTRACT_FROM,
+    VOP_FADD_TO,  /* As VOP_ADD_TO, one lane at a time for a float        */
+    VOP_FSUBTRACT_FROM
+} VectorOp;
+
+typedef struct
+{
+    VectorOp op;
+    int dest;
+    int left;
+    int right;
+    int slot;
+    int32_t bits;
+} VectorInstruction;
+
+typedef struct
+{
+    int slot;
+    bool is_float;
+} Accumulator;
+
+/* A variable set in the loop body, left holding its value from the last iteration */
+typedef struct
+{
+    int slot;
+    int reg;
+} Private;
+
+struct VectorLoop
+{
+    int induction;
+    int step;
+    NodeType comparison;
+    ASTNode *bound;
+    VectorInstruction *code;
+    int setup_count; /* code starts with the instructions run once */
+    int count;
+    Accumulator accumulators[MAX_ACCUMULATORS];
+    int accumulator_count;
+    Private privates[MAX_VARS];
+    int private_count;
+};
+
+/* Planning */
+
+typedef enum
+{
+    USE_NONE,
+    USE_ACCUMULATOR,
+    USE_PRIVATE
+} VariableUse;
+
+typedef struct
+{
+    VectorLoop *plan;
+    VectorInstruction setup[MAX_INSTRUCTIONS];
+    VectorInstruction body[MAX_INSTRUCTIONS];
+    int setup_count;
+    int body_count;
+    int register_count;
+    bool is_setup[MAX_REGISTERS];   /* Set once, before the first block */
+    bool is_counter[MAX_REGISTERS]; /* The counter values, possibly as floats */
+    bool assigned[MAX_VARS];        /* Anywhere in the body */
+    VariableUse use[MAX_VARS];
+    int value_register[MAX_VARS];   /* Holding the value set earlier in this iteration, or -1 */
+    int invariant_register[MAX_VARS];
+    bool stored[MAX_VARS];          /* Arrays with elements assigned */
+    bool read[MAX_VARS];
+    int offset[MAX_VARS];           /* The one offset from the counter an array is accessed at */
+    bool mixed[MAX_VARS];           /* Accessed at more than one offset */
+    bool failed;
+} Planner;
+
+static const VectorOp node_ops[] = {
+    [NODE_INT_ADD] = VOP_IADD,
+    [NODE_INT_SUB] = VOP_ISUB,
+    [NODE_INT_MUL] = VOP_IMUL,
+    [NODE_INT_DIV] = VOP_IDIV,
+    [NODE_INT_MOD] = VOP_IMOD,
+    [NODE_INT_LT] = VOP_ILT,
+    [NODE_INT_GT] = VOP_IGT,
+    [NODE_INT_LE] = VOP_ILE,
+    [NODE_INT_GE] = VOP_IGE,
+    [NODE_INT_EQ] = VOP_IEQ,
+    [NODE_INT_NE] = VOP_INE,
+    [NODE_INT_NEG] = VOP_INEG,
+    [NODE_UNSIGNED_DIV] = VOP_UDIV,
+    [NODE_UNSIGNED_MOD] = VOP_UMOD,
+    [NODE_UNSIGNED_LT] = VOP_ULT,
+    [NODE_UNSIGNED_GT] = VOP_UGT,
+    [NODE_UNSIGNED_LE] = VOP_ULE,
+    [NODE_UNSIGNED_GE] = VOP_UGE,
+    [NODE_FLOAT_ADD] = VOP_FADD,
+    [NODE_FLOAT_SUB] = VOP_FSUB,
+    [NODE_FLOAT_MUL] = VOP_FMUL,
+    [NODE_FLOAT_DIV] = VOP_FDIV,
+    [NODE_FLOAT_LT] = VOP_FLT,
+    [NODE_FLOAT_GT] = VOP_FGT,
+    [NODE_FLOAT_LE] = VOP_FLE,
+    [NODE_FLOAT_GE] = VOP_FGE,
+    [NODE_FLOAT_EQ] = VOP_FEQ,
+    [NODE_FLOAT_NE] = VOP_FNE,
+    [NODE_FLOAT_NEG] = VOP_FNEG,
+    [NODE_LOGICAL_AND] = VOP_AND,
+    [NODE_LOGICAL_OR] = VOP_OR,
+    [NODE_INT_TO_FLOAT] = VOP_I2F,
+    [NODE_UNSIGNED_TO_FLOAT] = VOP_U2F,
+    [NODE_FLOAT_TO_INT] = VOP_F2I,
+    [NODE_FLOAT_TO_BOOL] = VOP_F2B,
+    [NODE_INT_TO_BOOL] = VOP_I2B,
+    [NODE_INT_TO_CHAR] = VOP_I2C,
+    // Converting out of range floats to unsigned is left to the scalar loop
+    [NODE_FLOAT_TO_UNSIGNED] = VOP_NONE,
+};
+
+static bool is_division(VectorOp op)
+{
+    return op == VOP_IDIV || op == VOP_IMOD || op == VOP_UDIV || op == VOP_UMOD || op == VOP_FDIV;
+}
+
+static bool is_identifier(ASTNode *node, int slot)
+{
+    return node && node->type == NODE_IDENTIFIER && node->slot == slot;
+}
+
+/* Mark every variable assigned anywhere inside node; false if node is not a plain statement */
+static bool collect_assigned(ASTNode *node, bool *assigned)
+{
+    if (!node)
+        return true;
+
+    switch (node->type)
+    {
+    case NODE_ASSIGNMENT:
+        assigned[node->data.op.left->slot] = true;
+        return true;
+    case NODE_INDEX_ASSIGNMENT:
+        return true;
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            if (!collect_assigned(sl->statement, assigned))
+                return false;
+        }
+        return true;
+    case NODE_IF_STATEMENT:
+        return collect_assigned(node->data.if_stmt.then_branch, assigned) &&
+               collect_assigned(node->data.if_stmt.else_branch, assigned);
+    default:
+        return false;
+    }
+}
+
+static int new_register(Planner *p)
+{
+    if (p->register_count == MAX_REGISTERS)
+    {
+        p->failed = true;
+        return 0;
+    }
+    return p->register_count++;
+}
+
+static int emit(Planner *p, bool setup, VectorInstruction instruction)
+{
+    VectorInstruction *code = setup ? p->setup : p->body;
+    int *count = setup ? &p->setup_count : &p->body_count;
+    if (*count == MAX_INSTRUCTIONS)
+    {
+        p->failed = true;
+        return 0;
+    }
+    code[(*count)++] = instruction;
+    if (setup)
+        p->is_setup[instruction.dest] = true;
+    return instruction.dest;
+}
+
+/* The constant k when index is `i`, `i + k`, `k + i` or `i - k` for the counter i */
+static bool counter_offset(ASTNode *index, int induction, int32_t *offset)
+{
+    if (is_identifier(index, induction))
+    {
+        *offset = 0;
+        return true;
+    }
+    if (index->type != NODE_INT_ADD && index->type != NODE_INT_SUB)
+        return false;
+
+    ASTNode *left = index->data.op.left;
+    ASTNode *right = index->data.op.right;
+    if (is_identifier(left, induction) && right->type == NODE_NUMBER && right->data.value != INT32_MIN)
+    {
+        *offset = index->type == NODE_INT_ADD ? right->data.value : -right->data.value;
+        return true;
+    }
+    if (index->type == NODE_INT_ADD && left->type == NODE_NUMBER && is_identifier(right, induction))
+    {
+        *offset = left->data.value;
+        return true;
+    }
+    return false;
+}
+
+/* Note an access to an array at offset from the counter; false if it is not allowed */
+static bool access_array(Planner *p, ASTNode *node, int32_t *offset)
+{
+    int slot = node->slot;
+    // Lanes load and store 4-byte elements
+    if (element_size(node->value_type) != sizeof(Element))
+        return false;
+    if (!node->data.element.unchecked || !counter_offset(node->data.element.index, p->plan->induction, offset))
+        return false;
+    if ((p->stored[slot] || p->read[slot]) && p->offset[slot] != *offset)
+        p->mixed[slot] = true;
+    p->offset[slot] = *offset;
+    return true;
+}
+
+/* The register node's value is computed into, for every lane */
+static int plan_expression(Planner *p, ASTNode *node)
+{
+    if (p->failed)
+        return 0;
+    // Lanes are 32 bits wide
+    if (is_wide_type(node->value_type))
+    {
+        p->failed = true;
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CHAR:
+    case NODE_BOOLEAN:
+        return emit(p, true, (VectorInstruction){VOP_CONSTANT, new_register(p), 0, 0, 0, node->data.value});
+    case NODE_FLOAT:
+    {
+        int32_t bits;
+        memcpy(&bits, &node->data.fvalue, sizeof(bits));
+        return emit(p, true, (VectorInstruction){VOP_CONSTANT, new_register(p), 0, 0, 0, bits});
+    }
+    case NODE_IDENTIFIER:
+    {
+        int slot = node->slot;
+        if (slot == p->plan->induction)
+            return 0;
+        if (p->value_register[slot] >= 0)
+            return p->value_register[slot];
+        // Set by an earlier iteration, or summed into
+        if (p->assigned[slot] || symbol_table[slot].modifiers.is_volatile)
+        {
+            p->failed = true;
+            return 0;
+        }
+        if (p->invariant_register[slot] < 0)
+            p->invariant_register[slot] =
+                emit(p, true, (VectorInstruction){VOP_VARIABLE, new_register(p), 0, 0, slot, 0});
+        return p->invariant_register[slot];
+    }
+    case NODE_INDEX:
+    {
+        int32_t offset;
+        if (!access_array(p, node, &offset))
+        {
+            p->failed = true;
+            return 0;
+        }
+        p->read[node->slot] = true;
+        return emit(p, false, (VectorInstruction){VOP_ELEMENTS, new_register(p), 0, 0, node->slot, offset});
+    }
+    default:
+        break;
+    }
+
+    VectorOp op = node->type < sizeof(node_ops) / sizeof(node_ops[0]) ? node_ops[node->type] : VOP_NONE;
+    if (op == VOP_NONE)
+    {
+        p->failed = true;
+        return 0;
+    }
+    if (op == VOP_INEG || op == VOP_FNEG || op >= VOP_I2F)
+    {
+        int operand = plan_expression(p, node->data.unary.operand);
+        int dest = emit(p, false, (VectorInstruction){op, new_register(p), operand, 0, 0, 0});
+        p->is_counter[dest] = op == VOP_I2F && p->is_counter[operand];
+        return dest;
+    }
+
+    int left = plan_expression(p, node->data.op.left);
+    int right = plan_expression(p, node->data.op.right);
+    // A divisor must be known before the first block, to be checked once
+    if (is_division(op) && !p->is_setup[right] && !p->is_counter[right])
+        p->failed = true;
+    return emit(p, false, (VectorInstruction){op, new_register(p), left, right, 0, is_division(op) && p->is_counter[right]});
+}
+
+/* Whether value is the variable in slot with terms added and subtracted, as in `acc + a - b` */
+static bool is_sum_of(ASTNode *value, int slot, NodeType add, NodeType sub)
+{
+    while (value->type == add || value->type == sub)
+        value = value->data.op.left;
+    return is_identifier(value, slot);
+}
+
+/* Add the terms of value after the accumulator's, each under mask */
+static void plan_terms(Planner *p, ASTNode *value, int accumulator, int mask)
+{
+    if (value->type == NODE_IDENTIFIER)
+        return;
+    plan_terms(p, value->data.op.left, accumulator, mask);
+    int term = plan_expression(p, value->data.op.right);
+    VectorOp op = value->type == NODE_INT_ADD     ? VOP_ADD_TO
+                  : value->type == NODE_INT_SUB   ? VOP_SUBTRACT_FROM
+                  : value->type == NODE_FLOAT_ADD ? VOP_FADD_TO
+                                                  : VOP_FSUBTRACT_FROM;
+    emit(p, false, (VectorInstruction){op, 0, term, mask, 0, accumulator});
+}
+
+/*
+ * Plan an accumulation `acc = acc + term`, `acc = term + acc` or
+ * `acc = acc - term`; false if node is not one. Integer arithmetic wraps,
+ * so an integer accumulator may take several terms, `acc = acc + a - b`.
+ */
+static bool plan_accumulation(Planner *p, ASTNode *node, int mask)
+{
+    VectorLoop *plan = p->plan;
+    int slot = node->data.op.left->slot;
+    ASTNode *value = node->data.op.right;
+    ValueType type = symbol_table[slot].type;
+    bool is_float = type == TYPE_FLOAT;
+    if ((type != TYPE_INT && type != TYPE_UNSIGNED && !is_float) || plan->accumulator_count == MAX_ACCUMULATORS)
+        return false;
+
+    // Float terms are added one at a time to keep the scalar loop's rounding
+    NodeType add = is_float ? NODE_FLOAT_ADD : NODE_INT_ADD;
+    NodeType sub = is_float ? NODE_FLOAT_SUB : NODE_INT_SUB;
+    bool term_first = value->type == add && is_identifier(value->data.op.right, slot);
+    if (!term_first && (is_float ? !(value->type == add || value->type == sub) ||
+                                       !is_identifier(value->data.op.left, slot)
+                                 : value->type == NODE_IDENTIFIER || !is_sum_of(value, slot, add, sub)))
+        return false;
+
+    // The sum is only read after the loop
+    p->use[slot] = USE_ACCUMULATOR;
+    int accumulator = plan->accumulator_count++;
+    plan->accumulators[accumulator] = (Accumulator){slot, is_float};
+    if (term_first)
+        emit(p, false, (VectorInstruction){is_float ? VOP_FADD_TO : VOP_ADD_TO, 0,
+                                           plan_expression(p, value->data.op.left), mask, 0, accumulator});
+    else
+        plan_terms(p, value, accumulator, mask);
+    return true;
+}
+
+static void plan_statement(Planner *p, ASTNode *node, int mask)
+{
+    if (!node || p->failed)
+        return;
+
+    switch (node->type)
+    {
+    case NODE_STATEMENT_LIST:
+        for (StatementList *sl = node->data.statements; sl; sl = sl->next)
+        {
+            plan_statement(p, sl->statement, mask);
+        }
+        break;
+    case NODE_IF_STATEMENT:
+    {
+        if (node->data.if_stmt.condition->value_type == TYPE_FLOAT)
+        {
+            p->failed = true;
+            return;
+        }
+        int condition = plan_expression(p, node->data.if_stmt.condition);
+        int then_mask = emit(p, false, (VectorInstruction){VOP_MASK, new_register(p), mask, condition, 0, 0});
+        plan_statement(p, node->data.if_stmt.then_branch, then_mask);
+        if (node->data.if_stmt.else_branch)
+        {
+            int else_mask =
+                emit(p, false, (VectorInstruction){VOP_MASK_NOT, new_register(p), mask, condition, 0, 0});
+            plan_statement(p, node->data.if_stmt.else_branch, else_mask);
+        }
+        break;
+    }
+    case NODE_INDEX_ASSIGNMENT:
+    {
+        int32_t offset;
+        if (!access_array(p, node, &offset))
+        {
+            p->failed = true;
+            return;
+        }
+        int value = plan_expression(p, node->data.element.value);
+        p->stored[node->slot] = true;
+        emit(p, false, (VectorInstruction){VOP_STORE, 0, value, mask, node->slot, offset});
+        break;
+    }
+    case NODE_ASSIGNMENT:
+    {
+        int slot = node->data.op.left->slot;
+        if (slot == p->plan->induction || symbol_table[slot].modifiers.is_volatile || p->use[slot] == USE_ACCUMULATOR)
+        {
+            p->failed = true;
+            break;
+        }
+        if (p->use[slot] == USE_NONE && plan_accumulation(p, node, mask))
+            break;
+        // Otherwise set in every iteration before it is read
+        if (mask != ALL_LANES)
+        {
+            p->failed = true;
+            break;
+        }
+        p->value_register[slot] = plan_expression(p, node->data.op.right);
+        p->use[slot] = USE_PRIVATE;
+        break;
+    }
+    default:
+        p->failed = true;
+        break;
+    }
+}
+
+VectorLoop *vector_plan_loop(ASTNode *node)
+{
+    ASTNode *cond = node->data.for_stmt.cond;
+    ASTNode *incr = node->data.for_stmt.incr;
+    if (!cond || cond->type < NODE_INT_LT || cond->type > NODE_INT_NE || !incr || incr->type != NODE_ASSIGNMENT)
+        return NULL;
+
+    // `flex (...; i OP bound; i = i + step)` on an int counter
+    int induction = incr->data.op.left->slot;
+    ASTNode *step = incr->data.op.right;
+    ASTNode *bound = cond->data.op.right;
+    if (symbol_table[induction].type != TYPE_INT || symbol_table[induction].modifiers.is_volatile ||
+        (step->type != NODE_INT_ADD && step->type != NODE_INT_SUB) || !is_identifier(step->data.op.left, induction) ||
+        step->data.op.right->type != NODE_NUMBER || step->data.op.right->data.value == 0 ||
+        step->data.op.right->data.value == INT32_MIN || !is_identifier(cond->data.op.left, induction) ||
+        (bound->type != NODE_NUMBER && bound->type != NODE_IDENTIFIER))
+        return NULL;
+
+    Planner *p = calloc(1, sizeof(Planner));
+    VectorLoop plan = {.induction = induction, .comparison = cond->type, .bound = bound};
+    plan.step = step->type == NODE_INT_ADD ? step->data.op.right->data.value : -step->data.op.right->data.value;
+    p->plan = &plan;
+    p->register_count = 2;
+    p->is_counter[0] = true;
+    memset(p->value_register, 0xff, sizeof(p->value_register));
+    memset(p->invariant_register, 0xff, sizeof(p->invariant_register));
+
+    p->failed = !collect_assigned(node->data.for_stmt.body, p->assigned) || p->assigned[induction] ||
+                (bound->type == NODE_IDENTIFIER &&
+                 (p->assigned[bound->slot] || symbol_table[bound->slot].type == TYPE_FLOAT));
+    plan_statement(p, node->data.for_stmt.body, ALL_LANES);
+    for (int slot = 0; slot < var_count; slot++)
+    {
+        // An array stored to may only be read at the element of the same iteration
+        if (p->stored[slot] && p->mixed[slot])
+            p->failed = true;
+        if (p->use[slot] == USE_PRIVATE)
+            plan.privates[plan.private_count++] = (Private){slot, p->value_register[slot]};
+    }
+
+    VectorLoop *result = NULL;
+    if (!p->failed && (plan.accumulator_count > 0 || plan.private_count > 0 || p->body_count > 0))
+    {
+        result = arena_alloc(ast_arena, sizeof(VectorLoop));
+        *result = plan;
+        result->setup_count = p->setup_count;
+        result->count = p->setup_count + p->body_count;
+        result->code = arena_alloc(ast_arena, result->count * sizeof(VectorInstruction));
+        memcpy(result->code, p->setup, p->setup_count * sizeof(VectorInstruction));
+        memcpy(result->code + p->setup_count, p->body, p->body_count * sizeof(VectorInstruction));
+    }
+    free(p);
+    return result;
+}
+
+/* Execution */
+
+typedef int32_t IntBlock __attribute__((vector_size(VECTOR_WIDTH * sizeof(int32_t))));
+typedef uint32_t UIntBlock __attribute__((vector_size(VECTOR_WIDTH * sizeof(uint32_t))));
+typedef float FloatBlock __attribute__((vector_size(VECTOR_WIDTH * sizeof(float))));
+
+typedef union
+{
+    IntBlock i;
+    UIntBlock u;
+    FloatBlock f;
+} Block;
+
+/* Whether the counter takes value in the given number of blocks from start */
+static bool counter_reaches(int start, int step, long long blocks, long long value)
+{
+    long long distance = value - start;
+    return distance % step == 0 && distance / step >= 0 && distance / step < blocks * VECTOR_WIDTH;
+}
+
+/*
+ * Run blocks of VECTOR_WIDTH iterations from the counter value start.
+ * Compiled once for each instruction set, which the vector types then
+ * use; false, before anything is run, if a divisor is zero.
+ */
+static inline __attribute__((always_inline)) bool run_blocks(const VectorLoop *plan, int start, long long blocks)
+{
+    Block registers[MAX_REGISTERS];
+    variable *symbols = symbol_table;
+    // Masks hold -1 in the lanes selected and 0 elsewhere
+    for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+        registers[ALL_LANES].i[lane] = -1;
+
+    for (int n = 0; n < plan->setup_count; n++)
+    {
+        const VectorInstruction *in = &plan->code[n];
+        Block *dest = &registers[in->dest];
+        int32_t bits = in->op == VOP_CONSTANT ? in->bits : symbols[in->slot].value.ivalue;
+        for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+            dest->i[lane] = bits;
+    }
+    // Dividing by zero reports an error and INT_MIN / -1 traps, both left to the scalar loop
+    for (int n = plan->setup_count; n < plan->count; n++)
+    {
+        const VectorInstruction *in = &plan->code[n];
+        if (!is_division(in->op))
+            continue;
+        bool is_signed = in->op == VOP_IDIV || in->op == VOP_IMOD;
+        if (in->bits)
+        {
+            if (counter_reaches(start, plan->step, blocks, 0) ||
+                (is_signed && counter_reaches(start, plan->step, blocks, -1)))
+                return false;
+            continue;
+        }
+        const Block *divisor = &registers[in->right];
+        if (in->op == VOP_FDIV ? divisor->f[0] == 0.0f : divisor->i[0] == 0 || (is_signed && divisor->i[0] == -1))
+            return false;
+    }
+
+    UIntBlock lane_steps;
+    for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+        lane_steps[lane] = (uint32_t)lane * (uint32_t)plan->step;
+    uint32_t block_step = (uint32_t)VECTOR_WIDTH * (uint32_t)plan->step;
+    UIntBlock int_sums[MAX_ACCUMULATORS] = {{0}};
+    float float_sums[MAX_ACCUMULATORS];
+    for (int n = 0; n < plan->accumulator_count; n++)
+        float_sums[n] = symbols[plan->accumulators[n].slot].value.fvalue;
+
+    uint32_t first = (uint32_t)start;
+    for (long long block = 0; block < blocks; block++, first += block_step)
+    {
+        registers[0].u = first + lane_steps;
+        for (int n = plan->setup_count; n < plan->count; n++)
+        {
+            const VectorInstruction *in = &plan->code[n];
+            Block *dest = &registers[in->dest];
+            const Block *left = &registers[in->left];
+            const Block *right = &registers[in->right];
+            switch (in->op)
+            {
+            case VOP_ELEMENTS:
+            {
+                const Element *elements = symbols[in->slot].elements + (int32_t)first + in->bits;
+                if (plan->step == 1)
+                    memcpy(dest, elements, sizeof(Block));
+                else
+                    for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                        dest->i[lane] = elements[(int32_t)lane_steps[lane]].ivalue;
+                break;
+            }
+            case VOP_IADD:
+                dest->u = left->u + right->u;
+                break;
+            case VOP_ISUB:
+                dest->u = left->u - right->u;
+                break;
+            case VOP_IMUL:
+                dest->u = left->u * right->u;
+                break;
+            case VOP_INEG:
+                dest->u = -left->u;
+                break;
+            case VOP_IDIV:
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    dest->i[lane] = left->i[lane] / right->i[lane];
+                break;
+            case VOP_IMOD:
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    dest->i[lane] = left->i[lane] % right->i[lane];
+                break;
+            case VOP_UDIV:
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    dest->u[lane] = left->u[lane] / right->u[lane];
+                break;
+            case VOP_UMOD:
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    dest->u[lane] = left->u[lane] % right->u[lane];
+                break;
+            // Vector comparisons give -1 where they hold; negated, 1 as in the scalar loop
+            case VOP_ILT:
+                dest->i = -(left->i < right->i);
+                break;
+            case VOP_IGT:
+                dest->i = -(left->i > right->i);
+                break;
+            case VOP_ILE:
+                dest->i = -(left->i <= right->i);
+                break;
+            case VOP_IGE:
+                dest->i = -(left->i >= right->i);
+                break;
+            case VOP_IEQ:
+                dest->i = -(left->i == right->i);
+                break;
+            case VOP_INE:
+                dest->i = -(left->i != right->i);
+                break;
+            case VOP_ULT:
+                dest->i = -(left->u < right->u);
+                break;
+            case VOP_UGT:
+                dest->i = -(left->u > right->u);
+                break;
+            case VOP_ULE:
+                dest->i = -(left->u <= right->u);
+                break;
+            case VOP_UGE:
+                dest->i = -(left->u >= right->u);
+                break;
+            case VOP_FADD:
+                dest->f = left->f + right->f;
+                break;
+            case VOP_FSUB:
+                dest->f = left->f - right->f;
+                break;
+            case VOP_FMUL:
+                dest->f = left->f * right->f;
+                break;
+            case VOP_FDIV:
+                dest->f = left->f / right->f;
+                break;
+            case VOP_FNEG:
+                dest->f = -left->f;
+                break;
+            case VOP_FLT:
+                dest->i = -(left->f < right->f);
+                break;
+            case VOP_FGT:
+                dest->i = -(left->f > right->f);
+                break;
+            case VOP_FLE:
+                dest->i = -(left->f <= right->f);
+                break;
+            case VOP_FGE:
+                dest->i = -(left->f >= right->f);
+                break;
+            case VOP_FEQ:
+                dest->i = -(left->f == right->f);
+                break;
+            case VOP_FNE:
+                dest->i = -(left->f != right->f);
+                break;
+            case VOP_AND:
+                dest->i = -((left->i != 0) & (right->i != 0));
+                break;
+            case VOP_OR:
+                dest->i = -((left->i != 0) | (right->i != 0));
+                break;
+            case VOP_I2F:
+                dest->f = __builtin_convertvector(left->i, FloatBlock);
+                break;
+            case VOP_U2F:
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    dest->f[lane] = (float)left->u[lane];
+                break;
+            case VOP_F2I:
+                dest->i = __builtin_convertvector(left->f, IntBlock);
+                break;
+            case VOP_F2B:
+                dest->i = -(left->f != 0.0f);
+                break;
+            case VOP_I2B:
+                dest->i = -(left->i != 0);
+                break;
+            case VOP_I2C:
+                dest->i = (IntBlock)(left->u << 24) >> 24;
+                break;
+            case VOP_MASK:
+                dest->i = left->i & (right->i != 0);
+                break;
+            case VOP_MASK_NOT:
+                dest->i = left->i & (right->i == 0);
+                break;
+            case VOP_STORE:
+            {
+                Element *elements = symbols[in->slot].elements + (int32_t)first + in->bits;
+                IntBlock mask = right->i;
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    if (mask[lane])
+                        elements[(int32_t)lane_steps[lane]].ivalue = left->i[lane];
+                break;
+            }
+            case VOP_ADD_TO:
+                int_sums[in->bits] += left->u & right->u;
+                break;
+            case VOP_SUBTRACT_FROM:
+                int_sums[in->bits] -= left->u & right->u;
+                break;
+            // One iteration at a time, so the result is rounded as in the scalar loop
+            case VOP_FADD_TO:
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    if (right->i[lane])
+                        float_sums[in->bits] += left->f[lane];
+                break;
+            case VOP_FSUBTRACT_FROM:
+                for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+                    if (right->i[lane])
+                        float_sums[in->bits] -= left->f[lane];
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    for (int n = 0; n < plan->accumulator_count; n++)
+    {
+        Value *value = &symbols[plan->accumulators[n].slot].value;
+        if (plan->accumulators[n].is_float)
+        {
+            value->fvalue = float_sums[n];
+            continue;
+        }
+        uint32_t total = (uint32_t)value->ivalue;
+        for (int lane = 0; lane < VECTOR_WIDTH; lane++)
+            total += int_sums[n][lane];
+        value->ivalue = (int)total;
+    }
+    for (int n = 0; n < plan->private_count; n++)
+        symbols[plan->privates[n].slot].value.ivalue = registers[plan->privates[n].reg].i[VECTOR_WIDTH - 1];
+    return true;
+}
+
+static bool run_blocks_generic(const VectorLoop *plan, int start, long long blocks)
+{
+    return run_blocks(plan, start, blocks);
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+__attribute__((target("avx2"))) static bool run_blocks_avx2(const VectorLoop *plan, int start, long long blocks)
+{
+    return run_blocks(plan, start, blocks);
+}
+
+__attribute__((target("sse4.1"))) static bool run_blocks_sse41(const VectorLoop *plan, int start, long long blocks)
+{
+    return run_blocks(plan, start, blocks);
+}
+#endif
+
+void vector_execute_blocks(ASTNode *node)
+{
+    const VectorLoop *plan = node->data.for_stmt.vector;
+    variable *counter = &symbol_table[plan->induction];
+    int start = counter->value.ivalue;
+    int bound = plan->bound->type == NODE_NUMBER ? plan->bound->data.value : symbol_table[plan->bound->slot].value.ivalue;
+    long long trips = loop_trip_count(plan->comparison, start, bound, plan->step);
+    long long blocks = trips / VECTOR_WIDTH;
+    if (trips < 0 || blocks == 0)
+        return;
+
+    bool ran;
+#if defined(__x86_64__) && !defined(__clang__)
+    if (__builtin_cpu_supports("avx2"))
+        ran = run_blocks_avx2(plan, start, blocks);
+    else if (__builtin_cpu_supports("sse4.1"))
+        ran = run_blocks_sse41(plan, start, blocks);
+    else
+#endif
+        ran = run_blocks_generic(plan, start, blocks);
+    if (ran)
+        counter->value.ivalue = (int)(start + blocks * VECTOR_WIDTH * plan->step);
+}
+
+#else
+
+VectorLoop *vector_plan_loop(ASTNode *node)
+{
+    (void)node;
+    return NULL;
+}
+
+void vector_execute_blocks(ASTNode *node)
+{
+    (void)node;
+}
+
+#endif
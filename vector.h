@@ -0,0 +1,43 @@
+/* vector.h */
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include "ast.h"
+
+/*
+ * Batch execution of `flex` loops over blocks of counter values.
+ *
+ * At -O2, a counting loop is planned for batch execution when every
+ * iteration is independent of the others: its body only adds to or
+ * subtracts from `rizz` and `chad` accumulators, possibly under `edging`,
+ * stores into elements a[i + k], and sets variables that are read later
+ * in the same iteration, dividing only by values known before the first
+ * iteration, such as invariants or the counter itself. The tree
+ * walker, also under --jit, then evaluates the body for VECTOR_WIDTH
+ * consecutive counter values at once and runs the iterations left over
+ * as usual.
+ *
+ * Blocks are computed with AVX2 or SSE4.1 instructions when the
+ * processor has them and SSE2 otherwise, chosen at run time. Integer
+ * results are identical to the scalar loop's: arithmetic wraps in every
+ * lane and sums are associative. Float expressions use the same single
+ * precision operations as the scalar loop, without fused multiply-add,
+ * and each float accumulator receives its terms one iteration at a time
+ * in loop order, so float results are identical too; only the terms are
+ * computed in parallel.
+ */
+#define VECTOR_WIDTH 16
+
+/* The batch form of a loop, allocated in the program's arena, or NULL if the loop does not qualify */
+VectorLoop *vector_plan_loop(ASTNode *node);
+
+/*
+ * Run the whole blocks of iterations of node's loop, whose initialization
+ * has run, and step its counter past them. Nothing is run when the number
+ * of iterations is not known on entry or a divisor is zero, leaving every
+ * iteration to the tree walker.
+ */
+void vector_execute_blocks(ASTNode *node);
+
+#endif /* VECTOR_H */
@@ -0,0 +1,829 @@
+/* vm.c */
+
+#include "vm.h"
+#include "format.h"
+#include <stdbool.h>
+#include <string.h>
+
+extern void yyerror(const char *s);
+extern void baka(const char *format, ...);
+
+/*
+ * Threaded dispatch: with GCC/Clang every handler jumps straight to the
+ * next one through a label table, otherwise fall back to a switch.
+ */
+#if defined(__GNUC__)
+#define DISPATCH() goto *dispatch_table[*ip++]
+#define CASE(op) L_##op
+#else
+#define DISPATCH() continue
+#define CASE(op) case op
+#endif
+
+/* Wrapping integer arithmetic, matching two's complement hardware */
+#define INT_BINARY(operator)                                                                 \
+    do                                                                                       \
+    {                                                                                        \
+        sp--;                                                                                \
+        sp[-1].ivalue = (int)((unsigned int)sp[-1].ivalue operator (unsigned int)sp[0].ivalue); \
+    } while (0)
+
+#define LONG_BINARY(operator)                                                                     \
+    do                                                                                            \
+    {                                                                                             \
+        sp--;                                                                                     \
+        sp[-1].lvalue = (int64_t)((uint64_t)sp[-1].lvalue operator (uint64_t)sp[0].lvalue);       \
+    } while (0)
+
+#define BINARY(field, operator, result)                       \
+    do                                                        \
+    {                                                         \
+        sp--;                                                 \
+        sp[-1].result = sp[-1].field operator sp[0].field;    \
+    } while (0)
+
+#define UNSIGNED_COMPARE(operator)                                                  \
+    do                                                                              \
+    {                                                                               \
+        sp--;                                                                       \
+        sp[-1].ivalue = (unsigned int)sp[-1].ivalue operator (unsigned int)sp[0].ivalue; \
+    } while (0)
+
+/* Pop two operands and take the jump if the comparison holds */
+#define COMPARE_JUMP(type, operator)                              \
+    do                                                            \
+    {                                                             \
+        sp -= 2;                                                  \
+        if ((type)sp[0].ivalue operator (type)sp[1].ivalue)       \
+            ip = code + ip[0];                                    \
+        else                                                      \
+            ip++;                                                 \
+    } while (0)
+
+/* Where a call returns to */
+typedef struct
+{
+    const int32_t *ip;
+    variable *symbols;
+    int frame_size;
+} CallRecord;
+
+void vm_execute(Chunk *chunk)
+{
+#if defined(__GNUC__)
+    static void *dispatch_table[] = {
+        [BC_PUSH] = &&L_BC_PUSH,
+        [BC_LOAD] = &&L_BC_LOAD,
+        [BC_STORE] = &&L_BC_STORE,
+        [BC_POP] = &&L_BC_POP,
+        [BC_NEW_ARRAY] = &&L_BC_NEW_ARRAY,
+        [BC_ALOAD] = &&L_BC_ALOAD,
+        [BC_ALOAD_UNCHECKED] = &&L_BC_ALOAD_UNCHECKED,
+        [BC_ASTORE] = &&L_BC_ASTORE,
+        [BC_ASTORE_UNCHECKED] = &&L_BC_ASTORE_UNCHECKED,
+        [BC_PUSH_WIDE] = &&L_BC_PUSH_WIDE,
+        [BC_NEW_WIDE_ARRAY] = &&L_BC_NEW_WIDE_ARRAY,
+        [BC_ALOAD_WIDE] = &&L_BC_ALOAD_WIDE,
+        [BC_ALOAD_WIDE_UNCHECKED] = &&L_BC_ALOAD_WIDE_UNCHECKED,
+        [BC_ASTORE_WIDE] = &&L_BC_ASTORE_WIDE,
+        [BC_ASTORE_WIDE_UNCHECKED] = &&L_BC_ASTORE_WIDE_UNCHECKED,
+        [BC_NEW_BYTE_ARRAY] = &&L_BC_NEW_BYTE_ARRAY,
+        [BC_ALOAD_BYTE] = &&L_BC_ALOAD_BYTE,
+        [BC_ALOAD_BYTE_UNCHECKED] = &&L_BC_ALOAD_BYTE_UNCHECKED,
+        [BC_ASTORE_BYTE] = &&L_BC_ASTORE_BYTE,
+        [BC_ASTORE_BYTE_UNCHECKED] = &&L_BC_ASTORE_BYTE_UNCHECKED,
+        [BC_NEW_SHORT_ARRAY] = &&L_BC_NEW_SHORT_ARRAY,
+        [BC_ALOAD_SHORT] = &&L_BC_ALOAD_SHORT,
+        [BC_ALOAD_SHORT_UNCHECKED] = &&L_BC_ALOAD_SHORT_UNCHECKED,
+        [BC_ASTORE_SHORT] = &&L_BC_ASTORE_SHORT,
+        [BC_ASTORE_SHORT_UNCHECKED] = &&L_BC_ASTORE_SHORT_UNCHECKED,
+        [BC_IADD] = &&L_BC_IADD,
+        [BC_ISUB] = &&L_BC_ISUB,
+        [BC_IMUL] = &&L_BC_IMUL,
+        [BC_IDIV] = &&L_BC_IDIV,
+        [BC_IMOD] = &&L_BC_IMOD,
+        [BC_ILT] = &&L_BC_ILT,
+        [BC_IGT] = &&L_BC_IGT,
+        [BC_ILE] = &&L_BC_ILE,
+        [BC_IGE] = &&L_BC_IGE,
+        [BC_IEQ] = &&L_BC_IEQ,
+        [BC_INE] = &&L_BC_INE,
+        [BC_INEG] = &&L_BC_INEG,
+        [BC_UDIV] = &&L_BC_UDIV,
+        [BC_UMOD] = &&L_BC_UMOD,
+        [BC_ULT] = &&L_BC_ULT,
+        [BC_UGT] = &&L_BC_UGT,
+        [BC_ULE] = &&L_BC_ULE,
+        [BC_UGE] = &&L_BC_UGE,
+        [BC_FADD] = &&L_BC_FADD,
+        [BC_FSUB] = &&L_BC_FSUB,
+        [BC_FMUL] = &&L_BC_FMUL,
+        [BC_FDIV] = &&L_BC_FDIV,
+        [BC_FLT] = &&L_BC_FLT,
+        [BC_FGT] = &&L_BC_FGT,
+        [BC_FLE] = &&L_BC_FLE,
+        [BC_FGE] = &&L_BC_FGE,
+        [BC_FEQ] = &&L_BC_FEQ,
+        [BC_FNE] = &&L_BC_FNE,
+        [BC_FNEG] = &&L_BC_FNEG,
+        [BC_LADD] = &&L_BC_LADD,
+        [BC_LSUB] = &&L_BC_LSUB,
+        [BC_LMUL] = &&L_BC_LMUL,
+        [BC_LDIV] = &&L_BC_LDIV,
+        [BC_LMOD] = &&L_BC_LMOD,
+        [BC_LLT] = &&L_BC_LLT,
+        [BC_LGT] = &&L_BC_LGT,
+        [BC_LLE] = &&L_BC_LLE,
+        [BC_LGE] = &&L_BC_LGE,
+        [BC_LEQ] = &&L_BC_LEQ,
+        [BC_LNE] = &&L_BC_LNE,
+        [BC_LNEG] = &&L_BC_LNEG,
+        [BC_DADD] = &&L_BC_DADD,
+        [BC_DSUB] = &&L_BC_DSUB,
+        [BC_DMUL] = &&L_BC_DMUL,
+        [BC_DDIV] = &&L_BC_DDIV,
+        [BC_DLT] = &&L_BC_DLT,
+        [BC_DGT] = &&L_BC_DGT,
+        [BC_DLE] = &&L_BC_DLE,
+        [BC_DGE] = &&L_BC_DGE,
+        [BC_DEQ] = &&L_BC_DEQ,
+        [BC_DNE] = &&L_BC_DNE,
+        [BC_DNEG] = &&L_BC_DNEG,
+        [BC_I2F] = &&L_BC_I2F,
+        [BC_U2F] = &&L_BC_U2F,
+        [BC_F2I] = &&L_BC_F2I,
+        [BC_F2U] = &&L_BC_F2U,
+        [BC_F2B] = &&L_BC_F2B,
+        [BC_I2B] = &&L_BC_I2B,
+        [BC_I2C] = &&L_BC_I2C,
+        [BC_I2S] = &&L_BC_I2S,
+        [BC_I2L] = &&L_BC_I2L,
+        [BC_U2L] = &&L_BC_U2L,
+        [BC_L2I] = &&L_BC_L2I,
+        [BC_L2B] = &&L_BC_L2B,
+        [BC_L2F] = &&L_BC_L2F,
+        [BC_L2D] = &&L_BC_L2D,
+        [BC_F2L] = &&L_BC_F2L,
+        [BC_D2L] = &&L_BC_D2L,
+        [BC_I2D] = &&L_BC_I2D,
+        [BC_U2D] = &&L_BC_U2D,
+        [BC_F2D] = &&L_BC_F2D,
+        [BC_D2F] = &&L_BC_D2F,
+        [BC_D2I] = &&L_BC_D2I,
+        [BC_D2U] = &&L_BC_D2U,
+        [BC_D2B] = &&L_BC_D2B,
+        [BC_JUMP] = &&L_BC_JUMP,
+        [BC_JUMP_IF_FALSE] = &&L_BC_JUMP_IF_FALSE,
+        [BC_JUMP_IF_TRUE] = &&L_BC_JUMP_IF_TRUE,
+        [BC_JUMP_ILT] = &&L_BC_JUMP_ILT,
+        [BC_JUMP_IGT] = &&L_BC_JUMP_IGT,
+        [BC_JUMP_ILE] = &&L_BC_JUMP_ILE,
+        [BC_JUMP_IGE] = &&L_BC_JUMP_IGE,
+        [BC_JUMP_IEQ] = &&L_BC_JUMP_IEQ,
+        [BC_JUMP_INE] = &&L_BC_JUMP_INE,
+        [BC_JUMP_ULT] = &&L_BC_JUMP_ULT,
+        [BC_JUMP_UGT] = &&L_BC_JUMP_UGT,
+        [BC_JUMP_ULE] = &&L_BC_JUMP_ULE,
+        [BC_JUMP_UGE] = &&L_BC_JUMP_UGE,
+        [BC_SWITCH_DENSE] = &&L_BC_SWITCH_DENSE,
+        [BC_SWITCH_SPARSE] = &&L_BC_SWITCH_SPARSE,
+        [BC_PRINT] = &&L_BC_PRINT,
+        [BC_BAKA_VALUE] = &&L_BC_BAKA_VALUE,
+        [BC_CALL] = &&L_BC_CALL,
+        [BC_RETURN] = &&L_BC_RETURN,
+        [BC_HALT] = &&L_BC_HALT,
+    };
+#endif
+
+    // Each active call uses at most max_stack values above its caller's
+    int frames = chunk->function_count ? MAX_CALL_DEPTH + 1 : 1;
+    Value *stack = malloc((size_t)frames * (chunk->max_stack + 1) * sizeof(Value));
+    CallRecord *calls = chunk->function_count ? malloc(MAX_CALL_DEPTH * sizeof(CallRecord)) : NULL;
+    int call_depth = 0;
+    Value *sp = stack;
+    const int32_t *code = chunk->code;
+    const int32_t *ip = code;
+    variable *symbols = symbol_table;
+
+#if defined(__GNUC__)
+    DISPATCH();
+#else
+    for (;;)
+    {
+        switch (*ip++)
+        {
+#endif
+
+    CASE(BC_PUSH):
+        (sp++)->ivalue = *ip++;
+        DISPATCH();
+
+    CASE(BC_PUSH_WIDE):
+        // The low 32 bits come first
+        (sp++)->lvalue = (int64_t)((uint64_t)(uint32_t)ip[0] | (uint64_t)(uint32_t)ip[1] << 32);
+        ip += 2;
+        DISPATCH();
+
+    CASE(BC_LOAD):
+        *sp++ = symbols[*ip++].value;
+        DISPATCH();
+
+    CASE(BC_STORE):
+        symbols[*ip++].value = *--sp;
+        DISPATCH();
+
+    CASE(BC_POP):
+        sp--;
+        DISPATCH();
+
+    CASE(BC_NEW_ARRAY):
+        if (!declare_array(&symbols[*ip++], (--sp)->ivalue, sizeof(Element)))
+            goto halt;
+        DISPATCH();
+
+    CASE(BC_ALOAD):
+        sp[-1].ivalue = array_element(&symbols[*ip++], sp[-1].ivalue)->ivalue;
+        DISPATCH();
+
+    CASE(BC_ALOAD_UNCHECKED):
+        sp[-1].ivalue = symbols[*ip++].elements[sp[-1].ivalue].ivalue;
+        DISPATCH();
+
+    CASE(BC_ASTORE):
+        sp -= 2;
+        array_element(&symbols[*ip++], sp[0].ivalue)->ivalue = sp[1].ivalue;
+        DISPATCH();
+
+    CASE(BC_ASTORE_UNCHECKED):
+        sp -= 2;
+        symbols[*ip++].elements[sp[0].ivalue].ivalue = sp[1].ivalue;
+        DISPATCH();
+
+    CASE(BC_NEW_WIDE_ARRAY):
+        if (!declare_array(&symbols[*ip++], (--sp)->ivalue, sizeof(Value)))
+            goto halt;
+        DISPATCH();
+
+    CASE(BC_ALOAD_WIDE):
+        sp[-1] = *wide_array_element(&symbols[*ip++], sp[-1].ivalue);
+        DISPATCH();
+
+    CASE(BC_ALOAD_WIDE_UNCHECKED):
+        sp[-1] = symbols[*ip++].wide_elements[sp[-1].ivalue];
+        DISPATCH();
+
+    CASE(BC_ASTORE_WIDE):
+        sp -= 2;
+        *wide_array_element(&symbols[*ip++], sp[0].ivalue) = sp[1];
+        DISPATCH();
+
+    CASE(BC_ASTORE_WIDE_UNCHECKED):
+        sp -= 2;
+        symbols[*ip++].wide_elements[sp[0].ivalue] = sp[1];
+        DISPATCH();
+
+    CASE(BC_NEW_BYTE_ARRAY):
+        if (!declare_array(&symbols[*ip++], (--sp)->ivalue, sizeof(char)))
+            goto halt;
+        DISPATCH();
+
+    CASE(BC_ALOAD_BYTE):
+        sp[-1].ivalue = *byte_array_element(&symbols[*ip++], sp[-1].ivalue);
+        DISPATCH();
+
+    CASE(BC_ALOAD_BYTE_UNCHECKED):
+        sp[-1].ivalue = symbols[*ip++].byte_elements[sp[-1].ivalue];
+        DISPATCH();
+
+    CASE(BC_ASTORE_BYTE):
+        sp -= 2;
+        *byte_array_element(&symbols[*ip++], sp[0].ivalue) = (char)sp[1].ivalue;
+        DISPATCH();
+
+    CASE(BC_ASTORE_BYTE_UNCHECKED):
+        sp -= 2;
+        symbols[*ip++].byte_elements[sp[0].ivalue] = (char)sp[1].ivalue;
+        DISPATCH();
+
+    CASE(BC_NEW_SHORT_ARRAY):
+        if (!declare_array(&symbols[*ip++], (--sp)->ivalue, sizeof(short)))
+            goto halt;
+        DISPATCH();
+
+    CASE(BC_ALOAD_SHORT):
+        sp[-1].ivalue = *short_array_element(&symbols[*ip++], sp[-1].ivalue);
+        DISPATCH();
+
+    CASE(BC_ALOAD_SHORT_UNCHECKED):
+        sp[-1].ivalue = symbols[*ip++].short_elements[sp[-1].ivalue];
+        DISPATCH();
+
+    CASE(BC_ASTORE_SHORT):
+        sp -= 2;
+        *short_array_element(&symbols[*ip++], sp[0].ivalue) = (short)sp[1].ivalue;
+        DISPATCH();
+
+    CASE(BC_ASTORE_SHORT_UNCHECKED):
+        sp -= 2;
+        symbols[*ip++].short_elements[sp[0].ivalue] = (short)sp[1].ivalue;
+        DISPATCH();
+
+    CASE(BC_IADD):
+        INT_BINARY(+);
+        DISPATCH();
+
+    CASE(BC_ISUB):
+        INT_BINARY(-);
+        DISPATCH();
+
+    CASE(BC_IMUL):
+        INT_BINARY(*);
+        DISPATCH();
+
+    CASE(BC_IDIV):
+    CASE(BC_IMOD):
+    CASE(BC_UDIV):
+    CASE(BC_UMOD):
+    {
+        int32_t op = ip[-1];
+        int left = sp[-2].ivalue;
+        int right = sp[-1].ivalue;
+        sp--;
+        if (right == 0)
+        {
+            yyerror("Division by zero");
+            sp[-1].ivalue = 0;
+        }
+        else if (op == BC_IDIV)
+            sp[-1].ivalue = right == -1 ? (int)(0u - (unsigned int)left) : left / right;
+        else if (op == BC_IMOD)
+            sp[-1].ivalue = right == -1 ? 0 : left % right;
+        else if (op == BC_UDIV)
+            sp[-1].ivalue = (unsigned int)left / (unsigned int)right;
+        else
+            sp[-1].ivalue = (unsigned int)left % (unsigned int)right;
+        DISPATCH();
+    }
+
+    CASE(BC_ILT):
+        BINARY(ivalue, <, ivalue);
+        DISPATCH();
+
+    CASE(BC_IGT):
+        BINARY(ivalue, >, ivalue);
+        DISPATCH();
+
+    CASE(BC_ILE):
+        BINARY(ivalue, <=, ivalue);
+        DISPATCH();
+
+    CASE(BC_IGE):
+        BINARY(ivalue, >=, ivalue);
+        DISPATCH();
+
+    CASE(BC_IEQ):
+        BINARY(ivalue, ==, ivalue);
+        DISPATCH();
+
+    CASE(BC_INE):
+        BINARY(ivalue, !=, ivalue);
+        DISPATCH();
+
+    CASE(BC_INEG):
+        sp[-1].ivalue = (int)(0u - (unsigned int)sp[-1].ivalue);
+        DISPATCH();
+
+    CASE(BC_ULT):
+        UNSIGNED_COMPARE(<);
+        DISPATCH();
+
+    CASE(BC_UGT):
+        UNSIGNED_COMPARE(>);
+        DISPATCH();
+
+    CASE(BC_ULE):
+        UNSIGNED_COMPARE(<=);
+        DISPATCH();
+
+    CASE(BC_UGE):
+        UNSIGNED_COMPARE(>=);
+        DISPATCH();
+
+    CASE(BC_FADD):
+        BINARY(fvalue, +, fvalue);
+        DISPATCH();
+
+    CASE(BC_FSUB):
+        BINARY(fvalue, -, fvalue);
+        DISPATCH();
+
+    CASE(BC_FMUL):
+        BINARY(fvalue, *, fvalue);
+        DISPATCH();
+
+    CASE(BC_FDIV):
+        sp--;
+        if (sp[0].fvalue == 0.0f)
+        {
+            yyerror("Division by zero");
+            sp[-1].fvalue = 0.0f;
+        }
+        else
+        {
+            sp[-1].fvalue /= sp[0].fvalue;
+        }
+        DISPATCH();
+
+    CASE(BC_FLT):
+        BINARY(fvalue, <, ivalue);
+        DISPATCH();
+
+    CASE(BC_FGT):
+        BINARY(fvalue, >, ivalue);
+        DISPATCH();
+
+    CASE(BC_FLE):
+        BINARY(fvalue, <=, ivalue);
+        DISPATCH();
+
+    CASE(BC_FGE):
+        BINARY(fvalue, >=, ivalue);
+        DISPATCH();
+
+    CASE(BC_FEQ):
+        BINARY(fvalue, ==, ivalue);
+        DISPATCH();
+
+    CASE(BC_FNE):
+        BINARY(fvalue, !=, ivalue);
+        DISPATCH();
+
+    CASE(BC_FNEG):
+        sp[-1].fvalue = -sp[-1].fvalue;
+        DISPATCH();
+
+    CASE(BC_LADD):
+        LONG_BINARY(+);
+        DISPATCH();
+
+    CASE(BC_LSUB):
+        LONG_BINARY(-);
+        DISPATCH();
+
+    CASE(BC_LMUL):
+        LONG_BINARY(*);
+        DISPATCH();
+
+    CASE(BC_LDIV):
+    CASE(BC_LMOD):
+    {
+        int32_t op = ip[-1];
+        int64_t left = sp[-2].lvalue;
+        int64_t right = sp[-1].lvalue;
+        sp--;
+        if (right == 0)
+        {
+            yyerror("Division by zero");
+            sp[-1].lvalue = 0;
+        }
+        else if (right == -1)
+            // INT64_MIN / -1 overflows, so divide by negating
+            sp[-1].lvalue = op == BC_LDIV ? (int64_t)(0u - (uint64_t)left) : 0;
+        else if (op == BC_LDIV)
+            sp[-1].lvalue = left / right;
+        else
+            sp[-1].lvalue = left % right;
+        DISPATCH();
+    }
+
+    CASE(BC_LLT):
+        BINARY(lvalue, <, ivalue);
+        DISPATCH();
+
+    CASE(BC_LGT):
+        BINARY(lvalue, >, ivalue);
+        DISPATCH();
+
+    CASE(BC_LLE):
+        BINARY(lvalue, <=, ivalue);
+        DISPATCH();
+
+    CASE(BC_LGE):
+        BINARY(lvalue, >=, ivalue);
+        DISPATCH();
+
+    CASE(BC_LEQ):
+        BINARY(lvalue, ==, ivalue);
+        DISPATCH();
+
+    CASE(BC_LNE):
+        BINARY(lvalue, !=, ivalue);
+        DISPATCH();
+
+    CASE(BC_LNEG):
+        sp[-1].lvalue = (int64_t)(0u - (uint64_t)sp[-1].lvalue);
+        DISPATCH();
+
+    CASE(BC_DADD):
+        BINARY(dvalue, +, dvalue);
+        DISPATCH();
+
+    CASE(BC_DSUB):
+        BINARY(dvalue, -, dvalue);
+        DISPATCH();
+
+    CASE(BC_DMUL):
+        BINARY(dvalue, *, dvalue);
+        DISPATCH();
+
+    CASE(BC_DDIV):
+        sp--;
+        if (sp[0].dvalue == 0.0)
+        {
+            yyerror("Division by zero");
+            sp[-1].dvalue = 0.0;
+        }
+        else
+        {
+            sp[-1].dvalue /= sp[0].dvalue;
+        }
+        DISPATCH();
+
+    CASE(BC_DLT):
+        BINARY(dvalue, <, ivalue);
+        DISPATCH();
+
+    CASE(BC_DGT):
+        BINARY(dvalue, >, ivalue);
+        DISPATCH();
+
+    CASE(BC_DLE):
+        BINARY(dvalue, <=, ivalue);
+        DISPATCH();
+
+    CASE(BC_DGE):
+        BINARY(dvalue, >=, ivalue);
+        DISPATCH();
+
+    CASE(BC_DEQ):
+        BINARY(dvalue, ==, ivalue);
+        DISPATCH();
+
+    CASE(BC_DNE):
+        BINARY(dvalue, !=, ivalue);
+        DISPATCH();
+
+    CASE(BC_DNEG):
+        sp[-1].dvalue = -sp[-1].dvalue;
+        DISPATCH();
+
+    CASE(BC_I2F):
+        sp[-1].fvalue = (float)sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_U2F):
+        sp[-1].fvalue = (float)(unsigned int)sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_F2I):
+        sp[-1].ivalue = (int)sp[-1].fvalue;
+        DISPATCH();
+
+    CASE(BC_F2U):
+        sp[-1].ivalue = (int)(unsigned int)sp[-1].fvalue;
+        DISPATCH();
+
+    CASE(BC_F2B):
+        sp[-1].ivalue = sp[-1].fvalue != 0.0f;
+        DISPATCH();
+
+    CASE(BC_I2B):
+        sp[-1].ivalue = sp[-1].ivalue != 0;
+        DISPATCH();
+
+    CASE(BC_I2C):
+        sp[-1].ivalue = (char)sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_I2S):
+        sp[-1].ivalue = (short)sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_I2L):
+        sp[-1].lvalue = sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_U2L):
+        sp[-1].lvalue = (unsigned int)sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_L2I):
+        sp[-1].ivalue = (int)sp[-1].lvalue;
+        DISPATCH();
+
+    CASE(BC_L2B):
+        sp[-1].ivalue = sp[-1].lvalue != 0;
+        DISPATCH();
+
+    CASE(BC_L2F):
+        sp[-1].fvalue = (float)sp[-1].lvalue;
+        DISPATCH();
+
+    CASE(BC_L2D):
+        sp[-1].dvalue = (double)sp[-1].lvalue;
+        DISPATCH();
+
+    CASE(BC_F2L):
+        sp[-1].lvalue = (int64_t)sp[-1].fvalue;
+        DISPATCH();
+
+    CASE(BC_D2L):
+        sp[-1].lvalue = (int64_t)sp[-1].dvalue;
+        DISPATCH();
+
+    CASE(BC_I2D):
+        sp[-1].dvalue = sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_U2D):
+        sp[-1].dvalue = (unsigned int)sp[-1].ivalue;
+        DISPATCH();
+
+    CASE(BC_F2D):
+        sp[-1].dvalue = sp[-1].fvalue;
+        DISPATCH();
+
+    CASE(BC_D2F):
+        sp[-1].fvalue = (float)sp[-1].dvalue;
+        DISPATCH();
+
+    CASE(BC_D2I):
+        sp[-1].ivalue = (int)sp[-1].dvalue;
+        DISPATCH();
+
+    CASE(BC_D2U):
+        sp[-1].ivalue = (int)(unsigned int)sp[-1].dvalue;
+        DISPATCH();
+
+    CASE(BC_D2B):
+        sp[-1].ivalue = sp[-1].dvalue != 0.0;
+        DISPATCH();
+
+    CASE(BC_JUMP):
+        ip = code + ip[0];
+        DISPATCH();
+
+    CASE(BC_JUMP_IF_FALSE):
+        if ((--sp)->ivalue)
+            ip++;
+        else
+            ip = code + ip[0];
+        DISPATCH();
+
+    CASE(BC_JUMP_IF_TRUE):
+        if ((--sp)->ivalue)
+            ip = code + ip[0];
+        else
+            ip++;
+        DISPATCH();
+
+    CASE(BC_JUMP_ILT):
+        COMPARE_JUMP(int, <);
+        DISPATCH();
+
+    CASE(BC_JUMP_IGT):
+        COMPARE_JUMP(int, >);
+        DISPATCH();
+
+    CASE(BC_JUMP_ILE):
+        COMPARE_JUMP(int, <=);
+        DISPATCH();
+
+    CASE(BC_JUMP_IGE):
+        COMPARE_JUMP(int, >=);
+        DISPATCH();
+
+    CASE(BC_JUMP_IEQ):
+        COMPARE_JUMP(int, ==);
+        DISPATCH();
+
+    CASE(BC_JUMP_INE):
+        COMPARE_JUMP(int, !=);
+        DISPATCH();
+
+    CASE(BC_JUMP_ULT):
+        COMPARE_JUMP(unsigned int, <);
+        DISPATCH();
+
+    CASE(BC_JUMP_UGT):
+        COMPARE_JUMP(unsigned int, >);
+        DISPATCH();
+
+    CASE(BC_JUMP_ULE):
+        COMPARE_JUMP(unsigned int, <=);
+        DISPATCH();
+
+    CASE(BC_JUMP_UGE):
+        COMPARE_JUMP(unsigned int, >=);
+        DISPATCH();
+
+    CASE(BC_SWITCH_DENSE):
+    {
+        unsigned int index = (unsigned int)(--sp)->ivalue - (unsigned int)ip[0];
+        ip = code + (index < (unsigned int)ip[1] ? ip[3 + index] : ip[2]);
+        DISPATCH();
+    }
+
+    CASE(BC_SWITCH_SPARSE):
+    {
+        int value = (--sp)->ivalue;
+        const int32_t *pairs = ip + 2;
+        int32_t target = ip[1];
+        int low = 0;
+        int high = ip[0] - 1;
+        while (low <= high)
+        {
+            int mid = low + (high - low) / 2;
+            if (pairs[2 * mid] == value)
+            {
+                target = pairs[2 * mid + 1];
+                break;
+            }
+            if (pairs[2 * mid] < value)
+                low = mid + 1;
+            else
+                high = mid - 1;
+        }
+        ip = code + target;
+        DISPATCH();
+    }
+
+    CASE(BC_PRINT):
+        sp -= ip[1];
+        print_format(chunk->formats[ip[0]], sp);
+        ip += 2;
+        DISPATCH();
+
+    CASE(BC_BAKA_VALUE):
+        if (ip[0] >= 0)
+            baka("%s\n", chunk->strings[ip[0]]);
+        else
+            format_write_int(OUTPUT_STDERR, (--sp)->ivalue, "\n");
+        ip++;
+        DISPATCH();
+
+    CASE(BC_CALL):
+    {
+        const ChunkFunction *function = &chunk->functions[*ip++];
+        sp -= function->parameter_count;
+        variable *frame = push_frame(function->frame_size);
+        if (!frame)
+        {
+            if (current_program->halted)
+                goto halt;
+            (sp++)->lvalue = 0;
+            DISPATCH();
+        }
+        for (int i = 0; i < function->parameter_count; i++)
+        {
+            frame[i].value = sp[i];
+        }
+        calls[call_depth++] = (CallRecord){ip, symbols, function->frame_size};
+        symbols = frame;
+        ip = code + function->entry;
+        DISPATCH();
+    }
+
+    CASE(BC_RETURN):
+    {
+        // The result is already where the caller expects it
+        const CallRecord *call = &calls[--call_depth];
+        pop_frame(symbols, call->frame_size);
+        symbols = call->symbols;
+        ip = call->ip;
+        DISPATCH();
+    }
+
+    CASE(BC_HALT):
+        current_program->result = *--sp;
+        free(stack);
+        free(calls);
+        return;
+
+    halt:
+        // An error the program cannot run past: release the frames of the calls it cut short
+        while (call_depth > 0)
+        {
+            const CallRecord *call = &calls[--call_depth];
+            pop_frame(symbols, call->frame_size);
+            symbols = call->symbols;
+        }
+        free(stack);
+        free(calls);
+        return;
+
+#if !defined(__GNUC__)
+        }
+    }
+#endif
+}
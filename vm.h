@@ -0,0 +1,11 @@
+/* vm.h */
+
+#ifndef VM_H
+#define VM_H
+
+#include "compiler.h"
+
+/* Run a compiled program against the current program's symbol table */
+void vm_execute(Chunk *chunk);
+
+#endif /* VM_H */